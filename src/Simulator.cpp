@@ -9,6 +9,8 @@
 
 #include "Simulator.h"
 
+#include "perf/Trace.h"
+
 namespace tea_gui {
 
 /*
@@ -95,6 +97,7 @@ void Simulator::update(double delta_seconds) {
   if (!running_) {
     return;
   }
+  TEA_TRACE_SCOPE("gui.update", "gui", "batches", batch_count_);
   bool any_active = false;
   for (TeaBatch& b : batches_) {
     if (b.process() != tea::ProcessState::FINISHED) {
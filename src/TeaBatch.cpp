@@ -30,12 +30,17 @@ constexpr int kRollingSeconds = 30;
 constexpr int kDryingSeconds = 60;
 
 /*
- * @brief 小数dtの蓄積で 1.0 に届かないケースを吸収する許容誤差です。
+ * @brief 小数dtの蓄積で刻みに届かないケースを吸収する許容誤差（ミリ秒）です。
  *
- * 例: 0.1 を10回足した結果が 0.999999999... になるケースでも、
+ * 例: 0.1 を10回足した結果が 0.999999999... 秒になるケースでも、
  * 1秒ステップが発火するようにします。
  */
-constexpr double kTimeAccumulatorEpsilon = 1e-9;
+constexpr double kTimeAccumulatorEpsilonMs = 1e-6;
+
+/*
+ * @brief 1 回の判定で数える刻み数の上限です（極端な deltaTime で整数が溢れないようにします）。
+ */
+constexpr double kMaxPendingSteps = 1e15;
 
 } /* namespace */
 
@@ -106,9 +111,9 @@ void TeaBatch::set_model(tea::ModelType type) {
  * 品質スコアをリセットします。
  */
 void TeaBatch::reset() {
-  time_accumulator_seconds_ = 0.0;
-  elapsed_seconds_ = 0;
-  stage_remaining_seconds_ = kSteamingSeconds;
+  time_accumulator_ms_ = 0.0;
+  elapsed_ms_ = 0;
+  stage_remaining_ms_ = kSteamingSeconds * tea::kMillisecondsPerSecond;
 
   leaf_ = tea::TeaLeaf(); // TeaLeafを初期化
 
@@ -121,6 +126,24 @@ void TeaBatch::reset() {
       std::make_unique<tea::SteamingProcess>(model_params_.steaming);
 }
 
+/*
+ * @brief 物理更新の刻みを設定します。
+ *
+ * @param seconds 刻み（秒、1 ms 単位へ丸め、1 ms 未満は 1 ms）
+ */
+void TeaBatch::set_time_step(double seconds) {
+  time_step_ms_ = std::max<std::int64_t>(1, tea::to_milliseconds(seconds));
+}
+
+/*
+ * @brief 物理更新の刻みを返します。
+ *
+ * @return 刻み（秒）
+ */
+double TeaBatch::time_step_seconds() const {
+  return tea::to_seconds(time_step_ms_);
+}
+
 /*
  * @brief deltaTime（秒）だけバッチの状態を進めます。
  *
@@ -135,38 +158,56 @@ void TeaBatch::update(double delta_seconds) {
   }
 
   /*
-    GUI版はフレーム単位で dt が渡されるため、小数秒を蓄積して 1 秒単位で
-    工程へ適用します。工程境界を跨ぐ場合は残り時間で分割します。
+    GUI版はフレーム単位で dt が渡されるため、小数秒をミリ秒で蓄積して
+    刻み（time_step_ms_）単位で工程へ適用します。フレームの長さによらず
+    同じ刻みで積分するため、結果はフレームレートに依存しません。
+    工程境界を跨ぐ場合は残り時間ちょうどの刻みで分割します。
   */
-  time_accumulator_seconds_ += std::max(0.0, delta_seconds);
-
-  while (time_accumulator_seconds_ + kTimeAccumulatorEpsilon >= 1.0) {
-    if (current_process_handler_ == nullptr) {
-      break;
+  time_accumulator_ms_ += std::max(0.0, delta_seconds) *
+                          static_cast<double>(tea::kMillisecondsPerSecond);
+
+  while (current_process_handler_ != nullptr) {
+    if (stage_remaining_ms_ <= 0) {
+      stage_remaining_ms_ =
+          default_stage_seconds(current_process_handler_->state()) *
+          tea::kMillisecondsPerSecond;
     }
 
-    if (stage_remaining_seconds_ <= 0) {
-      stage_remaining_seconds_ =
-          default_stage_seconds(current_process_handler_->state());
+    const std::int64_t available = static_cast<std::int64_t>(
+        std::min(kMaxPendingSteps,
+                 std::floor((time_accumulator_ms_ + kTimeAccumulatorEpsilonMs) /
+                            static_cast<double>(time_step_ms_))));
+
+    /*
+      工程の残りに収まる刻みはまとめて適用し、工程末尾の刻みに満たない端数は
+      蓄積が足りていれば 1 回で刻みます（境界を刻みの倍数に丸めません）。
+    */
+    const std::int64_t full =
+        std::min(available, stage_remaining_ms_ / time_step_ms_);
+    std::int64_t advanced_ms = full * time_step_ms_;
+    if (full > 0) {
+      current_process_handler_->apply_steps(
+          leaf_, tea::to_seconds(time_step_ms_), static_cast<int>(full));
     }
-
-    const int available =
-        static_cast<int>(std::floor(time_accumulator_seconds_ +
-                                    kTimeAccumulatorEpsilon));
-    if (available <= 0) {
+    const std::int64_t last_ms = stage_remaining_ms_ - advanced_ms;
+    if (last_ms > 0 && last_ms < time_step_ms_ &&
+        time_accumulator_ms_ - static_cast<double>(advanced_ms) +
+                kTimeAccumulatorEpsilonMs >=
+            static_cast<double>(last_ms)) {
+      current_process_handler_->apply_step(leaf_, tea::to_seconds(last_ms));
+      advanced_ms += last_ms;
+    }
+    if (advanced_ms <= 0) {
       break;
     }
-    const int step = std::min(available, stage_remaining_seconds_);
-
-    current_process_handler_->apply_step(leaf_, step);
     tea::normalize(leaf_);
 
-    elapsed_seconds_ += step;
-    stage_remaining_seconds_ -= step;
-    time_accumulator_seconds_ =
-        std::max(0.0, time_accumulator_seconds_ - static_cast<double>(step));
+    elapsed_ms_ += advanced_ms;
+    stage_remaining_ms_ -= advanced_ms;
+    time_accumulator_ms_ = std::max(
+        0.0, time_accumulator_ms_ - static_cast<double>(advanced_ms));
 
-    if (stage_remaining_seconds_ > 0) {
+    if (stage_remaining_ms_ > 0) {
       continue;
     }
 
@@ -174,19 +215,19 @@ void TeaBatch::update(double delta_seconds) {
     if (state == tea::ProcessState::STEAMING) {
       current_process_handler_ =
           std::make_unique<tea::RollingProcess>(model_params_.rolling);
-      stage_remaining_seconds_ = kRollingSeconds;
+      stage_remaining_ms_ = kRollingSeconds * tea::kMillisecondsPerSecond;
       continue;
     }
     if (state == tea::ProcessState::ROLLING) {
       current_process_handler_ =
           std::make_unique<tea::DryingProcess>(model_params_.drying);
-      stage_remaining_seconds_ = kDryingSeconds;
+      stage_remaining_ms_ = kDryingSeconds * tea::kMillisecondsPerSecond;
       continue;
     }
     if (state == tea::ProcessState::DRYING) {
       current_process_handler_.reset();
-      stage_remaining_seconds_ = 0;
-      time_accumulator_seconds_ = 0.0;
+      stage_remaining_ms_ = 0;
+      time_accumulator_ms_ = 0.0;
 
       if (!has_quality_score_final_) {
         quality_score_final_ = quality_score();
@@ -214,8 +255,8 @@ tea::ProcessState TeaBatch::process() const {
  *
  * @return 経過時間（秒）
  */
-int TeaBatch::elapsed_seconds() const {
-  return elapsed_seconds_;
+double TeaBatch::elapsed_seconds() const {
+  return tea::to_seconds(elapsed_ms_);
 }
 
 /*
@@ -9,6 +9,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <memory> // For std::unique_ptr
 
@@ -17,6 +18,7 @@
 #include "domain/ProcessState.h"
 #include "process/IProcess.h" // For IProcess
 #include "domain/TeaLeaf.h" // For tea::TeaLeaf
+#include "domain/TimeStep.h" // For tea::kMillisecondsPerSecond
 
 namespace tea_gui {
 
@@ -35,14 +37,24 @@ class TeaBatch final {
   /* 初期状態へ戻します。 */
   void reset();
 
+  /*
+    物理更新の刻み（秒、1 ms 単位、既定 1 秒）を設定します。
+    update で渡した時間はこの刻みで工程へ適用し、工程の境界では
+    残り時間ちょうどの刻みで止めます（1 ms 未満は 1 ms とみなします）。
+  */
+  void set_time_step(double seconds);
+
+  /* 物理更新の刻み（秒）を返します。 */
+  double time_step_seconds() const;
+
   /* deltaTime（秒）だけ状態を進めます。 */
   void update(double delta_seconds);
 
   /* 現在工程を返します。 */
   tea::ProcessState process() const;
 
-  /* 経過時間（秒）を返します。 */
-  int elapsed_seconds() const;
+  /* 経過時間（秒、1 ms 単位）を返します。 */
+  double elapsed_seconds() const;
 
   /* 各状態量を返します。 */
   double moisture() const;
@@ -65,14 +77,17 @@ class TeaBatch final {
   
   std::unique_ptr<tea::IProcess> current_process_handler_;
   
-  /* フレーム単位の経過時間を蓄積し、1秒単位で工程へ適用します。 */
-  double time_accumulator_seconds_ = 0.0;
+  /* 物理更新の刻み（ミリ秒）です。 */
+  std::int64_t time_step_ms_ = tea::kMillisecondsPerSecond;
+
+  /* フレーム単位の経過時間（ミリ秒）を蓄積し、刻み単位で工程へ適用します。 */
+  double time_accumulator_ms_ = 0.0;
 
-  /* 離散時間（秒）での経過を保持します。 */
-  int elapsed_seconds_ = 0;
+  /* 離散時間（ミリ秒）での経過を保持します。 */
+  std::int64_t elapsed_ms_ = 0;
 
-  /* 現在工程の残り時間（秒）です。 */
-  int stage_remaining_seconds_ = 0;
+  /* 現在工程の残り時間（ミリ秒）です。 */
+  std::int64_t stage_remaining_ms_ = 0;
 
   tea::TeaLeaf leaf_; // 追加
 
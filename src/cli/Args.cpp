@@ -9,14 +9,25 @@
 
 #include "cli/Args.h"
 
-#include <cstdlib> // For std::strtol
+#include <cmath>
+#include <cstdint>
+#include <cstdlib> // For std::strtol, std::strtod
 #include <string>  // For std::string
 #include <optional> // For std::optional
 
+#include "domain/TimeStep.h"
+
 namespace tea_cli {
 
 namespace {
 
+/* ファイルをバッチごとに分ける場合と、多重化出力の場合のバッチ数上限です。 */
+constexpr int kMaxBatches = 128;
+constexpr int kMaxMultiplexBatches = 65536;
+
+/* --result-cache-size の上限（エントリ数）です。 */
+constexpr long kMaxResultCacheEntries = 1L << 24;
+
 /*
  * @brief 文字列を正の整数へ変換します。
  *
@@ -40,6 +51,177 @@ std::optional<int> parse_positive_int(const char* s) {
   return static_cast<int>(v);
 }
 
+/*
+ * @brief 文字列を正の秒数（小数は 3 桁まで、ミリ秒単位）へ変換します。
+ *
+ * "0.1" や "2" のような 10 進表記だけを受け付け、上限は parse_positive_int と
+ * 同じ 1 日です。ミリ秒より細かい値は時刻を整数ミリ秒で数える都合で扱えないため、
+ * 丸めずに不正値とします。
+ *
+ * @param s 変換する文字列
+ * @return 変換された秒数、またはstd::nullopt
+ */
+std::optional<double> parse_positive_seconds(const char* s) {
+  if (s == nullptr || *s == '\0') {
+    return std::nullopt;
+  }
+  const char* p = s;
+  while (*p >= '0' && *p <= '9') {
+    ++p;
+  }
+  if (*p == '.') {
+    const char* frac = ++p;
+    while (*p >= '0' && *p <= '9') {
+      ++p;
+    }
+    if (p == frac || p - frac > 3) {
+      return std::nullopt;
+    }
+  }
+  if (*p != '\0' || p == s || *s == '.') {
+    return std::nullopt;
+  }
+  const double v = std::strtod(s, nullptr);
+  if (!(v > 0.0) || v > 24 * 60 * 60) { // 1日（秒）を最大値とする
+    return std::nullopt;
+  }
+  return v;
+}
+
+/*
+ * @brief 文字列を [0, 1] の割合（水分率など）へ変換します。
+ *
+ * @param s 変換する文字列
+ * @return 変換された値、またはstd::nullopt
+ */
+std::optional<double> parse_fraction(const char* s) {
+  if (s == nullptr || *s == '\0') {
+    return std::nullopt;
+  }
+  char* end = nullptr;
+  const double v = std::strtod(s, &end);
+  if (end == s || *end != '\0' || !(v >= 0.0 && v <= 1.0)) {
+    return std::nullopt;
+  }
+  return v;
+}
+
+/*
+ * @brief 文字列を 0 以上の整数へ変換します（上限は parse_positive_int と同じ）。
+ *
+ * @param s 変換する文字列
+ * @return 変換された整数、またはstd::nullopt
+ */
+std::optional<int> parse_non_negative_int(const char* s) {
+  if (s != nullptr && std::string(s) == "0") {
+    return 0;
+  }
+  return parse_positive_int(s);
+}
+
+/*
+ * @brief "from:to:step" 形式のスイープ範囲を解析します。
+ *
+ * 各値は正の整数で、from <= to である必要があります。
+ *
+ * @param s 変換する文字列
+ * @return 解析結果、またはstd::nullopt
+ */
+std::optional<SweepRange> parse_sweep_range(const char* s) {
+  if (s == nullptr) {
+    return std::nullopt;
+  }
+  const std::string text(s);
+  const std::size_t c1 = text.find(':');
+  const std::size_t c2 =
+      (c1 == std::string::npos) ? std::string::npos : text.find(':', c1 + 1);
+  if (c2 == std::string::npos) {
+    return std::nullopt;
+  }
+  const auto from = parse_positive_int(text.substr(0, c1).c_str());
+  const auto to = parse_positive_int(text.substr(c1 + 1, c2 - c1 - 1).c_str());
+  const auto step = parse_positive_int(text.substr(c2 + 1).c_str());
+  if (!from.has_value() || !to.has_value() || !step.has_value() ||
+      *from > *to) {
+    return std::nullopt;
+  }
+  SweepRange r;
+  r.from = *from;
+  r.to = *to;
+  r.step = *step;
+  return r;
+}
+
+/*
+ * @brief "v1,v2,..." 形式の正の実数の列を解析します。
+ *
+ * @param s 変換する文字列
+ * @return 解析結果（空要素や 0 以下の値を含む場合は std::nullopt）
+ */
+std::optional<std::vector<double>> parse_positive_list(const char* s) {
+  if (s == nullptr || *s == '\0') {
+    return std::nullopt;
+  }
+  std::vector<double> values;
+  const char* p = s;
+  while (true) {
+    char* end = nullptr;
+    const double v = std::strtod(p, &end);
+    if (end == p || !(v > 0.0) || !std::isfinite(v)) {
+      return std::nullopt;
+    }
+    values.push_back(v);
+    if (*end == '\0') {
+      return values;
+    }
+    if (*end != ',') {
+      return std::nullopt;
+    }
+    p = end + 1;
+  }
+}
+
+/*
+ * @brief 指定されたモードのうち、オイラー法でしか実行しないものの名前を返します。
+ *
+ * main() の分岐と同じ順に調べます。これらのモードは run_batches より前に
+ * 分岐するため、--integrator rk45 を指定しても黙って無視されてしまいます。
+ *
+ * @param args 解析済みの引数
+ * @return オプション名（該当なしなら nullptr）
+ */
+const char* euler_only_mode(const Args& args) {
+  if (!args.serve_path.empty()) {
+    return "--serve";
+  }
+  if (!args.decode_path.empty()) {
+    return "--decode";
+  }
+  if (args.optimize) {
+    return "--optimize";
+  }
+  if (!args.result_cache_path.empty()) {
+    return "--result-cache";
+  }
+  if (args.precision_check) {
+    return "--precision-check";
+  }
+  if (!args.calibrate_paths.empty()) {
+    return "--calibrate";
+  }
+  if (args.sensitivity) {
+    return "--sensitivity";
+  }
+  if (args.events) {
+    return "--events";
+  }
+  if (args.sweep_steaming.has_value() || args.sweep_rolling.has_value() ||
+      args.sweep_drying.has_value() || !args.sweep_dry_k.empty()) {
+    return "--sweep-*";
+  }
+  return nullptr;
+}
+
 } /* namespace */
 
 /*
@@ -68,9 +250,63 @@ Args parse_args(int argc, char** argv) {
       continue;
     }
 
+    if (a == "--stats") {
+      args.stats = true;
+      continue;
+    }
+
+    if (a == "--optimize") {
+      args.optimize = true;
+      continue;
+    }
+
+    if (a == "--compress") {
+      args.compress = true;
+      continue;
+    }
+
+    if (a == "--preallocate") {
+      args.preallocate = true;
+      continue;
+    }
+
+    if (a == "--direct") {
+      args.direct_io = true;
+      continue;
+    }
+
+    if (a == "--precision-check") {
+      args.precision_check = true;
+      continue;
+    }
+
+    if (a == "--sweep-prune") {
+      args.sweep_prune = true;
+      continue;
+    }
+
+    if (a == "--sensitivity") {
+      args.sensitivity = true;
+      continue;
+    }
+
+    if (a == "--events") {
+      args.events = true;
+      continue;
+    }
+
     if (a == "--dt" || a == "--steaming" || a == "--rolling" ||
         a == "--drying" || a == "--csv" || a == "--model" ||
-        a == "--batches") {
+        a == "--batches" || a == "--budget" || a == "--sweep-steaming" ||
+        a == "--sweep-rolling" || a == "--sweep-drying" ||
+        a == "--sweep-dry-k" ||
+        a == "--cache-size" || a == "--stats-json" || a == "--trace" ||
+        a == "--csv-format" || a == "--decode" || a == "--multiplex" ||
+        a == "--batch" || a == "--from" || a == "--to" || a == "--io" ||
+        a == "--serve" || a == "--workers" || a == "--result-cache" ||
+        a == "--result-cache-size" || a == "--integrator" ||
+        a == "--sample-interval" || a == "--moisture-target" ||
+        a == "--calibrate") {
       if (i + 1 >= argc) {
         args.error = "Missing value for " + a;
         return args;
@@ -86,6 +322,133 @@ Args parse_args(int argc, char** argv) {
         continue;
       }
 
+      if (a == "--csv-format") {
+        args.csv_format = v ? v : "";
+        if (args.csv_format != "text" && args.csv_format != "quantized") {
+          args.error = "Invalid CSV format: " + args.csv_format;
+          return args;
+        }
+        continue;
+      }
+
+      if (a == "--integrator") {
+        args.integrator = v ? v : "";
+        if (args.integrator != "euler" && args.integrator != "rk45") {
+          args.error = "Invalid integrator: " + args.integrator;
+          return args;
+        }
+        continue;
+      }
+
+      if (a == "--io") {
+        args.io_backend = v ? v : "";
+        if (args.io_backend != "stream" && args.io_backend != "uring") {
+          args.error = "Invalid I/O backend: " + args.io_backend;
+          return args;
+        }
+        continue;
+      }
+
+      if (a == "--decode") {
+        args.decode_path = v ? v : "";
+        if (args.decode_path.empty()) {
+          args.error = "decode path is empty";
+          return args;
+        }
+        continue;
+      }
+
+      if (a == "--serve") {
+        args.serve_path = v ? v : "";
+        if (args.serve_path.empty()) {
+          args.error = "socket path is empty";
+          return args;
+        }
+        continue;
+      }
+
+      if (a == "--calibrate") {
+        const std::string path = v ? v : "";
+        if (path.empty()) {
+          args.error = "calibration trace path is empty";
+          return args;
+        }
+        args.calibrate_paths.push_back(path);
+        continue;
+      }
+
+      if (a == "--result-cache") {
+        args.result_cache_path = v ? v : "";
+        if (args.result_cache_path.empty()) {
+          args.error = "result cache path is empty";
+          return args;
+        }
+        continue;
+      }
+
+      if (a == "--result-cache-size") {
+        char* end = nullptr;
+        const long n = v ? std::strtol(v, &end, 10) : 0;
+        if (v == nullptr || end == v || *end != '\0' || n <= 0 ||
+            n > kMaxResultCacheEntries) {
+          args.error = "Invalid result cache size: " + std::string(v ? v : "");
+          return args;
+        }
+        args.result_cache_entries = static_cast<int>(n);
+        continue;
+      }
+
+      if (a == "--multiplex") {
+        args.multiplex_path = v ? v : "";
+        if (args.multiplex_path.empty()) {
+          args.error = "multiplex path is empty";
+          return args;
+        }
+        continue;
+      }
+
+      if (a == "--batch") {
+        const auto parsed = parse_non_negative_int(v);
+        if (!parsed.has_value()) {
+          args.error = "Invalid batch: " + std::string(v ? v : "");
+          return args;
+        }
+        args.decode_batch = *parsed;
+        continue;
+      }
+
+      if (a == "--from" || a == "--to") {
+        const auto parsed = parse_non_negative_int(v);
+        if (!parsed.has_value()) {
+          args.error = "Invalid time for " + a + ": " + std::string(v ? v : "");
+          return args;
+        }
+        if (a == "--from") {
+          args.decode_from = parsed;
+        } else {
+          args.decode_to = parsed;
+        }
+        continue;
+      }
+
+      if (a == "--trace") {
+        args.trace_path = v ? v : "";
+        if (args.trace_path.empty()) {
+          args.error = "trace path is empty";
+          return args;
+        }
+        continue;
+      }
+
+      if (a == "--stats-json") {
+        args.stats_json_path = v ? v : "";
+        if (args.stats_json_path.empty()) {
+          args.error = "stats JSON path is empty";
+          return args;
+        }
+        continue;
+      }
+
       if (a == "--model") {
         args.model = v ? v : "";
         if (args.model != "default" && args.model != "gentle" &&
@@ -98,7 +461,7 @@ Args parse_args(int argc, char** argv) {
 
       if (a == "--batches") {
         const auto parsed = parse_positive_int(v);
-        if (!parsed.has_value() || *parsed > 128) {
+        if (!parsed.has_value() || *parsed > kMaxMultiplexBatches) {
           args.error = "Invalid batches: " + std::string(v ? v : "");
           return args;
         }
@@ -106,20 +469,80 @@ Args parse_args(int argc, char** argv) {
         continue;
       }
 
+      if (a == "--dt" || a == "--sample-interval") {
+        const auto parsed = parse_positive_seconds(v);
+        if (!parsed.has_value()) {
+          args.error = "Invalid value for " + a + ": " +
+                       std::string(v ? v : "") +
+                       " (expected seconds with up to 3 decimals)";
+          return args;
+        }
+        if (a == "--dt") {
+          args.dt_seconds = *parsed;
+        } else {
+          args.sample_seconds = *parsed;
+        }
+        continue;
+      }
+
+      if (a == "--moisture-target") {
+        const auto parsed = parse_fraction(v);
+        if (!parsed.has_value()) {
+          args.error = "Invalid moisture target: " + std::string(v ? v : "") +
+                       " (expected 0..1)";
+          return args;
+        }
+        args.moisture_target = *parsed;
+        continue;
+      }
+
+      if (a == "--sweep-dry-k") {
+        const auto values = parse_positive_list(v);
+        if (!values.has_value()) {
+          args.error = "Invalid list for --sweep-dry-k: " +
+                       std::string(v ? v : "") + " (expected k1,k2,...)";
+          return args;
+        }
+        args.sweep_dry_k = *values;
+        continue;
+      }
+
+      if (a == "--sweep-steaming" || a == "--sweep-rolling" ||
+          a == "--sweep-drying") {
+        const auto range = parse_sweep_range(v);
+        if (!range.has_value()) {
+          args.error = "Invalid range for " + a + ": " +
+                       std::string(v ? v : "") + " (expected from:to:step)";
+          return args;
+        }
+        if (a == "--sweep-steaming") {
+          args.sweep_steaming = range;
+        } else if (a == "--sweep-rolling") {
+          args.sweep_rolling = range;
+        } else {
+          args.sweep_drying = range;
+        }
+        continue;
+      }
+
       const auto parsed = parse_positive_int(v);
       if (!parsed.has_value()) {
         args.error = "Invalid value for " + a + ": " + (v ? v : "");
         return args;
       }
 
-      if (a == "--dt") {
-        args.dt_seconds = *parsed;
-      } else if (a == "--steaming") {
+      if (a == "--steaming") {
         args.steaming_seconds = *parsed;
       } else if (a == "--rolling") {
         args.rolling_seconds = *parsed;
       } else if (a == "--drying") {
         args.drying_seconds = *parsed;
+      } else if (a == "--budget") {
+        args.budget_seconds = *parsed;
+      } else if (a == "--cache-size") {
+        args.cache_size = *parsed;
+      } else if (a == "--workers") {
+        args.serve_workers = *parsed;
       }
       continue;
     }
@@ -132,11 +555,50 @@ Args parse_args(int argc, char** argv) {
     args.error = "dt_seconds must be > 0";
     return args;
   }
+  const std::int64_t dt_ms = tea::to_milliseconds(args.dt_seconds);
+  const std::int64_t sample_ms = tea::to_milliseconds(args.sample_seconds);
+  if (args.sample_seconds > 0 && sample_ms % dt_ms != 0) {
+    args.error = "--sample-interval must be a multiple of --dt";
+    return args;
+  }
+  if (args.csv_format == "quantized" &&
+      (args.sample_seconds > 0 ? sample_ms : dt_ms) %
+              tea::kMillisecondsPerSecond !=
+          0) {
+    /* .teaq は経過時間を整数秒で持つため、1 秒未満の出力時刻を表せません。 */
+    args.error =
+        "quantized output needs whole-second rows "
+        "(use an integral --dt or --sample-interval)";
+    return args;
+  }
   if (args.steaming_seconds <= 0 || args.rolling_seconds <= 0 ||
       args.drying_seconds <= 0) {
     args.error = "stage seconds must be > 0";
     return args;
   }
+  if (args.batches > kMaxBatches && args.multiplex_path.empty() &&
+      args.result_cache_path.empty()) {
+    args.error = "batches > " + std::to_string(kMaxBatches) +
+                 " requires --multiplex or --result-cache (one file per batch)";
+    return args;
+  }
+  if (args.decode_from.has_value() && args.decode_to.has_value() &&
+      *args.decode_from > *args.decode_to) {
+    args.error = "--from must be <= --to";
+    return args;
+  }
+  if (args.integrator != "euler") {
+    const char* mode = euler_only_mode(args);
+    if (mode != nullptr) {
+      args.error = std::string(mode) +
+                   " follows the euler integrator (drop --integrator rk45)";
+      return args;
+    }
+  }
+  if (args.optimize && args.budget_seconds < 3) {
+    args.error = "budget must be >= 3 seconds (1s per stage)";
+    return args;
+  }
 
   return args;
 }
@@ -156,14 +618,66 @@ const char* help_text() {
       "  tea_factory_simulator_cli [options]\n"
       "\n"
       "Options:\n"
-      "  --dt <sec>        Time step seconds (default: 1)\n"
+      "  --dt <sec>        Time step seconds, down to 0.001 (default: 1)\n"
+      "  --sample-interval <sec>  Write one row every <sec> seconds\n"
+      "                    (multiple of --dt; default: every step)\n"
       "  --steaming <sec>  Steaming duration (default: 30)\n"
       "  --rolling <sec>   Rolling duration (default: 30)\n"
       "  --drying <sec>    Drying duration (default: 60)\n"
       "  --model <name>    Model: default|gentle|aggressive\n"
-      "  --batches <n>     Batch count (default: 1, max: 128)\n"
+      "  --integrator <name>  Integrator: euler|rk45 (default: euler)\n"
+      "                    rk45 integrates adaptively and samples every\n"
+      "                    --sample-interval (or --dt); batch runs only\n"
+      "  --batches <n>     Batch count (default: 1, max: 128;\n"
+      "                    65536 with --multiplex)\n"
       "  --csv <path>      CSV output path (default: tea_factory_cli.csv)\n"
       "  --no-csv          Disable CSV output\n"
+      "  --csv-format <f>  Output encoding: text|quantized (default: text)\n"
+      "                    quantized writes compact .teaq files\n"
+      "  --multiplex <path>  Write all batches into one file (CSV with a\n"
+      "                    batch column, or indexed .team when quantized)\n"
+      "  --compress        LZ4-compress output files (adds .lz4)\n"
+      "  --io <backend>    Output writes: stream|uring (default: stream)\n"
+      "                    uring falls back to pwrite when unavailable\n"
+      "  --preallocate     Preallocate output files from the predicted size\n"
+      "  --direct          Write output files with O_DIRECT (aligned buffers)\n"
+      "  --decode <path>   Decode a .teaq/.lz4 output file to CSV on stdout\n"
+      "  --batch <n>       Batch to extract when decoding a .team file\n"
+      "  --from <sec>, --to <sec>\n"
+      "                    Time range to extract from a .team file\n"
+      "  --stats           Print hot-path counters to stderr at exit\n"
+      "  --stats-json <path>  Dump hot-path counters as JSON at exit\n"
+      "  --trace <path>    Write Chrome trace_event JSON at exit\n"
+      "  --optimize        Search stage durations maximizing quality score\n"
+      "  --budget <sec>    Total time budget for --optimize (default: 240)\n"
+      "  --precision-check Compare float32 vs float64 results for all models\n"
+      "                    (uses --batches leaves per model)\n"
+      "  --sensitivity     Print d(moisture/aroma/color/score)/d(param) for\n"
+      "                    every model coefficient (one pass, autodiff)\n"
+      "  --calibrate <csv> Fit model coefficients to measured traces in\n"
+      "                    CsvWriter's CSV layout (repeatable; starts from\n"
+      "                    --model, steps with --dt)\n"
+      "  --events          Print stage/threshold/quality events per batch,\n"
+      "                    jumping between events without per-step output\n"
+      "  --moisture-target <v>  Moisture (0..1) to report crossings of\n"
+      "                    with --events\n"
+      "  --sweep-steaming <from:to:step>\n"
+      "  --sweep-rolling <from:to:step>\n"
+      "  --sweep-drying <from:to:step>\n"
+      "                    Sweep stage durations in-process (others fixed)\n"
+      "  --sweep-dry-k <k1,k2,...>  Also sweep the drying rate coefficient\n"
+      "                    (steaming/rolling are reused from the cache)\n"
+      "  --sweep-prune     Skip sweep candidates whose score bound cannot\n"
+      "                    reach GOOD (80) or the best so far\n"
+      "  --cache-size <n>  Stage-boundary cache entries for sweeps\n"
+      "                    and per server worker (default: 1024)\n"
+      "  --result-cache <path>  Print final results per batch, reusing a\n"
+      "                    persistent cache file (skips simulation on hits)\n"
+      "  --result-cache-size <n>  Max cache entries when creating the file\n"
+      "                    (default: 65536; existing files keep theirs)\n"
+      "  --serve <path>    Run as a server on a Unix domain socket\n"
+      "                    (line protocol: simulate/sweep/stats/ping/quit)\n"
+      "  --workers <n>     Server worker threads (default: CPU count)\n"
       "  -h, --help        Show help\n";
 }
 
@@ -2,26 +2,122 @@
 
 #include <optional>
 #include <string>
+#include <vector>
 
 namespace tea_cli {
 
+/* スイープ範囲（from:to:step、両端を含む）です。 */
+struct SweepRange final {
+  int from = 0;
+  int to = 0;
+  int step = 1;
+};
+
 /*
   CLI引数を解釈して、実行設定へ変換します。
   依存を増やさず、最小限のオプションだけ扱います。
 */
 struct Args final {
-  int dt_seconds = 1;
+  /* 時間刻み（秒、1 ms 単位で 1 秒未満も可）です。 */
+  double dt_seconds = 1.0;
+
+  /* 出力の間隔（--sample-interval、秒、dt の倍数。0 なら毎ステップ）です。 */
+  double sample_seconds = 0.0;
+
   int steaming_seconds = 30;
   int rolling_seconds = 30;
   int drying_seconds = 60;
 
   std::string model = "default";
 
+  /*
+    工程の式の積分方法です（euler: dt 秒刻みの前進オイラー,
+    rk45: 適応刻みの Dormand-Prince で積分し出力間隔ごとに出力）。
+  */
+  std::string integrator = "euler";
+
   int batches = 1;
 
+  /* 工程時間の最適化モード（--optimize）と合計時間予算です。 */
+  bool optimize = false;
+  int budget_seconds = 240;
+
+  /* float32/float64 の最終結果の乖離検証モード（--precision-check）です。 */
+  bool precision_check = false;
+
+  /* 最終結果の全パラメータに対する感度（偏微分）を出力するモード（--sensitivity）です。 */
+  bool sensitivity = false;
+
+  /* 係数を較正する計測トレースの CSV（--calibrate、複数指定可。空なら無効）です。 */
+  std::vector<std::string> calibrate_paths;
+
+  /*
+    工程の切り替え・閾値・品質ステータスの変化だけを出力するモード（--events）と、
+    通知する水分の目標値（--moisture-target、0 未満なら通知しません）です。
+  */
+  bool events = false;
+  double moisture_target = -1.0;
+
+  /* 工程時間スイープ（未指定の工程は固定値）と境界キャッシュ容量です。 */
+  std::optional<SweepRange> sweep_steaming;
+  std::optional<SweepRange> sweep_rolling;
+  std::optional<SweepRange> sweep_drying;
+  int cache_size = 1024;
+
+  /* スイープする乾燥速度係数 dry_k の候補（--sweep-dry-k、空なら --model の値）です。 */
+  std::vector<double> sweep_dry_k;
+
+  /* スイープで GOOD（80）と暫定最良に届かない候補を打ち切るか（--sweep-prune）です。 */
+  bool sweep_prune = false;
+
+  /* 計測結果の出力（--stats: 標準エラー, --stats-json: ファイル）です。 */
+  bool stats = false;
+  std::string stats_json_path;
+
+  /* Chrome trace_event JSON の出力先（空なら無効）です。 */
+  std::string trace_path;
+
   bool csv_enabled = true;
   std::string csv_path = "tea_factory_cli.csv";
 
+  /* 出力の符号化（text: CSV, quantized: .teaq）です。 */
+  std::string csv_format = "text";
+
+  /* 全バッチを 1 ファイルへまとめる多重化出力の出力先（空なら無効）です。 */
+  std::string multiplex_path;
+
+  /* --decode で多重化ファイル（.team）から取り出すバッチ番号（-1 なら未指定）です。 */
+  int decode_batch = -1;
+
+  /* --decode で .team から取り出す経過時間の範囲（秒、両端を含む）です。 */
+  std::optional<int> decode_from;
+  std::optional<int> decode_to;
+
+  /* 出力を LZ4 ブロック圧縮するか（--compress、拡張子 .lz4 を付与）です。 */
+  bool compress = false;
+
+  /* 出力ファイルの書き出し方式（stream: std::ofstream, uring: io_uring）です。 */
+  std::string io_backend = "stream";
+
+  /* 出力ファイルを予測行数から fallocate で先に確保するか（--preallocate）です。 */
+  bool preallocate = false;
+
+  /* 出力ファイルを O_DIRECT で書くか（--direct）です。 */
+  bool direct_io = false;
+
+  /* 出力ファイル（.teaq/.lz4）を CSV へ戻して標準出力へ書くモード（--decode）の入力です。 */
+  std::string decode_path;
+
+  /* 最終結果の永続キャッシュ（--result-cache、空なら無効）とエントリ数の上限です。 */
+  std::string result_cache_path;
+  int result_cache_entries = 65536;
+
+  /* 常駐サーバとして待ち受ける Unix ドメインソケットのパス（空なら無効）です。 */
+  std::string serve_path;
+
+  /* --serve のワーカースレッド数（0 ならハードウェアスレッド数）です。 */
+  int serve_workers = 0;
+
   bool show_help = false;
   std::optional<std::string> error;
 };
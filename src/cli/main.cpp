@@ -7,116 +7,871 @@
  * CSVファイルに書き込みます。
  */
 
+#include <algorithm> // For std::min
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <optional>
 #include <sstream>
+#include <string>
 #include <vector>
 
 #include "cli/Args.h"
 #include "io/CsvWriter.h"
+#include "io/Multiplex.h"
+#include "io/OutputSink.h"
+#include "io/QuantizedTrace.h"
 #include "domain/Model.h"
+#include "domain/TimeStep.h"
+#include "perf/Stats.h"
+#include "perf/Trace.h"
+#include "server/SimulationServer.h"
+#include "simulation/AdaptiveSimulator.h"
+#include "simulation/BatchEngine.h"
+#include "simulation/Calibration.h"
+#include "simulation/EventEngine.h"
+#include "simulation/Optimizer.h"
+#include "simulation/OutputPlan.h"
+#include "simulation/PrefixCache.h"
+#include "simulation/ResultCache.h"
+#include "simulation/Sensitivity.h"
 #include "simulation/Simulator.h"
+#include "simulation/Sweep.h"
+
+namespace {
 
 /*
- * @brief CLIアプリケーションのメインエントリポイント
+ * @brief スイープ範囲（未指定なら固定値 1 点）を候補列へ展開します。
  *
- * コマンドライン引数をパースし、シミュレーション設定を行います。
- * 複数のバッチを並行してシミュレートし、その進行状況をコンソールに表示し、
- * 必要に応じてCSVファイルに書き込みます。
+ * @param range スイープ範囲
+ * @param fixed 未指定時の固定値
+ * @return 候補値の列
+ */
+std::vector<int> expand_range(const std::optional<tea_cli::SweepRange>& range,
+                              int fixed) {
+  std::vector<int> values;
+  if (!range.has_value()) {
+    values.push_back(fixed);
+    return values;
+  }
+  for (int v = range->from; v <= range->to; v += range->step) {
+    values.push_back(v);
+  }
+  return values;
+}
+
+/*
+ * @brief 工程時間・乾燥速度係数のスイープをプロセス内で実行し、結果と集計を出力します。
  *
- * @param argc コマンドライン引数の数
- * @param argv コマンドライン引数の配列
- * @return 0 成功、2 引数エラー
+ * @param args CLI引数（スイープ範囲・dry_k 候補とキャッシュ容量を使用）
+ * @param config 実行設定（モデルと dt、固定工程時間を使用）
+ * @return 0 成功
  */
-int main(int argc, char** argv) {
-  const tea_cli::Args args = tea_cli::parse_args(argc, argv);
-  if (args.error.has_value()) {
-    std::cerr << "Error: " << *args.error << "\n\n";
-    std::cerr << tea_cli::help_text();
-    return 2;
+int run_sweep_mode(const tea_cli::Args& args,
+                   const tea::SimulationConfig& config) {
+  tea::SweepSpec spec;
+  spec.params = tea::make_model(config.model);
+  spec.dt_seconds = config.dt_seconds;
+  spec.steaming_seconds =
+      expand_range(args.sweep_steaming, config.steaming_seconds);
+  spec.rolling_seconds =
+      expand_range(args.sweep_rolling, config.rolling_seconds);
+  spec.drying_seconds = expand_range(args.sweep_drying, config.drying_seconds);
+  for (const double k : args.sweep_dry_k) {
+    tea::DryingParams drying = spec.params.drying;
+    drying.dry_k = k;
+    spec.drying_params.push_back(drying);
   }
-  if (args.show_help) {
-    std::cout << tea_cli::help_text();
+  spec.prune = args.sweep_prune;
+
+  tea::PrefixStateCache cache(static_cast<std::size_t>(args.cache_size));
+
+  std::cout << "steaming,rolling,drying,dryK,moisture,temperatureC,aroma,"
+               "color,qualityScore,qualityStatus\n";
+  std::cout.setf(std::ios::fixed);
+  const tea::SweepSummary summary = tea::run_sweep(
+      spec, cache, [](const tea::SweepEntry& e) {
+        std::cout << e.steaming_seconds << ',' << e.rolling_seconds << ','
+                  << e.drying_seconds << ',';
+        std::cout.precision(6);
+        std::cout << e.drying.dry_k << ',' << e.leaf.moisture << ',';
+        std::cout.precision(3);
+        std::cout << e.leaf.temperature_c << ',' << e.leaf.aroma << ','
+                  << e.leaf.color << ',';
+        std::cout.precision(2);
+        std::cout << e.score << ','
+                  << tea_io::CsvWriter::quality_status(e.score) << '\n';
+      });
+
+  const std::size_t lookups = summary.cache.hits + summary.cache.misses;
+  const double hit_rate =
+      lookups == 0 ? 0.0
+                   : 100.0 * static_cast<double>(summary.cache.hits) /
+                         static_cast<double>(lookups);
+  std::cerr.setf(std::ios::fixed);
+  std::cerr.precision(1);
+  std::cerr << "[sweep] evaluations=" << summary.evaluations
+            << " cache_hits=" << summary.cache.hits
+            << " cache_misses=" << summary.cache.misses
+            << " hit_rate=" << hit_rate << '%'
+            << " stages_reused=" << summary.cache.stages_reused
+            << " evictions=" << summary.cache.evictions
+            << " entries=" << cache.size() << '/' << cache.capacity();
+  if (spec.prune) {
+    std::cerr << " pruned=" << summary.pruned
+              << " pruned_before_steaming=" << summary.pruned_before[0]
+              << " pruned_before_rolling=" << summary.pruned_before[1]
+              << " pruned_before_drying=" << summary.pruned_before[2]
+              << " best_score=" << summary.best_score;
+  }
+  std::cerr << '\n';
+  return 0;
+}
+
+/*
+ * @brief 工程時間の最適化を実行し、最良点とパレートフロントを出力します。
+ *
+ * @param config 実行設定（モデルと dt を使用）
+ * @param budget_seconds 3工程合計の時間予算（秒）
+ * @return 0 成功、1 予算内に解が無い
+ */
+int run_optimize(const tea::SimulationConfig& config, int budget_seconds) {
+  tea::OptimizeConfig opt;
+  opt.model = config.model;
+  opt.dt_seconds = config.dt_seconds;
+  opt.budget_seconds = budget_seconds;
+
+  const tea::OptimizeResult result =
+      tea::optimize_durations(opt, tea::TeaLeaf());
+  if (!result.found) {
+    std::cerr << "Error: no feasible durations within budget\n";
+    return 1;
+  }
+
+  const tea::OptimizePoint& b = result.best;
+  std::cout << "[optimize] model=" << tea::to_string(config.model)
+            << " dt=" << config.dt_seconds << "s"
+            << " budget=" << budget_seconds << "s"
+            << " evaluations=" << result.evaluations << '\n';
+  std::cout.setf(std::ios::fixed);
+  std::cout.precision(2);
+  std::cout << "best: steaming=" << b.steaming_seconds << "s"
+            << " rolling=" << b.rolling_seconds << "s"
+            << " drying=" << b.drying_seconds << "s"
+            << " total=" << b.total_seconds() << "s"
+            << " score=" << b.score
+            << " status=" << tea_io::CsvWriter::quality_status(b.score)
+            << '\n';
+  std::cout << "pareto: totalSeconds,qualityScore,steaming,rolling,drying\n";
+  for (const tea::OptimizePoint& p : result.pareto_front) {
+    std::cout << p.total_seconds() << ',' << p.score << ','
+              << p.steaming_seconds << ',' << p.rolling_seconds << ','
+              << p.drying_seconds << '\n';
+  }
+  return 0;
+}
+
+/*
+ * @brief 全モデルを float32/float64 で一括計算し、最終結果の最大乖離を出力します。
+ *
+ * 初期状態は batches 枚の茶葉へ水分と温度を均等に振り分けます。
+ *
+ * @param config 実行設定（工程時間と dt を使用。モデルは全種類を走査）
+ * @param batches モデルあたりの茶葉数
+ * @return 0
+ */
+int run_precision_check(const tea::SimulationConfig& config, int batches) {
+  std::vector<tea::TeaLeaf> initial;
+  initial.reserve(static_cast<std::size_t>(batches));
+  for (int i = 0; i < batches; ++i) {
+    const double u = (batches > 1) ? static_cast<double>(i) / (batches - 1) : 0.0;
+    tea::TeaLeaf leaf;
+    leaf.moisture = 0.5 + 0.4 * u;
+    leaf.temperature_c = 20.0 + 10.0 * u;
+    initial.push_back(leaf);
+  }
+
+  std::cout << "[precision-check] leaves=" << batches
+            << " dt=" << config.dt_seconds << "s"
+            << " steaming=" << config.steaming_seconds << "s"
+            << " rolling=" << config.rolling_seconds << "s"
+            << " drying=" << config.drying_seconds << "s\n";
+  std::cout << "model,maxScoreDiff,maxMoistureDiff,maxTempDiff,"
+               "maxAromaDiff,maxColorDiff\n";
+  std::cout.setf(std::ios::scientific);
+  std::cout.precision(3);
+  const tea::ModelType models[] = {tea::ModelType::DEFAULT,
+                                   tea::ModelType::GENTLE,
+                                   tea::ModelType::AGGRESSIVE};
+  for (tea::ModelType model : models) {
+    tea::SimulationConfig c = config;
+    c.model = model;
+    const tea::PrecisionDivergence d =
+        tea::measure_precision_divergence(c, initial);
+    std::cout << tea::to_string(model) << ',' << d.max_score_diff << ','
+              << d.max_moisture_diff << ',' << d.max_temperature_diff << ','
+              << d.max_aroma_diff << ',' << d.max_color_diff << '\n';
+  }
+  return 0;
+}
+
+/*
+ * @brief 最終の水分・香気・色・品質スコアの、全モデル係数に対する偏微分を出力します。
+ *
+ * 双対数による前進モードの自動微分で、1 回の実行から全係数の微分を求めます。
+ * 係数ごとに値、各量の偏微分と、スコアの弾性（(value / score) * dScore/dvalue、
+ * 係数を 1% 変えたときのスコアの相対変化 [%]）を CSV 形式で標準出力へ書き出します。
+ * スコアが 0 のときは弾性を定義できないため 0 を書きます。
+ *
+ * @param config 実行設定
+ * @return 0
+ */
+int run_sensitivity(const tea::SimulationConfig& config) {
+  const tea::ModelParams params = tea::make_model(config.model);
+  const tea::SensitivityResult r = tea::compute_sensitivity(config, params);
+
+  std::cout << "[sensitivity] model=" << tea::to_string(config.model)
+            << " dt=" << config.dt_seconds << "s"
+            << " steaming=" << config.steaming_seconds << "s"
+            << " rolling=" << config.rolling_seconds << "s"
+            << " drying=" << config.drying_seconds << "s"
+            << " moisture=" << r.leaf.moisture << " aroma=" << r.leaf.aroma
+            << " color=" << r.leaf.color << " score=" << r.score << '\n';
+  std::cout << "param,value,dMoisture,dAroma,dColor,dScore,scoreElasticity\n";
+  std::cout.setf(std::ios::scientific);
+  std::cout.precision(6);
+  for (int i = 0; i < tea::kModelParamCount; ++i) {
+    const std::size_t k = static_cast<std::size_t>(i);
+    const double value = tea::model_param_value(params, i);
+    const double elasticity =
+        r.score != 0.0 ? value / r.score * r.score_gradient[k] : 0.0;
+    std::cout << tea::model_param_name(i) << ',' << value << ','
+              << r.moisture[k] << ',' << r.aroma[k] << ',' << r.color[k]
+              << ',' << r.score_gradient[k] << ',' << elasticity << '\n';
+  }
+  return 0;
+}
+
+/*
+ * @brief 計測トレースに合うようモデルの係数を較正し、較正前後の係数を出力します。
+ *
+ * --model の係数から始め、--dt 刻みでトレースを再現した残差の二乗和を
+ * 最小化します。経過は標準エラーへ、係数は CSV 形式で標準出力へ書き出します
+ * （fitted=0 の係数は損失が依存しないため動かしていません）。
+ *
+ * @param args CLI引数（トレースのパスを使用）
+ * @param config 実行設定（モデルと dt を使用）
+ * @return 0 成功、1 読み込み失敗
+ */
+int run_calibrate(const tea_cli::Args& args,
+                  const tea::SimulationConfig& config) {
+  tea::CalibrationOptions options;
+  options.dt_seconds = config.dt_seconds;
+  const tea::ModelParams start = tea::make_model(config.model);
+
+  const auto report = [](const tea::CalibrationProgress& p) {
+    std::cerr << "[calibrate] iteration=" << p.iteration << " loss=" << p.loss
+              << " lambda=" << p.lambda << '\n';
+  };
+  const tea::CalibrationResult r =
+      tea::calibrate(args.calibrate_paths, start, options, report);
+  if (!r.error.empty()) {
+    std::cerr << "Error: " << r.error << '\n';
+    return 1;
+  }
+
+  const double rms =
+      r.residuals > 0 ? std::sqrt(r.loss / static_cast<double>(r.residuals))
+                      : 0.0;
+  std::cerr << "[calibrate] traces=" << r.traces
+            << " residuals=" << r.residuals << " passes=" << r.passes
+            << " iterations=" << r.iterations
+            << " converged=" << (r.converged ? 1 : 0)
+            << " loss=" << r.initial_loss << "->" << r.loss
+            << " rms=" << rms << '\n';
+
+  std::cout << "param,start,fitted,value\n";
+  std::cout.precision(9);
+  for (int i = 0; i < tea::kModelParamCount; ++i) {
+    std::cout << tea::model_param_name(i) << ','
+              << tea::model_param_value(start, i) << ','
+              << (r.fitted[static_cast<std::size_t>(i)] ? 1 : 0) << ','
+              << tea::model_param_value(r.params, i) << '\n';
+  }
+  return 0;
+}
+
+/*
+ * @brief 出力ファイル（.teaq、LZ4 圧縮を含む）を CSV へ戻して標準出力へ書き出します。
+ *
+ * 多重化ファイル（.team）は --batch と --from/--to で指定した範囲だけを
+ * 索引から読み出します。
+ *
+ * @param args CLI引数（入力パスと取り出し範囲を使用）
+ * @return 0 成功、1 読み込み失敗または破損
+ */
+int run_decode(const tea_cli::Args& args) {
+  const std::string& path = args.decode_path;
+  const int batch = args.decode_batch;
+  tea_io::MultiplexReader mux(path);
+  if (mux.is_open()) {
+    if (batch < 0) {
+      std::cerr << "Error: " << path << " holds " << mux.batches().size()
+                << " batches; pass --batch <n>\n";
+      return 1;
+    }
+    std::string csv;
+    const int t0 = args.decode_from.value_or(0);
+    const int t1 = args.decode_to.value_or(std::numeric_limits<int>::max());
+    if (!mux.query_csv(batch, t0, t1, csv)) {
+      std::cerr << "Error: cannot read batch " << batch << " from " << path
+                << '\n';
+      return 1;
+    }
+    std::cout << csv;
     return 0;
   }
 
-  tea::SimulationConfig config;
-  config.dt_seconds = args.dt_seconds;
-  config.steaming_seconds = args.steaming_seconds;
-  config.rolling_seconds = args.rolling_seconds;
-  config.drying_seconds = args.drying_seconds;
-  if (args.model == "gentle") {
-    config.model = tea::ModelType::GENTLE;
-  } else if (args.model == "aggressive") {
-    config.model = tea::ModelType::AGGRESSIVE;
-  } else {
-    config.model = tea::ModelType::DEFAULT;
+  tea_io::QuantizedTraceReader reader(path);
+  if (reader.is_open()) {
+    reader.write_csv(std::cout);
+    if (reader.corrupted()) {
+      std::cerr << "Error: truncated or corrupted trace " << path << '\n';
+      return 1;
+    }
+    return 0;
+  }
+
+  /* .teaq でなければ CSV（圧縮されていれば展開して）をそのまま書き出します。 */
+  tea_io::OutputFileReader file(path);
+  if (!file.is_open()) {
+    std::cerr << "Error: cannot read " << path << '\n';
+    return 1;
+  }
+  std::string chunk;
+  while (file.read_chunk(chunk)) {
+    std::cout.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+  }
+  if (file.corrupted()) {
+    std::cerr << "Error: truncated or corrupted file " << path << '\n';
+    return 1;
+  }
+  return 0;
+}
+
+/*
+ * @brief 計測結果を --stats / --stats-json の指定に従って出力します。
+ *
+ * @param args CLI引数
+ * @return 0 成功、1 JSON の書き出し失敗
+ */
+int report_stats(const tea_cli::Args& args) {
+  if (!args.stats && args.stats_json_path.empty()) {
+    return 0;
+  }
+  const tea_perf::StatsSnapshot snapshot = tea_perf::collect();
+  if (args.stats) {
+    tea_perf::print_text(std::cerr, snapshot);
+  }
+  if (!args.stats_json_path.empty()) {
+    std::ofstream ofs(args.stats_json_path, std::ios::out | std::ios::trunc);
+    if (!ofs) {
+      std::cerr << "Error: cannot open " << args.stats_json_path << '\n';
+      return 1;
+    }
+    tea_perf::write_json(ofs, snapshot);
+  }
+  return 0;
+}
+
+/*
+ * @brief ログ 1 行の整形フォーマットです（従来の iostream 出力と文字単位で一致します）。
+ */
+constexpr const char* kLogLineFormat =
+    "[batch=%d] [%s] t=%ss moisture=%.2f temp=%.1f aroma=%.1f color=%.1f\n";
+
+/*
+ * @brief バッチ 1 本の現在状態をログ 1 行として out へ追記します。
+ *
+ * @param out 追記先
+ * @param batch バッチ番号
+ * @param sim シミュレータ
+ */
+template <typename Sim>
+void append_log_line(std::string& out, int batch, const Sim& sim) {
+  const tea::TeaLeaf& st = sim.leaf();
+  const char* process = tea::to_string(sim.current_process());
+  char elapsed[32];
+  tea_io::CsvWriter::format_elapsed(elapsed, sizeof(elapsed),
+                                    sim.elapsed_seconds());
+  char line[192];
+  const int n = std::snprintf(line, sizeof(line), kLogLineFormat, batch,
+                              process, elapsed, st.moisture,
+                              st.temperature_c, st.aroma, st.color);
+  if (n > 0 && static_cast<std::size_t>(n) < sizeof(line)) {
+    out.append(line, static_cast<std::size_t>(n));
+  } else if (n > 0) {
+    /* 極端な値で桁数が溢れた場合のみ、必要サイズで整形し直します。 */
+    std::vector<char> wide(static_cast<std::size_t>(n) + 1);
+    std::snprintf(wide.data(), wide.size(), kLogLineFormat, batch, process,
+                  elapsed, st.moisture, st.temperature_c, st.aroma, st.color);
+    out.append(wide.data(), static_cast<std::size_t>(n));
+  }
+}
+
+/*
+ * @brief バッチ番号ごとの初期状態を返します。
+ *
+ * バッチ差分は決定論的に小さく付与します（乱数は使わない）。
+ * 例: moisture をバッチ番号に応じて僅かに変える。
+ *
+ * @param batch バッチ番号
+ * @return 初期状態
+ */
+tea::TeaLeaf batch_initial_leaf(int batch) {
+  tea::TeaLeaf leaf;
+  leaf.moisture = tea::clamp(leaf.moisture - 0.01 * batch, 0.0, 1.0);
+  leaf.aroma = tea::clamp(leaf.aroma + 0.5 * batch, 0.0, 100.0);
+  leaf.color = tea::clamp(leaf.color + 0.3 * batch, 0.0, 100.0);
+  return leaf;
+}
+
+/*
+ * @brief 永続結果キャッシュを引きながら、バッチごとの最終結果だけを出力します。
+ *
+ * キャッシュにあるバッチはシミュレーションを省略し、無いものだけ計算して
+ * 登録します。ステップごとのログと CSV は出力しません。
+ *
+ * @param args CLI引数（キャッシュファイル、エントリ数、バッチ数を使用）
+ * @param config 実行設定
+ * @return 0 成功、1 キャッシュファイルを開けない
+ */
+int run_result_cache_mode(const tea_cli::Args& args,
+                          const tea::SimulationConfig& config) {
+  tea::ResultCache cache(args.result_cache_path,
+                         static_cast<std::size_t>(args.result_cache_entries));
+  if (!cache.is_open()) {
+    std::cerr << "Error: cannot open result cache " << args.result_cache_path
+              << '\n';
+    return 1;
+  }
+
+  std::string out;
+  for (int i = 0; i < args.batches; ++i) {
+    const std::size_t hits = cache.stats().hits;
+    const tea::QueryResult r = cache.evaluate(config, batch_initial_leaf(i));
+    char line[256];
+    const int n = std::snprintf(
+        line, sizeof(line),
+        "[batch=%d] final moisture=%.6f temp=%.3f aroma=%.3f color=%.3f "
+        "score=%.2f status=%s%s\n",
+        i, r.leaf.moisture, r.leaf.temperature_c, r.leaf.aroma, r.leaf.color,
+        r.score, tea_io::CsvWriter::quality_status(r.score),
+        cache.stats().hits != hits ? " (cached)" : "");
+    if (n > 0) {
+      out.append(line, std::min(static_cast<std::size_t>(n), sizeof(line) - 1));
+    }
+  }
+  std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+
+  const tea::ResultCacheStats& s = cache.stats();
+  const std::size_t lookups = s.hits + s.misses;
+  const double hit_rate =
+      lookups == 0 ? 0.0
+                   : 100.0 * static_cast<double>(s.hits) /
+                         static_cast<double>(lookups);
+  std::cerr.setf(std::ios::fixed);
+  std::cerr.precision(1);
+  std::cerr << "[result-cache] hits=" << s.hits << " misses=" << s.misses
+            << " hit_rate=" << hit_rate << '%'
+            << " evictions=" << s.evictions << " entries=" << cache.size()
+            << '/' << cache.capacity() << '\n';
+  return 0;
+}
+
+/*
+ * @brief バッチごとに工程の切り替え・閾値・品質ステータスの変化だけを出力します。
+ *
+ * EventEngine でイベントの時刻へ跳びながら進めるため、ステップごとのログと
+ * CSV は出力しません。閾値は過熱（DryingParams::overheat_c）と、指定があれば
+ * 水分の目標値（--moisture-target）です。
+ *
+ * @param args CLI引数（バッチ数と水分の目標値を使用）
+ * @param config 実行設定
+ * @return 0
+ */
+int run_events(const tea_cli::Args& args, const tea::SimulationConfig& config) {
+  tea::EventOptions options;
+  options.moisture_target = args.moisture_target;
+
+  std::string out;
+  tea::EventStats total;
+  for (int i = 0; i < args.batches; ++i) {
+    tea::EventEngine engine(config, options);
+    engine.set_initial_leaf(batch_initial_leaf(i));
+    const auto print = [&out, i](const tea::SimulationEvent& e) {
+      char t[32];
+      tea_io::CsvWriter::format_elapsed(t, sizeof(t), e.elapsed_seconds);
+      const char* detail = e.type == tea::EventType::STAGE_CHANGED
+                               ? tea::to_string(e.process)
+                           : e.type == tea::EventType::QUALITY_CHANGED
+                               ? e.status
+                               : (e.rising ? "above" : "below");
+      char line[256];
+      const int n = std::snprintf(
+          line, sizeof(line),
+          "[batch=%d] t=%ss %s %s moisture=%.4f temp=%.2f aroma=%.2f "
+          "color=%.2f\n",
+          i, t, tea::to_string(e.type), detail, e.leaf.moisture,
+          e.leaf.temperature_c, e.leaf.aroma, e.leaf.color);
+      if (n > 0) {
+        out.append(line,
+                   std::min(static_cast<std::size_t>(n), sizeof(line) - 1));
+      }
+    };
+    engine.subscribe(tea::EventType::STAGE_CHANGED, print);
+    engine.subscribe(tea::EventType::OVERHEAT, print);
+    engine.subscribe(tea::EventType::MOISTURE_CROSSED, print);
+    engine.subscribe(tea::EventType::QUALITY_CHANGED, print);
+    engine.run();
+
+    const tea::EventStats& s = engine.stats();
+    total.jumps += s.jumps;
+    total.skipped_steps += s.skipped_steps;
+    total.kernel_steps += s.kernel_steps;
+    total.events += s.events;
   }
+  std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+  std::cerr << "[events] events=" << total.events << " jumps=" << total.jumps
+            << " skipped_steps=" << total.skipped_steps
+            << " kernel_steps=" << total.kernel_steps << '\n';
+  return 0;
+}
+
+/*
+ * @brief 前進オイラーのバッチを出力 1 行分（dt 秒を substeps 回）進めます。
+ *
+ * @param sim シミュレータ
+ * @param config 実行設定（dt を使用）
+ * @param substeps 1 行あたりのステップ数
+ * @param csv 出力先（null なら出力しません）
+ * @return 完了済みなら false
+ */
+bool step_row(tea::Simulator& sim,
+              const tea::SimulationConfig& config,
+              int substeps,
+              tea_io::CsvWriter* csv) {
+  return sim.step(config.dt_seconds, substeps, csv);
+}
+
+/*
+ * @brief 適応刻みのバッチを出力 1 行分（dt * substeps 秒）進めます。
+ *
+ * @param sim シミュレータ
+ * @param config 実行設定（dt を使用）
+ * @param substeps 1 行あたりのステップ数
+ * @param csv 出力先（null なら出力しません）
+ * @return 完了済みなら false
+ */
+bool step_row(tea::AdaptiveSimulator& sim,
+              const tea::SimulationConfig& config,
+              int substeps,
+              tea_io::CsvWriter* csv) {
+  return sim.step(tea::to_seconds(tea::to_milliseconds(config.dt_seconds) *
+                                  substeps),
+                  csv);
+}
 
-  tea::Simulator simulator(config);
+/*
+ * @brief 全バッチを出力間隔ずつ進め、ログと CSV を出力します。
+ *
+ * Sim は tea::Simulator か tea::AdaptiveSimulator です（出力の時刻と形式は同じです）。
+ *
+ * @param args CLI引数（バッチ数と CSV 設定を使用）
+ * @param config 実行設定
+ * @param sims 初期状態を設定済みのバッチ（args.batches 本）
+ */
+template <typename Sim>
+void run_batch_loop(const tea_cli::Args& args,
+                    const tea::SimulationConfig& config,
+                    std::vector<Sim>& sims) {
+  TEA_STATS_TIMER(CLI_LOOP);
 
   /*
     複数バッチ:
-    - 同一設定で複数の Simulator を進めます（擬似的な複数ライン）
+    - 同一設定で複数のシミュレータを進めます（擬似的な複数ライン）
     - ログは batch=<id> を付与して出します
     - CSVはバッチごとに別ファイルへ出力します（フォーマット互換性のため）
   */
   const int batches = args.batches;
-  std::vector<tea::Simulator> sims;
-  sims.reserve(static_cast<std::size_t>(batches));
-  for (int i = 0; i < batches; ++i) {
-    tea::TeaLeaf leaf;
-    /*
-      バッチ差分は決定論的に小さく付与します（乱数は使わない）。
-      例: moisture をバッチ番号に応じて僅かに変える。
-    */
-    leaf.moisture = tea::clamp(leaf.moisture - 0.01 * i, 0.0, 1.0);
-    leaf.aroma = tea::clamp(leaf.aroma + 0.5 * i, 0.0, 100.0);
-    leaf.color = tea::clamp(leaf.color + 0.3 * i, 0.0, 100.0);
-    sims.emplace_back(config);
-    sims.back().set_initial_leaf(leaf);
-  }
 
+  const bool quantized = args.csv_format == "quantized";
+  const tea_io::CsvEncoding encoding =
+      quantized ? tea_io::CsvEncoding::QUANTIZED : tea_io::CsvEncoding::TEXT;
+  const tea_io::Compression compression =
+      args.compress ? tea_io::Compression::LZ4 : tea_io::Compression::NONE;
+  /*
+    行数と 1 行の上限は設定から決まるため、出力・ログのバッファは実行前に
+    一度だけ確保します。バッチ差分は水分・香気・色だけで、これらの値域は
+    初期値によらないため、既定の初期状態で予測します。
+  */
+  const tea::OutputPlan plan = tea::plan_output(config);
+  const bool multiplexed = !args.multiplex_path.empty();
+  tea_io::OutputFileOptions file;
+  file.backend = args.io_backend == "uring" ? tea_io::WriteBackend::URING
+                                            : tea_io::WriteBackend::STREAM;
+  file.direct = args.direct_io;
+  if (args.preallocate) {
+    file.preallocate_bytes =
+        multiplexed
+            ? tea::multiplex_bytes_bound(
+                  plan, batches, encoding, compression,
+                  tea_io::MultiplexWriter::kDefaultKeyframeRows)
+            : tea::file_bytes_bound(plan, encoding, compression);
+  }
+  /* 多重化出力は各バッチの書き手より後に破棄されるよう先に宣言します。 */
+  std::optional<tea_io::MultiplexWriter> mux;
   std::vector<std::optional<tea_io::CsvWriter>> csvs;
   csvs.resize(static_cast<std::size_t>(batches));
-  if (args.csv_enabled) {
+  if (args.csv_enabled && multiplexed) {
+    mux.emplace(args.multiplex_path, encoding, compression,
+                tea_io::MultiplexWriter::kDefaultKeyframeRows, file);
+    for (int i = 0; i < batches; ++i) {
+      csvs[static_cast<std::size_t>(i)].emplace(mux->make_writer(i));
+    }
+  } else if (args.csv_enabled) {
     for (int i = 0; i < batches; ++i) {
       std::ostringstream path;
       if (batches == 1) {
         path << args.csv_path;
       } else {
-        path << "tea_factory_cli_batch_" << i << ".csv";
+        path << "tea_factory_cli_batch_" << i
+             << (quantized ? ".teaq" : ".csv");
+      }
+      if (args.compress) {
+        path << ".lz4";
       }
-      csvs[static_cast<std::size_t>(i)].emplace(path.str());
+      csvs[static_cast<std::size_t>(i)].emplace(path.str(), encoding,
+                                                compression, file);
       csvs[static_cast<std::size_t>(i)]->write_header();
     }
   }
+  if (args.csv_enabled) {
+    const std::size_t row_bytes = tea::max_row_bytes(plan, encoding);
+    for (std::optional<tea_io::CsvWriter>& csv : csvs) {
+      csv->reserve_rows(plan.total_rows, row_bytes);
+    }
+  }
+
+  /* 1 周期分（全バッチ 1 行）のログをまとめて書き出します。 */
+  const int substeps = tea::sample_substeps(config);
+  std::string log;
+  log.reserve(static_cast<std::size_t>(batches) *
+              tea::console_line_bytes(plan, batches));
 
   bool any_running = true;
   while (any_running) {
     any_running = false;
+    log.clear();
     for (int i = 0; i < batches; ++i) {
       ::tea_io::CsvWriter* csv_ptr = nullptr;
       if (args.csv_enabled) {
         csv_ptr = &(*csvs[static_cast<std::size_t>(i)]);
       }
-      if (sims[static_cast<std::size_t>(i)].step(config.dt_seconds, csv_ptr)) {
+      TEA_TRACE_SCOPE("batch.step", "sim", "batch", i);
+      if (step_row(sims[static_cast<std::size_t>(i)], config, substeps,
+                   csv_ptr)) {
         any_running = true;
-        const tea::Simulator& s = sims[static_cast<std::size_t>(i)];
-        const tea::TeaLeaf& st = s.leaf();
-        std::cout << "[batch=" << i << "] ";
-        std::cout << '[' << tea::to_string(s.current_process()) << "] ";
-        std::cout << "t=" << s.elapsed_seconds() << "s ";
-        std::cout.setf(std::ios::fixed);
-        std::cout.precision(2);
-        std::cout << "moisture=" << st.moisture << ' ';
-        std::cout.precision(1);
-        std::cout << "temp=" << st.temperature_c << ' ';
-        std::cout << "aroma=" << st.aroma << ' ';
-        std::cout << "color=" << st.color << '\n';
+        TEA_STATS_TIMER(LOG_FORMAT);
+        TEA_STATS_ADD(LOG_LINES, 1);
+        append_log_line(log, i, sims[static_cast<std::size_t>(i)]);
       }
     }
+    std::cout.write(log.data(), static_cast<std::streamsize>(log.size()));
+  }
+
+  for (std::optional<tea_io::CsvWriter>& csv : csvs) {
+    if (csv.has_value()) {
+      csv->flush();
+    }
+  }
+  if (mux.has_value()) {
+    mux->finish();
+  }
+}
+
+/*
+ * @brief 同一設定の複数バッチを進め、ログと CSV を出力します。
+ *
+ * --integrator rk45 のときは適応刻みで積分し、刻みの統計を標準エラーへ出します。
+ *
+ * @param args CLI引数（バッチ数、積分方法と CSV 設定を使用）
+ * @param config 実行設定
+ */
+void run_batches(const tea_cli::Args& args,
+                 const tea::SimulationConfig& config) {
+  const std::size_t batches = static_cast<std::size_t>(args.batches);
+  if (args.integrator == "rk45") {
+    std::vector<tea::AdaptiveSimulator> sims;
+    sims.reserve(batches);
+    for (std::size_t i = 0; i < batches; ++i) {
+      sims.emplace_back(config);
+      sims.back().set_initial_leaf(batch_initial_leaf(static_cast<int>(i)));
+    }
+    run_batch_loop(args, config, sims);
+
+    /* 出力間隔と無関係に選ばれた刻みの数を、全バッチの合計で報告します。 */
+    tea::AdaptiveStats total;
+    for (const tea::AdaptiveSimulator& sim : sims) {
+      total.accepted_steps += sim.stats().accepted_steps;
+      total.rejected_steps += sim.stats().rejected_steps;
+      total.rhs_evaluations += sim.stats().rhs_evaluations;
+      total.events += sim.stats().events;
+    }
+    std::cerr << "[rk45] accepted_steps=" << total.accepted_steps
+              << " rejected_steps=" << total.rejected_steps
+              << " rhs_evaluations=" << total.rhs_evaluations
+              << " events=" << total.events << '\n';
+    return;
+  }
+
+  std::vector<tea::Simulator> sims;
+  sims.reserve(batches);
+  for (std::size_t i = 0; i < batches; ++i) {
+    sims.emplace_back(config);
+    sims.back().set_initial_leaf(batch_initial_leaf(static_cast<int>(i)));
+  }
+  run_batch_loop(args, config, sims);
+}
+
+/* SIGINT/SIGTERM で止める常駐サーバです（--serve の実行中だけ設定されます）。 */
+tea_server::SimulationServer* g_server = nullptr;
+
+/*
+ * @brief シグナルを受けたら常駐サーバの受け付けを止めます。
+ *
+ * @param signal_number 受けたシグナル（未使用）
+ */
+void stop_server(int /*signal_number*/) {
+  if (g_server != nullptr) {
+    g_server->stop();
+  }
+}
+
+/*
+ * @brief Unix ドメインソケットで要求を受け付ける常駐サーバとして動きます。
+ *
+ * shutdown 要求か SIGINT/SIGTERM を受けるまで戻りません。
+ *
+ * @param args CLI引数（ソケットパス、ワーカー数、キャッシュ容量を使用）
+ * @return 0 成功、1 起動失敗
+ */
+int run_serve(const tea_cli::Args& args) {
+  tea_server::ServerOptions options;
+  options.socket_path = args.serve_path;
+  options.workers = args.serve_workers;
+  options.cache_size = static_cast<std::size_t>(args.cache_size);
+
+  tea_server::SimulationServer server(options);
+  std::string error;
+  if (!server.start(&error)) {
+    std::cerr << "Error: cannot serve on " << args.serve_path << ": " << error
+              << '\n';
+    return 1;
   }
+  g_server = &server;
+  std::signal(SIGINT, stop_server);
+  std::signal(SIGTERM, stop_server);
+  std::cerr << "[serve] listening on " << args.serve_path
+            << " workers=" << server.worker_count() << '\n';
 
+  server.run();
+
+  std::signal(SIGINT, SIG_DFL);
+  std::signal(SIGTERM, SIG_DFL);
+  g_server = nullptr;
+  std::cerr << "[serve] stopped requests=" << server.requests() << '\n';
   return 0;
 }
+
+} /* namespace */
+
+/*
+ * @brief CLIアプリケーションのメインエントリポイント
+ *
+ * コマンドライン引数をパースし、シミュレーション設定を行います。
+ * 複数のバッチを並行してシミュレートし、その進行状況をコンソールに表示し、
+ * 必要に応じてCSVファイルに書き込みます。
+ *
+ * @param argc コマンドライン引数の数
+ * @param argv コマンドライン引数の配列
+ * @return 0 成功、1 実行エラー、2 引数エラー
+ */
+int main(int argc, char** argv) {
+  const tea_cli::Args args = tea_cli::parse_args(argc, argv);
+  if (args.error.has_value()) {
+    std::cerr << "Error: " << *args.error << "\n\n";
+    std::cerr << tea_cli::help_text();
+    return 2;
+  }
+  if (args.show_help) {
+    std::cout << tea_cli::help_text();
+    return 0;
+  }
+
+  tea::SimulationConfig config;
+  config.dt_seconds = args.dt_seconds;
+  config.sample_seconds = args.sample_seconds;
+  config.steaming_seconds = args.steaming_seconds;
+  config.rolling_seconds = args.rolling_seconds;
+  config.drying_seconds = args.drying_seconds;
+  if (args.model == "gentle") {
+    config.model = tea::ModelType::GENTLE;
+  } else if (args.model == "aggressive") {
+    config.model = tea::ModelType::AGGRESSIVE;
+  } else {
+    config.model = tea::ModelType::DEFAULT;
+  }
+
+  if (!args.trace_path.empty()) {
+    tea_perf::trace_start();
+  }
+
+  int code = 0;
+  if (!args.serve_path.empty()) {
+    code = run_serve(args);
+  } else if (!args.decode_path.empty()) {
+    code = run_decode(args);
+  } else if (args.optimize) {
+    code = run_optimize(config, args.budget_seconds);
+  } else if (!args.result_cache_path.empty()) {
+    code = run_result_cache_mode(args, config);
+  } else if (args.precision_check) {
+    code = run_precision_check(config, args.batches);
+  } else if (!args.calibrate_paths.empty()) {
+    code = run_calibrate(args, config);
+  } else if (args.sensitivity) {
+    code = run_sensitivity(config);
+  } else if (args.events) {
+    code = run_events(args, config);
+  } else if (args.sweep_steaming.has_value() ||
+             args.sweep_rolling.has_value() ||
+             args.sweep_drying.has_value() || !args.sweep_dry_k.empty()) {
+    code = run_sweep_mode(args, config);
+  } else {
+    run_batches(args, config);
+    code = report_stats(args);
+  }
+
+  if (!args.trace_path.empty()) {
+    tea_perf::trace_stop();
+    if (!tea_perf::trace_write_json(args.trace_path)) {
+      std::cerr << "Error: cannot write trace " << args.trace_path << '\n';
+      return 1;
+    }
+  }
+  return code;
+}
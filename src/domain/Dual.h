@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+
+namespace tea {
+
+/*
+  前進モードの自動微分に使う N 次元の双対数です。
+  値 v と、N 個の入力（パラメータ）に対する偏微分 d を組で持ち、
+  四則演算と exp で連鎖律を適用します。StepKernels.h の更新式へ
+  T = Dual<N> として渡すと、1 回の実行で全入力に対する微分が求まります。
+  値の計算は double と同じ演算順序なので、v は double で実行した結果と一致します。
+  比較（clamp や乾燥の香気の式の選択）は値だけで行い、切り替わりの
+  不連続は微分に含めません。
+*/
+template <int N>
+struct Dual final {
+  double v = 0.0;
+  std::array<double, N> d{};
+
+  Dual() = default;
+
+  /* 定数（微分 0）として構築します（数値リテラル T(1.0) などに使います）。 */
+  Dual(double value) : v(value) {}
+
+  /* i 番目の入力そのもの（微分が単位ベクトル）として構築します。 */
+  static Dual variable(double value, int i) {
+    Dual x(value);
+    x.d[static_cast<std::size_t>(i)] = 1.0;
+    return x;
+  }
+
+  Dual& operator+=(const Dual& b) {
+    v += b.v;
+    for (int i = 0; i < N; ++i) {
+      d[i] += b.d[i];
+    }
+    return *this;
+  }
+
+  Dual& operator-=(const Dual& b) {
+    v -= b.v;
+    for (int i = 0; i < N; ++i) {
+      d[i] -= b.d[i];
+    }
+    return *this;
+  }
+
+  Dual& operator*=(const Dual& b) {
+    for (int i = 0; i < N; ++i) {
+      d[i] = d[i] * b.v + v * b.d[i];
+    }
+    v *= b.v;
+    return *this;
+  }
+
+  Dual& operator/=(const Dual& b) {
+    const double inv = 1.0 / b.v;
+    for (int i = 0; i < N; ++i) {
+      d[i] = (d[i] - v * inv * b.d[i]) * inv;
+    }
+    v /= b.v;
+    return *this;
+  }
+
+  friend Dual operator+(Dual a, const Dual& b) { return a += b; }
+  friend Dual operator-(Dual a, const Dual& b) { return a -= b; }
+  friend Dual operator*(Dual a, const Dual& b) { return a *= b; }
+  friend Dual operator/(Dual a, const Dual& b) { return a /= b; }
+
+  friend Dual operator-(Dual a) {
+    a.v = -a.v;
+    for (int i = 0; i < N; ++i) {
+      a.d[i] = -a.d[i];
+    }
+    return a;
+  }
+
+  friend bool operator<(const Dual& a, const Dual& b) { return a.v < b.v; }
+  friend bool operator>(const Dual& a, const Dual& b) { return a.v > b.v; }
+  friend bool operator<=(const Dual& a, const Dual& b) { return a.v <= b.v; }
+  friend bool operator>=(const Dual& a, const Dual& b) { return a.v >= b.v; }
+  friend bool operator==(const Dual& a, const Dual& b) { return a.v == b.v; }
+  friend bool operator!=(const Dual& a, const Dual& b) { return a.v != b.v; }
+
+  /* exp(x) です（更新式からは using std::exp の上で ADL で呼ばれます）。 */
+  friend Dual exp(Dual a) {
+    a.v = std::exp(a.v);
+    for (int i = 0; i < N; ++i) {
+      a.d[i] *= a.v;
+    }
+    return a;
+  }
+};
+
+} /* namespace tea */
@@ -9,49 +9,129 @@ enum class ModelType {
   AGGRESSIVE
 };
 
-/* 蒸し工程のパラメータです。 */
-struct SteamingParams final {
-  double target_temp_c = 95.0;
-  double heat_k = 0.08;
-  double moisture_gain_per_s = 0.0008;
-  double aroma_gain_per_s = 1.0;
-  double color_gain_per_s = 0.2;
+/* 蒸し工程のパラメータです（T: 数値型）。 */
+template <typename T>
+struct SteamingParamsT final {
+  T target_temp_c = T(95.0);
+  T heat_k = T(0.08);
+  T moisture_gain_per_s = T(0.0008);
+  T aroma_gain_per_s = T(1.0);
+  T color_gain_per_s = T(0.2);
 };
 
-/* 揉捻工程のパラメータです。 */
-struct RollingParams final {
-  double target_temp_c = 70.0;
-  double cool_k = 0.05;
-  double moisture_loss_k = 0.0015;
-  double aroma_gain_per_s = 0.6;
-  double color_gain_per_s = 0.3;
+/* 揉捻工程のパラメータです（T: 数値型）。 */
+template <typename T>
+struct RollingParamsT final {
+  T target_temp_c = T(70.0);
+  T cool_k = T(0.05);
+  T moisture_loss_k = T(0.0015);
+  T aroma_gain_per_s = T(0.6);
+  T color_gain_per_s = T(0.3);
 };
 
-/* 乾燥工程のパラメータです。 */
-struct DryingParams final {
-  double target_temp_c = 60.0;
-  double temp_k = 0.07;
-  double dry_k = 0.05;
-  double aroma_recover_per_s = 0.2;
-  double overheat_c = 70.0;
-  double aroma_damage_k = 0.02;
-  double color_gain_per_s = 0.15;
+/* 乾燥工程のパラメータです（T: 数値型）。 */
+template <typename T>
+struct DryingParamsT final {
+  T target_temp_c = T(60.0);
+  T temp_k = T(0.07);
+  T dry_k = T(0.05);
+  T aroma_recover_per_s = T(0.2);
+  T overheat_c = T(70.0);
+  T aroma_damage_k = T(0.02);
+  T color_gain_per_s = T(0.15);
 };
 
-/* 工程別パラメータのセットです。 */
-struct ModelParams final {
-  SteamingParams steaming;
-  RollingParams rolling;
-  DryingParams drying;
+/* 工程別パラメータのセットです（T: 数値型）。 */
+template <typename T>
+struct ModelParamsT final {
+  SteamingParamsT<T> steaming;
+  RollingParamsT<T> rolling;
+  DryingParamsT<T> drying;
 };
 
-/* モデル種別から工程別パラメータを構築します。 */
-ModelParams make_model(ModelType type);
+/* 既定精度（double）のパラメータです。 */
+using SteamingParams = SteamingParamsT<double>;
+using RollingParams = RollingParamsT<double>;
+using DryingParams = DryingParamsT<double>;
+using ModelParams = ModelParamsT<double>;
+
+/*
+  モデル種別から工程別パラメータを構築します。
+  組み込みモデルの係数はコンパイル時定数なので constexpr で求まります
+  （kModelParams<M> と Pipeline<M> から定数として使います）。
+*/
+constexpr ModelParams make_model(ModelType type) {
+  /*
+    係数は「挙動の違いが分かりやすい」ことを優先し、過度に複雑化しません。
+    - GENTLE: 変化を緩やかに（熱/乾燥/香気変化を弱める）
+    - AGGRESSIVE: 変化を強めに（熱/乾燥/香気変化を強める）
+  */
+  ModelParams p;
+
+  if (type == ModelType::DEFAULT) {
+    return p;
+  }
+
+  /*
+    DEFAULT を基準に、モデルごとに倍率で挙動を変えます。
+    これにより「一部係数だけがDEFAULTのまま」という不整合を避けます。
+  */
+  const double k =
+      (type == ModelType::GENTLE) ? 0.75 :
+      (type == ModelType::AGGRESSIVE) ? 1.25 : 1.0;
+
+  p.steaming.heat_k *= k;
+  p.steaming.moisture_gain_per_s *= k;
+  p.steaming.aroma_gain_per_s *= k;
+  p.steaming.color_gain_per_s *= k;
+
+  p.rolling.cool_k *= k;
+  p.rolling.moisture_loss_k *= k;
+  p.rolling.aroma_gain_per_s *= k;
+  p.rolling.color_gain_per_s *= k;
+
+  p.drying.temp_k *= k;
+  p.drying.dry_k *= k;
+  p.drying.aroma_recover_per_s *= k;
+  p.drying.aroma_damage_k *= k;
+  p.drying.color_gain_per_s *= k;
+
+  return p;
+}
+
+/* 組み込みモデル M の工程別パラメータ（コンパイル時定数）です。 */
+template <ModelType M>
+inline constexpr ModelParams kModelParams = make_model(M);
 
 /* 表示用のモデル名を返します。 */
 const char* to_string(ModelType type);
 
-} /* namespace tea */
+/* 精度の異なるパラメータへ変換します。 */
+template <typename To, typename From>
+inline ModelParamsT<To> params_cast(const ModelParamsT<From>& p) {
+  ModelParamsT<To> out;
+  out.steaming.target_temp_c = static_cast<To>(p.steaming.target_temp_c);
+  out.steaming.heat_k = static_cast<To>(p.steaming.heat_k);
+  out.steaming.moisture_gain_per_s =
+      static_cast<To>(p.steaming.moisture_gain_per_s);
+  out.steaming.aroma_gain_per_s = static_cast<To>(p.steaming.aroma_gain_per_s);
+  out.steaming.color_gain_per_s = static_cast<To>(p.steaming.color_gain_per_s);
 
+  out.rolling.target_temp_c = static_cast<To>(p.rolling.target_temp_c);
+  out.rolling.cool_k = static_cast<To>(p.rolling.cool_k);
+  out.rolling.moisture_loss_k = static_cast<To>(p.rolling.moisture_loss_k);
+  out.rolling.aroma_gain_per_s = static_cast<To>(p.rolling.aroma_gain_per_s);
+  out.rolling.color_gain_per_s = static_cast<To>(p.rolling.color_gain_per_s);
 
+  out.drying.target_temp_c = static_cast<To>(p.drying.target_temp_c);
+  out.drying.temp_k = static_cast<To>(p.drying.temp_k);
+  out.drying.dry_k = static_cast<To>(p.drying.dry_k);
+  out.drying.aroma_recover_per_s =
+      static_cast<To>(p.drying.aroma_recover_per_s);
+  out.drying.overheat_c = static_cast<To>(p.drying.overheat_c);
+  out.drying.aroma_damage_k = static_cast<To>(p.drying.aroma_damage_k);
+  out.drying.color_gain_per_s = static_cast<To>(p.drying.color_gain_per_s);
+  return out;
+}
 
+} /* namespace tea */
@@ -4,27 +4,49 @@
 
 namespace tea {
 
-/* 茶葉の物理状態を表すドメインモデルです。 */
-struct TeaLeaf final {
-  double moisture = 0.75;      /* 水分率 [0.0, 1.0] */
-  double temperature_c = 25.0; /* 温度 [°C] */
-  double aroma = 10.0;         /* 香気 [0, 100] */
-  double color = 10.0;         /* 色指標 [0, 100] */
+/*
+  茶葉の物理状態を表すドメインモデルです。
+  数値型 T で精度を切り替えられます（既定は double の TeaLeaf）。
+*/
+template <typename T>
+struct TeaLeafT final {
+  T moisture = T(0.75);      /* 水分率 [0.0, 1.0] */
+  T temperature_c = T(25.0); /* 温度 [°C] */
+  T aroma = T(10.0);         /* 香気 [0, 100] */
+  T color = T(10.0);         /* 色指標 [0, 100] */
 };
 
+/* 既定精度（double）の茶葉状態です。 */
+using TeaLeaf = TeaLeafT<double>;
+
 /* 値を [min_v, max_v] に収めます。 */
 inline double clamp(double v, double min_v, double max_v) {
   return std::max(min_v, std::min(v, max_v));
 }
 
-/* 茶葉の状態を定義域へ正規化します。 */
-inline void normalize(TeaLeaf& leaf) {
-  leaf.moisture = clamp(leaf.moisture, 0.0, 1.0);
-  leaf.aroma = clamp(leaf.aroma, 0.0, 100.0);
-  leaf.color = clamp(leaf.color, 0.0, 100.0);
+/* 値を [min_v, max_v] に収めます（任意の数値型）。 */
+template <typename T>
+inline T clamp(T v, T min_v, T max_v) {
+  return std::max(min_v, std::min(v, max_v));
 }
 
-} /* namespace tea */
-
+/* 茶葉の状態を定義域へ正規化します。 */
+template <typename T>
+inline void normalize(TeaLeafT<T>& leaf) {
+  leaf.moisture = clamp(leaf.moisture, T(0.0), T(1.0));
+  leaf.aroma = clamp(leaf.aroma, T(0.0), T(100.0));
+  leaf.color = clamp(leaf.color, T(0.0), T(100.0));
+}
 
+/* 精度の異なる茶葉状態へ変換します。 */
+template <typename To, typename From>
+inline TeaLeafT<To> leaf_cast(const TeaLeafT<From>& leaf) {
+  TeaLeafT<To> out;
+  out.moisture = static_cast<To>(leaf.moisture);
+  out.temperature_c = static_cast<To>(leaf.temperature_c);
+  out.aroma = static_cast<To>(leaf.aroma);
+  out.color = static_cast<To>(leaf.color);
+  return out;
+}
 
+} /* namespace tea */
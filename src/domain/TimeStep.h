@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace tea {
+
+/*
+  時間の内部表現です。
+  dt や経過時間を double の秒で足し合わせると、0.1 秒刻みのように 2 進で
+  割り切れない刻みでは誤差が溜まり、工程の境界を踏み越えたり手前で
+  止まったりします。そこで時刻はミリ秒の整数で数え、工程の境界と
+  出力時刻を厳密に扱います（更新式へ渡す dt だけを秒の double に戻します）。
+  整数秒の dt は 1000 の倍数になるため、従来の結果と一致します。
+*/
+
+/* 1 秒あたりのミリ秒数（時刻の分解能）です。 */
+constexpr std::int64_t kMillisecondsPerSecond = 1000;
+
+/* 秒をミリ秒の整数へ丸めます（非有限値と 2^53 ミリ秒を超える値は 0）。 */
+inline std::int64_t to_milliseconds(double seconds) {
+  if (!std::isfinite(seconds) || std::fabs(seconds) > 9.0e12) {
+    return 0;
+  }
+  return std::llround(seconds * static_cast<double>(kMillisecondsPerSecond));
+}
+
+/* ミリ秒を秒へ戻します（1000 の倍数なら整数秒と厳密に一致します）。 */
+inline double to_seconds(std::int64_t milliseconds) {
+  return static_cast<double>(milliseconds) /
+         static_cast<double>(kMillisecondsPerSecond);
+}
+
+} /* namespace tea */
@@ -0,0 +1,330 @@
+/*
+ * @file main.cpp
+ * @brief GUI版シミュレーション（tea_gui::Simulator）のヘッドレス駆動
+ *
+ * GLFW/OpenGL を使わずに tea_gui::Simulator::update を合成フレーム時間で
+ * 駆動し、フレームごとの更新レイテンシ分布を出力します。
+ * CI やディスプレイの無いサーバで GUI 側の性能劣化を検出するためのものです。
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Simulator.h"
+#include "perf/Trace.h"
+
+namespace {
+
+/*
+ * @brief フレーム時間の生成方法です。
+ */
+enum class FrameMode {
+  FIXED,   /* 一定（既定 16.6ms） */
+  JITTER,  /* 一定 ± 一様乱数 */
+  REPLAY   /* ファイルから読み込み（ms/行、末尾で先頭へ戻る） */
+};
+
+/*
+ * @brief ヘッドレス実行の設定です。
+ */
+struct HeadlessArgs final {
+  int batches = 1;
+  int frames = 10000;
+  FrameMode mode = FrameMode::FIXED;
+  double frame_ms = 16.6;
+  double jitter_ms = 4.0;
+  unsigned int seed = 1;
+  std::string replay_path;
+  tea::ModelType model = tea::ModelType::DEFAULT;
+  std::string trace_path;
+  bool show_help = false;
+  std::optional<std::string> error;
+};
+
+/*
+ * @brief ヘルプ文字列を返します。
+ */
+const char* help_text() {
+  return
+      "TeaFactory Simulator (headless GUI driver)\n"
+      "\n"
+      "Usage:\n"
+      "  tea_gui_headless [options]\n"
+      "\n"
+      "Options:\n"
+      "  --batches <n>     Batch count (default: 1)\n"
+      "  --frames <n>      Frame count (default: 10000)\n"
+      "  --mode <name>     Frame deltas: fixed|jitter|replay (default: fixed)\n"
+      "  --frame-ms <ms>   Base frame delta (default: 16.6)\n"
+      "  --jitter-ms <ms>  Max jitter for --mode jitter (default: 4)\n"
+      "  --seed <n>        Jitter random seed (default: 1)\n"
+      "  --replay <path>   Frame deltas in ms, one per line (--mode replay)\n"
+      "  --model <name>    Model: default|gentle|aggressive\n"
+      "  --trace <path>    Write Chrome trace_event JSON at exit\n"
+      "  -h, --help        Show help\n";
+}
+
+/*
+ * @brief 文字列を正の整数へ変換します（失敗時は std::nullopt）。
+ */
+std::optional<long> parse_positive_long(const char* s) {
+  if (s == nullptr || *s == '\0') {
+    return std::nullopt;
+  }
+  char* end = nullptr;
+  const long v = std::strtol(s, &end, 10);
+  if (end == s || *end != '\0' || v <= 0) {
+    return std::nullopt;
+  }
+  return v;
+}
+
+/*
+ * @brief 文字列を 0 以上の実数へ変換します（失敗時は std::nullopt）。
+ */
+std::optional<double> parse_non_negative_double(const char* s) {
+  if (s == nullptr || *s == '\0') {
+    return std::nullopt;
+  }
+  char* end = nullptr;
+  const double v = std::strtod(s, &end);
+  if (end == s || *end != '\0' || !(v >= 0.0)) {
+    return std::nullopt;
+  }
+  return v;
+}
+
+/*
+ * @brief 引数をパースします。失敗時は HeadlessArgs::error に理由を設定します。
+ */
+HeadlessArgs parse_args(int argc, char** argv) {
+  HeadlessArgs args;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i] ? argv[i] : "";
+    if (a == "-h" || a == "--help") {
+      args.show_help = true;
+      return args;
+    }
+    if (i + 1 >= argc) {
+      args.error = (a.rfind("--", 0) == 0) ? "Missing value for " + a
+                                           : "Unknown argument: " + a;
+      return args;
+    }
+    const char* v = argv[++i];
+    const std::string value = v ? v : "";
+
+    if (a == "--batches" || a == "--frames" || a == "--seed") {
+      const auto parsed = parse_positive_long(v);
+      if (!parsed.has_value() || *parsed > 1000000) {
+        args.error = "Invalid value for " + a + ": " + value;
+        return args;
+      }
+      if (a == "--batches") {
+        args.batches = static_cast<int>(*parsed);
+      } else if (a == "--frames") {
+        args.frames = static_cast<int>(*parsed);
+      } else {
+        args.seed = static_cast<unsigned int>(*parsed);
+      }
+    } else if (a == "--frame-ms" || a == "--jitter-ms") {
+      const auto parsed = parse_non_negative_double(v);
+      if (!parsed.has_value()) {
+        args.error = "Invalid value for " + a + ": " + value;
+        return args;
+      }
+      (a == "--frame-ms" ? args.frame_ms : args.jitter_ms) = *parsed;
+    } else if (a == "--mode") {
+      if (value == "fixed") {
+        args.mode = FrameMode::FIXED;
+      } else if (value == "jitter") {
+        args.mode = FrameMode::JITTER;
+      } else if (value == "replay") {
+        args.mode = FrameMode::REPLAY;
+      } else {
+        args.error = "Invalid mode: " + value;
+        return args;
+      }
+    } else if (a == "--replay") {
+      args.replay_path = value;
+      args.mode = FrameMode::REPLAY;
+    } else if (a == "--model") {
+      if (value == "default") {
+        args.model = tea::ModelType::DEFAULT;
+      } else if (value == "gentle") {
+        args.model = tea::ModelType::GENTLE;
+      } else if (value == "aggressive") {
+        args.model = tea::ModelType::AGGRESSIVE;
+      } else {
+        args.error = "Invalid model: " + value;
+        return args;
+      }
+    } else if (a == "--trace") {
+      args.trace_path = value;
+    } else {
+      args.error = "Unknown argument: " + a;
+      return args;
+    }
+  }
+  if (args.mode == FrameMode::REPLAY && args.replay_path.empty()) {
+    args.error = "--mode replay requires --replay <path>";
+  }
+  return args;
+}
+
+/*
+ * @brief フレーム時間（秒）の列を生成します。
+ *
+ * @param args 実行設定
+ * @return フレーム時間の列（replay の読み込み失敗時は空）
+ */
+std::vector<double> make_frame_deltas(const HeadlessArgs& args) {
+  std::vector<double> deltas;
+  deltas.reserve(static_cast<std::size_t>(args.frames));
+
+  if (args.mode == FrameMode::REPLAY) {
+    std::vector<double> recorded;
+    std::ifstream ifs(args.replay_path);
+    double ms = 0.0;
+    while (ifs >> ms) {
+      recorded.push_back(std::max(0.0, ms) / 1000.0);
+    }
+    if (recorded.empty()) {
+      return deltas;
+    }
+    for (int i = 0; i < args.frames; ++i) {
+      deltas.push_back(recorded[static_cast<std::size_t>(i) % recorded.size()]);
+    }
+    return deltas;
+  }
+
+  std::mt19937 rng(args.seed);
+  std::uniform_real_distribution<double> jitter(-args.jitter_ms, args.jitter_ms);
+  for (int i = 0; i < args.frames; ++i) {
+    double ms = args.frame_ms;
+    if (args.mode == FrameMode::JITTER) {
+      ms = std::max(0.0, ms + jitter(rng));
+    }
+    deltas.push_back(ms / 1000.0);
+  }
+  return deltas;
+}
+
+/*
+ * @brief ソート済み列から最近傍順位法でパーセンタイルを返します。
+ */
+double percentile(const std::vector<double>& sorted, double p) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  const double rank = p / 100.0 * static_cast<double>(sorted.size());
+  std::size_t idx = static_cast<std::size_t>(rank);
+  if (static_cast<double>(idx) < rank) {
+    ++idx;
+  }
+  idx = std::max<std::size_t>(idx, 1);
+  return sorted[std::min(idx, sorted.size()) - 1];
+}
+
+} /* namespace */
+
+/*
+ * @brief ヘッドレス駆動のエントリポイントです。
+ *
+ * 全バッチが FINISHED になったら reset + start で再開し、指定フレーム数だけ
+ * 更新負荷をかけ続けます。
+ *
+ * @param argc コマンドライン引数の数
+ * @param argv コマンドライン引数の配列
+ * @return 0 成功、1 実行エラー、2 引数エラー
+ */
+int main(int argc, char** argv) {
+  const HeadlessArgs args = parse_args(argc, argv);
+  if (args.error.has_value()) {
+    std::cerr << "Error: " << *args.error << "\n\n" << help_text();
+    return 2;
+  }
+  if (args.show_help) {
+    std::cout << help_text();
+    return 0;
+  }
+
+  const std::vector<double> deltas = make_frame_deltas(args);
+  if (deltas.empty()) {
+    std::cerr << "Error: no frame deltas (replay file empty or unreadable)\n";
+    return 1;
+  }
+
+  if (!args.trace_path.empty()) {
+    tea_perf::trace_start();
+  }
+
+  tea_gui::Simulator simulator;
+  simulator.set_model(args.model);
+  simulator.set_batch_count(args.batches);
+  simulator.start();
+
+  using clock = std::chrono::steady_clock;
+  std::vector<double> latencies_us;
+  latencies_us.reserve(deltas.size());
+  int restarts = 0;
+  double simulated_seconds = 0.0;
+
+  for (const double dt : deltas) {
+    if (!simulator.is_running()) {
+      simulator.reset();
+      simulator.start();
+      ++restarts;
+    }
+    const auto t0 = clock::now();
+    simulator.update(dt);
+    const auto t1 = clock::now();
+    latencies_us.push_back(
+        std::chrono::duration<double, std::micro>(t1 - t0).count());
+    simulated_seconds += dt;
+  }
+
+  std::vector<double> sorted = latencies_us;
+  std::sort(sorted.begin(), sorted.end());
+  double total_us = 0.0;
+  for (const double v : sorted) {
+    total_us += v;
+  }
+  const double mean_us = total_us / static_cast<double>(sorted.size());
+
+  std::cout.setf(std::ios::fixed);
+  std::cout.precision(3);
+  std::cout << "[headless] model=" << tea::to_string(args.model)
+            << " batches=" << args.batches
+            << " frames=" << sorted.size()
+            << " simulated_s=" << simulated_seconds
+            << " restarts=" << restarts << '\n';
+  std::cout << "[headless] update_us mean=" << mean_us
+            << " p50=" << percentile(sorted, 50.0)
+            << " p90=" << percentile(sorted, 90.0)
+            << " p99=" << percentile(sorted, 99.0)
+            << " p99.9=" << percentile(sorted, 99.9)
+            << " max=" << sorted.back() << '\n';
+  std::cout.precision(0);
+  std::cout << "[headless] batch_updates_per_s="
+            << (total_us > 0.0
+                    ? static_cast<double>(sorted.size()) * args.batches /
+                          (total_us / 1e6)
+                    : 0.0)
+            << '\n';
+
+  if (!args.trace_path.empty()) {
+    tea_perf::trace_stop();
+    if (!tea_perf::trace_write_json(args.trace_path)) {
+      std::cerr << "Error: cannot write trace " << args.trace_path << '\n';
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -10,19 +10,237 @@
 #include "io/CsvWriter.h"
 
 #include <algorithm> // For std::clamp
-#include <iomanip>   // For std::fixed, std::setprecision
+#include <cmath>     // For std::llround
+#include <cstdio>    // For std::snprintf
+#include <utility>   // For std::move
+#include <vector>
+
+#include "perf/Stats.h"
+#include "perf/Trace.h"
 
 namespace tea_io {
 
+namespace {
+
+/*
+ * @brief 内部バッファをファイルへ書き出す閾値（バイト）です。
+ */
+constexpr std::size_t kFlushThresholdBytes = 64 * 1024;
+
+/*
+ * @brief 数値列の整形フォーマットです。
+ *
+ * iostream の std::fixed + setprecision と同じ printf 書式で、
+ * 従来の出力と文字単位で一致します。
+ */
+constexpr const char* kRowNumbersFormat = "%lld,%.6f,%.3f,%.3f,%.3f,%.2f,%s\n";
+
+/*
+ * @brief 経過時間に 1 秒未満の端数がある行の数値列の整形フォーマットです。
+ *
+ * 経過時間は format_elapsed で整形した文字列を使います。
+ */
+constexpr const char* kFractionalRowNumbersFormat =
+    "%s,%.6f,%.3f,%.3f,%.3f,%.2f,%s\n";
+
+/*
+ * @brief 1 秒あたりのミリ秒数です（経過時間の表示の分解能）。
+ */
+constexpr long long kMillisecondsPerSecond = 1000;
+
+/*
+ * @brief 経過時間（秒）をミリ秒の整数へ丸めます（非有限値は 0）。
+ */
+long long elapsed_milliseconds(double elapsed_seconds) {
+  if (!std::isfinite(elapsed_seconds) || std::fabs(elapsed_seconds) > 9.0e12) {
+    return 0;
+  }
+  return std::llround(elapsed_seconds *
+                      static_cast<double>(kMillisecondsPerSecond));
+}
+
+/*
+ * @brief 1 行の数値列を line へ整形し、snprintf と同じく必要な文字数を返します。
+ *
+ * 整数秒の行は従来と同じ書式で、端数のある行だけ経過時間を文字列で埋め込みます。
+ */
+int format_row_numbers(char* line,
+                       std::size_t size,
+                       double elapsed_seconds,
+                       double moisture,
+                       double temperature_c,
+                       double aroma,
+                       double color,
+                       double score,
+                       const char* status) {
+  const long long ms = elapsed_milliseconds(elapsed_seconds);
+  if (ms % kMillisecondsPerSecond == 0) {
+    return std::snprintf(line, size, kRowNumbersFormat,
+                         ms / kMillisecondsPerSecond, moisture, temperature_c,
+                         aroma, color, score, status);
+  }
+  char elapsed[32];
+  CsvWriter::format_elapsed(elapsed, sizeof(elapsed), elapsed_seconds);
+  return std::snprintf(line, size, kFractionalRowNumbersFormat, elapsed,
+                       moisture, temperature_c, aroma, color, score, status);
+}
+
+/*
+ * @brief ヘッダ行（.teaq の先頭）の長さの上限です。
+ */
+constexpr std::uint64_t kHeaderBoundBytes = 128;
+
+} /* namespace */
+
 /*
- * @brief 出力先パスを指定してCsvWriterを構築します。
+ * @brief 出力先パス、符号化方式、圧縮方式、出力ファイルの設定を指定してCsvWriterを構築します。
  *
  * 指定されたパスにファイルを開き、既存の内容を上書きします。
  *
  * @param path CSVファイルの出力パス
+ * @param encoding 符号化方式（既定は CSV テキスト）
+ * @param compression 圧縮方式（既定は無圧縮）
+ * @param file 書き出し方式・事前確保量など（既定は std::ofstream）
+ */
+CsvWriter::CsvWriter(const std::string& path,
+                     CsvEncoding encoding,
+                     Compression compression,
+                     const OutputFileOptions& file)
+    : sink_(make_output_sink(path, compression, file)),
+      encoding_(encoding),
+      flush_threshold_bytes_(kFlushThresholdBytes) {
+  buf_.reserve(kFlushThresholdBytes + 256);
+}
+
+/*
+ * @brief 出力シンクと書き出し設定を指定してCsvWriterを構築します。
+ *
+ * 多重化出力のように、書き出し先を呼び出し側で用意する場合に使います。
+ *
+ * @param sink 出力シンク
+ * @param options 書き出し設定
+ */
+CsvWriter::CsvWriter(std::unique_ptr<OutputSink> sink,
+                     const CsvWriterOptions& options)
+    : sink_(std::move(sink)),
+      encoding_(options.encoding),
+      batch_(options.batch),
+      flush_threshold_bytes_(options.flush_threshold_bytes),
+      keyframe_rows_(options.encoding == CsvEncoding::QUANTIZED
+                         ? options.keyframe_rows
+                         : 0) {
+  /* 多重化出力のヘッダは多重化側が書くため、書き済みとして扱います。 */
+  header_written_ = batch_ >= 0;
+  buf_.reserve(flush_threshold_bytes_ + 256);
+}
+
+/*
+ * @brief 未書き出しの行をフラッシュしてから破棄します。
+ */
+CsvWriter::~CsvWriter() {
+  flush();
+}
+
+/*
+ * @brief 未書き出しの行をフラッシュしてから other を引き継ぎます。
+ *
+ * 既定のムーブ代入は sink_ を差し替えるだけで、buf_ に残った行が
+ * 書き出されずに失われるため、先に flush() します。
+ *
+ * @param other 引き継ぐ書き出し器
+ * @return *this
+ */
+CsvWriter& CsvWriter::operator=(CsvWriter&& other) {
+  if (this != &other) {
+    flush();
+    sink_ = std::move(other.sink_);
+    encoding_ = other.encoding_;
+    batch_ = other.batch_;
+    flush_threshold_bytes_ = other.flush_threshold_bytes_;
+    keyframe_rows_ = other.keyframe_rows_;
+    rows_in_keyframe_ = other.rows_in_keyframe_;
+    encoder_ = std::move(other.encoder_);
+    buf_ = std::move(other.buf_);
+    header_written_ = other.header_written_;
+  }
+  return *this;
+}
+
+/*
+ * @brief 内部バッファとシンクの保持分をファイルへ書き出します。
+ *
+ * ファイルが開けていない場合は何もしません。
+ */
+void CsvWriter::flush() {
+  if (!sink_ || !sink_->is_open()) {
+    return;
+  }
+  drain();
+  TEA_STATS_TIMER(CSV_IO);
+  sink_->flush();
+}
+
+/*
+ * @brief 予測した行数と 1 行の上限から、内部バッファを一度だけ確保します。
+ *
+ * 内部バッファが同時に保持する量は、閾値で書き出す場合は「閾値 + 1 行」、
+ * キーフレームごとに書き出す場合は「K 行」、全行がそれより少なければ全行です。
+ * 確保済みの容量は減らしません。
+ *
+ * @param rows 書き込む行数
+ * @param max_row_bytes 1 行の上限（batch 列を除く）
+ */
+void CsvWriter::reserve_rows(std::int64_t rows, std::size_t max_row_bytes) {
+  std::size_t row = max_row_bytes;
+  if (encoding_ == CsvEncoding::TEXT && batch_ >= 0) {
+    row += std::to_string(batch_).size() + 1;
+  }
+  const std::uint64_t all =
+      kHeaderBoundBytes +
+      static_cast<std::uint64_t>(std::max<std::int64_t>(rows, 0)) * row;
+  const std::uint64_t held =
+      keyframe_rows_ > 0
+          ? kHeaderBoundBytes + static_cast<std::uint64_t>(keyframe_rows_) * row
+          : flush_threshold_bytes_ + row;
+  const std::size_t bytes = static_cast<std::size_t>(std::min(all, held));
+  if (bytes > buf_.capacity()) {
+    buf_.reserve(bytes);
+  }
+}
+
+/*
+ * @brief 内部バッファの確保済み容量を返します。
+ *
+ * reserve_rows の後に書き出し中の再確保が起きていないかを確かめるのに使います。
+ *
+ * @return 容量（バイト）
  */
-CsvWriter::CsvWriter(const std::string& path)
-    : ofs_(path, std::ios::out | std::ios::trunc) {
+std::size_t CsvWriter::buffer_capacity() const {
+  return buf_.capacity();
+}
+
+/*
+ * @brief 内部バッファの内容を出力シンクへ渡します。
+ *
+ * 圧縮シンクはブロックがたまるまで保持するため、ここではフラッシュしません。
+ * バッファが空、またはファイルが開けていない場合は何もしません。
+ */
+void CsvWriter::drain() {
+  if (buf_.empty() || !sink_ || !sink_->is_open()) {
+    return;
+  }
+  TEA_STATS_TIMER(CSV_IO);
+  TEA_TRACE_SCOPE("csv.flush", "io", "bytes",
+                  static_cast<std::int64_t>(buf_.size()));
+  sink_->write(buf_.data(), buf_.size());
+  TEA_STATS_ADD(CSV_BYTES_FLUSHED, buf_.size());
+  TEA_STATS_ADD(CSV_FLUSHES, 1);
+  buf_.clear();
+  if (keyframe_rows_ > 0) {
+    /* 渡した塊を単独で復号できるよう、次の行から符号化をやり直します。 */
+    encoder_.reset();
+    rows_in_keyframe_ = 0;
+  }
 }
 
 /*
@@ -32,11 +250,15 @@ CsvWriter::CsvWriter(const std::string& path)
  * ヘッダ行を書き込みます。
  */
 void CsvWriter::write_header() {
-  if (!ofs_.is_open() || header_written_) {
+  if (!sink_ || !sink_->is_open() || header_written_) {
     return;
   }
-  ofs_ << "process,elapsedSeconds,moisture,temperatureC,aroma,color,"
-          "qualityScore,qualityStatus\n";
+  if (encoding_ == CsvEncoding::QUANTIZED) {
+    QuantizedEncoder::write_preamble(buf_);
+  } else {
+    buf_ += "process,elapsedSeconds,moisture,temperatureC,aroma,color,"
+            "qualityScore,qualityStatus\n";
+  }
   header_written_ = true;
 }
 
@@ -54,29 +276,98 @@ void CsvWriter::write_header() {
  * @param color 色
  */
 void CsvWriter::write_row(const std::string& process,
-                          int elapsed_seconds,
+                          double elapsed_seconds,
                           double moisture,
                           double temperature_c,
                           double aroma,
                           double color) {
-  if (!ofs_.is_open()) {
+  if (!sink_ || !sink_->is_open()) {
     return;
   }
   if (!header_written_) {
     write_header();
   }
 
-  const double score = quality_score(moisture, aroma, color);
-  const char* status = quality_status(score);
+  if (keyframe_rows_ > 0 && rows_in_keyframe_ == keyframe_rows_) {
+    drain();
+  }
+
+  {
+    TEA_STATS_TIMER(CSV_FORMAT);
+    const double score = quality_score(moisture, aroma, color);
+    const char* status = quality_status(score);
 
-  ofs_ << process << ',';
-  ofs_ << elapsed_seconds << ',';
-  ofs_ << std::fixed << std::setprecision(6) << moisture << ',';
-  ofs_ << std::fixed << std::setprecision(3) << temperature_c << ',';
-  ofs_ << std::fixed << std::setprecision(3) << aroma << ',';
-  ofs_ << std::fixed << std::setprecision(3) << color << ',';
-  ofs_ << std::fixed << std::setprecision(2) << score << ',';
-  ofs_ << status << '\n';
+    if (encoding_ == CsvEncoding::QUANTIZED) {
+      ++rows_in_keyframe_;
+      encoder_.encode_row(buf_, process,
+                          static_cast<int>(
+                              elapsed_milliseconds(elapsed_seconds) /
+                              kMillisecondsPerSecond),
+                          moisture,
+                          temperature_c, aroma, color, score, status);
+    } else {
+      if (batch_ >= 0) {
+        buf_ += std::to_string(batch_);
+        buf_ += ',';
+      }
+      buf_ += process;
+      buf_ += ',';
+      /* .teaq の復号結果と一致させるため、"-0.000" は "0.000" と表示します。 */
+      moisture = drop_negative_zero(moisture, 6);
+      temperature_c = drop_negative_zero(temperature_c, 3);
+      aroma = drop_negative_zero(aroma, 3);
+      color = drop_negative_zero(color, 3);
+      const double shown_score = drop_negative_zero(score, 2);
+      char line[160];
+      const int n = format_row_numbers(line, sizeof(line), elapsed_seconds,
+                                       moisture, temperature_c, aroma, color,
+                                       shown_score, status);
+      if (n > 0 && static_cast<std::size_t>(n) < sizeof(line)) {
+        buf_.append(line, static_cast<std::size_t>(n));
+      } else if (n > 0) {
+        /* 極端な値で桁数が溢れた場合のみ、必要サイズで整形し直します。 */
+        std::vector<char> wide(static_cast<std::size_t>(n) + 1);
+        format_row_numbers(wide.data(), wide.size(), elapsed_seconds, moisture,
+                           temperature_c, aroma, color, shown_score, status);
+        buf_.append(wide.data(), static_cast<std::size_t>(n));
+      }
+    }
+    TEA_STATS_ADD(CSV_ROWS, 1);
+  }
+
+  if (keyframe_rows_ == 0 && buf_.size() >= flush_threshold_bytes_) {
+    drain();
+  }
+}
+
+/*
+ * @brief 経過時間（秒）を CSV・ログ用に整形します。
+ *
+ * ミリ秒単位に丸め、整数秒は "%lld"、それ以外は末尾の 0 を省いた
+ * 最大 3 桁の小数で書きます（例: 30, 0.1, 12.25）。
+ *
+ * @param out 書き込み先
+ * @param size 書き込み先の大きさ（バイト）
+ * @param elapsed_seconds 経過時間（秒）
+ * @return 書いた文字数（snprintf と同じく、切り詰め前の長さ）
+ */
+int CsvWriter::format_elapsed(char* out,
+                              std::size_t size,
+                              double elapsed_seconds) {
+  const long long ms = elapsed_milliseconds(elapsed_seconds);
+  const long long whole = ms / kMillisecondsPerSecond;
+  long long frac = ms % kMillisecondsPerSecond;
+  if (frac == 0) {
+    return std::snprintf(out, size, "%lld", whole);
+  }
+  int digits = 3;
+  frac = frac < 0 ? -frac : frac;
+  while (frac % 10 == 0) {
+    frac /= 10;
+    --digits;
+  }
+  return std::snprintf(out, size, "%s%lld.%0*lld", ms < 0 ? "-" : "",
+                       whole < 0 ? -whole : whole, digits, frac);
 }
 
 /*
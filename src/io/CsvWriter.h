@@ -1,30 +1,100 @@
 #pragma once
 
-#include <fstream>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
 
+#include "io/OutputSink.h"
+#include "io/QuantizedTrace.h"
+
 namespace tea_io {
 
+/* 出力の符号化方式です。 */
+enum class CsvEncoding {
+  TEXT,      /* CSV テキスト */
+  QUANTIZED, /* 固定小数点・差分符号化（.teaq） */
+};
+
+/* シンクを直接指定して構築する場合の書き出し設定です。 */
+struct CsvWriterOptions final {
+  CsvEncoding encoding = CsvEncoding::TEXT;
+
+  /*
+    0 以上なら多重化出力の 1 バッチ分として書きます。
+    TEXT では行頭に batch 列を付け、ヘッダ（.teaq の先頭を含む）は書きません。
+  */
+  int batch = -1;
+
+  /* 内部バッファをシンクへ渡す閾値（バイト）です。 */
+  std::size_t flush_threshold_bytes = 64 * 1024;
+
+  /*
+    QUANTIZED で 0 より大きければ、この行数ごとに符号化をリセットして
+    シンクへ渡します（1 回の受け渡しが単独で復号できるキーフレームになります）。
+    このときバイト数の閾値は使いません。
+  */
+  int keyframe_rows = 0;
+};
+
 /*
   CSV へシミュレーション状態を書き出す軽量ユーティリティです。
   標準ライブラリのみで、ヘッダ1行 + 以降のレコードを追記します。
+  行は内部バッファへ整形し、一定量たまったら出力シンクへまとめて渡します。
 */
 class CsvWriter final {
  public:
-  /* 出力先パスを指定して構築します。 */
-  explicit CsvWriter(const std::string& path);
+  /* 出力先パス、符号化方式、圧縮方式、出力ファイルの設定を指定して構築します。 */
+  explicit CsvWriter(const std::string& path,
+                     CsvEncoding encoding = CsvEncoding::TEXT,
+                     Compression compression = Compression::NONE,
+                     const OutputFileOptions& file = {});
+
+  /* 出力シンクと書き出し設定を指定して構築します。 */
+  CsvWriter(std::unique_ptr<OutputSink> sink, const CsvWriterOptions& options);
 
-  /* ヘッダ行を書き込みます（新規ファイル作成時のみ推奨）。 */
+  /* 未書き出しの行をフラッシュして閉じます。 */
+  ~CsvWriter();
+
+  CsvWriter(CsvWriter&&) = default;
+
+  /* 自身の未書き出しの行をフラッシュしてから other を引き継ぎます。 */
+  CsvWriter& operator=(CsvWriter&& other);
+
+  /* 内部バッファとシンクの保持分をファイルへ書き出します。 */
+  void flush();
+
+  /*
+    予測した行数と 1 行の上限（tea::plan_output など）から、
+    書き出し中に内部バッファが伸びないよう一度だけ確保します。
+  */
+  void reserve_rows(std::int64_t rows, std::size_t max_row_bytes);
+
+  /* 内部バッファの確保済み容量（バイト）を返します。 */
+  std::size_t buffer_capacity() const;
+
+  /* ヘッダ行（QUANTIZED ではファイル先頭）を書き込みます（新規ファイル作成時のみ推奨）。 */
   void write_header();
 
-  /* 1 行分のデータを書き込みます。 */
+  /*
+    1 行分のデータを書き込みます。
+    経過時間はミリ秒単位で書きます（format_elapsed 参照）。QUANTIZED の .teaq は
+    経過時間を整数秒で持つため、1 秒未満の端数は切り捨てます。
+  */
   void write_row(const std::string& process,
-                 int elapsed_seconds,
+                 double elapsed_seconds,
                  double moisture,
                  double temperature_c,
                  double aroma,
                  double color);
 
+  /*
+    経過時間（秒）をミリ秒単位に丸めて out へ整形し、文字数を返します。
+    整数秒は従来どおり整数で、それ以外は小数部を末尾の 0 を省いて
+    最大 3 桁で書きます（out は 32 バイトあれば足ります）。
+  */
+  static int format_elapsed(char* out, std::size_t size, double elapsed_seconds);
+
   /* 品質スコア（0-100）を要件式で算出します。 */
   static double quality_score(double moisture, double aroma, double color);
 
@@ -32,7 +102,17 @@ class CsvWriter final {
   static const char* quality_status(double score);
 
  private:
-  std::ofstream ofs_;
+  /* 内部バッファをシンクへ渡します（シンクのフラッシュはしません）。 */
+  void drain();
+
+  std::unique_ptr<OutputSink> sink_;
+  CsvEncoding encoding_ = CsvEncoding::TEXT;
+  int batch_ = -1;
+  std::size_t flush_threshold_bytes_ = 0;
+  int keyframe_rows_ = 0;
+  int rows_in_keyframe_ = 0;
+  QuantizedEncoder encoder_;
+  std::string buf_;
   bool header_written_ = false;
 };
 
@@ -0,0 +1,238 @@
+/*
+ * @file Lz4.cpp
+ * @brief LZ4 ブロック形式の圧縮/展開
+ *
+ * シーケンス = トークン（上位4ビット: リテラル長、下位4ビット: 一致長-4）
+ *            + [リテラル長の延長] + リテラル + オフセット(2バイト LE) + [一致長の延長]
+ * 末尾 5 バイトは必ずリテラルとし、最後の一致は末尾 12 バイトより前で始めます。
+ */
+
+#include "io/Lz4.h"
+
+#include <cstdint>
+#include <cstring> // For std::memcpy
+#include <vector>
+
+namespace tea_io {
+namespace lz4 {
+
+namespace {
+
+/* 最短一致長です。 */
+constexpr std::size_t kMinMatch = 4;
+
+/* 末尾に必ず残すリテラル数です。 */
+constexpr std::size_t kLastLiterals = 5;
+
+/* 一致を開始できる末尾からの最小距離です。 */
+constexpr std::size_t kMatchFindLimit = 12;
+
+/* 一致を探せる最大距離（オフセットは 16 ビット）です。 */
+constexpr std::size_t kMaxDistance = 65535;
+
+/* ハッシュ表のビット数です。 */
+constexpr int kHashLog = 14;
+
+/*
+ * @brief 4 バイトを読みます（アラインメント不要）。
+ */
+std::uint32_t read32(const char* p) {
+  std::uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+/*
+ * @brief 4 バイト列のハッシュ値を返します。
+ */
+std::uint32_t hash4(std::uint32_t v) {
+  return (v * 2654435761u) >> (32 - kHashLog);
+}
+
+/*
+ * @brief 長さの延長部（255 の繰り返し + 残り）を書きます。
+ */
+char* write_length(char* op, std::size_t len) {
+  while (len >= 255) {
+    *op++ = static_cast<char>(255);
+    len -= 255;
+  }
+  *op++ = static_cast<char>(len);
+  return op;
+}
+
+/*
+ * @brief 1 シーケンス（リテラル + 一致）を書きます。match_len が 0 なら末尾です。
+ */
+char* write_sequence(char* op,
+                     const char* literals,
+                     std::size_t literal_len,
+                     std::size_t offset,
+                     std::size_t match_len) {
+  char* token = op++;
+  const std::size_t ml = (match_len > 0) ? match_len - kMinMatch : 0;
+  *token = static_cast<char>(((literal_len >= 15 ? 15 : literal_len) << 4) |
+                             (ml >= 15 ? 15 : ml));
+  if (literal_len >= 15) {
+    op = write_length(op, literal_len - 15);
+  }
+  std::memcpy(op, literals, literal_len);
+  op += literal_len;
+  if (match_len == 0) {
+    return op;
+  }
+  *op++ = static_cast<char>(offset & 0xFF);
+  *op++ = static_cast<char>(offset >> 8);
+  if (ml >= 15) {
+    op = write_length(op, ml - 15);
+  }
+  return op;
+}
+
+/*
+ * @brief 長さの延長部を読みます。
+ *
+ * @return 成功なら true（入力が途切れていれば false）
+ */
+bool read_length(const unsigned char*& ip,
+                 const unsigned char* end,
+                 std::size_t& len) {
+  unsigned char b = 0;
+  do {
+    if (ip >= end) {
+      return false;
+    }
+    b = *ip++;
+    len += b;
+  } while (b == 255);
+  return true;
+}
+
+} /* namespace */
+
+/*
+ * @brief n バイトを圧縮したときの最大サイズを返します。
+ *
+ * @param n 入力サイズ
+ * @return 圧縮後の最大サイズ
+ */
+std::size_t compress_bound(std::size_t n) {
+  return n + n / 255 + 16;
+}
+
+/*
+ * @brief 入力を LZ4 ブロック形式で圧縮します。
+ *
+ * @param src 入力
+ * @param n 入力サイズ
+ * @param dst 出力先
+ * @param capacity 出力先の容量
+ * @return 圧縮後のサイズ（容量不足なら 0）
+ */
+std::size_t compress(const char* src, std::size_t n, char* dst,
+                     std::size_t capacity) {
+  if (capacity < compress_bound(n)) {
+    return 0;
+  }
+  char* op = dst;
+  std::size_t anchor = 0;
+
+  if (n >= kMatchFindLimit + 1) {
+    /* 位置 + 1 を保持し、0 を「未登録」とします。 */
+    std::vector<std::uint32_t> table(std::size_t{1} << kHashLog, 0);
+    const std::size_t match_start_limit = n - kMatchFindLimit;
+    const std::size_t match_end_limit = n - kLastLiterals;
+
+    std::size_t ip = 0;
+    while (ip < match_start_limit) {
+      const std::uint32_t seq = read32(src + ip);
+      const std::uint32_t h = hash4(seq);
+      const std::size_t candidate = table[h];
+      table[h] = static_cast<std::uint32_t>(ip + 1);
+
+      if (candidate == 0 || ip - (candidate - 1) > kMaxDistance ||
+          read32(src + candidate - 1) != seq) {
+        /* 一致しない区間が続くほど探索間隔を広げます。 */
+        ip += 1 + ((ip - anchor) >> 6);
+        continue;
+      }
+
+      const std::size_t ref = candidate - 1;
+      std::size_t len = kMinMatch;
+      while (ip + len < match_end_limit && src[ref + len] == src[ip + len]) {
+        ++len;
+      }
+      op = write_sequence(op, src + anchor, ip - anchor, ip - ref, len);
+      ip += len;
+      anchor = ip;
+    }
+  }
+
+  op = write_sequence(op, src + anchor, n - anchor, 0, 0);
+  return static_cast<std::size_t>(op - dst);
+}
+
+/*
+ * @brief LZ4 ブロック形式のデータを展開します。
+ *
+ * @param src 圧縮データ
+ * @param n 圧縮データのサイズ
+ * @param dst 出力先
+ * @param dst_size 展開後の期待サイズ
+ * @return ちょうど dst_size バイトに展開できたら true
+ */
+bool decompress(const char* src, std::size_t n, char* dst,
+                std::size_t dst_size) {
+  const unsigned char* ip = reinterpret_cast<const unsigned char*>(src);
+  const unsigned char* const end = ip + n;
+  std::size_t op = 0;
+
+  while (ip < end) {
+    const unsigned char token = *ip++;
+
+    std::size_t literal_len = token >> 4;
+    if (literal_len == 15 && !read_length(ip, end, literal_len)) {
+      return false;
+    }
+    if (literal_len > static_cast<std::size_t>(end - ip) ||
+        literal_len > dst_size - op) {
+      return false;
+    }
+    std::memcpy(dst + op, ip, literal_len);
+    ip += literal_len;
+    op += literal_len;
+
+    if (ip == end) {
+      break; /* 末尾シーケンスはリテラルのみです。 */
+    }
+
+    if (end - ip < 2) {
+      return false;
+    }
+    const std::size_t offset =
+        static_cast<std::size_t>(ip[0]) | (static_cast<std::size_t>(ip[1]) << 8);
+    ip += 2;
+    if (offset == 0 || offset > op) {
+      return false;
+    }
+
+    std::size_t match_len = token & 0x0F;
+    if (match_len == 15 && !read_length(ip, end, match_len)) {
+      return false;
+    }
+    match_len += kMinMatch;
+    if (match_len > dst_size - op) {
+      return false;
+    }
+    /* 重なりのある複製（offset < match_len）があるため 1 バイトずつ写します。 */
+    const std::size_t from = op - offset;
+    for (std::size_t i = 0; i < match_len; ++i) {
+      dst[op + i] = dst[from + i];
+    }
+    op += match_len;
+  }
+  return op == dst_size;
+}
+
+} /* namespace lz4 */
+} /* namespace tea_io */
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+namespace tea_io {
+namespace lz4 {
+
+/*
+  LZ4 ブロック形式の最小実装です（外部ライブラリ不要）。
+  出力は LZ4 のブロック形式と互換で、フレーム形式（チェックサム等）は扱いません。
+  速度優先の貪欲マッチで、圧縮率よりも書き出しスレッドの負荷の小ささを重視します。
+*/
+
+/* n バイトを圧縮したときの最大サイズを返します。 */
+std::size_t compress_bound(std::size_t n);
+
+/*
+  src を圧縮して dst へ書き、圧縮後のサイズを返します。
+  capacity が compress_bound(n) 未満なら 0 を返します。
+*/
+std::size_t compress(const char* src, std::size_t n, char* dst,
+                     std::size_t capacity);
+
+/*
+  圧縮データを展開します。展開後がちょうど dst_size バイトになれば true を返します。
+  入力が壊れていても dst の範囲外へは書きません。
+*/
+bool decompress(const char* src, std::size_t n, char* dst,
+                std::size_t dst_size);
+
+} /* namespace lz4 */
+} /* namespace tea_io */
@@ -0,0 +1,465 @@
+/*
+ * @file Multiplex.cpp
+ * @brief 多数バッチの単一ファイル出力（多重化）と、索引によるバッチ単位の読み出し
+ *
+ * 各バッチの CsvWriter は小さな閾値で MultiplexWriter へデータを渡し、
+ * MultiplexWriter はそれを 1 本の連続書き込みにまとめます。
+ */
+
+#include "io/Multiplex.h"
+
+#include <algorithm> // For std::upper_bound
+#include <limits>
+#include <utility>   // For std::move
+
+#include "io/ByteOrder.h"
+#include "io/Lz4.h"
+#include "io/QuantizedTrace.h"
+
+namespace tea_io {
+
+namespace {
+
+/* .team の先頭マジック、版数、末尾マジックです。 */
+constexpr char kMagic[4] = {'T', 'E', 'A', 'M'};
+constexpr std::uint8_t kVersion = 2;
+constexpr char kTrailerMagic[4] = {'T', 'E', 'M', 'X'};
+
+/* チャンクヘッダ、索引エントリ、末尾のサイズ（バイト）です。 */
+constexpr std::size_t kChunkHeaderBytes = 12;
+constexpr std::size_t kIndexEntryBytes = 16;
+constexpr std::size_t kTrailerBytes = 20;
+
+/* 格納サイズの「無圧縮で格納」フラグです。 */
+constexpr std::uint32_t kStoredRawFlag = 0x80000000u;
+
+/* 読み込み時に受け付けるチャンクの上限（破損データでの過大確保を防ぎます）。 */
+constexpr std::uint32_t kMaxChunkSize = 64u * 1024u * 1024u;
+
+/* バッチごとの書き手が多重化側へ渡す閾値です（バッチ数が多くても省メモリ）。 */
+constexpr std::size_t kLaneFlushThresholdBytes = 4 * 1024;
+
+/* 多重化側がシンクへまとめて渡す閾値です。 */
+constexpr std::size_t kStagingBytes = 1024 * 1024;
+
+/* TEXT の多重化 CSV のヘッダです。 */
+constexpr const char* kTextHeader =
+    "batch,process,elapsedSeconds,moisture,temperatureC,aroma,color,"
+    "qualityScore,qualityStatus\n";
+
+} /* namespace */
+
+/*
+  1 バッチ分の書き手が使うシンクです。受け取ったデータを多重化側へ渡します。
+  ファイルへの書き出しは多重化側がまとめて行うため、flush では何もしません。
+*/
+class MultiplexWriter::LaneSink final : public OutputSink {
+ public:
+  LaneSink(MultiplexWriter* owner, int batch) : owner_(owner), batch_(batch) {
+  }
+
+  bool is_open() const override {
+    return owner_->is_open();
+  }
+
+  void write(const char* data, std::size_t n) override {
+    owner_->append(batch_, data, n);
+  }
+
+  void flush() override {
+  }
+
+ private:
+  MultiplexWriter* owner_;
+  int batch_;
+};
+
+/*
+ * @brief 出力先パス、符号化方式、圧縮方式、時刻索引の間隔を指定して構築します。
+ *
+ * TEXT は CSV ヘッダを、QUANTIZED は .team の先頭を書きます。
+ *
+ * @param path 出力パス
+ * @param encoding 符号化方式
+ * @param compression 圧縮方式（TEXT はファイル全体、QUANTIZED はチャンク単位）
+ * @param keyframe_rows QUANTIZED のチャンク（キーフレーム）あたりの行数 K
+ * @param file 書き出し方式・事前確保量など
+ */
+MultiplexWriter::MultiplexWriter(const std::string& path,
+                                 CsvEncoding encoding,
+                                 Compression compression,
+                                 int keyframe_rows,
+                                 const OutputFileOptions& file)
+    : sink_(make_output_sink(path,
+                             encoding == CsvEncoding::TEXT ? compression
+                                                           : Compression::NONE,
+                             file)),
+      encoding_(encoding),
+      compression_(compression),
+      keyframe_rows_(keyframe_rows > 0 ? keyframe_rows
+                                       : kDefaultKeyframeRows) {
+  staging_.reserve(kStagingBytes + kLaneFlushThresholdBytes * 2);
+  if (encoding_ == CsvEncoding::TEXT) {
+    staging_ += kTextHeader;
+  } else {
+    staging_.append(kMagic, sizeof(kMagic));
+    staging_ += static_cast<char>(kVersion);
+  }
+  offset_ = staging_.size();
+}
+
+/*
+ * @brief 索引を書いて閉じます。
+ */
+MultiplexWriter::~MultiplexWriter() {
+  finish();
+}
+
+/*
+ * @brief 書き出し可能かを返します。
+ *
+ * @return 書き出し可能なら true
+ */
+bool MultiplexWriter::is_open() const {
+  return !finished_ && sink_ && sink_->is_open();
+}
+
+/*
+ * @brief バッチ用の書き手を生成します。
+ *
+ * @param batch バッチ番号（0 以上）
+ * @return 書き手
+ */
+CsvWriter MultiplexWriter::make_writer(int batch) {
+  CsvWriterOptions options;
+  options.encoding = encoding_;
+  options.batch = batch;
+  options.flush_threshold_bytes = kLaneFlushThresholdBytes;
+  options.keyframe_rows = keyframe_rows_;
+  return CsvWriter(std::make_unique<LaneSink>(this, batch), options);
+}
+
+/*
+ * @brief これまでに書いたチャンク数を返します。
+ *
+ * @return チャンク数（TEXT では 0）
+ */
+std::size_t MultiplexWriter::chunk_count() const {
+  return index_.size();
+}
+
+/*
+ * @brief バッチのデータを受け取り、連続書き込み用のバッファへ積みます。
+ *
+ * QUANTIZED ではチャンクヘッダを付け、索引へ位置と先頭行の経過時間を記録します。
+ *
+ * @param batch バッチ番号
+ * @param data データ
+ * @param n バイト数
+ */
+void MultiplexWriter::append(int batch, const char* data, std::size_t n) {
+  if (!is_open() || n == 0) {
+    return;
+  }
+  if (encoding_ == CsvEncoding::TEXT) {
+    staging_.append(data, n);
+  } else {
+    const char* payload = data;
+    std::uint32_t stored = static_cast<std::uint32_t>(n) | kStoredRawFlag;
+    std::size_t payload_size = n;
+    if (compression_ == Compression::LZ4) {
+      compressed_.resize(lz4::compress_bound(n));
+      const std::size_t c =
+          lz4::compress(data, n, &compressed_[0], compressed_.size());
+      if (c > 0 && c < n) {
+        payload = compressed_.data();
+        payload_size = c;
+        stored = static_cast<std::uint32_t>(c);
+      }
+    }
+
+    IndexEntry entry;
+    entry.batch = static_cast<std::uint32_t>(batch);
+    std::int64_t first = 0;
+    read_keyframe_elapsed(data, n, first);
+    entry.first_elapsed_seconds = static_cast<std::int32_t>(first);
+    entry.offset = offset_;
+    index_.push_back(entry);
+    put_u32(staging_, static_cast<std::uint32_t>(batch));
+    put_u32(staging_, static_cast<std::uint32_t>(n));
+    put_u32(staging_, stored);
+    staging_.append(payload, payload_size);
+    offset_ += kChunkHeaderBytes + payload_size;
+  }
+
+  if (staging_.size() >= kStagingBytes) {
+    drain();
+  }
+}
+
+/*
+ * @brief 連続書き込み用のバッファをシンクへ渡します。
+ */
+void MultiplexWriter::drain() {
+  if (!staging_.empty() && sink_) {
+    sink_->write(staging_.data(), staging_.size());
+  }
+  staging_.clear();
+}
+
+/*
+ * @brief 保持分と索引を書き出して閉じます。
+ *
+ * 書き手が保持している未書き出し分は含まれないため、先に各書き手を
+ * フラッシュしてから呼び出します。
+ */
+void MultiplexWriter::finish() {
+  if (finished_ || !sink_) {
+    return;
+  }
+  if (encoding_ == CsvEncoding::QUANTIZED && sink_->is_open()) {
+    const std::uint64_t index_offset = offset_;
+    for (const IndexEntry& e : index_) {
+      put_u32(staging_, e.batch);
+      put_u32(staging_, static_cast<std::uint32_t>(e.first_elapsed_seconds));
+      put_u64(staging_, e.offset);
+    }
+    put_u64(staging_, index_offset);
+    put_u64(staging_, index_.size());
+    staging_.append(kTrailerMagic, sizeof(kTrailerMagic));
+  }
+  drain();
+  sink_->flush();
+  sink_.reset();
+  finished_ = true;
+}
+
+/*
+ * @brief 入力パスを指定して構築し、末尾から索引を読み込みます。
+ *
+ * @param path .team ファイルのパス
+ */
+MultiplexReader::MultiplexReader(const std::string& path)
+    : ifs_(path, std::ios::in | std::ios::binary) {
+  char head[sizeof(kMagic) + 1];
+  if (!ifs_.read(head, sizeof(head)) ||
+      std::string(head, sizeof(kMagic)) !=
+          std::string(kMagic, sizeof(kMagic)) ||
+      static_cast<std::uint8_t>(head[sizeof(kMagic)]) != kVersion) {
+    return;
+  }
+
+  ifs_.seekg(0, std::ios::end);
+  const std::uint64_t file_size = static_cast<std::uint64_t>(ifs_.tellg());
+  if (file_size < sizeof(head) + kTrailerBytes) {
+    return;
+  }
+  char trailer[kTrailerBytes];
+  ifs_.seekg(static_cast<std::streamoff>(file_size - kTrailerBytes));
+  if (!ifs_.read(trailer, sizeof(trailer)) ||
+      std::string(trailer + 16, 4) !=
+          std::string(kTrailerMagic, sizeof(kTrailerMagic))) {
+    return;
+  }
+  const std::uint64_t index_offset = get_u64(trailer);
+  const std::uint64_t count = get_u64(trailer + 8);
+  if (index_offset > file_size - kTrailerBytes ||
+      count != (file_size - kTrailerBytes - index_offset) / kIndexEntryBytes) {
+    return;
+  }
+
+  std::string index(static_cast<std::size_t>(count * kIndexEntryBytes), '\0');
+  ifs_.seekg(static_cast<std::streamoff>(index_offset));
+  if (!index.empty() &&
+      !ifs_.read(&index[0], static_cast<std::streamsize>(index.size()))) {
+    return;
+  }
+  for (std::uint64_t i = 0; i < count; ++i) {
+    const char* e = index.data() + i * kIndexEntryBytes;
+    ChunkRef ref;
+    ref.first_elapsed_seconds = static_cast<std::int32_t>(get_u32(e + 4));
+    ref.offset = get_u64(e + 8);
+    if (ref.offset + kChunkHeaderBytes > index_offset) {
+      return;
+    }
+    std::vector<ChunkRef>& refs = chunks_[static_cast<int>(get_u32(e))];
+    if (!refs.empty() &&
+        ref.first_elapsed_seconds < refs.back().first_elapsed_seconds) {
+      return; /* 時刻索引は単調でなければ二分探索できません。 */
+    }
+    refs.push_back(ref);
+  }
+  open_ = true;
+}
+
+/*
+ * @brief 形式が正しく索引を読めたかを返します。
+ *
+ * @return 読めたら true
+ */
+bool MultiplexReader::is_open() const {
+  return open_;
+}
+
+/*
+ * @brief 含まれるバッチ番号を昇順で返します。
+ *
+ * @return バッチ番号の列
+ */
+std::vector<int> MultiplexReader::batches() const {
+  std::vector<int> out;
+  out.reserve(chunks_.size());
+  for (const auto& kv : chunks_) {
+    out.push_back(kv.first);
+  }
+  return out;
+}
+
+/*
+ * @brief 直近の query で読んだチャンク数を返します。
+ *
+ * @return チャンク数
+ */
+std::size_t MultiplexReader::last_chunks_read() const {
+  return last_chunks_read_;
+}
+
+/*
+ * @brief チャンクを 1 つ読み、先頭を付けた .teaq バイト列として返します。
+ *
+ * @param batch 期待するバッチ番号
+ * @param offset チャンク先頭のオフセット
+ * @param out .teaq バイト列（先頭を含む）
+ * @return 読めたら true
+ */
+bool MultiplexReader::read_chunk(int batch,
+                                 std::uint64_t offset,
+                                 std::string& out) {
+  out.clear();
+  char head[kChunkHeaderBytes];
+  ifs_.clear();
+  ifs_.seekg(static_cast<std::streamoff>(offset));
+  if (!ifs_.read(head, sizeof(head)) ||
+      static_cast<int>(get_u32(head)) != batch) {
+    return false;
+  }
+  const std::uint32_t raw_size = get_u32(head + 4);
+  const std::uint32_t stored_field = get_u32(head + 8);
+  const bool raw = (stored_field & kStoredRawFlag) != 0;
+  const std::uint32_t stored_size = stored_field & ~kStoredRawFlag;
+  if (raw_size > kMaxChunkSize || stored_size > kMaxChunkSize ||
+      (raw && stored_size != raw_size)) {
+    return false;
+  }
+
+  QuantizedEncoder::write_preamble(out);
+  const std::size_t at = out.size();
+  if (raw) {
+    out.resize(at + stored_size);
+    return stored_size == 0 ||
+           static_cast<bool>(
+               ifs_.read(&out[at], static_cast<std::streamsize>(stored_size)));
+  }
+  std::string stored(stored_size, '\0');
+  if (stored_size > 0 &&
+      !ifs_.read(&stored[0], static_cast<std::streamsize>(stored_size))) {
+    return false;
+  }
+  out.resize(at + raw_size);
+  return lz4::decompress(stored.data(), stored_size, &out[at], raw_size);
+}
+
+/*
+ * @brief バッチの経過時間 [t0, t1] の行を読み出します。
+ *
+ * 時刻索引を二分探索して t0 を含むチャンクを求め、以降は t1 を超える
+ * チャンクに達するまで順に読みます。シーク回数は O(log n + 範囲のチャンク数) です。
+ *
+ * @param batch バッチ番号
+ * @param t0 開始時刻（秒、含む）
+ * @param t1 終了時刻（秒、含む）
+ * @param rows 読み出した行（上書き）
+ * @return バッチが存在し、読み出しに成功したら true
+ */
+bool MultiplexReader::query(int batch,
+                            int t0,
+                            int t1,
+                            std::vector<QuantizedRow>& rows) {
+  rows.clear();
+  last_chunks_read_ = 0;
+  const auto it = chunks_.find(batch);
+  if (!open_ || it == chunks_.end()) {
+    return false;
+  }
+  const std::vector<ChunkRef>& refs = it->second;
+
+  /* 先頭時刻が t0 を超える最初のチャンクの 1 つ前から読み始めます。 */
+  auto first = std::upper_bound(
+      refs.begin(), refs.end(), static_cast<std::int64_t>(t0),
+      [](std::int64_t t, const ChunkRef& r) {
+        return t < r.first_elapsed_seconds;
+      });
+  if (first != refs.begin()) {
+    --first;
+  }
+
+  std::string bytes;
+  for (auto c = first; c != refs.end(); ++c) {
+    if (c->first_elapsed_seconds > t1) {
+      break;
+    }
+    if (!read_chunk(batch, c->offset, bytes)) {
+      return false;
+    }
+    ++last_chunks_read_;
+    QuantizedTraceReader reader =
+        QuantizedTraceReader::from_bytes(std::move(bytes));
+    QuantizedRow row;
+    while (reader.next(row)) {
+      if (row.elapsed_seconds >= t0 && row.elapsed_seconds <= t1) {
+        rows.push_back(row);
+      }
+    }
+    if (!reader.is_open() || reader.corrupted()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * @brief query の結果を CSV（ヘッダ付き）として返します。
+ *
+ * @param batch バッチ番号
+ * @param t0 開始時刻（秒、含む）
+ * @param t1 終了時刻（秒、含む）
+ * @param out CSV テキスト
+ * @return 成功なら true
+ */
+bool MultiplexReader::query_csv(int batch, int t0, int t1, std::string& out) {
+  out = "process,elapsedSeconds,moisture,temperatureC,aroma,color,"
+        "qualityScore,qualityStatus\n";
+  std::vector<QuantizedRow> rows;
+  if (!query(batch, t0, t1, rows)) {
+    out.clear();
+    return false;
+  }
+  for (const QuantizedRow& row : rows) {
+    append_csv_row(out, row);
+  }
+  return true;
+}
+
+/*
+ * @brief バッチ全体を CSV（ヘッダ付き）として読み出します。
+ *
+ * @param batch バッチ番号
+ * @param out CSV テキスト
+ * @return バッチが存在し、最後まで復号できたら true
+ */
+bool MultiplexReader::read_batch_csv(int batch, std::string& out) {
+  return query_csv(batch, std::numeric_limits<int>::min(),
+                   std::numeric_limits<int>::max(), out);
+}
+
+} /* namespace tea_io */
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "io/CsvWriter.h"
+#include "io/OutputSink.h"
+#include "io/QuantizedTrace.h"
+
+namespace tea_io {
+
+/*
+  多数のバッチを 1 ファイルへまとめて書く多重化出力です。
+  ファイル記述子は 1 つだけで、各バッチの書き手（CsvWriter）が小さくためた
+  データをまとめて大きな連続書き込みにします。
+
+  TEXT:      先頭に batch 列を持つ 1 本の CSV（圧縮指定時は LZ4）
+  QUANTIZED: バッチ別チャンクの列 + 索引フッタを持つ索引付きトレース（.team）
+
+  .team のレイアウト:
+    "TEAM" + 版数 1 バイト
+    チャンク = u32 バッチ番号 + u32 展開後サイズ
+             + u32 格納サイズ（最上位ビット: 無圧縮で格納）+ データ
+    索引     = チャンクごとに u32 バッチ番号 + i32 先頭行の経過時間
+             + u64 チャンク先頭オフセット（ファイル内の順）
+    末尾     = u64 索引オフセット + u64 チャンク数 + "TEMX"
+  各チャンクは K 行ごとのキーフレームで、先頭を付ければ単独の .teaq として
+  復号できます。索引は「バッチ別のオフセット」と「K 行ごとの疎な時刻索引」を兼ねます。
+*/
+class MultiplexWriter final {
+ public:
+  /* 時刻索引の間隔（キーフレームの行数 K）の既定値です。 */
+  static constexpr int kDefaultKeyframeRows = 256;
+
+  /* 出力先パス、符号化方式、圧縮方式、時刻索引の間隔、出力ファイルの設定を指定して構築します。 */
+  MultiplexWriter(const std::string& path,
+                  CsvEncoding encoding,
+                  Compression compression,
+                  int keyframe_rows = kDefaultKeyframeRows,
+                  const OutputFileOptions& file = {});
+
+  /* 索引を書いて閉じます（finish 済みなら何もしません）。 */
+  ~MultiplexWriter();
+
+  MultiplexWriter(const MultiplexWriter&) = delete;
+  MultiplexWriter& operator=(const MultiplexWriter&) = delete;
+
+  /* 書き出し可能なら true を返します。 */
+  bool is_open() const;
+
+  /*
+    バッチ batch 用の書き手を生成します。
+    書き手はこの MultiplexWriter より先にフラッシュ（または破棄）してください。
+  */
+  CsvWriter make_writer(int batch);
+
+  /* 保持分と索引を書き出して閉じます。 */
+  void finish();
+
+  /* これまでに書いたチャンク数を返します。 */
+  std::size_t chunk_count() const;
+
+ private:
+  class LaneSink;
+
+  /* バッチ batch のデータを受け取ります（書き手のシンクから呼ばれます）。 */
+  void append(int batch, const char* data, std::size_t n);
+
+  /* 連続書き込み用のバッファをシンクへ渡します。 */
+  void drain();
+
+  /* 索引の 1 エントリです。 */
+  struct IndexEntry final {
+    std::uint32_t batch = 0;
+    std::int32_t first_elapsed_seconds = 0;
+    std::uint64_t offset = 0;
+  };
+
+  std::unique_ptr<OutputSink> sink_;
+  CsvEncoding encoding_;
+  Compression compression_;
+  int keyframe_rows_;
+  std::string staging_;
+  std::string compressed_;
+  std::uint64_t offset_ = 0;
+  std::vector<IndexEntry> index_;
+  bool finished_ = false;
+};
+
+/*
+  .team ファイルから索引を使ってバッチ・時刻範囲を読み出します。
+  索引はフッタから 1 回で読み、範囲の先頭チャンクを二分探索で求めたあと、
+  範囲に掛かるチャンクだけをシークして読みます。
+*/
+class MultiplexReader final {
+ public:
+  /* 入力パスを指定して構築し、索引を読み込みます。 */
+  explicit MultiplexReader(const std::string& path);
+
+  /* 形式が正しく索引を読めたら true を返します。 */
+  bool is_open() const;
+
+  /* 含まれるバッチ番号を昇順で返します。 */
+  std::vector<int> batches() const;
+
+  /*
+    バッチ batch の経過時間 [t0, t1] の行を読み出します（rows は上書き）。
+    バッチが無い、または読み出しに失敗したら false を返します。
+  */
+  bool query(int batch, int t0, int t1, std::vector<QuantizedRow>& rows);
+
+  /* query の結果を CSV（ヘッダ付き）として返します。 */
+  bool query_csv(int batch, int t0, int t1, std::string& out);
+
+  /* バッチ全体を CSV（ヘッダ付き）として読み出します。無ければ false を返します。 */
+  bool read_batch_csv(int batch, std::string& out);
+
+  /* 直近の query で読んだチャンク数を返します（シーク回数の目安）。 */
+  std::size_t last_chunks_read() const;
+
+ private:
+  /* チャンクの位置と先頭行の経過時間です。 */
+  struct ChunkRef final {
+    std::int64_t first_elapsed_seconds = 0;
+    std::uint64_t offset = 0;
+  };
+
+  /* チャンクを読み、先頭を付けた .teaq バイト列として返します。 */
+  bool read_chunk(int batch, std::uint64_t offset, std::string& out);
+
+  std::ifstream ifs_;
+  bool open_ = false;
+  std::map<int, std::vector<ChunkRef>> chunks_;
+  std::size_t last_chunks_read_ = 0;
+};
+
+} /* namespace tea_io */
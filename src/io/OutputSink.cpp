@@ -0,0 +1,356 @@
+/*
+ * @file OutputSink.cpp
+ * @brief 出力シンク（無圧縮/LZ4 ブロック圧縮）と読み戻し
+ *
+ * CsvWriter などが整形したバイト列を受け取り、ファイルへ書き出します。
+ * 圧縮シンクは大きなブロック単位で圧縮し、書き出し回数と容量を減らします。
+ */
+
+#include "io/OutputSink.h"
+
+#include <cstdint>
+#include <utility> // For std::move
+
+#include "io/ByteOrder.h"
+#include "io/Lz4.h"
+#include "io/UringSink.h"
+
+namespace tea_io {
+
+namespace {
+
+/* 圧縮ファイルの先頭マジックと版数です。 */
+constexpr char kMagic[4] = {'T', 'E', 'A', 'Z'};
+constexpr std::uint8_t kVersion = 1;
+
+/* 格納サイズの「無圧縮で格納」フラグです。 */
+constexpr std::uint32_t kStoredRawFlag = 0x80000000u;
+
+/* 読み込み時に受け付けるブロックの上限（破損データでの過大確保を防ぎます）。 */
+constexpr std::uint32_t kMaxBlockSize = 64u * 1024u * 1024u;
+
+/* 無圧縮ファイルを読み戻すときの塊サイズです。 */
+constexpr std::size_t kPlainChunkSize = 256 * 1024;
+
+} /* namespace */
+
+/*
+ * @brief 出力先パスを指定して構築します。
+ *
+ * @param path 出力パス
+ */
+FileSink::FileSink(const std::string& path)
+    : ofs_(path, std::ios::out | std::ios::trunc | std::ios::binary) {
+}
+
+/*
+ * @brief 書き出し可能かを返します。
+ *
+ * @return ファイルが開けていれば true
+ */
+bool FileSink::is_open() const {
+  return ofs_.is_open();
+}
+
+/*
+ * @brief バイト列をファイルへ書き込みます。
+ *
+ * @param data 書き込むデータ
+ * @param n バイト数
+ */
+void FileSink::write(const char* data, std::size_t n) {
+  ofs_.write(data, static_cast<std::streamsize>(n));
+}
+
+/*
+ * @brief ストリームをフラッシュします。
+ */
+void FileSink::flush() {
+  ofs_.flush();
+}
+
+/*
+ * @brief 出力先パスとブロックサイズを指定して構築し、先頭を書きます。
+ *
+ * @param path 出力パス
+ * @param block_size 圧縮ブロックのサイズ（バイト）
+ */
+Lz4FileSink::Lz4FileSink(const std::string& path, std::size_t block_size)
+    : Lz4FileSink(std::make_unique<FileSink>(path), block_size) {
+}
+
+/*
+ * @brief 下位のシンクとブロックサイズを指定して構築し、先頭を書きます。
+ *
+ * @param inner 圧縮後のデータを受け取るシンク
+ * @param block_size 圧縮ブロックのサイズ（バイト）
+ */
+Lz4FileSink::Lz4FileSink(std::unique_ptr<OutputSink> inner,
+                         std::size_t block_size)
+    : inner_(std::move(inner)),
+      block_size_(block_size == 0 ? kDefaultBlockSize : block_size) {
+  if (is_open()) {
+    std::string head(kMagic, sizeof(kMagic));
+    head += static_cast<char>(kVersion);
+    inner_->write(head.data(), head.size());
+  }
+  pending_.reserve(block_size_);
+  compressed_.resize(lz4::compress_bound(block_size_));
+}
+
+/*
+ * @brief 残りのデータと終端を書いて閉じます。
+ */
+Lz4FileSink::~Lz4FileSink() {
+  if (!is_open()) {
+    return;
+  }
+  if (!pending_.empty()) {
+    write_block(pending_.size());
+  }
+  std::string end;
+  put_u32(end, 0);
+  inner_->write(end.data(), end.size());
+  inner_->flush();
+}
+
+/*
+ * @brief 書き出し可能かを返します。
+ *
+ * @return 下位のシンクが書き出し可能なら true
+ */
+bool Lz4FileSink::is_open() const {
+  return inner_ && inner_->is_open();
+}
+
+/*
+ * @brief バイト列を受け取り、ブロックサイズに達した分から圧縮して書きます。
+ *
+ * @param data 書き込むデータ
+ * @param n バイト数
+ */
+void Lz4FileSink::write(const char* data, std::size_t n) {
+  if (!is_open()) {
+    return;
+  }
+  pending_.append(data, n);
+  while (pending_.size() >= block_size_) {
+    write_block(block_size_);
+  }
+}
+
+/*
+ * @brief 途中のブロックも圧縮して書き出します。
+ */
+void Lz4FileSink::flush() {
+  if (!is_open()) {
+    return;
+  }
+  if (!pending_.empty()) {
+    write_block(pending_.size());
+  }
+  inner_->flush();
+}
+
+/*
+ * @brief pending_ の先頭 n バイトを 1 ブロックとして書きます。
+ *
+ * 圧縮しても小さくならない場合は無圧縮で格納します。
+ *
+ * @param n ブロックのバイト数
+ */
+void Lz4FileSink::write_block(std::size_t n) {
+  if (compressed_.size() < lz4::compress_bound(n)) {
+    compressed_.resize(lz4::compress_bound(n));
+  }
+  const std::size_t c =
+      lz4::compress(pending_.data(), n, &compressed_[0], compressed_.size());
+
+  std::string head;
+  put_u32(head, static_cast<std::uint32_t>(n));
+  if (c > 0 && c < n) {
+    put_u32(head, static_cast<std::uint32_t>(c));
+    inner_->write(head.data(), head.size());
+    inner_->write(compressed_.data(), c);
+  } else {
+    put_u32(head, static_cast<std::uint32_t>(n) | kStoredRawFlag);
+    inner_->write(head.data(), head.size());
+    inner_->write(pending_.data(), n);
+  }
+  pending_.erase(0, n);
+}
+
+/*
+ * @brief 圧縮方式と出力ファイルの設定に応じたファイルシンクを生成します。
+ *
+ * @param path 出力パス
+ * @param compression 圧縮方式
+ * @param file 書き出し方式・事前確保量・O_DIRECT の有無
+ * @return 生成したシンク
+ */
+std::unique_ptr<OutputSink> make_output_sink(const std::string& path,
+                                             Compression compression,
+                                             const OutputFileOptions& file) {
+  std::unique_ptr<OutputSink> sink;
+#if !defined(_WIN32)
+  if (file.backend == WriteBackend::URING || file.preallocate_bytes > 0 ||
+      file.direct) {
+    UringFileSinkOptions options;
+    options.force_pwrite = file.backend != WriteBackend::URING;
+    options.preallocate_bytes = file.preallocate_bytes;
+    options.direct = file.direct;
+    sink = std::make_unique<UringFileSink>(path, options);
+  }
+#else
+  (void)file;
+#endif
+  if (!sink) {
+    sink = std::make_unique<FileSink>(path);
+  }
+  if (compression == Compression::LZ4) {
+    return std::make_unique<Lz4FileSink>(std::move(sink));
+  }
+  return sink;
+}
+
+/*
+ * @brief 入力パスを指定して構築し、先頭から圧縮形式かを判定します。
+ *
+ * @param path 入力パス
+ */
+OutputFileReader::OutputFileReader(const std::string& path)
+    : ifs_(path, std::ios::in | std::ios::binary) {
+  if (!ifs_.is_open()) {
+    return;
+  }
+  open_ = true;
+
+  char head[sizeof(kMagic) + 1];
+  ifs_.read(head, sizeof(head));
+  const std::streamsize got = ifs_.gcount();
+  if (got == static_cast<std::streamsize>(sizeof(head)) &&
+      std::string(head, sizeof(kMagic)) ==
+          std::string(kMagic, sizeof(kMagic)) &&
+      static_cast<std::uint8_t>(head[sizeof(kMagic)]) == kVersion) {
+    compressed_ = true;
+    return;
+  }
+  /* 無圧縮: 読んでしまった先頭は最初の塊として返します。 */
+  head_.assign(head, static_cast<std::size_t>(got));
+  ifs_.clear();
+}
+
+/*
+ * @brief ファイルが開けたかを返します。
+ *
+ * @return 開けていれば true
+ */
+bool OutputFileReader::is_open() const {
+  return open_;
+}
+
+/*
+ * @brief 圧縮形式かを返します。
+ *
+ * @return 圧縮形式なら true
+ */
+bool OutputFileReader::compressed() const {
+  return compressed_;
+}
+
+/*
+ * @brief 破損を検出したかを返します。
+ *
+ * @return 破損していれば true
+ */
+bool OutputFileReader::corrupted() const {
+  return corrupted_;
+}
+
+/*
+ * @brief 次の塊を読み込みます。
+ *
+ * @param out 読み込んだ塊（上書き）
+ * @return 読めたら true（終端または破損で false）
+ */
+bool OutputFileReader::read_chunk(std::string& out) {
+  out.clear();
+  if (!open_ || finished_ || corrupted_) {
+    return false;
+  }
+
+  if (!compressed_) {
+    out.swap(head_);
+    const std::size_t have = out.size();
+    out.resize(have + kPlainChunkSize);
+    ifs_.read(&out[have], static_cast<std::streamsize>(kPlainChunkSize));
+    out.resize(have + static_cast<std::size_t>(ifs_.gcount()));
+    if (out.empty()) {
+      finished_ = true;
+      return false;
+    }
+    return true;
+  }
+
+  char head[8];
+  if (!ifs_.read(head, 4)) {
+    corrupted_ = true; /* 終端マーカーが無い */
+    return false;
+  }
+  const std::uint32_t raw_size = get_u32(head);
+  if (raw_size == 0) {
+    finished_ = true;
+    return false;
+  }
+  if (!ifs_.read(head + 4, 4)) {
+    corrupted_ = true;
+    return false;
+  }
+  const std::uint32_t stored = get_u32(head + 4);
+  const bool raw = (stored & kStoredRawFlag) != 0;
+  const std::uint32_t stored_size = stored & ~kStoredRawFlag;
+  if (raw_size > kMaxBlockSize || stored_size > kMaxBlockSize ||
+      (raw && stored_size != raw_size)) {
+    corrupted_ = true;
+    return false;
+  }
+
+  stored_.resize(stored_size);
+  if (!ifs_.read(&stored_[0], static_cast<std::streamsize>(stored_size))) {
+    corrupted_ = true;
+    return false;
+  }
+  if (raw) {
+    out.swap(stored_);
+    return true;
+  }
+  out.resize(raw_size);
+  if (!lz4::decompress(stored_.data(), stored_size, &out[0], raw_size)) {
+    out.clear();
+    corrupted_ = true;
+    return false;
+  }
+  return true;
+}
+
+/*
+ * @brief 出力ファイル全体を読み込みます。
+ *
+ * @param path 入力パス
+ * @param out 読み込んだ内容（展開後）
+ * @return 成功なら true
+ */
+bool read_output_file(const std::string& path, std::string& out) {
+  out.clear();
+  OutputFileReader reader(path);
+  if (!reader.is_open()) {
+    return false;
+  }
+  std::string chunk;
+  while (reader.read_chunk(chunk)) {
+    out += chunk;
+  }
+  return !reader.corrupted();
+}
+
+} /* namespace tea_io */
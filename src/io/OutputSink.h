@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+
+namespace tea_io {
+
+/* 出力の圧縮方式です。 */
+enum class Compression {
+  NONE, /* 無圧縮 */
+  LZ4,  /* LZ4 ブロック圧縮（.lz4） */
+};
+
+/* ファイルへの書き出し方式です。 */
+enum class WriteBackend {
+  STREAM, /* std::ofstream */
+  URING,  /* io_uring の非同期書き込み（使えなければ pwrite） */
+};
+
+/* 出力ファイルの開き方・書き方の設定です。 */
+struct OutputFileOptions {
+  /* 書き出し方式です。 */
+  WriteBackend backend = WriteBackend::STREAM;
+
+  /* fallocate で先に確保する領域（バイト、0 なら確保しない）です。 */
+  std::uint64_t preallocate_bytes = 0;
+
+  /* O_DIRECT で書くなら true です（整列済みバッファで書きます）。 */
+  bool direct = false;
+};
+
+/*
+  書き出し先の抽象です。CsvWriter などの書き手は整形済みのバイト列を渡すだけで、
+  ファイルへ直接書くか、圧縮してから書くかはシンク側が決めます。
+*/
+class OutputSink {
+ public:
+  virtual ~OutputSink() = default;
+
+  /* 書き出し可能なら true を返します。 */
+  virtual bool is_open() const = 0;
+
+  /* バイト列を書き込みます（シンク内部でまとめて書き出す場合があります）。 */
+  virtual void write(const char* data, std::size_t n) = 0;
+
+  /* 保持しているデータをすべて書き出します。 */
+  virtual void flush() = 0;
+};
+
+/* ファイルへそのまま書き出すシンクです。 */
+class FileSink final : public OutputSink {
+ public:
+  /* 出力先パスを指定して構築します（既存の内容は上書きします）。 */
+  explicit FileSink(const std::string& path);
+
+  bool is_open() const override;
+  void write(const char* data, std::size_t n) override;
+  void flush() override;
+
+ private:
+  std::ofstream ofs_;
+};
+
+/*
+  一定サイズのブロックごとに LZ4 圧縮して下位のシンクへ書くシンクです。
+  圧縮は書き手のスレッドでブロック単位に行います。
+
+  レイアウト:
+    "TEAZ" + 版数 1 バイト
+    ブロック = u32 展開後サイズ + u32 格納サイズ（最上位ビット: 無圧縮で格納）+ データ
+    終端 = u32 0
+*/
+class Lz4FileSink final : public OutputSink {
+ public:
+  /* 既定のブロックサイズ（バイト）です。 */
+  static constexpr std::size_t kDefaultBlockSize = 256 * 1024;
+
+  /* 出力先パスとブロックサイズを指定して構築します（下位は FileSink）。 */
+  explicit Lz4FileSink(const std::string& path,
+                       std::size_t block_size = kDefaultBlockSize);
+
+  /* 下位のシンクとブロックサイズを指定して構築します。 */
+  explicit Lz4FileSink(std::unique_ptr<OutputSink> inner,
+                       std::size_t block_size = kDefaultBlockSize);
+
+  /* 残りのデータと終端を書いて閉じます。 */
+  ~Lz4FileSink() override;
+
+  Lz4FileSink(const Lz4FileSink&) = delete;
+  Lz4FileSink& operator=(const Lz4FileSink&) = delete;
+
+  bool is_open() const override;
+  void write(const char* data, std::size_t n) override;
+  void flush() override;
+
+ private:
+  /* pending_ の先頭 n バイトを 1 ブロックとして圧縮して書きます。 */
+  void write_block(std::size_t n);
+
+  std::unique_ptr<OutputSink> inner_;
+  std::size_t block_size_;
+  std::string pending_;
+  std::string compressed_;
+};
+
+/*
+  圧縮方式と出力ファイルの設定に応じたファイルシンクを生成します。
+  事前確保や O_DIRECT を指定した場合は、STREAM でも pwrite で書きます。
+*/
+std::unique_ptr<OutputSink> make_output_sink(
+    const std::string& path,
+    Compression compression,
+    const OutputFileOptions& file = {});
+
+/*
+  出力ファイルを先頭から読み戻します（再生用）。
+  Lz4FileSink の形式ならブロックごとに展開し、それ以外はそのまま返します。
+*/
+class OutputFileReader final {
+ public:
+  /* ファイルを持たない（常に終端の）リーダを構築します。 */
+  OutputFileReader() = default;
+
+  /* 入力パスを指定して構築し、圧縮形式かを判定します。 */
+  explicit OutputFileReader(const std::string& path);
+
+  /* ファイルが開けたら true を返します。 */
+  bool is_open() const;
+
+  /* 圧縮形式なら true を返します。 */
+  bool compressed() const;
+
+  /* 次の塊を out へ読み込みます（out は上書き）。終端または破損で false を返します。 */
+  bool read_chunk(std::string& out);
+
+  /* 破損（途中で途切れた、展開できない等）を検出したら true を返します。 */
+  bool corrupted() const;
+
+ private:
+  std::ifstream ifs_;
+  bool open_ = false;
+  bool compressed_ = false;
+  bool finished_ = false;
+  bool corrupted_ = false;
+  std::string head_;
+  std::string stored_;
+};
+
+/* 出力ファイル全体を（必要なら展開して）out へ読み込みます。失敗時は false を返します。 */
+bool read_output_file(const std::string& path, std::string& out);
+
+} /* namespace tea_io */
@@ -0,0 +1,485 @@
+/*
+ * @file QuantizedTrace.cpp
+ * @brief 固定小数点・差分符号化トレース（.teaq）の符号化と復号
+ *
+ * 各列を CSV の表示桁で整数化し、直前 2 行からの線形予測との残差を
+ * zigzag + varint で詰めます。工程が滑らかに進む区間では残差がほぼ 0 になり、
+ * 1 行あたり数バイトに収まります。
+ */
+
+#include "io/QuantizedTrace.h"
+
+#include <cmath>   // For std::floor, std::llround, std::signbit
+#include <cstdio>  // For std::snprintf
+#include <cstdlib> // For std::strtoll
+#include <ostream>
+#include <utility> // For std::move
+
+namespace tea_io {
+
+namespace {
+
+/* ファイル先頭のマジックと版数です。 */
+constexpr char kMagic[4] = {'T', 'E', 'A', 'Q'};
+constexpr std::uint8_t kVersion = 1;
+
+/* 列数（時刻、水分、温度、香気、色、スコア）です。 */
+constexpr int kColumns = 6;
+
+/* 辞書に登録できる工程名の数と、辞書外の名前を直接書く番号です。 */
+constexpr std::size_t kMaxProcesses = 7;
+constexpr std::uint64_t kInlineProcess = 7;
+
+/* ステータス文字列です（番号はファイル形式の一部）。 */
+constexpr const char* kStatusNames[] = {"GOOD", "OK", "BAD"};
+
+/*
+ * @brief 符号付き整数を zigzag 変換します。
+ */
+std::uint64_t zigzag(std::int64_t v) {
+  return (static_cast<std::uint64_t>(v) << 1) ^
+         static_cast<std::uint64_t>(v >> 63);
+}
+
+/*
+ * @brief zigzag 変換を戻します。
+ */
+std::int64_t unzigzag(std::uint64_t v) {
+  return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1);
+}
+
+/*
+ * @brief varint（下位 7 ビットずつ、継続ビット付き）を追記します。
+ */
+void put_varint(std::string& out, std::uint64_t v) {
+  while (v >= 0x80) {
+    out += static_cast<char>((v & 0x7F) | 0x80);
+    v >>= 7;
+  }
+  out += static_cast<char>(v);
+}
+
+/*
+ * @brief 値を printf("%.<decimals>f") と同じ丸めで整数化します。
+ *
+ * 通常は scale 倍して丸めれば一致します。ちょうど半端（x.5）付近の値だけは
+ * 二進表現の誤差で丸め方向が変わり得るため、printf の結果から求めます。
+ *
+ * @param v 値
+ * @param scale 10^decimals
+ * @param decimals 小数桁数
+ * @return 整数化した値
+ */
+std::int64_t quantize(double v, double scale, int decimals) {
+  v = drop_negative_zero(v, decimals);
+  const double x = v * scale;
+  const double frac = x - std::floor(x);
+  if (std::fabs(frac - 0.5) > 1e-6) {
+    return static_cast<std::int64_t>(std::llround(x));
+  }
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+  std::string digits;
+  for (const char* p = buf; *p != '\0'; ++p) {
+    if (*p != '.') {
+      digits += *p;
+    }
+  }
+  return static_cast<std::int64_t>(std::strtoll(digits.c_str(), nullptr, 10));
+}
+
+/*
+ * @brief 整数化した値を小数 decimals 桁の固定小数点表記で追記します。
+ */
+void append_fixed(std::string& out, std::int64_t q, int decimals) {
+  if (q < 0) {
+    out += '-';
+  }
+  std::uint64_t a = (q < 0) ? static_cast<std::uint64_t>(-(q + 1)) + 1
+                            : static_cast<std::uint64_t>(q);
+  std::uint64_t div = 1;
+  for (int i = 0; i < decimals; ++i) {
+    div *= 10;
+  }
+  out += std::to_string(a / div);
+  if (decimals > 0) {
+    out += '.';
+    const std::string frac = std::to_string(a % div);
+    out.append(static_cast<std::size_t>(decimals) - frac.size(), '0');
+    out += frac;
+  }
+}
+
+/*
+ * @brief 直前 2 値からの線形予測値を返します。
+ */
+std::int64_t predict(std::int64_t prev, std::int64_t prev2) {
+  return 2 * prev - prev2;
+}
+
+} /* namespace */
+
+/*
+ * @brief 表示桁で 0 になる負の値を 0.0 に置き換えます。
+ *
+ * 符号ビットが立っていて -1 より大きい値だけを printf で確かめるため、
+ * それ以外の値ではほとんど費用がかかりません。
+ *
+ * @param v 値
+ * @param decimals 小数桁数
+ * @return 表示が "-0.0..." になるなら 0.0、それ以外は v
+ */
+double drop_negative_zero(double v, int decimals) {
+  if (!std::signbit(v) || !(v > -1.0)) {
+    return v;
+  }
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+  for (const char* p = buf; *p != '\0'; ++p) {
+    if (*p >= '1' && *p <= '9') {
+      return v;
+    }
+  }
+  return 0.0;
+}
+
+/*
+ * @brief ファイル先頭（マジックと版数）を追記します。
+ *
+ * @param out 出力バッファ
+ */
+void QuantizedEncoder::write_preamble(std::string& out) {
+  out.append(kMagic, sizeof(kMagic));
+  out += static_cast<char>(kVersion);
+}
+
+/*
+ * @brief 予測と工程名の辞書を初期状態へ戻します。
+ */
+void QuantizedEncoder::reset() {
+  processes_.clear();
+  for (int c = 0; c < kColumns; ++c) {
+    prev_[c] = 0;
+    prev2_[c] = 0;
+  }
+}
+
+/*
+ * @brief 1 行を符号化して追記します。
+ *
+ * @param out 出力バッファ
+ * @param process 工程名
+ * @param elapsed_seconds 経過時間（秒）
+ * @param moisture 水分量
+ * @param temperature_c 温度（摂氏）
+ * @param aroma 香気
+ * @param color 色
+ * @param score 品質スコア
+ * @param status 品質ステータス（GOOD/OK/BAD）
+ */
+void QuantizedEncoder::encode_row(std::string& out,
+                                  const std::string& process,
+                                  int elapsed_seconds,
+                                  double moisture,
+                                  double temperature_c,
+                                  double aroma,
+                                  double color,
+                                  double score,
+                                  const char* status) {
+  const std::int64_t q[kColumns] = {
+      elapsed_seconds,
+      quantize(moisture, 1e6, 6),
+      quantize(temperature_c, 1e3, 3),
+      quantize(aroma, 1e3, 3),
+      quantize(color, 1e3, 3),
+      quantize(score, 1e2, 2),
+  };
+
+  std::uint64_t status_id = 2;
+  for (std::uint64_t i = 0; i < 3; ++i) {
+    if (std::string(kStatusNames[i]) == status) {
+      status_id = i;
+    }
+  }
+
+  std::uint64_t process_id = 0;
+  while (process_id < processes_.size() &&
+         processes_[process_id] != process) {
+    ++process_id;
+  }
+  bool write_name = false;
+  if (process_id == processes_.size()) {
+    write_name = true;
+    if (processes_.size() < kMaxProcesses) {
+      processes_.push_back(process);
+    } else {
+      process_id = kInlineProcess;
+    }
+  }
+
+  const std::int64_t t_residual = q[0] - predict(prev_[0], prev2_[0]);
+  put_varint(out, (zigzag(t_residual) << 5) | (process_id << 2) | status_id);
+  if (write_name) {
+    put_varint(out, process.size());
+    out += process;
+  }
+  for (int c = 1; c < kColumns; ++c) {
+    put_varint(out, zigzag(q[c] - predict(prev_[c], prev2_[c])));
+  }
+
+  for (int c = 0; c < kColumns; ++c) {
+    prev2_[c] = prev_[c];
+    prev_[c] = q[c];
+  }
+}
+
+/*
+ * @brief 入力パスを指定して構築し、先頭のマジックと版数を検証します。
+ *
+ * @param path .teaq ファイルのパス（LZ4 圧縮形式も可）
+ */
+QuantizedTraceReader::QuantizedTraceReader(const std::string& path)
+    : file_(path) {
+  read_preamble();
+}
+
+/*
+ * @brief メモリ上の .teaq バイト列から読むリーダを構築します。
+ *
+ * 多重化ファイルから取り出したバッチの復号などに使います。
+ *
+ * @param bytes 先頭（マジックと版数）を含むバイト列
+ * @return リーダ
+ */
+QuantizedTraceReader QuantizedTraceReader::from_bytes(std::string bytes) {
+  QuantizedTraceReader reader;
+  reader.chunk_ = std::move(bytes);
+  reader.read_preamble();
+  return reader;
+}
+
+/*
+ * @brief 先頭のマジックと版数を読み、検証します。
+ */
+void QuantizedTraceReader::read_preamble() {
+  unsigned char head[sizeof(kMagic) + 1];
+  for (unsigned char& b : head) {
+    if (!read_byte(b)) {
+      return;
+    }
+  }
+  open_ = std::string(reinterpret_cast<const char*>(head), sizeof(kMagic)) ==
+              std::string(kMagic, sizeof(kMagic)) &&
+          head[sizeof(kMagic)] == kVersion;
+}
+
+/*
+ * @brief ファイルが開けて形式が正しければ true を返します。
+ *
+ * @return 読み込み可能なら true
+ */
+bool QuantizedTraceReader::is_open() const {
+  return open_;
+}
+
+/*
+ * @brief 破損を検出したかを返します。
+ *
+ * @return 行の途中で途切れた、または不正な値があれば true
+ */
+bool QuantizedTraceReader::corrupted() const {
+  return corrupted_;
+}
+
+/*
+ * @brief 1 バイト読みます（必要なら次の塊を展開します）。
+ *
+ * @param b 読み取ったバイト
+ * @return 読めたら true（終端では false）
+ */
+bool QuantizedTraceReader::read_byte(unsigned char& b) {
+  while (pos_ >= chunk_.size()) {
+    if (!file_.read_chunk(chunk_)) {
+      if (file_.corrupted()) {
+        corrupted_ = true;
+      }
+      return false;
+    }
+    pos_ = 0;
+  }
+  b = static_cast<unsigned char>(chunk_[pos_++]);
+  return true;
+}
+
+/*
+ * @brief varint を 1 つ読みます。
+ *
+ * @param v 読み取った値
+ * @return 成功なら true（途中で途切れた場合は破損として false）
+ */
+bool QuantizedTraceReader::read_varint(std::uint64_t& v) {
+  v = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    unsigned char ch = 0;
+    if (!read_byte(ch)) {
+      corrupted_ = true;
+      return false;
+    }
+    v |= static_cast<std::uint64_t>(ch & 0x7F) << shift;
+    if ((ch & 0x80) == 0) {
+      return true;
+    }
+  }
+  corrupted_ = true;
+  return false;
+}
+
+/*
+ * @brief 次の行を読みます。
+ *
+ * @param row 読み取った行
+ * @return 行を読めたら true（終端または破損で false）
+ */
+bool QuantizedTraceReader::next(QuantizedRow& row) {
+  if (!open_ || corrupted_) {
+    return false;
+  }
+  unsigned char first = 0;
+  if (!read_byte(first)) {
+    return false; /* 行の境界で終われば正常な終端です。 */
+  }
+  --pos_;
+
+  std::uint64_t head = 0;
+  if (!read_varint(head)) {
+    return false;
+  }
+  const std::uint64_t status_id = head & 0x3;
+  const std::uint64_t process_id = (head >> 2) & 0x7;
+  if (status_id > 2 || (process_id > processes_.size() &&
+                        process_id != kInlineProcess)) {
+    corrupted_ = true;
+    return false;
+  }
+  if (process_id == processes_.size() || process_id == kInlineProcess) {
+    std::uint64_t len = 0;
+    if (!read_varint(len) || len > 4096) {
+      corrupted_ = true;
+      return false;
+    }
+    std::string name;
+    for (std::uint64_t i = 0; i < len; ++i) {
+      unsigned char ch = 0;
+      if (!read_byte(ch)) {
+        corrupted_ = true;
+        return false;
+      }
+      name += static_cast<char>(ch);
+    }
+    if (process_id != kInlineProcess) {
+      processes_.push_back(name);
+    }
+    row.process = name;
+  } else {
+    row.process = processes_[process_id];
+  }
+
+  std::int64_t q[kColumns];
+  q[0] = unzigzag(head >> 5) + predict(prev_[0], prev2_[0]);
+  for (int c = 1; c < kColumns; ++c) {
+    std::uint64_t v = 0;
+    if (!read_varint(v)) {
+      return false;
+    }
+    q[c] = unzigzag(v) + predict(prev_[c], prev2_[c]);
+  }
+  for (int c = 0; c < kColumns; ++c) {
+    prev2_[c] = prev_[c];
+    prev_[c] = q[c];
+  }
+
+  row.elapsed_seconds = q[0];
+  row.moisture = q[1];
+  row.temperature_c = q[2];
+  row.aroma = q[3];
+  row.color = q[4];
+  row.score = q[5];
+  row.status = static_cast<int>(status_id);
+  return true;
+}
+
+/*
+ * @brief 残りの全行を CSV（ヘッダ付き）として書き出します。
+ *
+ * @param os 出力先
+ * @return 書き出した行数（ヘッダを除く）
+ */
+std::size_t QuantizedTraceReader::write_csv(std::ostream& os) {
+  std::string buf =
+      "process,elapsedSeconds,moisture,temperatureC,aroma,color,"
+      "qualityScore,qualityStatus\n";
+  std::size_t rows = 0;
+  QuantizedRow row;
+  while (next(row)) {
+    append_csv_row(buf, row);
+    ++rows;
+    if (buf.size() >= 64 * 1024) {
+      os.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+      buf.clear();
+    }
+  }
+  os.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+  return rows;
+}
+
+/*
+ * @brief キーフレーム先頭行の経過時間を読みます。
+ *
+ * キーフレームの先頭では予測値が 0 のため、行ヘッダの時刻残差がそのまま
+ * 経過時間になります。
+ *
+ * @param data キーフレーム先頭からのバイト列
+ * @param n バイト数
+ * @param elapsed_seconds 経過時間（秒）
+ * @return 読めたら true
+ */
+bool read_keyframe_elapsed(const char* data, std::size_t n,
+                           std::int64_t& elapsed_seconds) {
+  std::uint64_t v = 0;
+  for (std::size_t i = 0; i < n && i < 10; ++i) {
+    const unsigned char ch = static_cast<unsigned char>(data[i]);
+    v |= static_cast<std::uint64_t>(ch & 0x7F) << (7 * i);
+    if ((ch & 0x80) == 0) {
+      elapsed_seconds = unzigzag(v >> 5);
+      return true;
+    }
+  }
+  return false;
+}
+
+/*
+ * @brief 量子化行を CsvWriter と同じ書式の 1 行として追記します。
+ *
+ * @param out 出力バッファ
+ * @param row 量子化行
+ */
+void append_csv_row(std::string& out, const QuantizedRow& row) {
+  out += row.process;
+  out += ',';
+  out += std::to_string(row.elapsed_seconds);
+  out += ',';
+  append_fixed(out, row.moisture, 6);
+  out += ',';
+  append_fixed(out, row.temperature_c, 3);
+  out += ',';
+  append_fixed(out, row.aroma, 3);
+  out += ',';
+  append_fixed(out, row.color, 3);
+  out += ',';
+  append_fixed(out, row.score, 2);
+  out += ',';
+  out += kStatusNames[row.status];
+  out += '\n';
+}
+
+} /* namespace tea_io */
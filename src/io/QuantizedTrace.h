@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "io/OutputSink.h"
+
+namespace tea_io {
+
+/*
+  固定小数点・差分符号化によるコンパクトなトレース形式（.teaq）です。
+  各列を CSV の表示桁（水分 1e-6、温度/香気/色 1e-3、スコア 1e-2）で整数化し、
+  直前 2 行からの線形予測との残差を zigzag + varint で詰めます。
+  CSV の表示精度で可逆で、復号すると CsvWriter と同一のテキストになります。
+
+  レイアウト:
+    "TEAQ" + 版数 1 バイト、以降は行の列
+    行 = varint(zigzag(時刻残差) << 5 | 工程番号 << 2 | ステータス)
+         [新規工程名: varint(長さ) + 名前]
+         varint(zigzag(水分残差)) ... varint(zigzag(スコア残差))
+*/
+
+/* 量子化後の 1 行です（値は各列のスケール倍の整数）。 */
+struct QuantizedRow final {
+  std::string process;
+  std::int64_t elapsed_seconds = 0;
+  std::int64_t moisture = 0;      /* ×1e6 */
+  std::int64_t temperature_c = 0; /* ×1e3 */
+  std::int64_t aroma = 0;         /* ×1e3 */
+  std::int64_t color = 0;         /* ×1e3 */
+  std::int64_t score = 0;         /* ×1e2 */
+  int status = 0;                 /* 0: GOOD, 1: OK, 2: BAD */
+};
+
+/*
+  printf("%.<decimals>f") で "-0.000" のように表示される値（負のゼロと、
+  表示桁で 0 に丸まる小さな負の値）を 0.0 に置き換えます。
+  整数化した .teaq には負のゼロが無いため、テキストの CSV と .teaq の
+  両方の経路で整形前に通し、復号結果と文字単位で一致させます。
+*/
+double drop_negative_zero(double v, int decimals);
+
+/* 行を .teaq のバイト列へ符号化します（状態を持つため 1 ファイルに 1 つ）。 */
+class QuantizedEncoder final {
+ public:
+  /* ファイル先頭（マジックと版数）を out へ追記します。 */
+  static void write_preamble(std::string& out);
+
+  /*
+    予測と工程名の辞書を初期状態へ戻します。以降の行は単独で復号できる
+    キーフレームになります（先頭を付ければ独立した .teaq として読めます）。
+  */
+  void reset();
+
+  /* 1 行を符号化して out へ追記します。 */
+  void encode_row(std::string& out,
+                  const std::string& process,
+                  int elapsed_seconds,
+                  double moisture,
+                  double temperature_c,
+                  double aroma,
+                  double color,
+                  double score,
+                  const char* status);
+
+ private:
+  std::vector<std::string> processes_;
+  std::int64_t prev_[6] = {};
+  std::int64_t prev2_[6] = {};
+};
+
+/* .teaq ファイル（LZ4 圧縮されたものを含む）を先頭から順に復号します。 */
+class QuantizedTraceReader final {
+ public:
+  /* 入力パスを指定して構築し、先頭を検証します。 */
+  explicit QuantizedTraceReader(const std::string& path);
+
+  /* メモリ上の .teaq バイト列（先頭を含む）から読むリーダを構築します。 */
+  static QuantizedTraceReader from_bytes(std::string bytes);
+
+  /* ファイルが開けて形式が正しければ true を返します。 */
+  bool is_open() const;
+
+  /* 次の行を読みます。終端または破損時は false を返します。 */
+  bool next(QuantizedRow& row);
+
+  /* 破損を検出した場合は true を返します（正常な終端では false）。 */
+  bool corrupted() const;
+
+  /* 残りの全行を CSV（ヘッダ付き）として os へ書き出し、行数を返します。 */
+  std::size_t write_csv(std::ostream& os);
+
+ private:
+  QuantizedTraceReader() = default;
+
+  /* 先頭（マジックと版数）を読み、検証します。 */
+  void read_preamble();
+
+  /* 1 バイト読みます。終端なら false を返します。 */
+  bool read_byte(unsigned char& b);
+
+  /* varint を 1 つ読みます。 */
+  bool read_varint(std::uint64_t& v);
+
+  OutputFileReader file_;
+  std::string chunk_;
+  std::size_t pos_ = 0;
+  bool open_ = false;
+  bool corrupted_ = false;
+  std::vector<std::string> processes_;
+  std::int64_t prev_[6] = {};
+  std::int64_t prev2_[6] = {};
+};
+
+/* キーフレーム先頭行の経過時間を読みます。読めなければ false を返します。 */
+bool read_keyframe_elapsed(const char* data, std::size_t n,
+                           std::int64_t& elapsed_seconds);
+
+/* 量子化行を CsvWriter と同じ書式の 1 行（改行付き）として out へ追記します。 */
+void append_csv_row(std::string& out, const QuantizedRow& row);
+
+} /* namespace tea_io */
@@ -0,0 +1,218 @@
+/*
+ * @file TraceReader.cpp
+ * @brief CsvWriter のテキスト CSV を計測トレースとして読み込む
+ *
+ * 実ラインの計測値をシミュレーション出力と同じ列構成の CSV で受け取り、
+ * バッチ（トレース）単位で返します。較正（Calibration）の入力に使います。
+ */
+
+#include "io/TraceReader.h"
+
+#include <cmath>
+#include <cstdlib> // For std::strtod, std::strtol
+#include <fstream>
+#include <map>
+#include <utility> // For std::move
+
+namespace tea_io {
+
+namespace {
+
+/*
+ * @brief 行の pos 以降の 1 列を取り出し、pos を次の列の先頭へ進めます。
+ *
+ * @param line 行
+ * @param pos 列の先頭位置（更新されます）
+ * @param out 取り出した列
+ * @return 列があれば true
+ */
+bool next_field(const std::string& line, std::size_t& pos, std::string& out) {
+  if (pos > line.size()) {
+    return false;
+  }
+  const std::size_t comma = line.find(',', pos);
+  const std::size_t end = (comma == std::string::npos) ? line.size() : comma;
+  out.assign(line, pos, end - pos);
+  pos = end + 1;
+  return true;
+}
+
+/*
+ * @brief 列を有限の実数として解釈します。
+ */
+bool parse_double(const std::string& s, double& out) {
+  if (s.empty()) {
+    return false;
+  }
+  char* end = nullptr;
+  out = std::strtod(s.c_str(), &end);
+  return end != nullptr && *end == '\0' && std::isfinite(out);
+}
+
+/*
+ * @brief 工程名（CsvWriter の process 列）を解釈します。
+ */
+bool parse_process(const std::string& s, tea::ProcessState& out) {
+  const tea::ProcessState states[] = {tea::ProcessState::STEAMING,
+                                      tea::ProcessState::ROLLING,
+                                      tea::ProcessState::DRYING};
+  for (const tea::ProcessState state : states) {
+    if (s == tea::to_string(state)) {
+      out = state;
+      return true;
+    }
+  }
+  return false;
+}
+
+} /* namespace */
+
+/*
+ * @brief CSV の 1 行を計測行として解釈します。
+ *
+ * @param line 行（改行を含まない）
+ * @param has_batch 先頭に batch 列があるか
+ * @param batch batch 列の値の格納先
+ * @param row 計測行の格納先
+ * @return 解釈できたら true（ヘッダ行は false）
+ */
+bool parse_trace_line(const std::string& line,
+                      bool has_batch,
+                      int& batch,
+                      MeasuredRow& row) {
+  std::size_t pos = 0;
+  std::string field;
+  if (has_batch) {
+    if (!next_field(line, pos, field) || field.empty()) {
+      return false;
+    }
+    char* end = nullptr;
+    const long v = std::strtol(field.c_str(), &end, 10);
+    if (end == nullptr || *end != '\0' || v < 0) {
+      return false;
+    }
+    batch = static_cast<int>(v);
+  }
+
+  double elapsed = 0.0;
+  if (!next_field(line, pos, field) || !parse_process(field, row.process) ||
+      !next_field(line, pos, field) || !parse_double(field, elapsed) ||
+      elapsed < 0.0 ||
+      !next_field(line, pos, field) || !parse_double(field, row.moisture) ||
+      !next_field(line, pos, field) ||
+      !parse_double(field, row.temperature_c) ||
+      !next_field(line, pos, field) || !parse_double(field, row.aroma) ||
+      !next_field(line, pos, field) || !parse_double(field, row.color)) {
+    return false;
+  }
+  row.elapsed_ms = std::llround(elapsed * 1000.0);
+  return true;
+}
+
+/*
+ * @brief 読み込むファイルを指定して構築します。
+ *
+ * @param paths CSV ファイルのパス（指定順に読みます）
+ */
+TraceReader::TraceReader(std::vector<std::string> paths)
+    : paths_(std::move(paths)) {
+}
+
+/*
+ * @brief 次のトレースを読み込みます。
+ *
+ * @param trace 読み込み先
+ * @return 読み込めたら true、終端または失敗なら false
+ */
+bool TraceReader::next(MeasuredTrace& trace) {
+  while (pending_.empty()) {
+    if (!error_.empty() || next_path_ >= paths_.size()) {
+      return false;
+    }
+    if (!load_next_file()) {
+      return false;
+    }
+  }
+  trace = std::move(pending_.front());
+  pending_.pop_front();
+  return true;
+}
+
+/*
+ * @brief 読み込みに失敗した理由を返します。
+ *
+ * @return 理由（失敗していなければ空）
+ */
+const std::string& TraceReader::error() const {
+  return error_;
+}
+
+/*
+ * @brief これまでに読み込んだ行数を返します。
+ *
+ * @return 行数
+ */
+std::size_t TraceReader::rows_read() const {
+  return rows_read_;
+}
+
+/*
+ * @brief 次のファイルを読み込み、含まれるトレースを pending_ へ積みます。
+ *
+ * 先頭行がヘッダ（process または batch で始まる）であることを確かめ、
+ * 各トレースの経過時間が減らないことを検証します。
+ *
+ * @return 成功なら true（error_ に理由を設定して false）
+ */
+bool TraceReader::load_next_file() {
+  const std::string& path = paths_[next_path_++];
+  std::ifstream in(path);
+  std::string line;
+  if (!in || !std::getline(in, line)) {
+    error_ = "cannot read " + path;
+    return false;
+  }
+  if (!line.empty() && line.back() == '\r') {
+    line.pop_back();
+  }
+  const bool has_batch = line.compare(0, 6, "batch,") == 0;
+  if (!has_batch && line.compare(0, 8, "process,") != 0) {
+    error_ = path + ": missing CSV header";
+    return false;
+  }
+
+  std::map<int, MeasuredTrace> traces;
+  std::size_t line_no = 1;
+  while (std::getline(in, line)) {
+    ++line_no;
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty()) {
+      continue;
+    }
+    int batch = -1;
+    MeasuredRow row;
+    if (!parse_trace_line(line, has_batch, batch, row)) {
+      error_ = path + ":" + std::to_string(line_no) + ": malformed row";
+      return false;
+    }
+    MeasuredTrace& trace = traces[batch];
+    if (!trace.rows.empty() && row.elapsed_ms < trace.rows.back().elapsed_ms) {
+      error_ = path + ":" + std::to_string(line_no) +
+               ": elapsed time goes backwards";
+      return false;
+    }
+    trace.rows.push_back(row);
+    ++rows_read_;
+  }
+
+  for (auto& entry : traces) {
+    entry.second.source = path;
+    entry.second.batch = entry.first;
+    pending_.push_back(std::move(entry.second));
+  }
+  return true;
+}
+
+} /* namespace tea_io */
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "domain/ProcessState.h"
+
+namespace tea_io {
+
+/* 計測トレースの 1 行（CsvWriter のテキスト CSV の 1 レコード）です。 */
+struct MeasuredRow final {
+  tea::ProcessState process = tea::ProcessState::STEAMING; /* その刻みを進めた工程 */
+  std::int64_t elapsed_ms = 0;                             /* 経過時間 [ms] */
+  double moisture = 0.0;
+  double temperature_c = 0.0;
+  double aroma = 0.0;
+  double color = 0.0;
+};
+
+/* 1 バッチ分の計測トレースです（行は経過時間の昇順）。 */
+struct MeasuredTrace final {
+  std::string source; /* 読み込んだファイル */
+  int batch = -1;     /* batch 列の値（無ければ -1） */
+  std::vector<MeasuredRow> rows;
+};
+
+/*
+  CSV の 1 行を解釈します（ヘッダ行や不正な行なら false）。
+  has_batch なら先頭の batch 列を batch へ読み込みます。
+  qualityScore/qualityStatus 列は読み飛ばします。
+*/
+bool parse_trace_line(const std::string& line,
+                      bool has_batch,
+                      int& batch,
+                      MeasuredRow& row);
+
+/*
+  CsvWriter が書いたテキスト CSV（バッチ別ファイル、または --multiplex の
+  batch 列付き CSV）を、トレース単位で順に読み出します。
+  バッチ別ファイルは 1 ファイルを 1 トレースとして読むため、保持するのは
+  常に 1 トレース分です。batch 列付きのファイルは行がバッチをまたいで
+  並ぶため、ファイル単位で読み込んでからバッチごとに返します。
+*/
+class TraceReader final {
+ public:
+  /* 読み込むファイルを指定して構築します（指定順に読みます）。 */
+  explicit TraceReader(std::vector<std::string> paths);
+
+  /*
+    次のトレースを trace へ読み込みます。
+    全ファイルを読み終えたか、読み込みに失敗したら false を返します（失敗時は error()）。
+  */
+  bool next(MeasuredTrace& trace);
+
+  /* 読み込みに失敗した理由を返します（失敗していなければ空）。 */
+  const std::string& error() const;
+
+  /* これまでに読み込んだ行数を返します。 */
+  std::size_t rows_read() const;
+
+ private:
+  bool load_next_file();
+
+  std::vector<std::string> paths_;
+  std::size_t next_path_ = 0;
+  std::deque<MeasuredTrace> pending_;
+  std::string error_;
+  std::size_t rows_read_ = 0;
+};
+
+} /* namespace tea_io */
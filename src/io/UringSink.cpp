@@ -0,0 +1,506 @@
+/*
+ * @file UringSink.cpp
+ * @brief io_uring による非同期ファイル書き出し（pwrite へのフォールバック付き）
+ *
+ * liburing には依存せず、システムコールを直接呼んでリングを操作します。
+ * 書き込みは 1 本のファイルへ順に追記するだけなので、必要な操作は
+ * 「固定バッファからの書き込み発行」と「完了の刈り取り」だけです。
+ * 領域の事前確保（fallocate）と O_DIRECT も同じ書き込み経路で扱います。
+ */
+
+#include "io/UringSink.h"
+
+#include <algorithm> // For std::min
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && \
+    defined(__NR_io_uring_register)
+#define TEA_HAVE_IO_URING 1
+#endif
+#endif
+
+namespace tea_io {
+
+namespace {
+
+/* バッファの整列単位（O_DIRECT でも使えるようページ境界に揃えます）です。 */
+constexpr std::size_t kBufferAlign = 4096;
+
+/*
+ * @brief n を kBufferAlign の倍数へ切り上げます。
+ *
+ * @param n バイト数
+ * @return 切り上げたバイト数（0 なら kBufferAlign）
+ */
+std::size_t align_up(std::size_t n) {
+  if (n == 0) {
+    return kBufferAlign;
+  }
+  return (n + kBufferAlign - 1) / kBufferAlign * kBufferAlign;
+}
+
+} /* namespace */
+
+#if defined(TEA_HAVE_IO_URING)
+
+/* 提出キュー・完了キューの共有メモリと、その中の各ポインタです。 */
+struct UringFileSink::Ring {
+  int fd = -1;
+  bool fixed_buffers = false;
+
+  void* sq_ptr = MAP_FAILED;
+  std::size_t sq_size = 0;
+  void* cq_ptr = MAP_FAILED;
+  std::size_t cq_size = 0;
+  io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+  std::size_t sqes_size = 0;
+
+  unsigned* sq_tail = nullptr;
+  unsigned* sq_mask = nullptr;
+  unsigned* sq_array = nullptr;
+  unsigned* cq_head = nullptr;
+  unsigned* cq_tail = nullptr;
+  unsigned* cq_mask = nullptr;
+  io_uring_cqe* cqes = nullptr;
+
+  ~Ring() {
+    if (sqes != MAP_FAILED) {
+      ::munmap(sqes, sqes_size);
+    }
+    if (cq_ptr != MAP_FAILED) {
+      ::munmap(cq_ptr, cq_size);
+    }
+    if (sq_ptr != MAP_FAILED) {
+      ::munmap(sq_ptr, sq_size);
+    }
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  /*
+   * @brief リングを作成し、共有メモリを割り当てます。
+   *
+   * @param entries 提出キューの要素数
+   * @return 成功なら true
+   */
+  bool setup(unsigned entries) {
+    io_uring_params p;
+    std::memset(&p, 0, sizeof(p));
+    fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+    if (fd < 0) {
+      return false;
+    }
+    sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+    sq_ptr = ::mmap(nullptr, sq_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    cq_ptr = ::mmap(nullptr, cq_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    sqes = static_cast<io_uring_sqe*>(
+        ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+    if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes == MAP_FAILED) {
+      return false;
+    }
+    char* sq = static_cast<char*>(sq_ptr);
+    char* cq = static_cast<char*>(cq_ptr);
+    sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+    return true;
+  }
+
+  /*
+   * @brief 書き込みを 1 件提出します。
+   *
+   * @param file 書き込み先
+   * @param index バッファ番号（完了時の識別子）
+   * @param data 書き込むデータ
+   * @param n バイト数
+   * @param offset ファイル内の位置
+   * @return 提出できたら true
+   */
+  bool submit_write(int file, std::size_t index, const char* data,
+                    std::size_t n, std::uint64_t offset) {
+    const unsigned tail = *sq_tail;
+    const unsigned slot = tail & *sq_mask;
+    io_uring_sqe* sqe = &sqes[slot];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = fixed_buffers ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = file;
+    sqe->addr = reinterpret_cast<std::uint64_t>(data);
+    sqe->len = static_cast<std::uint32_t>(n);
+    sqe->off = offset;
+    sqe->buf_index = static_cast<std::uint16_t>(index);
+    sqe->user_data = index;
+    sq_array[slot] = slot;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    for (;;) {
+      const long r = ::syscall(__NR_io_uring_enter, fd, 1, 0, 0, nullptr, 0);
+      if (r >= 1) {
+        return true;
+      }
+      if (r < 0 && errno != EINTR && errno != EAGAIN) {
+        /* 提出を取り消します（カーネルはまだ読んでいません）。 */
+        __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+        return false;
+      }
+    }
+  }
+
+  /*
+   * @brief 完了を 1 件取り出します（無ければ待ちます）。
+   *
+   * @param index 完了したバッファ番号
+   * @param result 書き込んだバイト数（失敗時は負の errno）
+   * @return 取り出せたら true
+   */
+  bool reap(std::size_t& index, int& result) {
+    for (;;) {
+      const unsigned head = *cq_head;
+      if (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+        const io_uring_cqe& cqe = cqes[head & *cq_mask];
+        index = static_cast<std::size_t>(cqe.user_data);
+        result = cqe.res;
+        __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+        return true;
+      }
+      const long r = ::syscall(__NR_io_uring_enter, fd, 0, 1,
+                               IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (r < 0 && errno != EINTR && errno != EAGAIN) {
+        return false;
+      }
+    }
+  }
+};
+
+#else
+
+/* io_uring が無い環境では空の型です（常に pwrite で書きます）。 */
+struct UringFileSink::Ring {
+  bool fixed_buffers = false;
+};
+
+#endif
+
+/*
+ * @brief 出力先パスと設定を指定して構築します。
+ *
+ * io_uring の準備やバッファ登録に失敗した場合は pwrite で書きます。
+ * O_DIRECT を受け付けないファイルシステムでは通常の書き込みにします。
+ * 領域の事前確保に失敗しても書き出しは続けます。
+ *
+ * @param path 出力パス
+ * @param options バッファの大きさ・数、事前確保量、O_DIRECT の有無
+ */
+UringFileSink::UringFileSink(const std::string& path,
+                             const UringFileSinkOptions& options)
+    : buffer_bytes_(align_up(options.buffer_bytes)),
+      storage_(nullptr, &std::free) {
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+#if defined(O_DIRECT)
+  if (options.direct) {
+    fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+    direct_ = fd_ >= 0;
+  }
+#endif
+  if (fd_ < 0) {
+    fd_ = ::open(path.c_str(), flags, 0644);
+  }
+  if (fd_ < 0) {
+    return;
+  }
+  truncate_on_close_ = direct_;
+#if defined(__linux__)
+  if (options.preallocate_bytes > 0) {
+    /* サイズは変えずにブロックだけ確保します（読み手には書いた分だけが見えます）。 */
+    truncate_on_close_ =
+        ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0,
+                    static_cast<off_t>(options.preallocate_bytes)) == 0 ||
+        truncate_on_close_;
+  }
+#endif
+  const std::size_t count = options.buffer_count == 0 ? 1
+                                                      : options.buffer_count;
+  storage_.reset(static_cast<char*>(
+      std::aligned_alloc(kBufferAlign, buffer_bytes_ * count)));
+  if (!storage_) {
+    ::close(fd_);
+    fd_ = -1;
+    return;
+  }
+  buffers_.resize(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    buffers_[i].data = storage_.get() + i * buffer_bytes_;
+  }
+
+#if defined(TEA_HAVE_IO_URING)
+  if (!options.force_pwrite) {
+    auto ring = std::make_unique<Ring>();
+    if (ring->setup(static_cast<unsigned>(count))) {
+      std::vector<iovec> iovs(count);
+      for (std::size_t i = 0; i < count; ++i) {
+        iovs[i].iov_base = buffers_[i].data;
+        iovs[i].iov_len = buffer_bytes_;
+      }
+      /* 固定バッファの登録はメモリロック上限などで失敗し得るので、その場合は通常の書き込みを使います。 */
+      ring->fixed_buffers =
+          ::syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS,
+                    iovs.data(), static_cast<unsigned>(count)) == 0;
+      ring_ = std::move(ring);
+    }
+  }
+#endif
+}
+
+/*
+ * @brief 残りを書き出して閉じます。
+ */
+UringFileSink::~UringFileSink() {
+  if (fd_ < 0) {
+    return;
+  }
+  flush();
+  close_ring();
+  if (truncate_on_close_) {
+    /* 事前確保の余りと、O_DIRECT で埋めた末尾のゼロを落とします。 */
+    const std::uint64_t size = offset_ + buffers_[current_].used;
+    while (::ftruncate(fd_, static_cast<off_t>(size)) != 0 && errno == EINTR) {
+    }
+  }
+  ::close(fd_);
+}
+
+/*
+ * @brief 書き出し可能かを返します。
+ *
+ * @return ファイルを開けていれば true
+ */
+bool UringFileSink::is_open() const {
+  return fd_ >= 0;
+}
+
+/*
+ * @brief データを現在のバッファへ写し、満杯になったら書き込みを発行します。
+ *
+ * @param data 書き出すデータ
+ * @param n バイト数
+ */
+void UringFileSink::write(const char* data, std::size_t n) {
+  if (fd_ < 0) {
+    return;
+  }
+  while (n > 0) {
+    Buffer& b = buffers_[current_];
+    while (b.in_flight) {
+      wait_one();
+    }
+    const std::size_t take = std::min(n, buffer_bytes_ - b.used);
+    std::memcpy(b.data + b.used, data, take);
+    b.used += take;
+    data += take;
+    n -= take;
+    if (b.used == buffer_bytes_) {
+      submit_current();
+    }
+  }
+}
+
+/*
+ * @brief 埋めかけのバッファを発行し、すべての書き込みの完了を待ちます。
+ */
+void UringFileSink::flush() {
+  if (fd_ < 0) {
+    return;
+  }
+  if (direct_) {
+    wait_all();
+    write_direct_tail();
+    return;
+  }
+  submit_current();
+  wait_all();
+}
+
+/*
+ * @brief pwrite で書いているかを返します。
+ *
+ * @return io_uring を使っていなければ true
+ */
+bool UringFileSink::using_fallback() const {
+  return !ring_;
+}
+
+/*
+ * @brief 書き込みに失敗したことがあるかを返します。
+ *
+ * @return 失敗があれば true
+ */
+bool UringFileSink::failed() const {
+  return failed_;
+}
+
+/*
+ * @brief O_DIRECT で書いているかを返します。
+ *
+ * @return O_DIRECT なら true
+ */
+bool UringFileSink::direct() const {
+  return direct_;
+}
+
+/*
+ * @brief 埋めかけのバッファを、境界までゼロで埋めて O_DIRECT で書きます。
+ *
+ * O_DIRECT は長さと位置を揃える必要があるため、端数はその場で書くだけで
+ * 書き込み位置は進めません。続きのデータはバッファに残した内容ごと、
+ * 満杯になったときに同じ位置へ書き直されます。
+ */
+void UringFileSink::write_direct_tail() {
+  Buffer& b = buffers_[current_];
+  if (b.used == 0) {
+    return;
+  }
+  const std::size_t padded = align_up(b.used);
+  std::memset(b.data + b.used, 0, padded - b.used);
+  write_at(b.data, padded, offset_);
+}
+
+/*
+ * @brief 現在のバッファの書き込みを発行し、次のバッファへ進みます。
+ */
+void UringFileSink::submit_current() {
+  Buffer& b = buffers_[current_];
+  if (b.used == 0) {
+    return;
+  }
+  b.offset = offset_;
+  offset_ += b.used;
+#if defined(TEA_HAVE_IO_URING)
+  if (ring_ && ring_->submit_write(fd_, current_, b.data, b.used, b.offset)) {
+    b.in_flight = true;
+    ++in_flight_;
+  } else
+#endif
+  {
+    if (ring_) {
+      /* 提出に失敗したら以後は pwrite で書きます。 */
+      close_ring();
+    }
+    write_at(b.data, b.used, b.offset);
+    b.used = 0;
+  }
+  current_ = (current_ + 1) % buffers_.size();
+}
+
+/*
+ * @brief 書き込みの完了を 1 件待って処理します。
+ */
+void UringFileSink::wait_one() {
+#if defined(TEA_HAVE_IO_URING)
+  std::size_t index = 0;
+  int result = 0;
+  if (ring_ && in_flight_ > 0 && ring_->reap(index, result) &&
+      index < buffers_.size()) {
+    complete(index, result);
+    return;
+  }
+#endif
+  /* 完了を受け取れない場合は、書き込み中のものを pwrite で書き直し、以後は pwrite で書きます。 */
+  for (std::size_t i = 0; i < buffers_.size(); ++i) {
+    if (buffers_[i].in_flight) {
+      complete(i, -EIO);
+    }
+  }
+  ring_.reset();
+}
+
+/*
+ * @brief 書き込み中のものがすべて完了するまで待ちます。
+ */
+void UringFileSink::wait_all() {
+  while (in_flight_ > 0) {
+    wait_one();
+  }
+}
+
+/*
+ * @brief 完了した書き込みを処理し、バッファを空きに戻します。
+ *
+ * 書き込みが途中で終わった・失敗した場合は、残りを pwrite で書きます。
+ *
+ * @param index バッファ番号
+ * @param result 書き込んだバイト数（失敗時は負の errno）
+ */
+void UringFileSink::complete(std::size_t index, int result) {
+  Buffer& b = buffers_[index];
+  if (!b.in_flight) {
+    return;
+  }
+  const std::size_t done =
+      result > 0 ? std::min(static_cast<std::size_t>(result), b.used) : 0;
+  if (done < b.used) {
+    write_at(b.data + done, b.used - done, b.offset + done);
+  }
+  b.used = 0;
+  b.in_flight = false;
+  --in_flight_;
+}
+
+/*
+ * @brief 指定位置へ pwrite で書き切ります。
+ *
+ * @param data 書き出すデータ
+ * @param n バイト数
+ * @param offset ファイル内の位置
+ */
+void UringFileSink::write_at(const char* data, std::size_t n,
+                             std::uint64_t offset) {
+  while (n > 0) {
+    const ssize_t w = ::pwrite(fd_, data, n, static_cast<off_t>(offset));
+    if (w < 0 && errno == EINTR) {
+      continue;
+    }
+#if defined(O_DIRECT)
+    if (w < 0 && errno == EINVAL && direct_) {
+      /* 整列の制約を満たせない場合は、以後ページキャッシュ経由で書きます。 */
+      ::fcntl(fd_, F_SETFL, ::fcntl(fd_, F_GETFL) & ~O_DIRECT);
+      direct_ = false;
+      continue;
+    }
+#endif
+    if (w <= 0) {
+      failed_ = true;
+      return;
+    }
+    data += w;
+    n -= static_cast<std::size_t>(w);
+    offset += static_cast<std::uint64_t>(w);
+  }
+}
+
+/*
+ * @brief 書き込み中のものを片付けてからリングを閉じます。
+ */
+void UringFileSink::close_ring() {
+  wait_all();
+  ring_.reset();
+}
+
+} /* namespace tea_io */
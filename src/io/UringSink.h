@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "io/OutputSink.h"
+
+namespace tea_io {
+
+/* UringFileSink の設定です。 */
+struct UringFileSinkOptions {
+  /* 1 バッファの大きさ（4 KiB 単位へ切り上げます）です。 */
+  std::size_t buffer_bytes = 256 * 1024;
+
+  /* 交互に使うバッファの数（同時に書き込み中にできる数）です。 */
+  std::size_t buffer_count = 4;
+
+  /* io_uring を使わず pwrite で書くなら true（比較・試験用）です。 */
+  bool force_pwrite = false;
+
+  /* 先に確保しておくファイル領域（バイト、0 なら確保しない）です。 */
+  std::uint64_t preallocate_bytes = 0;
+
+  /* O_DIRECT でページキャッシュを介さずに書くなら true です。 */
+  bool direct = false;
+};
+
+/*
+  io_uring でファイルへ非同期に書き出すシンクです。
+  あらかじめ登録した固定バッファを順に埋め、満杯になったものから書き込みを
+  発行します。書き手はカーネルの完了を待たずに次のバッファを埋められるため、
+  整形と書き込みが重なります。
+  io_uring が使えない環境（カーネル・seccomp・非 Linux）では pwrite で
+  同期的に書きます。出力されるバイト列はどちらでも同じです。
+
+  preallocate_bytes を指定すると、開いた直後に fallocate で領域を確保し、
+  書き込み中のブロック割り当てを避けます（サイズは書いた分だけ伸び、
+  閉じるときに余りを解放します）。direct を指定すると O_DIRECT で書きます。
+  端数の末尾はゼロで埋めて書き、閉じるときに実サイズへ切り詰めます。
+*/
+class UringFileSink final : public OutputSink {
+ public:
+  /* 出力先パスと設定を指定して構築します。 */
+  explicit UringFileSink(const std::string& path,
+                         const UringFileSinkOptions& options = {});
+
+  /* 残りを書き出して閉じます。 */
+  ~UringFileSink() override;
+
+  UringFileSink(const UringFileSink&) = delete;
+  UringFileSink& operator=(const UringFileSink&) = delete;
+
+  bool is_open() const override;
+  void write(const char* data, std::size_t n) override;
+
+  /* 埋めかけのバッファを発行し、書き込み中のものがすべて完了するまで待ちます。 */
+  void flush() override;
+
+  /* pwrite で書いている（io_uring を使っていない）なら true を返します。 */
+  bool using_fallback() const;
+
+  /* 書き込みに失敗したことがあれば true を返します。 */
+  bool failed() const;
+
+  /* O_DIRECT で書いているなら true を返します。 */
+  bool direct() const;
+
+ private:
+  struct Ring;
+
+  /* 1 枚のバッファと、その書き込み状態です。 */
+  struct Buffer {
+    char* data = nullptr;
+    std::size_t used = 0;
+    std::uint64_t offset = 0;
+    bool in_flight = false;
+  };
+
+  void submit_current();
+  void wait_one();
+  void wait_all();
+  void complete(std::size_t index, int result);
+  void write_at(const char* data, std::size_t n, std::uint64_t offset);
+  void write_direct_tail();
+  void close_ring();
+
+  int fd_ = -1;
+  std::size_t buffer_bytes_ = 0;
+  std::unique_ptr<char, void (*)(void*)> storage_;
+  std::vector<Buffer> buffers_;
+  std::unique_ptr<Ring> ring_;
+  std::size_t current_ = 0;
+  std::size_t in_flight_ = 0;
+  std::uint64_t offset_ = 0;
+  bool failed_ = false;
+  bool direct_ = false;
+  bool truncate_on_close_ = false;
+};
+
+} /* namespace tea_io */
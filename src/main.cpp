@@ -12,11 +12,13 @@
 #include <cstdio>
 #include <algorithm>
 #include <optional>
+#include <string>
 
 #include "Simulator.h"
 #include "TeaBatch.h"
 
 #include "io/CsvWriter.h"
+#include "perf/Trace.h"
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
@@ -116,7 +118,7 @@ int total_process_seconds() {
 }
 
 /* 経過秒から工程全体の進捗率 [0, 1] を返します。 */
-float total_progress_fraction(int elapsed_seconds) {
+float total_progress_fraction(double elapsed_seconds) {
   const int total = total_process_seconds();
   if (total <= 0) {
     return 0.0F;
@@ -221,9 +223,11 @@ void draw_bar(const char* label,
  * GLFW、OpenGL、Dear ImGuiを初期化し、シミュレーションループを実行します。
  * シミュレーションの状態を更新し、GUIで表示します。
  *
+ * @param argc コマンドライン引数の数
+ * @param argv コマンドライン引数の配列（--trace <path> のみ解釈）
  * @return 0 成功、1 失敗
  */
-int main() {
+int main(int argc, char** argv) {
   /*
     ビルド:
       cmake -S . -B build
@@ -231,7 +235,18 @@ int main() {
 
     実行:
       ./build/TeaFactorySimulator
+      ./build/TeaFactorySimulator --trace gui_trace.json
   */
+  std::string trace_path;
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (std::string(argv[i]) == "--trace") {
+      trace_path = argv[i + 1];
+    }
+  }
+  if (!trace_path.empty()) {
+    tea_perf::trace_start();
+  }
+
   if (glfwInit() == GLFW_FALSE) {
     std::fprintf(stderr, "Failed to init GLFW\n");
     return 1;
@@ -267,10 +282,10 @@ int main() {
 
   tea_gui::Simulator simulator;
   std::optional<tea_io::CsvWriter> csv;
-  int last_csv_elapsed = -1;
+  double last_csv_elapsed = -1.0;
   int selected_batch = 0;
   int desired_batches = 1;
-  int last_history_elapsed = -1;
+  double last_history_elapsed = -1.0;
   int last_history_selected_batch = -1;
 
   HistoryBuffer moisture_hist(180);
@@ -294,6 +309,7 @@ int main() {
 
     simulator.update(dt.count());
 
+    TEA_TRACE_SCOPE("gui.render", "gui");
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -309,12 +325,15 @@ int main() {
       selected_batch = simulator.batch_count() - 1;
     }
     const tea_gui::TeaBatch& batch = simulator.batch_at(selected_batch);
-    const int elapsed = batch.elapsed_seconds();
+    const double elapsed = batch.elapsed_seconds();
+    char elapsed_seconds_text[32];
+    tea_io::CsvWriter::format_elapsed(elapsed_seconds_text,
+                                      sizeof(elapsed_seconds_text), elapsed);
 
     /*
       GUI版CSV出力:
       - Start時に tea_factory_gui.csv を新規作成（上書き）
-      - 実行中、elapsedSeconds が進んだタイミング（=1秒ごと）で1行追記
+      - 実行中、elapsedSeconds が進んだタイミング（=物理更新の刻みごと）で1行追記
     */
     if (csv.has_value() && elapsed != last_csv_elapsed) {
       last_csv_elapsed = elapsed;
@@ -333,7 +352,7 @@ int main() {
     */
     if (selected_batch != last_history_selected_batch) {
       last_history_selected_batch = selected_batch;
-      last_history_elapsed = -1;
+      last_history_elapsed = -1.0;
       moisture_hist.clear();
       temp_hist.clear();
       aroma_hist.clear();
@@ -351,8 +370,8 @@ int main() {
 
     const float total_prog = total_progress_fraction(elapsed);
     char total_overlay[64];
-    std::snprintf(total_overlay, sizeof(total_overlay), "%ds / %ds",
-                  elapsed, total_process_seconds());
+    std::snprintf(total_overlay, sizeof(total_overlay), "%ss / %ds",
+                  elapsed_seconds_text, total_process_seconds());
 
     ImGui::TextUnformatted("Overview");
     ImGui::Separator();
@@ -363,7 +382,8 @@ int main() {
     std::snprintf(process_text, sizeof(process_text), "%s",
                   tea::to_string(batch.process()));
     char elapsed_text[64];
-    std::snprintf(elapsed_text, sizeof(elapsed_text), "%d sec", elapsed);
+    std::snprintf(elapsed_text, sizeof(elapsed_text), "%s sec",
+                  elapsed_seconds_text);
     char batch_text[64];
     std::snprintf(batch_text, sizeof(batch_text), "%d / %d",
                   selected_batch + 1, simulator.batch_count());
@@ -569,7 +589,7 @@ int main() {
         simulator.set_batch_count(desired_batches);
         selected_batch = 0;
         csv.reset();
-        last_csv_elapsed = -1;
+        last_csv_elapsed = -1.0;
       }
       ImGui::EndDisabled();
       if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled) &&
@@ -595,7 +615,7 @@ int main() {
           csv.emplace(csv_path);
           csv->write_header();
         }
-        last_csv_elapsed = -1;
+        last_csv_elapsed = -1.0;
       }
 
       if (ImGui::Button("Pause", ImVec2(-1.0F, 0.0F))) {
@@ -605,7 +625,7 @@ int main() {
       if (ImGui::Button("Reset", ImVec2(-1.0F, 0.0F))) {
         simulator.reset();
         csv.reset();
-        last_csv_elapsed = -1;
+        last_csv_elapsed = -1.0;
       }
 
       ImGui::EndTable();
@@ -631,5 +651,13 @@ int main() {
 
   glfwDestroyWindow(window);
   glfwTerminate();
+
+  if (!trace_path.empty()) {
+    tea_perf::trace_stop();
+    if (!tea_perf::trace_write_json(trace_path)) {
+      std::fprintf(stderr, "Failed to write trace: %s\n", trace_path.c_str());
+      return 1;
+    }
+  }
   return 0;
 }
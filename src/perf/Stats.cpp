@@ -0,0 +1,228 @@
+/*
+ * @file Stats.cpp
+ * @brief ホットパス計測カウンタの集計
+ *
+ * カウンタはスレッドローカルに保持し、ホットパスでは排他を取りません。
+ * スレッド終了時に値を全体集計へ畳み込み、collect() で稼働中スレッドの
+ * 値と合算します。
+ */
+
+#include "perf/Stats.h"
+
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace tea_perf {
+
+namespace {
+
+/*
+ * @brief カウンタ名（JSON キーと表示に使用）です。
+ */
+constexpr const char* kCounterNames[kCounterCount] = {
+  "steaming_steps",
+  "rolling_steps",
+  "drying_steps",
+  "csv_rows",
+  "csv_bytes_flushed",
+  "csv_flushes",
+  "log_lines"
+};
+
+/*
+ * @brief 区間時間名（JSON キーと表示に使用）です。
+ */
+constexpr const char* kTimerNames[kTimerCount] = {
+  "physics",
+  "csv_format",
+  "csv_io",
+  "log_format",
+  "cli_loop"
+};
+
+/*
+ * @brief 1 スレッド分のカウンタです。
+ *
+ * 書き込みは所有スレッドのみなので、relaxed の load/store で足ります
+ * （collect() からの読み取りと競合しないよう atomic にしています）。
+ */
+struct ThreadStats final {
+  std::array<std::atomic<std::uint64_t>, kCounterCount> counters{};
+  std::array<std::atomic<std::uint64_t>, kTimerCount> ns{};
+
+  ThreadStats();
+  ~ThreadStats();
+};
+
+/*
+ * @brief 全スレッドの登録簿と、終了済みスレッドの集計値です。
+ */
+struct Registry final {
+  std::mutex mutex;
+  std::vector<ThreadStats*> live;
+  StatsSnapshot retired;
+};
+
+/*
+ * @brief 登録簿を返します（静的破棄順の問題を避けるため意図的に解放しません）。
+ */
+Registry& registry() {
+  static Registry* r = new Registry();
+  return *r;
+}
+
+/*
+ * @brief 単一書き込みスレッド前提で値を加算します。
+ */
+inline void bump(std::atomic<std::uint64_t>& v, std::uint64_t n) {
+  v.store(v.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+/*
+ * @brief スレッドのカウンタを登録簿へ登録します。
+ */
+ThreadStats::ThreadStats() {
+  Registry& r = registry();
+  const std::lock_guard<std::mutex> lock(r.mutex);
+  r.live.push_back(this);
+}
+
+/*
+ * @brief スレッド終了時に値を終了済み集計へ畳み込みます。
+ */
+ThreadStats::~ThreadStats() {
+  Registry& r = registry();
+  const std::lock_guard<std::mutex> lock(r.mutex);
+  for (std::size_t i = 0; i < kCounterCount; ++i) {
+    r.retired.counters[i] += counters[i].load(std::memory_order_relaxed);
+  }
+  for (std::size_t i = 0; i < kTimerCount; ++i) {
+    r.retired.ns[i] += ns[i].load(std::memory_order_relaxed);
+  }
+  for (std::size_t i = 0; i < r.live.size(); ++i) {
+    if (r.live[i] == this) {
+      r.live[i] = r.live.back();
+      r.live.pop_back();
+      break;
+    }
+  }
+}
+
+/*
+ * @brief 呼び出しスレッドのカウンタを返します。
+ */
+ThreadStats& local() {
+  thread_local ThreadStats stats;
+  return stats;
+}
+
+} /* namespace */
+
+/*
+ * @brief 呼び出しスレッドのカウンタへ加算します。
+ *
+ * @param c カウンタ種別
+ * @param n 加算値
+ */
+void add(Counter c, std::uint64_t n) {
+  bump(local().counters[static_cast<std::size_t>(c)], n);
+}
+
+/*
+ * @brief 呼び出しスレッドの区間時間へ加算します。
+ *
+ * @param t 区間種別
+ * @param ns 加算する時間（ns）
+ */
+void add_time(Timer t, std::uint64_t ns) {
+  bump(local().ns[static_cast<std::size_t>(t)], ns);
+}
+
+/*
+ * @brief 稼働中/終了済みの全スレッド分を集計します。
+ *
+ * @return 集計値
+ */
+StatsSnapshot collect() {
+  Registry& r = registry();
+  const std::lock_guard<std::mutex> lock(r.mutex);
+  StatsSnapshot s = r.retired;
+  for (const ThreadStats* t : r.live) {
+    for (std::size_t i = 0; i < kCounterCount; ++i) {
+      s.counters[i] += t->counters[i].load(std::memory_order_relaxed);
+    }
+    for (std::size_t i = 0; i < kTimerCount; ++i) {
+      s.ns[i] += t->ns[i].load(std::memory_order_relaxed);
+    }
+  }
+  return s;
+}
+
+/*
+ * @brief 集計値をすべて 0 に戻します。
+ *
+ * 他スレッドが加算中でない状態で呼び出してください。
+ */
+void reset() {
+  Registry& r = registry();
+  const std::lock_guard<std::mutex> lock(r.mutex);
+  r.retired = StatsSnapshot();
+  for (ThreadStats* t : r.live) {
+    for (auto& v : t->counters) {
+      v.store(0, std::memory_order_relaxed);
+    }
+    for (auto& v : t->ns) {
+      v.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+/*
+ * @brief 人が読む形式で出力します。
+ *
+ * @param os 出力先
+ * @param s 集計値
+ */
+void print_text(std::ostream& os, const StatsSnapshot& s) {
+  if (!compiled_in()) {
+    os << "[stats] disabled at build time "
+          "(configure with -DTEAFACTORY_ENABLE_STATS=ON)\n";
+    return;
+  }
+  os << "[stats] counters:";
+  for (std::size_t i = 0; i < kCounterCount; ++i) {
+    os << ' ' << kCounterNames[i] << '=' << s.counters[i];
+  }
+  os << '\n';
+  os << "[stats] time_ns:";
+  for (std::size_t i = 0; i < kTimerCount; ++i) {
+    os << ' ' << kTimerNames[i] << '=' << s.ns[i];
+  }
+  os << '\n';
+}
+
+/*
+ * @brief JSON で出力します。
+ *
+ * 例: {"enabled":true,"counters":{"csv_rows":120,...},"time_ns":{...}}
+ *
+ * @param os 出力先
+ * @param s 集計値
+ */
+void write_json(std::ostream& os, const StatsSnapshot& s) {
+  os << "{\"enabled\":" << (compiled_in() ? "true" : "false");
+  os << ",\"counters\":{";
+  for (std::size_t i = 0; i < kCounterCount; ++i) {
+    os << (i == 0 ? "" : ",") << '"' << kCounterNames[i] << "\":"
+       << s.counters[i];
+  }
+  os << "},\"time_ns\":{";
+  for (std::size_t i = 0; i < kTimerCount; ++i) {
+    os << (i == 0 ? "" : ",") << '"' << kTimerNames[i] << "\":" << s.ns[i];
+  }
+  os << "}}\n";
+}
+
+} /* namespace tea_perf */
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+
+/*
+  ホットパス計測（カウンタ/区間時間）です。
+  CMake オプション TEAFACTORY_ENABLE_STATS=ON のときだけ TEA_ENABLE_STATS=1 になり、
+  OFF のときは TEA_STATS_* マクロが空になるため、計測コードは一切残りません。
+*/
+#ifndef TEA_ENABLE_STATS
+#define TEA_ENABLE_STATS 0
+#endif
+
+namespace tea_perf {
+
+/* 加算カウンタの種別です。 */
+enum class Counter : std::size_t {
+  STEAMING_STEPS,
+  ROLLING_STEPS,
+  DRYING_STEPS,
+  CSV_ROWS,
+  CSV_BYTES_FLUSHED,
+  CSV_FLUSHES,
+  LOG_LINES,
+  COUNT
+};
+
+/* 区間時間（ns）の種別です。 */
+enum class Timer : std::size_t {
+  PHYSICS,     /* 工程の状態更新 */
+  CSV_FORMAT,  /* CSV 行の文字列化 */
+  CSV_IO,      /* CSV バッファの書き出し */
+  LOG_FORMAT,  /* コンソールログの出力 */
+  CLI_LOOP,    /* CLI のバッチ実行ループ全体 */
+  COUNT
+};
+
+constexpr std::size_t kCounterCount = static_cast<std::size_t>(Counter::COUNT);
+constexpr std::size_t kTimerCount = static_cast<std::size_t>(Timer::COUNT);
+
+/* 全スレッド分を集計した値です。 */
+struct StatsSnapshot final {
+  std::array<std::uint64_t, kCounterCount> counters{};
+  std::array<std::uint64_t, kTimerCount> ns{};
+
+  /* カウンタ値を返します。 */
+  std::uint64_t counter(Counter c) const {
+    return counters[static_cast<std::size_t>(c)];
+  }
+
+  /* 区間時間（ns）を返します。 */
+  std::uint64_t nanoseconds(Timer t) const {
+    return ns[static_cast<std::size_t>(t)];
+  }
+};
+
+/* 計測がビルドに含まれているかを返します。 */
+constexpr bool compiled_in() {
+  return TEA_ENABLE_STATS != 0;
+}
+
+/* 呼び出しスレッドのカウンタへ加算します。 */
+void add(Counter c, std::uint64_t n);
+
+/* 呼び出しスレッドの区間時間へ加算します。 */
+void add_time(Timer t, std::uint64_t ns);
+
+/* 稼働中/終了済みの全スレッド分を集計します。 */
+StatsSnapshot collect();
+
+/* 集計値をすべて 0 に戻します（テスト用）。 */
+void reset();
+
+/* 人が読む形式で出力します。 */
+void print_text(std::ostream& os, const StatsSnapshot& s);
+
+/* JSON で出力します。 */
+void write_json(std::ostream& os, const StatsSnapshot& s);
+
+/* スコープの経過時間を Timer へ加算する RAII です。 */
+class ScopedTimer final {
+ public:
+  /* 計測を開始します。 */
+  explicit ScopedTimer(Timer t)
+      : timer_(t), start_(std::chrono::steady_clock::now()) {
+  }
+
+  /* 経過時間を加算します。 */
+  ~ScopedTimer() {
+    const auto elapsed = std::chrono::steady_clock::now() - start_;
+    add_time(timer_,
+             static_cast<std::uint64_t>(
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                     .count()));
+  }
+
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+ private:
+  Timer timer_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+} /* namespace tea_perf */
+
+#if TEA_ENABLE_STATS
+#define TEA_STATS_CONCAT_INNER(a, b) a##b
+#define TEA_STATS_CONCAT(a, b) TEA_STATS_CONCAT_INNER(a, b)
+#define TEA_STATS_ADD(counter, n) \
+  ::tea_perf::add(::tea_perf::Counter::counter, (n))
+#define TEA_STATS_TIMER(timer)                                   \
+  const ::tea_perf::ScopedTimer TEA_STATS_CONCAT(tea_stats_t_, \
+                                                 __LINE__)(     \
+      ::tea_perf::Timer::timer)
+#else
+#define TEA_STATS_ADD(counter, n) ((void)0)
+#define TEA_STATS_TIMER(timer) ((void)0)
+#endif
@@ -0,0 +1,282 @@
+/*
+ * @file Trace.cpp
+ * @brief Chrome trace_event 形式のスパン記録と JSON 出力
+ *
+ * イベントはスレッドごとのバッファへ排他なしで追記し、バッファの登録
+ * （スレッドの初回記録時）だけ排他を取ります。バッファはスレッド終了後も
+ * 登録簿が保持するため、終了時にまとめて書き出せます。
+ */
+
+#include "perf/Trace.h"
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace tea_perf {
+
+namespace detail {
+
+std::atomic<bool> g_trace_enabled{false};
+
+} /* namespace detail */
+
+namespace {
+
+/*
+ * @brief スレッドバッファの初期予約イベント数です。
+ */
+constexpr std::size_t kInitialEventsPerThread = 16 * 1024;
+
+/*
+ * @brief 1 イベント分の記録です（文字列は静的領域を指します）。
+ */
+struct TraceEvent final {
+  const char* name = nullptr;
+  const char* category = nullptr;
+  const char* arg_name = nullptr;
+  std::int64_t arg_value = 0;
+  std::int64_t ts_ns = 0;
+  std::int64_t dur_ns = 0;
+  char phase = 'X';
+};
+
+/*
+ * @brief 1 スレッド分のイベントバッファです。
+ */
+struct ThreadBuffer final {
+  int tid = 0;
+  std::vector<TraceEvent> events;
+};
+
+/*
+ * @brief バッファの登録簿と時刻基準点です。
+ */
+struct Registry final {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+  std::chrono::steady_clock::time_point origin =
+      std::chrono::steady_clock::now();
+  int next_tid = 1;
+};
+
+/*
+ * @brief 登録簿を返します（静的破棄順の問題を避けるため解放しません）。
+ */
+Registry& registry() {
+  static Registry* r = new Registry();
+  return *r;
+}
+
+/*
+ * @brief 呼び出しスレッドのバッファを返します（初回のみ登録します）。
+ */
+ThreadBuffer& local_buffer() {
+  thread_local std::shared_ptr<ThreadBuffer> buffer;
+  if (!buffer) {
+    buffer = std::make_shared<ThreadBuffer>();
+    buffer->events.reserve(kInitialEventsPerThread);
+    Registry& r = registry();
+    const std::lock_guard<std::mutex> lock(r.mutex);
+    buffer->tid = r.next_tid++;
+    r.buffers.push_back(buffer);
+  }
+  return *buffer;
+}
+
+/*
+ * @brief 基準点からの経過時間（ns）を返します。
+ */
+std::int64_t since_origin_ns(std::chrono::steady_clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             t - registry().origin)
+      .count();
+}
+
+/*
+ * @brief JSON 文字列として安全な形で出力します。
+ */
+void write_json_string(std::ostream& os, const char* s) {
+  os << '"';
+  for (const char* p = (s != nullptr ? s : ""); *p != '\0'; ++p) {
+    if (*p == '"' || *p == '\\') {
+      os << '\\';
+    }
+    os << *p;
+  }
+  os << '"';
+}
+
+/*
+ * @brief ns をマイクロ秒（小数3桁）で出力します。
+ */
+void write_us(std::ostream& os, std::int64_t ns) {
+  os << ns / 1000 << '.';
+  const std::int64_t frac = ns % 1000;
+  os << (frac < 100 ? "0" : "") << (frac < 10 ? "0" : "") << frac;
+}
+
+} /* namespace */
+
+namespace detail {
+
+/*
+ * @brief 完了スパンを記録します。
+ *
+ * @param name スパン名
+ * @param category カテゴリ
+ * @param start 開始時刻
+ * @param arg_name 引数名（null なら引数なし）
+ * @param arg_value 引数値
+ */
+void trace_complete(const char* name,
+                    const char* category,
+                    std::chrono::steady_clock::time_point start,
+                    const char* arg_name,
+                    std::int64_t arg_value) {
+  const auto end = std::chrono::steady_clock::now();
+  TraceEvent e;
+  e.name = name;
+  e.category = category;
+  e.arg_name = arg_name;
+  e.arg_value = arg_value;
+  e.ts_ns = since_origin_ns(start);
+  e.dur_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+                 .count();
+  e.phase = 'X';
+  local_buffer().events.push_back(e);
+}
+
+} /* namespace detail */
+
+/*
+ * @brief トレースを有効化し、時刻の基準点を現在時刻にします。
+ */
+void trace_start() {
+  {
+    Registry& r = registry();
+    const std::lock_guard<std::mutex> lock(r.mutex);
+    r.origin = std::chrono::steady_clock::now();
+  }
+  detail::g_trace_enabled.store(true, std::memory_order_relaxed);
+}
+
+/*
+ * @brief トレースを無効化します。
+ */
+void trace_stop() {
+  detail::g_trace_enabled.store(false, std::memory_order_relaxed);
+}
+
+/*
+ * @brief 記録済みイベントをすべて破棄します。
+ */
+void trace_clear() {
+  Registry& r = registry();
+  const std::lock_guard<std::mutex> lock(r.mutex);
+  for (const auto& b : r.buffers) {
+    b->events.clear();
+  }
+}
+
+/*
+ * @brief 瞬間イベントを記録します（無効時は何もしません）。
+ *
+ * @param name イベント名
+ * @param category カテゴリ
+ * @param arg_name 引数名（null なら引数なし）
+ * @param arg_value 引数値
+ */
+void trace_instant(const char* name,
+                   const char* category,
+                   const char* arg_name,
+                   std::int64_t arg_value) {
+  if (!trace_enabled()) {
+    return;
+  }
+  TraceEvent e;
+  e.name = name;
+  e.category = category;
+  e.arg_name = arg_name;
+  e.arg_value = arg_value;
+  e.ts_ns = since_origin_ns(std::chrono::steady_clock::now());
+  e.phase = 'i';
+  local_buffer().events.push_back(e);
+}
+
+/*
+ * @brief 記録済みイベント数を返します。
+ *
+ * @return イベント数
+ */
+std::size_t trace_event_count() {
+  Registry& r = registry();
+  const std::lock_guard<std::mutex> lock(r.mutex);
+  std::size_t n = 0;
+  for (const auto& b : r.buffers) {
+    n += b->events.size();
+  }
+  return n;
+}
+
+/*
+ * @brief 全スレッドのイベントを trace_event JSON で出力します。
+ *
+ * 例:
+ *   {"traceEvents":[{"name":"batch.step","cat":"sim","ph":"X",
+ *    "ts":12.345,"dur":0.210,"pid":1,"tid":1,"args":{"batch":0}}, ...]}
+ *
+ * @param os 出力先
+ */
+void trace_write_json(std::ostream& os) {
+  Registry& r = registry();
+  const std::lock_guard<std::mutex> lock(r.mutex);
+
+  os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (const auto& b : r.buffers) {
+    for (const TraceEvent& e : b->events) {
+      os << (first ? "\n" : ",\n");
+      first = false;
+      os << "{\"name\":";
+      write_json_string(os, e.name);
+      os << ",\"cat\":";
+      write_json_string(os, e.category);
+      os << ",\"ph\":\"" << e.phase << "\",\"ts\":";
+      write_us(os, e.ts_ns);
+      if (e.phase == 'X') {
+        os << ",\"dur\":";
+        write_us(os, e.dur_ns);
+      } else {
+        os << ",\"s\":\"t\"";
+      }
+      os << ",\"pid\":1,\"tid\":" << b->tid;
+      if (e.arg_name != nullptr) {
+        os << ",\"args\":{";
+        write_json_string(os, e.arg_name);
+        os << ':' << e.arg_value << '}';
+      }
+      os << '}';
+    }
+  }
+  os << "\n]}\n";
+}
+
+/*
+ * @brief 全スレッドのイベントをファイルへ書き出します。
+ *
+ * @param path 出力先パス
+ * @return 成功なら true
+ */
+bool trace_write_json(const std::string& path) {
+  std::ofstream ofs(path, std::ios::out | std::ios::trunc);
+  if (!ofs) {
+    return false;
+  }
+  trace_write_json(ofs);
+  return static_cast<bool>(ofs);
+}
+
+} /* namespace tea_perf */
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace tea_perf {
+
+/*
+  Chrome trace_event 形式のスパン記録です。
+  実行時に trace_start() で有効化し、終了時に trace_write_json() で書き出します。
+  無効時のコストは atomic の relaxed 読み込み 1 回だけです。
+  イベントはスレッドローカルのバッファへ排他なしで追記します。
+*/
+
+namespace detail {
+
+/* トレースの有効/無効フラグです。 */
+extern std::atomic<bool> g_trace_enabled;
+
+/* 完了スパン（ph=X）を記録します。 */
+void trace_complete(const char* name,
+                    const char* category,
+                    std::chrono::steady_clock::time_point start,
+                    const char* arg_name,
+                    std::int64_t arg_value);
+
+} /* namespace detail */
+
+/* トレースが有効かを返します。 */
+inline bool trace_enabled() {
+  return detail::g_trace_enabled.load(std::memory_order_relaxed);
+}
+
+/* トレースを有効化し、時刻の基準点を設定します。 */
+void trace_start();
+
+/* トレースを無効化します（記録済みイベントは保持します）。 */
+void trace_stop();
+
+/* 記録済みイベントをすべて破棄します（テスト用）。 */
+void trace_clear();
+
+/* 瞬間イベント（ph=i）を記録します（name/category/arg_name は静的文字列）。 */
+void trace_instant(const char* name,
+                   const char* category,
+                   const char* arg_name = nullptr,
+                   std::int64_t arg_value = 0);
+
+/* 記録済みイベント数を返します。 */
+std::size_t trace_event_count();
+
+/*
+  全スレッドのイベントを trace_event JSON で出力します。
+  記録中のスレッドが無い状態（終了時など）で呼び出してください。
+*/
+void trace_write_json(std::ostream& os);
+
+/* ファイルへ書き出します。失敗時は false を返します。 */
+bool trace_write_json(const std::string& path);
+
+/* スコープを 1 つの完了スパンとして記録する RAII です。 */
+class TraceSpan final {
+ public:
+  /* 有効時のみ開始時刻を記録します（name/category は静的文字列）。 */
+  TraceSpan(const char* name,
+            const char* category,
+            const char* arg_name = nullptr,
+            std::int64_t arg_value = 0)
+      : name_(name),
+        category_(category),
+        arg_name_(arg_name),
+        arg_value_(arg_value),
+        active_(trace_enabled()) {
+    if (active_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  /* 有効時のみスパンを記録します。 */
+  ~TraceSpan() {
+    if (active_) {
+      detail::trace_complete(name_, category_, start_, arg_name_, arg_value_);
+    }
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+ private:
+  const char* name_;
+  const char* category_;
+  const char* arg_name_;
+  std::int64_t arg_value_;
+  bool active_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+} /* namespace tea_perf */
+
+#define TEA_TRACE_CONCAT_INNER(a, b) a##b
+#define TEA_TRACE_CONCAT(a, b) TEA_TRACE_CONCAT_INNER(a, b)
+
+/* スコープ全体をスパンとして記録します（引数は TraceSpan と同じ）。 */
+#define TEA_TRACE_SCOPE(...) \
+  const ::tea_perf::TraceSpan TEA_TRACE_CONCAT(tea_trace_s_, __LINE__)(__VA_ARGS__)
@@ -9,7 +9,7 @@
 
 #include "process/DryingProcess.h"
 
-#include <cmath> // For std::exp
+#include "process/StepKernels.h"
 
 namespace tea {
 
@@ -51,7 +51,7 @@ ProcessState DryingProcess::state() const {
  * @param leaf 更新するTeaLeafオブジェクトへの参照
  * @param dt_seconds 更新する時間間隔（秒）
  */
-void DryingProcess::apply_step(TeaLeaf& leaf, int dt_seconds) const {
+void DryingProcess::apply_step(TeaLeaf& leaf, double dt_seconds) const {
   /*
     乾燥は「水分が指数関数的に減る」近似が扱いやすいので、指数減衰で
     モデル化します。
@@ -60,23 +60,27 @@ void DryingProcess::apply_step(TeaLeaf& leaf, int dt_seconds) const {
     - 温度: 目標温度へ近づく緩和（制御された乾燥の近似）
     - 香気: 過熱時（閾値超え）に劣化、通常は僅かに整う
   */
-  const double dt = static_cast<double>(dt_seconds);
-  leaf.temperature_c +=
-      (params_.target_temp_c - leaf.temperature_c) * params_.temp_k * dt;
-  leaf.moisture *= std::exp(-params_.dry_k * dt);
+  drying_step(params_, leaf, dt_seconds);
+}
 
-  if (leaf.temperature_c > params_.overheat_c) {
-    leaf.aroma -=
-        params_.aroma_damage_k * (leaf.temperature_c - params_.overheat_c) * dt;
-  } else {
-    leaf.aroma +=
-        params_.aroma_recover_per_s * dt * (1.0 - leaf.aroma / 100.0);
+/*
+ * @brief 同じ dt のステップを count 回まとめて適用します。
+ *
+ * 水分の減衰率 exp(-dry_k * dt) は葉によらず一定のため、ループの外で
+ * 1 回だけ計算します（apply_step を count 回呼ぶのと同じ結果です）。
+ *
+ * @param leaf 更新するTeaLeafオブジェクトへの参照
+ * @param dt_seconds 1 ステップの時間間隔（秒）
+ * @param count ステップ数
+ */
+void DryingProcess::apply_steps(TeaLeaf& leaf,
+                                double dt_seconds,
+                                int count) const {
+  const DryingParams params = params_;
+  const double decay = drying_decay(params, dt_seconds);
+  for (int i = 0; i < count; ++i) {
+    drying_step(params, leaf, dt_seconds, decay);
   }
-
-  leaf.color +=
-      params_.color_gain_per_s * dt * (1.0 - leaf.color / 100.0);
-
-  normalize(leaf);
 }
 
 } /* namespace tea */
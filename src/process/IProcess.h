@@ -14,8 +14,19 @@ class IProcess {
   /* 工程の状態（種別）を返します。 */
   virtual ProcessState state() const = 0;
 
-  /* 1 ステップ分（dt 秒）だけ茶葉の状態を更新します。 */
-  virtual void apply_step(TeaLeaf& leaf, int dt_seconds) const = 0;
+  /* 1 ステップ分（dt 秒、1 秒未満も可）だけ茶葉の状態を更新します。 */
+  virtual void apply_step(TeaLeaf& leaf, double dt_seconds) const = 0;
+
+  /*
+    dt 秒のステップを count 回続けて適用します（apply_step を count 回呼ぶのと同じ結果です）。
+    細かい dt で長い区間を進めるときに仮想呼び出しと係数の読み込みを 1 回に
+    まとめるための入口で、各工程は更新式をループ内で展開して上書きします。
+  */
+  virtual void apply_steps(TeaLeaf& leaf, double dt_seconds, int count) const {
+    for (int i = 0; i < count; ++i) {
+      apply_step(leaf, dt_seconds);
+    }
+  }
 };
 
 } /* namespace tea */
@@ -9,6 +9,8 @@
 
 #include "process/RollingProcess.h"
 
+#include "process/StepKernels.h"
+
 namespace tea {
 
 /*
@@ -48,7 +50,7 @@ ProcessState RollingProcess::state() const {
  * @param leaf 更新するTeaLeafオブジェクトへの参照
  * @param dt_seconds 更新する時間間隔（秒）
  */
-void RollingProcess::apply_step(TeaLeaf& leaf, int dt_seconds) const {
+void RollingProcess::apply_step(TeaLeaf& leaf, double dt_seconds) const {
   /*
     揉捻は「圧力/摩擦で水分が抜ける + 香気が少し増える」挙動を
     シンプルに表します。
@@ -56,15 +58,26 @@ void RollingProcess::apply_step(TeaLeaf& leaf, int dt_seconds) const {
     - 水分: 現在の水分が多いほど抜けやすい（弱い非線形）
     - 香気/色: 上限 100 へ近づく飽和モデル
   */
-  const double dt = static_cast<double>(dt_seconds);
-  leaf.temperature_c +=
-      (params_.target_temp_c - leaf.temperature_c) * params_.cool_k * dt;
-  leaf.moisture -=
-      params_.moisture_loss_k * dt * (0.4 + 0.6 * leaf.moisture);
-  leaf.aroma += params_.aroma_gain_per_s * dt * (1.0 - leaf.aroma / 100.0);
-  leaf.color += params_.color_gain_per_s * dt * (1.0 - leaf.color / 100.0);
+  rolling_step(params_, leaf, dt_seconds);
+}
 
-  normalize(leaf);
+/*
+ * @brief 同じ dt のステップを count 回まとめて適用します。
+ *
+ * 係数を局所変数へ写してから更新式をループ内で展開します
+ * （apply_step を count 回呼ぶのと同じ結果です）。
+ *
+ * @param leaf 更新するTeaLeafオブジェクトへの参照
+ * @param dt_seconds 1 ステップの時間間隔（秒）
+ * @param count ステップ数
+ */
+void RollingProcess::apply_steps(TeaLeaf& leaf,
+                                 double dt_seconds,
+                                 int count) const {
+  const RollingParams params = params_;
+  for (int i = 0; i < count; ++i) {
+    rolling_step(params, leaf, dt_seconds);
+  }
 }
 
 } /* namespace tea */
@@ -9,6 +9,8 @@
 
 #include "process/SteamingProcess.h"
 
+#include "process/StepKernels.h"
+
 namespace tea {
 
 /*
@@ -49,7 +51,7 @@ ProcessState SteamingProcess::state() const {
  * @param leaf 更新するTeaLeafオブジェクトへの参照
  * @param dt_seconds 更新する時間間隔（秒）
  */
-void SteamingProcess::apply_step(TeaLeaf& leaf, int dt_seconds) const {
+void SteamingProcess::apply_step(TeaLeaf& leaf, double dt_seconds) const {
   /*
     蒸しは「目標温度へ近づく」緩和モデルで表現します。
     - 温度: dT = k * (T_target - T) * dt
@@ -57,14 +59,26 @@ void SteamingProcess::apply_step(TeaLeaf& leaf, int dt_seconds) const {
     - 水分: 蒸気付与による僅かな増加（定率）
     - 香気/色: 上限 100 へ近づく飽和モデル（増分は残り量に比例）
   */
-  const double dt = static_cast<double>(dt_seconds);
-  leaf.temperature_c +=
-      (params_.target_temp_c - leaf.temperature_c) * params_.heat_k * dt;
-  leaf.moisture += params_.moisture_gain_per_s * dt;
-  leaf.aroma += params_.aroma_gain_per_s * dt * (1.0 - leaf.aroma / 100.0);
-  leaf.color += params_.color_gain_per_s * dt * (1.0 - leaf.color / 100.0);
+  steaming_step(params_, leaf, dt_seconds);
+}
 
-  normalize(leaf);
+/*
+ * @brief 同じ dt のステップを count 回まとめて適用します。
+ *
+ * 係数を局所変数へ写してから更新式をループ内で展開します
+ * （apply_step を count 回呼ぶのと同じ結果です）。
+ *
+ * @param leaf 更新するTeaLeafオブジェクトへの参照
+ * @param dt_seconds 1 ステップの時間間隔（秒）
+ * @param count ステップ数
+ */
+void SteamingProcess::apply_steps(TeaLeaf& leaf,
+                                  double dt_seconds,
+                                  int count) const {
+  const SteamingParams params = params_;
+  for (int i = 0; i < count; ++i) {
+    steaming_step(params, leaf, dt_seconds);
+  }
 }
 
 } /* namespace tea */
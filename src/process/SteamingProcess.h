@@ -18,7 +18,10 @@ class SteamingProcess final : public IProcess {
   ProcessState state() const override;
 
   /* 1 ステップ分の更新を行います。 */
-  void apply_step(TeaLeaf& leaf, int dt_seconds) const override;
+  void apply_step(TeaLeaf& leaf, double dt_seconds) const override;
+
+  /* 同じ dt のステップを count 回まとめて適用します。 */
+  void apply_steps(TeaLeaf& leaf, double dt_seconds, int count) const override;
 
  private:
   SteamingParams params_;
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cmath>
+
+#include "domain/Model.h"
+#include "domain/TeaLeaf.h"
+
+namespace tea {
+
+/*
+  各工程の 1 ステップ更新式です（数値型 T で共通化）。
+  IProcess 実装と一括計算（BatchEngineT）の双方から使い、
+  式の重複と精度ごとの実装ずれを防ぎます。
+  T=double のときは従来の apply_step と演算順序まで同一です。
+*/
+
+/* 蒸し工程の 1 ステップ更新です。 */
+template <typename T>
+inline void steaming_step(const SteamingParamsT<T>& p,
+                          TeaLeafT<T>& leaf,
+                          T dt) {
+  leaf.temperature_c += (p.target_temp_c - leaf.temperature_c) * p.heat_k * dt;
+  leaf.moisture += p.moisture_gain_per_s * dt;
+  leaf.aroma += p.aroma_gain_per_s * dt * (T(1.0) - leaf.aroma / T(100.0));
+  leaf.color += p.color_gain_per_s * dt * (T(1.0) - leaf.color / T(100.0));
+  normalize(leaf);
+}
+
+/* 揉捻工程の 1 ステップ更新です。 */
+template <typename T>
+inline void rolling_step(const RollingParamsT<T>& p,
+                         TeaLeafT<T>& leaf,
+                         T dt) {
+  leaf.temperature_c += (p.target_temp_c - leaf.temperature_c) * p.cool_k * dt;
+  leaf.moisture -= p.moisture_loss_k * dt * (T(0.4) + T(0.6) * leaf.moisture);
+  leaf.aroma += p.aroma_gain_per_s * dt * (T(1.0) - leaf.aroma / T(100.0));
+  leaf.color += p.color_gain_per_s * dt * (T(1.0) - leaf.color / T(100.0));
+  normalize(leaf);
+}
+
+/* 乾燥工程の水分減衰率 exp(-dry_k * dt) です（葉によらず一定）。 */
+template <typename T>
+inline T drying_decay(const DryingParamsT<T>& p, T dt) {
+  using std::exp;
+  return exp(-p.dry_k * dt);
+}
+
+/* 乾燥工程の 1 ステップ更新です（decay は drying_decay の値）。 */
+template <typename T>
+inline void drying_step(const DryingParamsT<T>& p,
+                        TeaLeafT<T>& leaf,
+                        T dt,
+                        T decay) {
+  leaf.temperature_c += (p.target_temp_c - leaf.temperature_c) * p.temp_k * dt;
+  leaf.moisture *= decay;
+
+  /* 分岐せず両方の候補を計算して選択し、一括計算でもベクトル化できるようにします。 */
+  const T damaged =
+      leaf.aroma - p.aroma_damage_k * (leaf.temperature_c - p.overheat_c) * dt;
+  const T recovered =
+      leaf.aroma + p.aroma_recover_per_s * dt * (T(1.0) - leaf.aroma / T(100.0));
+  leaf.aroma = (leaf.temperature_c > p.overheat_c) ? damaged : recovered;
+
+  leaf.color += p.color_gain_per_s * dt * (T(1.0) - leaf.color / T(100.0));
+  normalize(leaf);
+}
+
+/* 乾燥工程の 1 ステップ更新です。 */
+template <typename T>
+inline void drying_step(const DryingParamsT<T>& p, TeaLeafT<T>& leaf, T dt) {
+  drying_step(p, leaf, dt, drying_decay(p, dt));
+}
+
+/*
+  各工程の連続時間での時間微分（1 秒あたりの変化率）です。
+  上の 1 ステップ更新式を dt → 0 とした常微分方程式の右辺で、
+  適応刻みの積分（AdaptiveSimulator）から使います。
+  定義域への正規化は右辺ではなく、積分した状態に対して行います。
+*/
+
+/* 蒸し工程の時間微分です。 */
+template <typename T>
+inline TeaLeafT<T> steaming_rate(const SteamingParamsT<T>& p,
+                                 const TeaLeafT<T>& leaf) {
+  TeaLeafT<T> d;
+  d.temperature_c = (p.target_temp_c - leaf.temperature_c) * p.heat_k;
+  d.moisture = p.moisture_gain_per_s;
+  d.aroma = p.aroma_gain_per_s * (T(1.0) - leaf.aroma / T(100.0));
+  d.color = p.color_gain_per_s * (T(1.0) - leaf.color / T(100.0));
+  return d;
+}
+
+/* 揉捻工程の時間微分です。 */
+template <typename T>
+inline TeaLeafT<T> rolling_rate(const RollingParamsT<T>& p,
+                                const TeaLeafT<T>& leaf) {
+  TeaLeafT<T> d;
+  d.temperature_c = (p.target_temp_c - leaf.temperature_c) * p.cool_k;
+  d.moisture = -p.moisture_loss_k * (T(0.4) + T(0.6) * leaf.moisture);
+  d.aroma = p.aroma_gain_per_s * (T(1.0) - leaf.aroma / T(100.0));
+  d.color = p.color_gain_per_s * (T(1.0) - leaf.color / T(100.0));
+  return d;
+}
+
+/*
+  乾燥工程の時間微分です（overheated: 香気を劣化側の式で計算するか）。
+  香気の式は温度が overheat_c を超えるかどうかで切り替わり、右辺はその境界で
+  不連続になるため、積分する側が切り替えの時刻を決められるよう分けています。
+*/
+template <typename T>
+inline TeaLeafT<T> drying_rate(const DryingParamsT<T>& p,
+                               const TeaLeafT<T>& leaf,
+                               bool overheated) {
+  TeaLeafT<T> d;
+  d.temperature_c = (p.target_temp_c - leaf.temperature_c) * p.temp_k;
+  d.moisture = -p.dry_k * leaf.moisture;
+  d.aroma = overheated
+                ? -p.aroma_damage_k * (leaf.temperature_c - p.overheat_c)
+                : p.aroma_recover_per_s * (T(1.0) - leaf.aroma / T(100.0));
+  d.color = p.color_gain_per_s * (T(1.0) - leaf.color / T(100.0));
+  return d;
+}
+
+/* 乾燥工程の時間微分です（香気の式は現在の温度で選びます）。 */
+template <typename T>
+inline TeaLeafT<T> drying_rate(const DryingParamsT<T>& p,
+                               const TeaLeafT<T>& leaf) {
+  return drying_rate(p, leaf, leaf.temperature_c > p.overheat_c);
+}
+
+} /* namespace tea */
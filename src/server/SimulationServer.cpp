@@ -0,0 +1,746 @@
+/*
+ * @file SimulationServer.cpp
+ * @brief Unix ドメインソケットで要求を受け付ける常駐シミュレーションサーバ
+ *
+ * 要求ごとにプロセスを起動して標準出力を解析する代わりに、常駐したまま
+ * 行区切りの要求を受け付けて結果を返します。ワーカーは起動時に作って
+ * 使い回し、各ワーカーの工程境界キャッシュも要求をまたいで保持します。
+ */
+
+#include "server/SimulationServer.h"
+
+#include <algorithm> // For std::min, std::max
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "domain/Model.h"
+#include "domain/TimeStep.h"
+#include "io/CsvWriter.h"
+#include "simulation/Simulator.h"
+#include "simulation/Sweep.h"
+
+namespace tea_server {
+
+namespace {
+
+/* 工程時間と dt の上限（秒、CLI と同じ 1 日）です。 */
+constexpr long kMaxSeconds = 24 * 60 * 60;
+
+/* 1 回の sweep で評価できる組み合わせ数の上限です。 */
+constexpr std::size_t kMaxSweepEvaluations = 1000000;
+
+/* 要求 1 行の上限（バイト）です。 */
+constexpr std::size_t kMaxLineBytes = 4096;
+
+/* sweep の結果行をこの大きさ（バイト）ごとに送り出します。 */
+constexpr std::size_t kFlushBytes = 64 * 1024;
+
+/* 受信バッファの大きさ（バイト）です。 */
+constexpr std::size_t kRecvBytes = 64 * 1024;
+
+/* listen の待ち行列の長さです。 */
+constexpr int kListenBacklog = 64;
+
+/* 工程時間の範囲（from:to:step、両端を含む）です。 */
+struct Range final {
+  int from = 0;
+  int to = 0;
+  int step = 1;
+};
+
+/* 解析済みの要求です。 */
+struct Request final {
+  tea::SimulationConfig config;
+  tea::TeaLeaf initial;
+  Range stages[3];
+};
+
+/*
+ * @brief 文字列を 1 以上 kMaxSeconds 以下の整数へ変換します。
+ *
+ * @param s 変換する文字列
+ * @return 変換結果、またはstd::nullopt
+ */
+std::optional<int> parse_seconds(const std::string& s) {
+  if (s.empty()) {
+    return std::nullopt;
+  }
+  char* end = nullptr;
+  const long v = std::strtol(s.c_str(), &end, 10);
+  if (end == s.c_str() || *end != '\0' || v <= 0 || v > kMaxSeconds) {
+    return std::nullopt;
+  }
+  return static_cast<int>(v);
+}
+
+/*
+ * @brief 工程時間（N または from:to:step）を解析します。
+ *
+ * @param s 変換する文字列
+ * @return 解析結果、またはstd::nullopt
+ */
+std::optional<Range> parse_range(const std::string& s) {
+  const std::size_t c1 = s.find(':');
+  if (c1 == std::string::npos) {
+    const auto v = parse_seconds(s);
+    if (!v.has_value()) {
+      return std::nullopt;
+    }
+    Range r;
+    r.from = *v;
+    r.to = *v;
+    return r;
+  }
+  const std::size_t c2 = s.find(':', c1 + 1);
+  if (c2 == std::string::npos) {
+    return std::nullopt;
+  }
+  const auto from = parse_seconds(s.substr(0, c1));
+  const auto to = parse_seconds(s.substr(c1 + 1, c2 - c1 - 1));
+  const auto step = parse_seconds(s.substr(c2 + 1));
+  if (!from.has_value() || !to.has_value() || !step.has_value() ||
+      *from > *to) {
+    return std::nullopt;
+  }
+  Range r;
+  r.from = *from;
+  r.to = *to;
+  r.step = *step;
+  return r;
+}
+
+/*
+ * @brief 文字列を [lo, hi] の有限な実数へ変換します。
+ *
+ * @param s 変換する文字列
+ * @param lo 下限
+ * @param hi 上限
+ * @return 変換結果、またはstd::nullopt
+ */
+std::optional<double> parse_real(const std::string& s, double lo, double hi) {
+  if (s.empty()) {
+    return std::nullopt;
+  }
+  char* end = nullptr;
+  const double v = std::strtod(s.c_str(), &end);
+  if (end == s.c_str() || *end != '\0' || !std::isfinite(v) || v < lo ||
+      v > hi) {
+    return std::nullopt;
+  }
+  return v;
+}
+
+/*
+ * @brief dt（0 より大きく kMaxSeconds 以下の、1 ms 単位の秒数）を解析します。
+ *
+ * @param s 変換する文字列
+ * @return 変換結果、またはstd::nullopt（1 ms より細かい値も不正とします）
+ */
+std::optional<double> parse_dt(const std::string& s) {
+  const auto v = parse_real(s, 0.0, static_cast<double>(kMaxSeconds));
+  if (!v.has_value()) {
+    return std::nullopt;
+  }
+  const std::int64_t ms = tea::to_milliseconds(*v);
+  if (ms <= 0 || std::fabs(tea::to_seconds(ms) - *v) > 1e-9) {
+    return std::nullopt;
+  }
+  return v;
+}
+
+/*
+ * @brief 範囲に含まれる値の数を返します。
+ *
+ * @param r 範囲
+ * @return 値の数
+ */
+std::size_t range_count(const Range& r) {
+  return static_cast<std::size_t>((r.to - r.from) / r.step) + 1;
+}
+
+/*
+ * @brief 範囲を値の列へ展開します。
+ *
+ * @param r 範囲
+ * @return 値の列
+ */
+std::vector<int> expand(const Range& r) {
+  std::vector<int> values;
+  values.reserve(range_count(r));
+  for (int v = r.from; v <= r.to; v += r.step) {
+    values.push_back(v);
+  }
+  return values;
+}
+
+/*
+ * @brief 行を空白で区切ります。
+ *
+ * @param line 要求 1 行
+ * @return 区切った語の列
+ */
+std::vector<std::string> split_words(const std::string& line) {
+  std::vector<std::string> words;
+  std::size_t i = 0;
+  while (i < line.size()) {
+    while (i < line.size() && (line[i] == ' ' || line[i] == '\t')) {
+      ++i;
+    }
+    const std::size_t begin = i;
+    while (i < line.size() && line[i] != ' ' && line[i] != '\t') {
+      ++i;
+    }
+    if (i > begin) {
+      words.push_back(line.substr(begin, i - begin));
+    }
+  }
+  return words;
+}
+
+/*
+ * @brief simulate/sweep の key=value を解析します。
+ *
+ * @param words 要求の語（先頭はコマンド）
+ * @param request 解析結果
+ * @return 失敗時は理由、成功時は空文字列
+ */
+std::string parse_request(const std::vector<std::string>& words,
+                          Request& request) {
+  request.stages[0].from = request.stages[0].to =
+      request.config.steaming_seconds;
+  request.stages[1].from = request.stages[1].to =
+      request.config.rolling_seconds;
+  request.stages[2].from = request.stages[2].to =
+      request.config.drying_seconds;
+
+  for (std::size_t i = 1; i < words.size(); ++i) {
+    const std::string& w = words[i];
+    const std::size_t eq = w.find('=');
+    if (eq == std::string::npos) {
+      return "expected key=value: " + w;
+    }
+    const std::string key = w.substr(0, eq);
+    const std::string value = w.substr(eq + 1);
+
+    if (key == "model") {
+      if (value == "default") {
+        request.config.model = tea::ModelType::DEFAULT;
+      } else if (value == "gentle") {
+        request.config.model = tea::ModelType::GENTLE;
+      } else if (value == "aggressive") {
+        request.config.model = tea::ModelType::AGGRESSIVE;
+      } else {
+        return "invalid model: " + value;
+      }
+    } else if (key == "dt") {
+      const auto v = parse_dt(value);
+      if (!v.has_value()) {
+        return "invalid dt: " + value;
+      }
+      request.config.dt_seconds = *v;
+    } else if (key == "steaming" || key == "rolling" || key == "drying") {
+      const auto r = parse_range(value);
+      if (!r.has_value()) {
+        return "invalid " + key + ": " + value;
+      }
+      const int stage = key == "steaming" ? 0 : (key == "rolling" ? 1 : 2);
+      request.stages[stage] = *r;
+    } else if (key == "moisture") {
+      const auto v = parse_real(value, 0.0, 1.0);
+      if (!v.has_value()) {
+        return "invalid moisture: " + value;
+      }
+      request.initial.moisture = *v;
+    } else if (key == "temperature") {
+      const auto v = parse_real(value, -273.15, 1000.0);
+      if (!v.has_value()) {
+        return "invalid temperature: " + value;
+      }
+      request.initial.temperature_c = *v;
+    } else if (key == "aroma" || key == "color") {
+      const auto v = parse_real(value, 0.0, 100.0);
+      if (!v.has_value()) {
+        return "invalid " + key + ": " + value;
+      }
+      (key == "aroma" ? request.initial.aroma : request.initial.color) = *v;
+    } else {
+      return "unknown key: " + key;
+    }
+  }
+
+  request.config.steaming_seconds = request.stages[0].from;
+  request.config.rolling_seconds = request.stages[1].from;
+  request.config.drying_seconds = request.stages[2].from;
+  return std::string();
+}
+
+/*
+ * @brief 書式付きで out へ追記します。
+ *
+ * @param out 追記先
+ * @param format printf 形式の書式
+ */
+template <typename... Ts>
+void append_format(std::string& out, const char* format, Ts... values) {
+  char line[256];
+  const int n = std::snprintf(line, sizeof(line), format, values...);
+  if (n > 0) {
+    out.append(line, static_cast<std::size_t>(
+                         std::min(n, static_cast<int>(sizeof(line)) - 1)));
+  }
+}
+
+/*
+ * @brief 接続へ data をすべて送ります。
+ *
+ * @param fd 接続
+ * @param data 送るバイト列
+ * @return 成功時 true
+ */
+bool send_all(int fd, const std::string& data) {
+  std::size_t sent = 0;
+  while (sent < data.size()) {
+    const ssize_t n =
+        ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    sent += static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+} /* namespace */
+
+/*
+ * @brief 工程境界キャッシュの容量を指定して構築します。
+ *
+ * @param cache_size キャッシュのエントリ数
+ */
+RequestHandler::RequestHandler(std::size_t cache_size) : cache_(cache_size) {
+}
+
+/*
+ * @brief 要求 1 行を処理し、応答を out へ追記します。
+ *
+ * 空行は何も返さずに読み飛ばします。
+ *
+ * @param line 要求 1 行（改行を除く）
+ * @param out 応答の追記先
+ * @param flush sweep の途中経過を送り出す関数
+ * @return 処理後の接続の扱い
+ */
+Action RequestHandler::handle(const std::string& line,
+                              std::string& out,
+                              const Flush& flush) {
+  const std::vector<std::string> words = split_words(line);
+  if (words.empty()) {
+    return Action::CONTINUE;
+  }
+  ++stats_.requests;
+  const std::string& command = words.front();
+
+  const auto fail = [&](const std::string& reason) {
+    ++stats_.errors;
+    out += "error ";
+    out += reason;
+    out += '\n';
+    return Action::CONTINUE;
+  };
+
+  if (command == "ping") {
+    out += "pong\n";
+    return Action::CONTINUE;
+  }
+  if (command == "quit") {
+    out += "bye\n";
+    return Action::CLOSE;
+  }
+  if (command == "shutdown") {
+    out += "ok\n";
+    return Action::SHUTDOWN;
+  }
+  if (command == "stats") {
+    const tea::PrefixCacheStats& c = cache_.stats();
+    append_format(out,
+                  "ok requests=%zu errors=%zu cache_hits=%zu "
+                  "cache_misses=%zu entries=%zu/%zu\n",
+                  stats_.requests, stats_.errors, c.hits, c.misses,
+                  cache_.size(), cache_.capacity());
+    return Action::CONTINUE;
+  }
+  if (command != "simulate" && command != "sweep") {
+    return fail("unknown command: " + command);
+  }
+
+  Request request;
+  const std::string parse_error = parse_request(words, request);
+  if (!parse_error.empty()) {
+    return fail(parse_error);
+  }
+
+  if (command == "simulate") {
+    for (const Range& r : request.stages) {
+      if (r.from != r.to) {
+        return fail("ranges are only allowed in sweep");
+      }
+    }
+    const tea::TeaLeaf leaf = cache_.run(request.config, request.initial);
+    const double score = ::tea_io::CsvWriter::quality_score(
+        leaf.moisture, leaf.aroma, leaf.color);
+    append_format(out,
+                  "ok moisture=%.6f temperatureC=%.3f aroma=%.3f color=%.3f "
+                  "score=%.2f status=%s\n",
+                  leaf.moisture, leaf.temperature_c, leaf.aroma, leaf.color,
+                  score, ::tea_io::CsvWriter::quality_status(score));
+    return Action::CONTINUE;
+  }
+
+  const std::size_t evaluations = range_count(request.stages[0]) *
+                                  range_count(request.stages[1]) *
+                                  range_count(request.stages[2]);
+  if (evaluations > kMaxSweepEvaluations) {
+    return fail("too many evaluations: " + std::to_string(evaluations));
+  }
+
+  tea::SweepSpec spec;
+  spec.params = tea::make_model(request.config.model);
+  spec.dt_seconds = request.config.dt_seconds;
+  spec.initial = request.initial;
+  spec.steaming_seconds = expand(request.stages[0]);
+  spec.rolling_seconds = expand(request.stages[1]);
+  spec.drying_seconds = expand(request.stages[2]);
+
+  const tea::SweepSummary summary = tea::run_sweep(
+      spec, cache_, [&](const tea::SweepEntry& e) {
+        append_format(out, "row %d,%d,%d,%.6f,%.3f,%.3f,%.3f,%.2f,%s\n",
+                      e.steaming_seconds, e.rolling_seconds,
+                      e.drying_seconds, e.leaf.moisture,
+                      e.leaf.temperature_c, e.leaf.aroma, e.leaf.color,
+                      e.score, ::tea_io::CsvWriter::quality_status(e.score));
+        if (out.size() >= kFlushBytes && flush) {
+          flush(out);
+        }
+      });
+  append_format(out, "end evaluations=%zu cache_hits=%zu cache_misses=%zu\n",
+                summary.evaluations, summary.cache.hits,
+                summary.cache.misses);
+  return Action::CONTINUE;
+}
+
+/*
+ * @brief 統計を返します。
+ *
+ * @return 統計
+ */
+const HandlerStats& RequestHandler::stats() const {
+  return stats_;
+}
+
+/*
+ * @brief 工程境界キャッシュを返します。
+ *
+ * @return キャッシュ
+ */
+const tea::PrefixStateCache& RequestHandler::cache() const {
+  return cache_;
+}
+
+/*
+ * @brief 設定を保持して構築します（待ち受けは start で始めます）。
+ *
+ * @param options サーバ設定
+ */
+SimulationServer::SimulationServer(const ServerOptions& options)
+    : options_(options) {
+}
+
+/*
+ * @brief 停止してワーカーを待ち合わせ、ソケットファイルを削除します。
+ */
+SimulationServer::~SimulationServer() {
+  stop();
+  shutdown_connections();
+  for (std::thread& th : workers_) {
+    if (th.joinable()) {
+      th.join();
+    }
+  }
+  if (listen_fd_ >= 0) {
+    ::close(listen_fd_);
+  }
+  for (int fd : wake_fds_) {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+  if (bound_) {
+    ::unlink(options_.socket_path.c_str());
+  }
+}
+
+/*
+ * @brief ソケットを作って待ち受けを始め、ワーカーを起動します。
+ *
+ * パスに古いソケットファイルが残っていれば削除してから bind します
+ * （ソケット以外のファイルがある場合は失敗します）。
+ *
+ * @param error 失敗時の理由の格納先（nullptr 可）
+ * @return 成功時 true
+ */
+bool SimulationServer::start(std::string* error) {
+  const auto fail = [&](const std::string& reason) {
+    if (error != nullptr) {
+      *error = reason;
+    }
+    return false;
+  };
+
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (options_.socket_path.empty() ||
+      options_.socket_path.size() >= sizeof(addr.sun_path)) {
+    return fail("invalid socket path: " + options_.socket_path);
+  }
+  std::memcpy(addr.sun_path, options_.socket_path.data(),
+              options_.socket_path.size());
+
+  struct stat st;
+  if (::lstat(options_.socket_path.c_str(), &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      return fail("path exists and is not a socket: " + options_.socket_path);
+    }
+    ::unlink(options_.socket_path.c_str());
+  }
+
+  listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd_ < 0) {
+    return fail(std::string("socket: ") + std::strerror(errno));
+  }
+  if (::bind(listen_fd_, reinterpret_cast<const sockaddr*>(&addr),
+             sizeof(addr)) != 0) {
+    return fail(std::string("bind: ") + std::strerror(errno));
+  }
+  bound_ = true;
+  if (::listen(listen_fd_, kListenBacklog) != 0) {
+    return fail(std::string("listen: ") + std::strerror(errno));
+  }
+  if (::pipe2(wake_fds_, O_CLOEXEC | O_NONBLOCK) != 0) {
+    return fail(std::string("pipe: ") + std::strerror(errno));
+  }
+
+  int count = options_.workers;
+  if (count <= 0) {
+    count = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  count = std::max(1, count);
+  workers_.reserve(static_cast<std::size_t>(count));
+  for (int i = 0; i < count; ++i) {
+    workers_.emplace_back(&SimulationServer::worker_main, this);
+  }
+  return true;
+}
+
+/*
+ * @brief stop() が呼ばれるまで接続を受け付け、ワーカーへ渡します。
+ *
+ * 戻る前に処理中の接続を打ち切り、ワーカーの終了を待ちます。
+ */
+void SimulationServer::run() {
+  while (!stopping_.load()) {
+    pollfd fds[2];
+    fds[0].fd = listen_fd_;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = wake_fds_[0];
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+    if (::poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    if (fds[1].revents != 0) {
+      break;
+    }
+    if ((fds[0].revents & POLLIN) == 0) {
+      continue;
+    }
+    const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pending_.push_back(fd);
+    }
+    ready_.notify_one();
+  }
+
+  shutdown_connections();
+  for (std::thread& th : workers_) {
+    if (th.joinable()) {
+      th.join();
+    }
+  }
+}
+
+/*
+ * @brief 受け付けを止めるよう要求します。
+ *
+ * フラグを立ててパイプへ 1 バイト書くだけなので、シグナルハンドラからも呼べます。
+ */
+void SimulationServer::stop() {
+  stopping_.store(true);
+  if (wake_fds_[1] >= 0) {
+    const char byte = 1;
+    const ssize_t ignored = ::write(wake_fds_[1], &byte, 1);
+    (void)ignored;
+  }
+}
+
+/*
+ * @brief ワーカースレッド数を返します。
+ *
+ * @return ワーカースレッド数
+ */
+int SimulationServer::worker_count() const {
+  return static_cast<int>(workers_.size());
+}
+
+/*
+ * @brief 処理した要求数の合計を返します。
+ *
+ * @return 要求数
+ */
+std::size_t SimulationServer::requests() const {
+  return requests_.load();
+}
+
+/*
+ * @brief キューから接続を受け取り、閉じるまで処理することを繰り返します。
+ */
+void SimulationServer::worker_main() {
+  RequestHandler handler(options_.cache_size);
+  while (true) {
+    int fd = -1;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ready_.wait(lock, [&] { return closing_ || !pending_.empty(); });
+      if (closing_) {
+        return;
+      }
+      fd = pending_.front();
+      pending_.pop_front();
+      active_.insert(fd);
+    }
+    serve_connection(fd, handler);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      active_.erase(fd);
+    }
+    ::close(fd);
+  }
+}
+
+/*
+ * @brief 1 接続の要求を、相手が閉じるか quit/shutdown まで処理します。
+ *
+ * 1 回の受信に含まれる要求をすべて処理してから、応答をまとめて送ります。
+ *
+ * @param fd 接続
+ * @param handler このワーカーの要求処理
+ */
+void SimulationServer::serve_connection(int fd, RequestHandler& handler) {
+  std::string in;
+  std::string out;
+  std::vector<char> buffer(kRecvBytes);
+  bool alive = true;
+  const RequestHandler::Flush flush = [&](std::string& data) {
+    if (alive) {
+      alive = send_all(fd, data);
+    }
+    data.clear();
+  };
+
+  while (alive) {
+    const ssize_t n = ::recv(fd, buffer.data(), buffer.size(), 0);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return;
+    }
+    in.append(buffer.data(), static_cast<std::size_t>(n));
+
+    Action action = Action::CONTINUE;
+    std::size_t begin = 0;
+    while (action == Action::CONTINUE) {
+      const std::size_t end = in.find('\n', begin);
+      if (end == std::string::npos) {
+        break;
+      }
+      std::size_t len = end - begin;
+      if (len > 0 && in[begin + len - 1] == '\r') {
+        --len;
+      }
+      const std::size_t before = handler.stats().requests;
+      action = handler.handle(in.substr(begin, len), out, flush);
+      requests_.fetch_add(handler.stats().requests - before);
+      begin = end + 1;
+    }
+    in.erase(0, begin);
+    if (action == Action::CONTINUE && in.size() > kMaxLineBytes) {
+      out += "error request line too long\n";
+      action = Action::CLOSE;
+    }
+
+    if (!out.empty()) {
+      flush(out);
+    }
+    if (action == Action::SHUTDOWN) {
+      stop();
+      return;
+    }
+    if (action == Action::CLOSE) {
+      return;
+    }
+  }
+}
+
+/*
+ * @brief 待ち中の接続を閉じ、処理中の接続を打ち切ってワーカーを起こします。
+ */
+void SimulationServer::shutdown_connections() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closing_ = true;
+    for (int fd : pending_) {
+      ::close(fd);
+    }
+    pending_.clear();
+    for (int fd : active_) {
+      ::shutdown(fd, SHUT_RDWR);
+    }
+  }
+  ready_.notify_all();
+}
+
+} /* namespace tea_server */
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "simulation/PrefixCache.h"
+
+namespace tea_server {
+
+/* 要求を処理した後に接続をどう扱うかです。 */
+enum class Action {
+  CONTINUE, /* 次の要求を待つ */
+  CLOSE,    /* この接続を閉じる */
+  SHUTDOWN  /* サーバ全体を止める */
+};
+
+/* RequestHandler が処理した要求の統計です。 */
+struct HandlerStats final {
+  std::size_t requests = 0; /* 処理した要求数（エラーを含む） */
+  std::size_t errors = 0;   /* エラーを返した要求数 */
+};
+
+/*
+  行区切りの要求 1 行を解釈して評価し、応答行を組み立てます。
+  ソケットには依存しないため、単体でも使えます。
+  工程境界キャッシュ（PrefixStateCache）を要求をまたいで保持するため、
+  同じレシピや前段を共有するレシピの再評価はキャッシュから返ります。
+  スレッド安全ではありません（ワーカーごとに 1 つ持ちます）。
+
+  要求（空白区切り、キーは key=value）:
+    ping
+    simulate [model=] [dt=] [steaming=] [rolling=] [drying=]
+             [moisture=] [temperature=] [aroma=] [color=]
+    sweep    （simulate と同じキー。工程時間は from:to:step も可）
+    stats
+    quit
+    shutdown
+  応答:
+    pong / ok key=value... / row <CSV> ... end key=value... / bye / error <理由>
+*/
+class RequestHandler final {
+ public:
+  /* 応答の途中経過を送り出す関数です（渡したバッファは送信後に空にします）。 */
+  using Flush = std::function<void(std::string&)>;
+
+  /* 工程境界キャッシュの容量を指定して構築します。 */
+  explicit RequestHandler(std::size_t cache_size);
+
+  /*
+    要求 1 行（改行を除く）を処理し、応答を out へ追記します。
+    sweep の結果行は out が大きくなるたびに flush へ渡して逐次送ります。
+  */
+  Action handle(const std::string& line, std::string& out, const Flush& flush);
+
+  /* 統計を返します。 */
+  const HandlerStats& stats() const;
+
+  /* 工程境界キャッシュを返します。 */
+  const tea::PrefixStateCache& cache() const;
+
+ private:
+  tea::PrefixStateCache cache_;
+  HandlerStats stats_;
+};
+
+/* SimulationServer の設定です。 */
+struct ServerOptions final {
+  /* 待ち受ける Unix ドメインソケットのパスです。 */
+  std::string socket_path;
+
+  /* 接続を処理するワーカースレッド数（0 ならハードウェアスレッド数）です。 */
+  int workers = 0;
+
+  /* ワーカーごとの工程境界キャッシュの容量です。 */
+  std::size_t cache_size = 1024;
+};
+
+/*
+  Unix ドメインソケットで要求を受け付ける常駐サーバです。
+  起動時に固定数のワーカースレッドを作り、各ワーカーが RequestHandler
+  （温まったキャッシュ）を持ち続けます。受け付けた接続はキューを介して
+  空いているワーカーへ渡され、接続が閉じるまで同じワーカーが処理します。
+  1 回の受信に含まれる複数の要求は、応答をまとめて 1 回で送り返します。
+*/
+class SimulationServer final {
+ public:
+  explicit SimulationServer(const ServerOptions& options);
+
+  /* 停止してワーカーを待ち合わせ、ソケットファイルを削除します。 */
+  ~SimulationServer();
+
+  SimulationServer(const SimulationServer&) = delete;
+  SimulationServer& operator=(const SimulationServer&) = delete;
+
+  /* ソケットを作って待ち受けを始め、ワーカーを起動します。失敗時は error に理由を設定します。 */
+  bool start(std::string* error);
+
+  /* stop() が呼ばれるまで接続を受け付けます（呼び出し元のスレッドで動きます）。 */
+  void run();
+
+  /* 受け付けを止めるよう要求します（シグナルハンドラからも呼べます）。 */
+  void stop();
+
+  /* ワーカースレッド数を返します。 */
+  int worker_count() const;
+
+  /* 処理した要求数の合計を返します。 */
+  std::size_t requests() const;
+
+ private:
+  void worker_main();
+  void serve_connection(int fd, RequestHandler& handler);
+  void shutdown_connections();
+
+  ServerOptions options_;
+  int listen_fd_ = -1;
+  int wake_fds_[2] = {-1, -1};
+  bool bound_ = false;
+  std::atomic<bool> stopping_{false};
+  std::atomic<std::size_t> requests_{0};
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::deque<int> pending_;
+  std::unordered_set<int> active_;
+  bool closing_ = false;
+};
+
+} /* namespace tea_server */
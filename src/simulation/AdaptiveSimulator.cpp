@@ -0,0 +1,460 @@
+/*
+ * @file AdaptiveSimulator.cpp
+ * @brief 工程の式を適応刻み（Dormand-Prince 5(4)）で積分するシミュレータ
+ *
+ * 1 回の刻みで右辺を 6 回評価し（7 段目は次の刻みの 1 段目に使い回します）、
+ * 5 次と 4 次の解の差で誤差を見積もって刻みを伸縮します。
+ * 出力時刻の状態は、採用した刻みの密出力（Hairer の dopri5 と同じ係数）で
+ * 補間するため、出力の間隔ごとに刻みを切る必要はありません。
+ */
+
+#include "simulation/AdaptiveSimulator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "perf/Stats.h"
+#include "perf/Trace.h"
+#include "process/StepKernels.h"
+
+namespace tea {
+
+namespace {
+
+/* 状態の添字です。 */
+constexpr std::size_t kMoisture = 0;
+constexpr std::size_t kTemperature = 1;
+constexpr std::size_t kAroma = 2;
+constexpr std::size_t kColor = 3;
+
+/* Dormand-Prince 5(4) の係数です。 */
+constexpr double kA21 = 1.0 / 5.0;
+constexpr double kA31 = 3.0 / 40.0;
+constexpr double kA32 = 9.0 / 40.0;
+constexpr double kA41 = 44.0 / 45.0;
+constexpr double kA42 = -56.0 / 15.0;
+constexpr double kA43 = 32.0 / 9.0;
+constexpr double kA51 = 19372.0 / 6561.0;
+constexpr double kA52 = -25360.0 / 2187.0;
+constexpr double kA53 = 64448.0 / 6561.0;
+constexpr double kA54 = -212.0 / 729.0;
+constexpr double kA61 = 9017.0 / 3168.0;
+constexpr double kA62 = -355.0 / 33.0;
+constexpr double kA63 = 46732.0 / 5247.0;
+constexpr double kA64 = 49.0 / 176.0;
+constexpr double kA65 = -5103.0 / 18656.0;
+constexpr double kA71 = 35.0 / 384.0;
+constexpr double kA73 = 500.0 / 1113.0;
+constexpr double kA74 = 125.0 / 192.0;
+constexpr double kA75 = -2187.0 / 6784.0;
+constexpr double kA76 = 11.0 / 84.0;
+
+/* 5 次と 4 次の重みの差（誤差の見積もり）です。 */
+constexpr double kE1 = 71.0 / 57600.0;
+constexpr double kE3 = -71.0 / 16695.0;
+constexpr double kE4 = 71.0 / 1920.0;
+constexpr double kE5 = -17253.0 / 339200.0;
+constexpr double kE6 = 22.0 / 525.0;
+constexpr double kE7 = -1.0 / 40.0;
+
+/* 密出力の係数です。 */
+constexpr double kD1 = -12715105075.0 / 11282082432.0;
+constexpr double kD3 = 87487479700.0 / 32700410799.0;
+constexpr double kD4 = -10690763975.0 / 1880347072.0;
+constexpr double kD5 = 701980252875.0 / 199316789632.0;
+constexpr double kD6 = -1453857185.0 / 822651844.0;
+constexpr double kD7 = 69997945.0 / 29380423.0;
+
+/* 刻みの伸縮の安全係数と、1 回で伸縮する倍率の範囲です。 */
+constexpr double kSafety = 0.9;
+constexpr double kMinScale = 0.2;
+constexpr double kMaxScale = 5.0;
+
+/*
+  採用時の刻みの伸縮は、直前の誤差も使う PI 制御です（dopri5 と同じ指数）。
+  安定性で刻みが抑えられる区間で、伸ばしすぎてはやり直す振動を防ぎます。
+*/
+constexpr double kErrorExponent = 0.2 - 0.75 * 0.04;
+constexpr double kPreviousErrorExponent = 0.04;
+constexpr double kMinPreviousError = 1e-4;
+
+/* これより短い刻みは誤差によらず採用します（工程の長さに対する比）。 */
+constexpr double kMinStepRatio = 1e-12;
+
+/* 閾値の通過時刻を二分法で求める回数です。 */
+constexpr int kEventIterations = 60;
+
+} /* namespace */
+
+/*
+ * @brief 設定と誤差制御の設定を保持し、工程構成を作ります。
+ *
+ * @param config 実行設定（モデルと工程時間を使用）
+ * @param options 許容誤差と刻みの設定
+ */
+AdaptiveSimulator::AdaptiveSimulator(SimulationConfig config,
+                                     const AdaptiveOptions& options)
+    : config_(config), options_(options), model_(make_model(config.model)) {
+  stages_[0] = Stage{ProcessState::STEAMING, config_.steaming_seconds};
+  stages_[1] = Stage{ProcessState::ROLLING, config_.rolling_seconds};
+  stages_[2] = Stage{ProcessState::DRYING, config_.drying_seconds};
+  stage_remaining_ms_ =
+      stages_.front().duration_seconds * kMillisecondsPerSecond;
+}
+
+/*
+ * @brief 初期状態を設定します（定義域へ正規化します）。
+ *
+ * @param leaf 初期状態
+ */
+void AdaptiveSimulator::set_initial_leaf(const TeaLeaf& leaf) {
+  leaf_ = leaf;
+  normalize(leaf_);
+  stage_started_ = false;
+}
+
+/*
+ * @brief 1 ステップ進め、csv があれば 1 行書き出します。
+ *
+ * @param sample_seconds 出力の間隔 [s]
+ * @param csv 出力先（nullptr なら書き出しません）
+ * @return 進めたら true、完了済みなら false
+ */
+bool AdaptiveSimulator::step(double sample_seconds,
+                             ::tea_io::CsvWriter* csv) {
+  if (csv != nullptr) {
+    CsvTraceRecorder recorder(*csv);
+    return step(sample_seconds, recorder);
+  }
+  NullTraceRecorder recorder;
+  return step(sample_seconds, recorder);
+}
+
+/*
+ * @brief 出力時刻を min(sample_seconds, 工程の残り) だけ進めます。
+ *
+ * 工程の切り替えと最後の刻み幅の調整は Simulator::advance と同じです
+ * （出力時刻もミリ秒で数えます）。
+ *
+ * @param sample_seconds 出力の間隔 [s]
+ * @return 進めたら true、完了済みなら false
+ */
+bool AdaptiveSimulator::advance(double sample_seconds) {
+  const std::int64_t sample_ms = to_milliseconds(sample_seconds);
+  if (sample_ms <= 0 || stage_index_ >= stages_.size()) {
+    return false;
+  }
+  if (stage_remaining_ms_ <= 0) {
+    ++stage_index_;
+    if (stage_index_ >= stages_.size()) {
+      ::tea_perf::trace_instant(to_string(ProcessState::FINISHED), "stage",
+                                "elapsed_ms", elapsed_ms_);
+      return false;
+    }
+    stage_remaining_ms_ =
+        stages_[stage_index_].duration_seconds * kMillisecondsPerSecond;
+    stage_started_ = false;
+    ::tea_perf::trace_instant(to_string(stages_[stage_index_].state), "stage",
+                              "elapsed_ms", elapsed_ms_);
+  }
+  if (!stage_started_) {
+    begin_stage();
+  }
+
+  const Stage& stage = stages_[stage_index_];
+  const std::int64_t step = std::min(sample_ms, stage_remaining_ms_);
+  const double target = to_seconds(
+      stage.duration_seconds * kMillisecondsPerSecond - stage_remaining_ms_ +
+      step);
+  {
+    TEA_STATS_TIMER(PHYSICS);
+    integrate_to(target);
+    leaf_ = sample(target);
+  }
+  elapsed_ms_ += step;
+  stage_remaining_ms_ -= step;
+  return true;
+}
+
+/*
+ * @brief 現在の茶葉状態から工程内の積分を始めます。
+ */
+void AdaptiveSimulator::begin_stage() {
+  y_[kMoisture] = leaf_.moisture;
+  y_[kTemperature] = leaf_.temperature_c;
+  y_[kAroma] = leaf_.aroma;
+  y_[kColor] = leaf_.color;
+  t_ = 0.0;
+  overheated_ = y_[kTemperature] > model_.drying.overheat_c;
+  f_ = rate(y_);
+  h_ = options_.initial_step_seconds > 0.0 ? options_.initial_step_seconds
+                                           : 1.0;
+  last_t_ = 0.0;
+  last_h_ = 0.0;
+  last_error_ = kMinPreviousError;
+  stage_started_ = true;
+}
+
+/*
+ * @brief 現在工程の時間微分を返します。
+ *
+ * @param y 状態
+ * @return 1 秒あたりの変化率
+ */
+AdaptiveSimulator::State AdaptiveSimulator::rate(const State& y) {
+  ++stats_.rhs_evaluations;
+  TeaLeaf leaf;
+  leaf.moisture = y[kMoisture];
+  leaf.temperature_c = y[kTemperature];
+  leaf.aroma = y[kAroma];
+  leaf.color = y[kColor];
+
+  TeaLeaf d;
+  switch (stages_[stage_index_].state) {
+    case ProcessState::STEAMING:
+      d = steaming_rate(model_.steaming, leaf);
+      break;
+    case ProcessState::ROLLING:
+      d = rolling_rate(model_.rolling, leaf);
+      break;
+    case ProcessState::DRYING:
+      d = drying_rate(model_.drying, leaf, overheated_);
+      break;
+    case ProcessState::FINISHED:
+      d = TeaLeaf{0.0, 0.0, 0.0, 0.0};
+      break;
+  }
+  return State{d.moisture, d.temperature_c, d.aroma, d.color};
+}
+
+/*
+ * @brief 工程内の時刻 t を含む刻みまで積分を進めます。
+ *
+ * @param t 工程の開始からの時刻 [s]
+ */
+void AdaptiveSimulator::integrate_to(double t) {
+  while (t_ < t) {
+    take_step();
+  }
+}
+
+/*
+ * @brief 誤差が許容範囲に収まる刻みを 1 つ採用します。
+ *
+ * 刻みは工程の終わりで止めます。乾燥工程の香気の式は刻みの中では
+ * 切り替えず（overheated_ で固定）、温度が過熱閾値を横切る刻みは密出力から
+ * 求めた通過時刻まで縮めてやり直し、その刻みを採用した時点で式を切り替えます
+ * （縮めた刻みが誤差でやり直しになれば、切り替えずに通過を調べ直します）。
+ * 温度の式は香気によらないため、通過時刻は密出力で正確に求まります。
+ */
+void AdaptiveSimulator::take_step() {
+  const Stage& stage = stages_[stage_index_];
+  const double end = static_cast<double>(stage.duration_seconds);
+  const double min_step = std::max(end, 1.0) * kMinStepRatio;
+  const double overheat = model_.drying.overheat_c;
+  const bool watch_overheat = stage.state == ProcessState::DRYING;
+
+  double h = h_;
+  if (options_.max_step_seconds > 0.0) {
+    h = std::min(h, options_.max_step_seconds);
+  }
+  bool event_limited = false;
+  const State& k1 = f_;
+  State k2, k3, k4, k5, k6, k7, tmp, y1;
+  while (true) {
+    bool to_end = false;
+    if (h >= end - t_) {
+      h = end - t_;
+      to_end = true;
+    }
+
+    for (std::size_t i = 0; i < tmp.size(); ++i) {
+      tmp[i] = y_[i] + h * kA21 * k1[i];
+    }
+    k2 = rate(tmp);
+    for (std::size_t i = 0; i < tmp.size(); ++i) {
+      tmp[i] = y_[i] + h * (kA31 * k1[i] + kA32 * k2[i]);
+    }
+    k3 = rate(tmp);
+    for (std::size_t i = 0; i < tmp.size(); ++i) {
+      tmp[i] = y_[i] + h * (kA41 * k1[i] + kA42 * k2[i] + kA43 * k3[i]);
+    }
+    k4 = rate(tmp);
+    for (std::size_t i = 0; i < tmp.size(); ++i) {
+      tmp[i] = y_[i] + h * (kA51 * k1[i] + kA52 * k2[i] + kA53 * k3[i] +
+                            kA54 * k4[i]);
+    }
+    k5 = rate(tmp);
+    for (std::size_t i = 0; i < tmp.size(); ++i) {
+      tmp[i] = y_[i] + h * (kA61 * k1[i] + kA62 * k2[i] + kA63 * k3[i] +
+                            kA64 * k4[i] + kA65 * k5[i]);
+    }
+    k6 = rate(tmp);
+    for (std::size_t i = 0; i < y1.size(); ++i) {
+      y1[i] = y_[i] + h * (kA71 * k1[i] + kA73 * k3[i] + kA74 * k4[i] +
+                           kA75 * k5[i] + kA76 * k6[i]);
+    }
+    k7 = rate(y1);
+
+    double err = 0.0;
+    for (std::size_t i = 0; i < y1.size(); ++i) {
+      const double e = h * (kE1 * k1[i] + kE3 * k3[i] + kE4 * k4[i] +
+                            kE5 * k5[i] + kE6 * k6[i] + kE7 * k7[i]);
+      const double scale =
+          options_.atol +
+          options_.rtol * std::max(std::fabs(y_[i]), std::fabs(y1[i]));
+      err += (e / scale) * (e / scale);
+    }
+    err = std::sqrt(err / static_cast<double>(y1.size()));
+
+    if (err > 1.0 && h > min_step) {
+      ++stats_.rejected_steps;
+      h *= std::max(kMinScale, kSafety * std::pow(err, -0.2));
+      /*
+        閾値まで縮めた刻みが誤差でやり直しになった場合、縮めた刻みは
+        閾値に届かないので、式を切り替えずに通過をもう一度調べます。
+      */
+      event_limited = false;
+      continue;
+    }
+
+    /* 密出力の係数です（y(θ) は dense_ の多項式で θ ∈ [0, 1]）。 */
+    for (std::size_t i = 0; i < y1.size(); ++i) {
+      const double diff = y1[i] - y_[i];
+      const double bspl = h * k1[i] - diff;
+      dense_[0][i] = y_[i];
+      dense_[1][i] = diff;
+      dense_[2][i] = bspl;
+      dense_[3][i] = diff - h * k7[i] - bspl;
+      dense_[4][i] = h * (kD1 * k1[i] + kD3 * k3[i] + kD4 * k4[i] +
+                          kD5 * k5[i] + kD6 * k6[i] + kD7 * k7[i]);
+    }
+
+    const bool hot0 = overheated_;
+    const bool hot1 = y1[kTemperature] > overheat;
+    if (watch_overheat && !event_limited && hot0 != hot1 && h > min_step) {
+      /* 刻み内で閾値を横切るので、通過直後の θ を二分法で求めて刻みを縮めます。 */
+      double lo = 0.0;
+      double hi = 1.0;
+      for (int it = 0; it < kEventIterations; ++it) {
+        const double mid = 0.5 * (lo + hi);
+        const double s = 1.0 - mid;
+        const std::size_t j = kTemperature;
+        const double temp =
+            dense_[0][j] +
+            mid * (dense_[1][j] +
+                   s * (dense_[2][j] +
+                        mid * (dense_[3][j] + s * dense_[4][j])));
+        if ((temp > overheat) == hot0) {
+          lo = mid;
+        } else {
+          hi = mid;
+        }
+      }
+      ++stats_.events;
+      event_limited = true;
+      h *= hi;
+      continue;
+    }
+
+    ++stats_.accepted_steps;
+    /* 閾値まで縮めた刻みを採用したら、そこから香気の式を切り替えます。 */
+    const bool switch_branch = watch_overheat && (event_limited || hot0 != hot1);
+    last_t_ = t_;
+    last_h_ = h;
+    t_ = to_end ? end : t_ + h;
+    y_ = y1;
+
+    /* 定義域外へ出た成分は戻し、戻した場合は次の 1 段目を計算し直します。 */
+    TeaLeaf projected{y_[kMoisture], y_[kTemperature], y_[kAroma], y_[kColor]};
+    normalize(projected);
+    const State clamped{projected.moisture, projected.temperature_c,
+                        projected.aroma, projected.color};
+    if (switch_branch) {
+      overheated_ = !overheated_;
+    }
+    if (clamped != y_ || switch_branch) {
+      y_ = clamped;
+      f_ = rate(y_);
+    } else {
+      f_ = k7;
+    }
+
+    const double scale =
+        err > 0.0 ? kSafety * std::pow(err, -kErrorExponent) *
+                        std::pow(last_error_, kPreviousErrorExponent)
+                  : kMaxScale;
+    last_error_ = std::max(err, kMinPreviousError);
+    if (!to_end && !event_limited) {
+      h_ = h * std::min(kMaxScale, std::max(kMinScale, scale));
+    } else {
+      /* 工程の終わりや閾値で切り詰めた刻みは、次の刻みを縮める理由にしません。 */
+      h_ = std::max(h_, h * std::min(kMaxScale, std::max(kMinScale, scale)));
+    }
+    return;
+  }
+}
+
+/*
+ * @brief 工程内の時刻 t の状態を返します（直前の刻みの密出力で補間します）。
+ *
+ * @param t 工程の開始からの時刻 [s]（直前の刻みの範囲内）
+ * @return 定義域へ正規化した茶葉状態
+ */
+TeaLeaf AdaptiveSimulator::sample(double t) const {
+  State y = y_;
+  if (last_h_ > 0.0 && t < t_) {
+    const double theta = (t - last_t_) / last_h_;
+    const double s = 1.0 - theta;
+    for (std::size_t i = 0; i < y.size(); ++i) {
+      y[i] = dense_[0][i] +
+             theta * (dense_[1][i] +
+                      s * (dense_[2][i] +
+                           theta * (dense_[3][i] + s * dense_[4][i])));
+    }
+  }
+  TeaLeaf leaf{y[kMoisture], y[kTemperature], y[kAroma], y[kColor]};
+  normalize(leaf);
+  return leaf;
+}
+
+/*
+ * @brief 現在工程を返します。
+ *
+ * @return 現在工程（完了時は FINISHED）
+ */
+ProcessState AdaptiveSimulator::current_process() const {
+  if (stage_index_ >= stages_.size()) {
+    return ProcessState::FINISHED;
+  }
+  return stages_[stage_index_].state;
+}
+
+/*
+ * @brief 現在の出力時刻の茶葉状態を返します。
+ *
+ * @return 茶葉状態
+ */
+const TeaLeaf& AdaptiveSimulator::leaf() const {
+  return leaf_;
+}
+
+/*
+ * @brief 経過時間（秒）を返します。
+ *
+ * @return 経過時間
+ */
+double AdaptiveSimulator::elapsed_seconds() const {
+  return to_seconds(elapsed_ms_);
+}
+
+/*
+ * @brief 積分の統計を返します。
+ *
+ * @return 統計
+ */
+const AdaptiveStats& AdaptiveSimulator::stats() const {
+  return stats_;
+}
+
+} /* namespace tea */
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "domain/Model.h"
+#include "domain/ProcessState.h"
+#include "domain/TeaLeaf.h"
+#include "domain/TimeStep.h"
+#include "simulation/Simulator.h"
+#include "simulation/TraceRecorder.h"
+
+namespace tea_io {
+class CsvWriter;
+} /* namespace tea_io */
+
+namespace tea {
+
+/* AdaptiveSimulator の誤差制御の設定です。 */
+struct AdaptiveOptions final {
+  double rtol = 1e-6;                /* 相対許容誤差 */
+  double atol = 1e-8;                /* 絶対許容誤差 */
+  double initial_step_seconds = 1.0; /* 各工程の最初に試す刻み [s] */
+  double max_step_seconds = 0.0;     /* 刻みの上限 [s]（0 以下なら工程の長さ） */
+};
+
+/* AdaptiveSimulator の積分の統計です。 */
+struct AdaptiveStats final {
+  std::size_t accepted_steps = 0;  /* 採用した刻みの数 */
+  std::size_t rejected_steps = 0;  /* 誤差超過でやり直した刻みの数 */
+  std::size_t rhs_evaluations = 0; /* 時間微分（右辺）の評価回数 */
+  std::size_t events = 0;          /* 過熱閾値の通過で刻みを区切った回数 */
+};
+
+/*
+  工程の式を連続時間の常微分方程式（StepKernels.h の *_rate）として
+  Dormand-Prince 5(4) の適応刻みで積分するシミュレータです。
+  変化の緩やかな区間では大きく刻み、乾燥工程で温度が過熱閾値を横切る
+  区間（香気の式が切り替わる所）では刻みを閾値ちょうどで区切って、
+  そこで香気の式を切り替えます（刻みの途中で右辺が不連続にならないようにします）。
+  刻みは工程の境界をまたぎません。
+
+  step(sample_seconds) は Simulator と同じ時刻（min(sample_seconds, 工程の残り)
+  ずつ）の状態を密出力（刻み内の 4 次補間）で返すため、出力の間隔は積分の
+  刻みと無関係に選べます。結果は固定刻みの Simulator（前進オイラー）の
+  dt → 0 の極限に対応し、dt 秒刻みの Simulator の出力とは一致しません。
+*/
+class AdaptiveSimulator final {
+ public:
+  explicit AdaptiveSimulator(SimulationConfig config,
+                             const AdaptiveOptions& options = {});
+
+  /* 初期状態の茶葉を設定します。 */
+  void set_initial_leaf(const TeaLeaf& leaf);
+
+  /*
+    全工程を config の出力間隔（dt * sample_substeps）で進め、
+    各時刻の状態を recorder へ渡します。
+  */
+  template <typename Recorder>
+  void run(Recorder& recorder) {
+    const double sample = to_seconds(to_milliseconds(config_.dt_seconds) *
+                                     sample_substeps(config_));
+    while (step(sample, recorder)) {
+    }
+  }
+
+  /* 出力時刻を 1 つ進めます。完了済みなら false を返します。 */
+  bool step(double sample_seconds, ::tea_io::CsvWriter* csv);
+
+  /*
+    出力時刻を 1 つ進め、その時刻の状態を recorder へ渡します。完了済みなら false を返します。
+    recorder は record(ProcessState, double, const TeaLeaf&) を持つ型です（TraceRecorder 参照）。
+  */
+  template <typename Recorder>
+  bool step(double sample_seconds, Recorder& recorder) {
+    if (!advance(sample_seconds)) {
+      return false;
+    }
+    recorder.record(current_process(), elapsed_seconds(), leaf_);
+    return true;
+  }
+
+  /* 現在工程を返します（完了時は FINISHED を返します）。 */
+  ProcessState current_process() const;
+
+  /* 現在の出力時刻の茶葉状態を返します。 */
+  const TeaLeaf& leaf() const;
+
+  /* 経過時間（秒）を返します。 */
+  double elapsed_seconds() const;
+
+  /* 積分の統計を返します。 */
+  const AdaptiveStats& stats() const;
+
+ private:
+  /* 積分する状態（水分, 温度, 香気, 色）です。 */
+  using State = std::array<double, 4>;
+
+  /* 工程種別と継続時間です。 */
+  struct Stage final {
+    ProcessState state = ProcessState::FINISHED;
+    int duration_seconds = 0;
+  };
+
+  bool advance(double sample_seconds);
+  void begin_stage();
+  State rate(const State& y);
+  void integrate_to(double t);
+  void take_step();
+  TeaLeaf sample(double t) const;
+
+  SimulationConfig config_;
+  AdaptiveOptions options_;
+  ModelParams model_;
+  std::array<Stage, 3> stages_;
+
+  TeaLeaf leaf_;
+  std::int64_t elapsed_ms_ = 0;
+  std::size_t stage_index_ = 0;
+  std::int64_t stage_remaining_ms_ = 0;
+  bool stage_started_ = false;
+
+  /* 積分器の状態です（時刻は工程の開始からの秒数）。 */
+  double t_ = 0.0;       /* 積分済みの時刻 */
+  State y_{};            /* t_ での状態 */
+  State f_{};            /* t_ での時間微分（次の刻みの 1 段目に使い回します） */
+  double h_ = 0.0;       /* 次に試す刻み */
+  double last_t_ = 0.0;  /* 直前の刻みの開始時刻 */
+  double last_h_ = 0.0;  /* 直前の刻みの幅（0 なら未積分） */
+  std::array<State, 5> dense_{}; /* 直前の刻みの密出力の係数 */
+  double last_error_ = 0.0;      /* 直前に採用した刻みの誤差（PI 制御用） */
+  bool overheated_ = false;      /* 乾燥の香気を劣化側の式で積分しているか */
+
+  AdaptiveStats stats_;
+};
+
+} /* namespace tea */
@@ -0,0 +1,420 @@
+/*
+ * @file Calibration.cpp
+ * @brief 計測トレースに対するモデル係数の最小二乗較正
+ *
+ * トレースごとの残差と、その係数に対する微分（双対数による前進モードの
+ * 自動微分）を並列に求めて畳み込み、Levenberg-Marquardt 法で係数を更新します。
+ */
+
+#include "simulation/Calibration.h"
+
+#include <algorithm> // For std::max, std::min
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <utility> // For std::move
+
+#include "domain/TimeStep.h"
+#include "io/TraceReader.h"
+#include "process/StepKernels.h"
+
+namespace tea {
+
+namespace {
+
+constexpr std::size_t kParams = static_cast<std::size_t>(kModelParamCount);
+
+/* 減衰係数の初期値と上限です（上限を超えたら改善できないものとして止めます）。 */
+constexpr double kInitialLambda = 1e-3;
+constexpr double kMaxLambda = 1e12;
+
+/*
+ * @brief 全トレースの損失と、その勾配・近似ヘッセ行列の和です。
+ *
+ * 勾配は J^T r、近似ヘッセ行列は J^T J（J は残差の係数に対するヤコビ行列）で、
+ * 損失だけを求める評価（T=double）では使いません。近似ヘッセ行列は対称なので、
+ * 上三角（i <= j）だけを足し込みます。
+ */
+struct LossSum final {
+  double loss = 0.0;
+  std::size_t residuals = 0;
+  std::size_t traces = 0;
+  std::array<double, kParams> gradient{};
+  std::array<std::array<double, kParams>, kParams> hessian{};
+
+  /* 別スレッドの部分和を足し込みます。 */
+  void add(const LossSum& o) {
+    loss += o.loss;
+    residuals += o.residuals;
+    traces += o.traces;
+    for (std::size_t i = 0; i < kParams; ++i) {
+      gradient[i] += o.gradient[i];
+      for (std::size_t j = 0; j < kParams; ++j) {
+        hessian[i][j] += o.hessian[i][j];
+      }
+    }
+  }
+};
+
+/*
+ * @brief 残差 1 つを損失へ足し込みます（損失だけ）。
+ */
+void add_residual(double r, LossSum& sum) {
+  sum.loss += r * r;
+  ++sum.residuals;
+}
+
+/*
+ * @brief 残差 1 つを損失・勾配・近似ヘッセ行列へ足し込みます。
+ */
+void add_residual(const ParamDual& r, LossSum& sum) {
+  sum.loss += r.v * r.v;
+  ++sum.residuals;
+  for (std::size_t i = 0; i < kParams; ++i) {
+    if (r.d[i] == 0.0) {
+      continue;
+    }
+    sum.gradient[i] += r.v * r.d[i];
+    for (std::size_t j = i; j < kParams; ++j) {
+      sum.hessian[i][j] += r.d[i] * r.d[j];
+    }
+  }
+}
+
+/*
+ * @brief 1 本のトレースをモデルで再現し、各行の残差を sum へ足し込みます。
+ *
+ * 先頭行の状態から始め、各工程の最後の行の時刻を工程の終わりとして、
+ * min(dt, 工程の残り, 次の行までの残り) ずつ進めます。シミュレーションの出力を
+ * そのまま読んだ場合は、Simulator と同じ刻みになります。
+ *
+ * @param p 工程別パラメータ（T: double または ParamDual）
+ * @param trace 計測トレース
+ * @param dt_ms 時間刻み [ms]
+ * @param options 残差の尺度
+ * @param sum 足し込み先
+ */
+template <typename T>
+void accumulate_trace(const ModelParamsT<T>& p,
+                      const tea_io::MeasuredTrace& trace,
+                      std::int64_t dt_ms,
+                      const CalibrationOptions& options,
+                      LossSum& sum) {
+  const std::vector<tea_io::MeasuredRow>& rows = trace.rows;
+  if (rows.size() < 2) {
+    return;
+  }
+  ++sum.traces;
+
+  /* 各工程の終わりの時刻です（行の無い工程は長さ 0）。 */
+  std::array<std::int64_t, 3> stage_end{};
+  for (const tea_io::MeasuredRow& row : rows) {
+    const std::size_t s = static_cast<std::size_t>(row.process);
+    stage_end[s] = std::max(stage_end[s], row.elapsed_ms);
+  }
+  for (std::size_t s = 1; s < stage_end.size(); ++s) {
+    stage_end[s] = std::max(stage_end[s], stage_end[s - 1]);
+  }
+
+  TeaLeafT<T> leaf;
+  leaf.moisture = T(rows.front().moisture);
+  leaf.temperature_c = T(rows.front().temperature_c);
+  leaf.aroma = T(rows.front().aroma);
+  leaf.color = T(rows.front().color);
+  normalize(leaf);
+  std::int64_t t = rows.front().elapsed_ms;
+
+  for (std::size_t k = 1; k < rows.size(); ++k) {
+    const tea_io::MeasuredRow& row = rows[k];
+    while (t < row.elapsed_ms) {
+      std::size_t s = 0;
+      while (s < stage_end.size() && stage_end[s] <= t) {
+        ++s;
+      }
+      if (s == stage_end.size()) {
+        break;
+      }
+      const std::int64_t h_ms =
+          std::min({dt_ms, stage_end[s] - t, row.elapsed_ms - t});
+      const T h(to_seconds(h_ms));
+      if (s == 0) {
+        steaming_step(p.steaming, leaf, h);
+      } else if (s == 1) {
+        rolling_step(p.rolling, leaf, h);
+      } else {
+        drying_step(p.drying, leaf, h);
+      }
+      t += h_ms;
+    }
+
+    if (options.moisture_scale > 0.0) {
+      add_residual((leaf.moisture - T(row.moisture)) /
+                       T(options.moisture_scale), sum);
+    }
+    if (options.temperature_scale > 0.0) {
+      add_residual((leaf.temperature_c - T(row.temperature_c)) /
+                       T(options.temperature_scale), sum);
+    }
+    if (options.aroma_scale > 0.0) {
+      add_residual((leaf.aroma - T(row.aroma)) / T(options.aroma_scale), sum);
+    }
+    if (options.color_scale > 0.0) {
+      add_residual((leaf.color - T(row.color)) / T(options.color_scale), sum);
+    }
+  }
+}
+
+/*
+ * @brief トレースの塊をスレッドで並列に評価し、sum へ足し込みます。
+ */
+template <typename T>
+void accumulate_chunk(const ModelParamsT<T>& p,
+                      const std::vector<tea_io::MeasuredTrace>& chunk,
+                      std::int64_t dt_ms,
+                      const CalibrationOptions& options,
+                      int thread_count,
+                      LossSum& sum) {
+  const int workers =
+      std::max(1, std::min(thread_count, static_cast<int>(chunk.size())));
+  std::vector<LossSum> partials(static_cast<std::size_t>(workers));
+  std::atomic<std::size_t> next{0};
+  auto worker = [&](LossSum& out) {
+    while (true) {
+      const std::size_t i = next.fetch_add(1);
+      if (i >= chunk.size()) {
+        return;
+      }
+      accumulate_trace(p, chunk[i], dt_ms, options, out);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(static_cast<std::size_t>(workers - 1));
+  for (int t = 1; t < workers; ++t) {
+    pool.emplace_back(worker, std::ref(partials[static_cast<std::size_t>(t)]));
+  }
+  worker(partials.front());
+  for (std::thread& th : pool) {
+    th.join();
+  }
+  for (const LossSum& partial : partials) {
+    sum.add(partial);
+  }
+}
+
+/*
+ * @brief 全ファイルを chunk_traces 本ずつ読みながら評価します。
+ *
+ * @param paths 計測トレースのファイル
+ * @param p 工程別パラメータ（T: double なら損失だけ、ParamDual なら勾配も）
+ * @param options 較正の設定
+ * @param thread_count スレッド数
+ * @param sum 結果の格納先
+ * @param error 読み込みに失敗した理由の格納先
+ * @return 成功なら true
+ */
+template <typename T>
+bool stream_loss(const std::vector<std::string>& paths,
+                 const ModelParamsT<T>& p,
+                 const CalibrationOptions& options,
+                 int thread_count,
+                 LossSum& sum,
+                 std::string& error) {
+  const std::int64_t dt_ms = to_milliseconds(options.dt_seconds);
+  const std::size_t chunk_size = std::max<std::size_t>(1, options.chunk_traces);
+  sum = LossSum();
+
+  tea_io::TraceReader reader(paths);
+  std::vector<tea_io::MeasuredTrace> chunk;
+  chunk.reserve(chunk_size);
+  tea_io::MeasuredTrace trace;
+  while (reader.next(trace)) {
+    chunk.push_back(std::move(trace));
+    if (chunk.size() == chunk_size) {
+      accumulate_chunk(p, chunk, dt_ms, options, thread_count, sum);
+      chunk.clear();
+    }
+  }
+  if (!reader.error().empty()) {
+    error = reader.error();
+    return false;
+  }
+  if (!chunk.empty()) {
+    accumulate_chunk(p, chunk, dt_ms, options, thread_count, sum);
+  }
+  return true;
+}
+
+/*
+ * @brief 対称な連立一次方程式 a x = b を部分ピボット付きの消去法で解きます。
+ *
+ * @return 解けたら true（特異なら false）
+ */
+bool solve(std::vector<std::vector<double>> a,
+           std::vector<double> b,
+           std::vector<double>& x) {
+  const std::size_t n = b.size();
+  for (std::size_t c = 0; c < n; ++c) {
+    std::size_t pivot = c;
+    for (std::size_t r = c + 1; r < n; ++r) {
+      if (std::fabs(a[r][c]) > std::fabs(a[pivot][c])) {
+        pivot = r;
+      }
+    }
+    if (a[pivot][c] == 0.0 || !std::isfinite(a[pivot][c])) {
+      return false;
+    }
+    std::swap(a[c], a[pivot]);
+    std::swap(b[c], b[pivot]);
+    for (std::size_t r = c + 1; r < n; ++r) {
+      const double f = a[r][c] / a[c][c];
+      for (std::size_t k = c; k < n; ++k) {
+        a[r][k] -= f * a[c][k];
+      }
+      b[r] -= f * b[c];
+    }
+  }
+  x.assign(n, 0.0);
+  for (std::size_t c = n; c-- > 0;) {
+    double v = b[c];
+    for (std::size_t k = c + 1; k < n; ++k) {
+      v -= a[c][k] * x[k];
+    }
+    x[c] = v / a[c][c];
+  }
+  return true;
+}
+
+} /* namespace */
+
+/*
+ * @brief 計測トレースに合うようモデルの係数を較正します。
+ *
+ * 減衰付きの正規方程式 (J^T J + λ diag(J^T J)) δ = -J^T r を解き、損失が減れば
+ * 採用して λ を小さく、減らなければ λ を大きくしてやり直します。
+ * 係数の符号が変わるステップは採用しません。
+ *
+ * @param paths 計測トレースのファイル
+ * @param start 較正の起点とする工程別パラメータ
+ * @param options 較正の設定
+ * @param on_progress 採用したステップごとに呼ばれます（空なら呼びません）
+ * @return 較正の結果
+ */
+CalibrationResult calibrate(
+    const std::vector<std::string>& paths,
+    const ModelParams& start,
+    const CalibrationOptions& options,
+    const std::function<void(const CalibrationProgress&)>& on_progress) {
+  CalibrationResult result;
+  result.params = start;
+  if (to_milliseconds(options.dt_seconds) <= 0) {
+    result.error = "time step must be at least 1 ms";
+    return result;
+  }
+
+  int thread_count = options.threads;
+  if (thread_count <= 0) {
+    thread_count = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  thread_count = std::max(1, thread_count);
+
+  LossSum current;
+  if (!stream_loss(paths, make_dual_params(result.params), options,
+                   thread_count, current, result.error)) {
+    return result;
+  }
+  ++result.passes;
+  result.initial_loss = current.loss;
+  result.loss = current.loss;
+  result.traces = current.traces;
+  result.residuals = current.residuals;
+
+  /* 損失が依存する係数だけを動かします（対角が 0 の係数は識別できません）。 */
+  double max_diag = 0.0;
+  for (std::size_t i = 0; i < kParams; ++i) {
+    max_diag = std::max(max_diag, current.hessian[i][i]);
+  }
+  std::vector<std::size_t> active;
+  for (std::size_t i = 0; i < kParams; ++i) {
+    if (current.hessian[i][i] > max_diag * 1e-20 &&
+        current.hessian[i][i] > 0.0) {
+      active.push_back(i);
+      result.fitted[i] = true;
+    }
+  }
+  if (active.empty() || current.loss == 0.0) {
+    result.converged = true;
+    return result;
+  }
+
+  double lambda = kInitialLambda;
+  while (result.iterations < options.max_iterations) {
+    const std::size_t n = active.size();
+    std::vector<std::vector<double>> a(n, std::vector<double>(n, 0.0));
+    std::vector<double> b(n, 0.0);
+    for (std::size_t r = 0; r < n; ++r) {
+      for (std::size_t c = 0; c < n; ++c) {
+        const std::size_t i = std::min(active[r], active[c]);
+        const std::size_t j = std::max(active[r], active[c]);
+        a[r][c] = current.hessian[i][j];
+      }
+      a[r][r] += lambda * current.hessian[active[r]][active[r]];
+      b[r] = -current.gradient[active[r]];
+    }
+
+    std::vector<double> step;
+    bool valid = solve(a, b, step);
+    ModelParams trial = result.params;
+    for (std::size_t r = 0; valid && r < n; ++r) {
+      const int i = static_cast<int>(active[r]);
+      const double value = model_param_value(result.params, i);
+      const double next = value + step[r];
+      valid = std::isfinite(next) && (value > 0.0) == (next > 0.0) &&
+              next != 0.0;
+      set_model_param_value(trial, i, next);
+    }
+
+    LossSum trial_sum;
+    if (valid) {
+      if (!stream_loss(paths, trial, options, thread_count, trial_sum,
+                       result.error)) {
+        return result;
+      }
+      ++result.passes;
+    }
+    if (!valid || !(trial_sum.loss < current.loss)) {
+      lambda *= 4.0;
+      if (lambda > kMaxLambda) {
+        result.converged = true;
+        break;
+      }
+      continue;
+    }
+
+    const double decrease = (current.loss - trial_sum.loss) / current.loss;
+    result.params = trial;
+    ++result.iterations;
+    lambda = std::max(lambda / 3.0, 1e-12);
+    if (!stream_loss(paths, make_dual_params(result.params), options,
+                     thread_count, current, result.error)) {
+      return result;
+    }
+    ++result.passes;
+    result.loss = current.loss;
+    if (on_progress) {
+      CalibrationProgress progress;
+      progress.iteration = result.iterations;
+      progress.loss = current.loss;
+      progress.lambda = lambda;
+      on_progress(progress);
+    }
+    if (decrease < options.tolerance || current.loss == 0.0) {
+      result.converged = true;
+      break;
+    }
+  }
+  return result;
+}
+
+} /* namespace tea */
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "domain/Model.h"
+#include "simulation/Sensitivity.h"
+
+namespace tea {
+
+/* 較正（calibrate）の設定です。 */
+struct CalibrationOptions final {
+  double dt_seconds = 1.0; /* モデルを進める時間刻み [s]（1 ms 単位） */
+
+  /*
+    残差の尺度です（誤差 / 尺度 の二乗和を最小化します。0 以下ならその量は使いません）。
+    既定は水分 0.01（1 ポイント）と温度 1 °C を同じ重みで扱い、香気と色は使いません。
+  */
+  double moisture_scale = 0.01;
+  double temperature_scale = 1.0;
+  double aroma_scale = 0.0;
+  double color_scale = 0.0;
+
+  int max_iterations = 50;   /* 採用するステップ数の上限 */
+  double tolerance = 1e-10;  /* 損失の相対減少がこれ未満になったら収束とします */
+  std::size_t chunk_traces = 256; /* 同時に保持して並列評価するトレース数 */
+  int threads = 0;           /* 並列評価のスレッド数（0 以下ならハードウェアスレッド数） */
+};
+
+/* 較正の 1 反復ごとの経過です。 */
+struct CalibrationProgress final {
+  int iteration = 0;   /* 採用したステップ数 */
+  double loss = 0.0;   /* 現在の損失（残差の二乗和） */
+  double lambda = 0.0; /* Levenberg-Marquardt の減衰係数 */
+};
+
+/* 較正の結果です。 */
+struct CalibrationResult final {
+  ModelParams params;              /* 較正後のパラメータ */
+  double initial_loss = 0.0;       /* 開始時の損失 */
+  double loss = 0.0;               /* 較正後の損失 */
+  int iterations = 0;              /* 採用したステップ数 */
+  std::size_t passes = 0;          /* 全トレースを読み直した回数 */
+  std::size_t traces = 0;          /* トレース数 */
+  std::size_t residuals = 0;       /* 残差の数（行数 × 使った量の数） */
+  bool converged = false;          /* 損失の減少が tolerance 未満で止まったか */
+  std::array<bool, kModelParamCount> fitted{}; /* 較正したパラメータ（損失が依存するもの） */
+  std::string error;               /* 読み込みに失敗した理由（成功なら空） */
+};
+
+/*
+  計測トレース（CsvWriter と同じ列構成の CSV、paths の各ファイル）に合うよう、
+  start を起点にモデルの係数を最小二乗で較正します。
+
+  各トレースは先頭行の状態から始め、工程の境界（各工程の最後の行の時刻）と
+  以降の行の時刻で刻みを区切りながら dt 秒刻みで進めて、各行の計測値との
+  残差を求めます。残差の係数に対する微分は、更新式（StepKernels.h）を
+  双対数で評価して 1 回の実行で求め、Gauss-Newton 近似の Levenberg-Marquardt 法で
+  ステップを決めます（損失が依存しない係数は動かしません）。
+
+  トレースはファイルから chunk_traces 本ずつ読み、スレッドで並列に評価して
+  損失・勾配・近似ヘッセ行列（係数の数の二乗）へ畳み込むため、保持する
+  メモリはトレースの総数によりません。反復ごとにファイルを読み直します。
+*/
+CalibrationResult calibrate(
+    const std::vector<std::string>& paths,
+    const ModelParams& start,
+    const CalibrationOptions& options = {},
+    const std::function<void(const CalibrationProgress&)>& on_progress = {});
+
+} /* namespace tea */
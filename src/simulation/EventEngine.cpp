@@ -0,0 +1,507 @@
+/*
+ * @file EventEngine.cpp
+ * @brief 次のイベントの時刻へ閉じた式で跳ぶイベント駆動のシミュレーション
+ *
+ * 工程内の dt ステップを成分ごとの 1 次式として扱い、n ステップ後の状態と
+ * 閾値をまたぐステップ数を解析的に求めます。ステップごとの出力が不要な
+ * 場合は、イベントの直前まで 1 回で跳び、イベントのステップだけを
+ * 更新式（StepKernels.h）で進めます。
+ */
+
+#include "simulation/EventEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "io/CsvWriter.h"
+#include "process/StepKernels.h"
+
+namespace tea {
+
+namespace {
+
+/* イベントが起きないことを表すステップ数です。 */
+constexpr std::int64_t kNever = std::numeric_limits<std::int64_t>::max();
+
+/* 1 ステップの更新 x' = a x + b です。 */
+struct Affine final {
+  double a = 1.0;
+  double b = 0.0;
+};
+
+/*
+  工程の 1 ステップ（dt 秒）を成分ごとの 1 次式で表したものです。
+  乾燥工程の香気は温度が過熱閾値のどちら側にあるかで式が変わり、
+  劣化側では香気の減少量が更新後の温度で決まります（aroma_damaged 参照）。
+*/
+struct StageLinearization final {
+  Affine moisture;
+  Affine temperature;
+  Affine aroma;
+  Affine color;
+  bool aroma_damaged = false;   /* 香気を劣化側の式で更新するか */
+  double aroma_damage_per_c = 0.0; /* 劣化側で 1°C あたりに減る香気（damage_k * dt） */
+  double overheat_c = 0.0;
+};
+
+/*
+ * @brief 上限 100 へ近づく飽和型の更新 x + g dt (1 - x / 100) を 1 次式にします。
+ */
+Affine saturating(double gain_per_s, double dt) {
+  return Affine{1.0 - gain_per_s * dt / 100.0, gain_per_s * dt};
+}
+
+/*
+ * @brief 目標温度へ近づく更新 T + (target - T) k dt を 1 次式にします。
+ */
+Affine relaxing(double target, double k, double dt) {
+  return Affine{1.0 - k * dt, target * k * dt};
+}
+
+/*
+ * @brief 工程の 1 ステップを 1 次式にします。
+ *
+ * @param process 工程種別（FINISHED 以外）
+ * @param model 工程別パラメータ
+ * @param dt 刻み [s]
+ * @param overheated 乾燥工程で香気を劣化側の式で更新するか
+ * @return 成分ごとの 1 次式
+ */
+StageLinearization linearize(ProcessState process,
+                             const ModelParams& model,
+                             double dt,
+                             bool overheated) {
+  StageLinearization lin;
+  lin.overheat_c = model.drying.overheat_c;
+  switch (process) {
+    case ProcessState::STEAMING: {
+      const SteamingParams& p = model.steaming;
+      lin.temperature = relaxing(p.target_temp_c, p.heat_k, dt);
+      lin.moisture = Affine{1.0, p.moisture_gain_per_s * dt};
+      lin.aroma = saturating(p.aroma_gain_per_s, dt);
+      lin.color = saturating(p.color_gain_per_s, dt);
+      break;
+    }
+    case ProcessState::ROLLING: {
+      const RollingParams& p = model.rolling;
+      lin.temperature = relaxing(p.target_temp_c, p.cool_k, dt);
+      lin.moisture = Affine{1.0 - 0.6 * p.moisture_loss_k * dt,
+                            -0.4 * p.moisture_loss_k * dt};
+      lin.aroma = saturating(p.aroma_gain_per_s, dt);
+      lin.color = saturating(p.color_gain_per_s, dt);
+      break;
+    }
+    case ProcessState::DRYING: {
+      const DryingParams& p = model.drying;
+      lin.temperature = relaxing(p.target_temp_c, p.temp_k, dt);
+      lin.moisture = Affine{drying_decay(p, dt), 0.0};
+      lin.aroma = saturating(p.aroma_recover_per_s, dt);
+      lin.aroma_damaged = overheated;
+      lin.aroma_damage_per_c = p.aroma_damage_k * dt;
+      lin.color = saturating(p.color_gain_per_s, dt);
+      break;
+    }
+    case ProcessState::FINISHED:
+      break;
+  }
+  return lin;
+}
+
+/*
+ * @brief 係数が (0, 1] に入り、各成分が振動せず単調に動くかを返します。
+ *
+ * 単調なら、定義域の端で止まる成分も「1 次式の値を端で切ったもの」になり、
+ * 区間の両端の値で区間内の値を挟めます。
+ */
+bool is_monotone(const StageLinearization& lin) {
+  const Affine* parts[] = {&lin.moisture, &lin.temperature, &lin.aroma,
+                           &lin.color};
+  for (const Affine* f : parts) {
+    if (!(f->a > 0.0 && f->a <= 1.0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * @brief x0 から n ステップ後の値を返します（正規化前）。
+ */
+double affine_power(const Affine& f, double x0, std::int64_t n) {
+  const double steps = static_cast<double>(n);
+  if (f.a == 1.0) {
+    return x0 + steps * f.b;
+  }
+  const double fixed = f.b / (1.0 - f.a);
+  return fixed + std::pow(f.a, steps) * (x0 - fixed);
+}
+
+/*
+ * @brief x > threshold の真偽が初めて変わるステップ数を返します。
+ *
+ * 丸め誤差で前後 1 ステップずれ得るため、呼び出し側は跳んだ後の状態で
+ * 改めて判定します（この値は跳び先の見積もりにだけ使います）。
+ *
+ * @return 1 以上のステップ数（変わらなければ kNever）
+ */
+std::int64_t first_crossing(const Affine& f, double x0, double threshold) {
+  const bool above = x0 > threshold;
+  double steps = 0.0;
+  if (f.a == 1.0) {
+    if (above ? f.b >= 0.0 : f.b <= 0.0) {
+      return kNever;
+    }
+    /* 上側からは x <= threshold、下側からは x > threshold になる最初の n です。 */
+    const double n = (threshold - x0) / f.b;
+    steps = above ? std::ceil(n) : std::floor(n) + 1.0;
+  } else {
+    const double fixed = f.b / (1.0 - f.a);
+    if (above ? fixed >= threshold : fixed <= threshold) {
+      return kNever;
+    }
+    const double n =
+        std::log((threshold - fixed) / (x0 - fixed)) / std::log(f.a);
+    steps = above ? std::ceil(n) : std::floor(n) + 1.0;
+  }
+  if (!(steps < 9.0e18)) {
+    return kNever;
+  }
+  return std::max<std::int64_t>(1, static_cast<std::int64_t>(steps));
+}
+
+/*
+ * @brief leaf から n ステップ後の茶葉状態を閉じた式で返します（正規化済み）。
+ */
+TeaLeaf leaf_after(const StageLinearization& lin, const TeaLeaf& leaf,
+                   std::int64_t n) {
+  TeaLeaf out;
+  out.temperature_c = affine_power(lin.temperature, leaf.temperature_c, n);
+  out.moisture = affine_power(lin.moisture, leaf.moisture, n);
+  out.color = affine_power(lin.color, leaf.color, n);
+  if (lin.aroma_damaged) {
+    /* 香気は更新後の温度 T_i で a_i = a_{i-1} - D dt (T_i - overheat) と減ります。 */
+    const Affine& t = lin.temperature;
+    const double steps = static_cast<double>(n);
+    double excess = 0.0; /* sum_{i=1..n} (T_i - overheat) */
+    if (t.a == 1.0) {
+      excess = steps * (leaf.temperature_c - lin.overheat_c) +
+               t.b * steps * (steps + 1.0) / 2.0;
+    } else {
+      const double fixed = t.b / (1.0 - t.a);
+      excess = steps * (fixed - lin.overheat_c) +
+               (leaf.temperature_c - fixed) * t.a *
+                   (1.0 - std::pow(t.a, steps)) / (1.0 - t.a);
+    }
+    out.aroma = leaf.aroma - lin.aroma_damage_per_c * excess;
+  } else {
+    out.aroma = affine_power(lin.aroma, leaf.aroma, n);
+  }
+  normalize(out);
+  return out;
+}
+
+/*
+ * @brief 品質ステータスの順位を返します（BAD: 0, OK: 1, GOOD: 2）。
+ */
+int status_rank(double score) {
+  const char* status = ::tea_io::CsvWriter::quality_status(score);
+  if (std::strcmp(status, "GOOD") == 0) {
+    return 2;
+  }
+  return std::strcmp(status, "OK") == 0 ? 1 : 0;
+}
+
+/*
+ * @brief [lo, hi] ステップで品質ステータスが rank から変わる最初のステップを返します。
+ *
+ * 単調な成分は区間の両端の値で挟まれるため、スコアの取り得る範囲が
+ * 同じステータスに収まる区間は丸ごと除き、残りを二分します。
+ *
+ * @return 最初に変わるステップ（変わらなければ kNever）
+ */
+std::int64_t first_status_change(const StageLinearization& lin,
+                                 const TeaLeaf& leaf,
+                                 std::int64_t lo,
+                                 std::int64_t hi,
+                                 int rank) {
+  const TeaLeaf a = leaf_after(lin, leaf, lo);
+  const TeaLeaf b = leaf_after(lin, leaf, hi);
+  const double worst = ::tea_io::CsvWriter::quality_score(
+      std::max(a.moisture, b.moisture), std::min(a.aroma, b.aroma),
+      std::min(a.color, b.color));
+  const double best = ::tea_io::CsvWriter::quality_score(
+      std::min(a.moisture, b.moisture), std::max(a.aroma, b.aroma),
+      std::max(a.color, b.color));
+  if (status_rank(worst) == rank && status_rank(best) == rank) {
+    return kNever;
+  }
+  if (lo == hi) {
+    return lo;
+  }
+  const std::int64_t mid = lo + (hi - lo) / 2;
+  const std::int64_t left = first_status_change(lin, leaf, lo, mid, rank);
+  if (left != kNever) {
+    return left;
+  }
+  return first_status_change(lin, leaf, mid + 1, hi, rank);
+}
+
+/*
+ * @brief 工程の更新式で 1 ステップ進めます（Simulator と同じ式です）。
+ */
+void kernel_step(ProcessState process, const ModelParams& model,
+                 TeaLeaf& leaf, double dt) {
+  switch (process) {
+    case ProcessState::STEAMING:
+      steaming_step(model.steaming, leaf, dt);
+      break;
+    case ProcessState::ROLLING:
+      rolling_step(model.rolling, leaf, dt);
+      break;
+    case ProcessState::DRYING:
+      drying_step(model.drying, leaf, dt);
+      break;
+    case ProcessState::FINISHED:
+      break;
+  }
+}
+
+} /* namespace */
+
+/*
+ * @brief イベント種別の表示名を返します。
+ *
+ * @param type イベント種別
+ * @return 表示名
+ */
+const char* to_string(EventType type) {
+  switch (type) {
+    case EventType::STAGE_CHANGED:
+      return "STAGE";
+    case EventType::MOISTURE_CROSSED:
+      return "MOISTURE";
+    case EventType::OVERHEAT:
+      return "OVERHEAT";
+    case EventType::QUALITY_CHANGED:
+      return "QUALITY";
+  }
+  return "UNKNOWN";
+}
+
+/*
+ * @brief 設定と閾値を保持します。
+ *
+ * @param config 実行設定（dt・工程時間・モデルを使用）
+ * @param options 閾値の設定
+ */
+EventEngine::EventEngine(SimulationConfig config, const EventOptions& options)
+    : config_(config), options_(options), model_(make_model(config.model)) {
+  normalize(initial_);
+  leaf_ = initial_;
+}
+
+/*
+ * @brief 初期状態を設定します（定義域へ正規化します）。
+ *
+ * @param leaf 初期状態
+ */
+void EventEngine::set_initial_leaf(const TeaLeaf& leaf) {
+  initial_ = leaf;
+  normalize(initial_);
+  leaf_ = initial_;
+}
+
+/*
+ * @brief イベントを購読します。
+ *
+ * @param type 購読するイベント種別
+ * @param callback 発生時に呼ぶ関数
+ */
+void EventEngine::subscribe(EventType type, Callback callback) {
+  callbacks_.emplace_back(type, std::move(callback));
+}
+
+/*
+ * @brief 全工程を、次のイベントの時刻へ跳びながら実行します。
+ *
+ * 工程内では「工程の残りに収まる dt ステップ数」と「閾値をまたぐまでの
+ * ステップ数（解析解）」「品質ステータスが変わるまでのステップ数（区間の二分）」
+ * の最小値 n を求め、n - 1 ステップを閉じた式で跳んでから n ステップ目を
+ * 更新式で進めます。工程の終わりに dt に満たない端数が残る場合は、
+ * Simulator と同じく残り時間ちょうどの 1 ステップを足します。
+ */
+void EventEngine::run() {
+  begin();
+  const std::int64_t dt_ms = to_milliseconds(config_.dt_seconds);
+  if (dt_ms <= 0) {
+    return;
+  }
+  const double dt = to_seconds(dt_ms);
+  const ProcessState stages[] = {ProcessState::STEAMING, ProcessState::ROLLING,
+                                 ProcessState::DRYING};
+  const int durations[] = {config_.steaming_seconds, config_.rolling_seconds,
+                           config_.drying_seconds};
+
+  for (std::size_t i = 0; i < 3; ++i) {
+    const ProcessState process = stages[i];
+    if (i > 0) {
+      notify_stage(process);
+    }
+    std::int64_t remaining_ms =
+        static_cast<std::int64_t>(durations[i]) * kMillisecondsPerSecond;
+    while (remaining_ms > 0) {
+      const std::int64_t full = remaining_ms / dt_ms;
+      if (full == 0) {
+        kernel_step(process, model_, leaf_, to_seconds(remaining_ms));
+        ++stats_.kernel_steps;
+        elapsed_ms_ += remaining_ms;
+        remaining_ms = 0;
+        observe(process);
+        break;
+      }
+
+      const StageLinearization lin =
+          linearize(process, model_, dt, flags_.overheated);
+      std::int64_t n = 1;
+      if (is_monotone(lin)) {
+        n = std::min(full, first_crossing(lin.temperature, leaf_.temperature_c,
+                                          model_.drying.overheat_c));
+        if (options_.moisture_target >= 0.0) {
+          n = std::min(n, first_crossing(lin.moisture, leaf_.moisture,
+                                         options_.moisture_target));
+        }
+        if (n > 1) {
+          n = std::min(n, first_status_change(lin, leaf_, 1, n - 1,
+                                              flags_.status));
+        }
+      }
+
+      if (n > 1) {
+        leaf_ = leaf_after(lin, leaf_, n - 1);
+        ++stats_.jumps;
+        stats_.skipped_steps += static_cast<std::size_t>(n - 1);
+        elapsed_ms_ += (n - 1) * dt_ms;
+        remaining_ms -= (n - 1) * dt_ms;
+        /* 見積もりが丸めで 1 ステップ早い場合は、跳んだ時点でイベントになります。 */
+        observe(process);
+      }
+      kernel_step(process, model_, leaf_, dt);
+      ++stats_.kernel_steps;
+      elapsed_ms_ += dt_ms;
+      remaining_ms -= dt_ms;
+      observe(process);
+    }
+  }
+  notify_stage(ProcessState::FINISHED);
+}
+
+/*
+ * @brief 最終状態を返します。
+ *
+ * @return 茶葉状態
+ */
+const TeaLeaf& EventEngine::leaf() const {
+  return leaf_;
+}
+
+/*
+ * @brief 経過時間（秒）を返します。
+ *
+ * @return 経過時間
+ */
+double EventEngine::elapsed_seconds() const {
+  return to_seconds(elapsed_ms_);
+}
+
+/*
+ * @brief 統計を返します。
+ *
+ * @return 統計
+ */
+const EventStats& EventEngine::stats() const {
+  return stats_;
+}
+
+/*
+ * @brief 初期状態から実行を始める準備をします（統計と閾値の判定を初期化します）。
+ */
+void EventEngine::begin() {
+  leaf_ = initial_;
+  elapsed_ms_ = 0;
+  stats_ = EventStats();
+  flags_ = flags_of(leaf_);
+}
+
+/*
+ * @brief 茶葉状態の閾値の判定結果を返します。
+ *
+ * @param leaf 茶葉状態
+ * @return 判定結果
+ */
+EventEngine::Flags EventEngine::flags_of(const TeaLeaf& leaf) const {
+  Flags f;
+  f.moisture_above = leaf.moisture > options_.moisture_target;
+  f.overheated = leaf.temperature_c > model_.drying.overheat_c;
+  f.status = status_rank(::tea_io::CsvWriter::quality_score(
+      leaf.moisture, leaf.aroma, leaf.color));
+  return f;
+}
+
+/*
+ * @brief 現在の状態を前回の判定と比べ、変わった閾値のイベントを通知します。
+ *
+ * @param process 現在工程
+ */
+void EventEngine::observe(ProcessState process) {
+  const Flags now = flags_of(leaf_);
+  const Flags before = flags_;
+  flags_ = now;
+  if (now.overheated != before.overheated) {
+    notify(EventType::OVERHEAT, process, now.overheated);
+  }
+  if (options_.moisture_target >= 0.0 &&
+      now.moisture_above != before.moisture_above) {
+    notify(EventType::MOISTURE_CROSSED, process, now.moisture_above);
+  }
+  if (now.status != before.status) {
+    notify(EventType::QUALITY_CHANGED, process, now.status > before.status);
+  }
+}
+
+/*
+ * @brief 工程の切り替えを通知します。
+ *
+ * @param process 切り替え後の工程（完了時は FINISHED）
+ */
+void EventEngine::notify_stage(ProcessState process) {
+  notify(EventType::STAGE_CHANGED, process, true);
+}
+
+/*
+ * @brief 現在の時刻と状態でイベントを作り、購読している関数を呼びます。
+ *
+ * @param type イベント種別
+ * @param process 発生時の工程
+ * @param rising 閾値をまたいだ向き
+ */
+void EventEngine::notify(EventType type, ProcessState process, bool rising) {
+  ++stats_.events;
+  SimulationEvent event;
+  event.type = type;
+  event.process = process;
+  event.elapsed_seconds = to_seconds(elapsed_ms_);
+  event.leaf = leaf_;
+  event.rising = rising;
+  event.status = ::tea_io::CsvWriter::quality_status(
+      ::tea_io::CsvWriter::quality_score(leaf_.moisture, leaf_.aroma,
+                                         leaf_.color));
+  for (const auto& entry : callbacks_) {
+    if (entry.first == type) {
+      entry.second(event);
+    }
+  }
+}
+
+} /* namespace tea */
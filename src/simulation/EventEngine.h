@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "domain/Model.h"
+#include "domain/ProcessState.h"
+#include "domain/TeaLeaf.h"
+#include "domain/TimeStep.h"
+#include "simulation/Simulator.h"
+
+namespace tea {
+
+/* EventEngine が通知するイベントの種類です。 */
+enum class EventType {
+  STAGE_CHANGED,    /* 工程が切り替わった（完了時は FINISHED） */
+  MOISTURE_CROSSED, /* 水分が目標値をまたいだ */
+  OVERHEAT,         /* 温度が DryingParams::overheat_c をまたいだ */
+  QUALITY_CHANGED,  /* 品質ステータス（BAD/OK/GOOD）が変わった */
+};
+
+/* イベント種別の表示名を返します。 */
+const char* to_string(EventType type);
+
+/* 通知するイベントです。 */
+struct SimulationEvent final {
+  EventType type = EventType::STAGE_CHANGED;
+  ProcessState process = ProcessState::STEAMING; /* 発生時の工程（切り替え後） */
+  double elapsed_seconds = 0.0;                  /* 発生時刻 [s] */
+  TeaLeaf leaf;                                  /* 発生時刻の茶葉状態 */
+  /*
+    閾値をまたいだ向きです（MOISTURE_CROSSED/OVERHEAT: 閾値を上回ったら true、
+    QUALITY_CHANGED: ステータスが上がったら true、STAGE_CHANGED: 常に true）。
+  */
+  bool rising = true;
+  const char* status = "BAD";                    /* 発生時刻の品質ステータス */
+};
+
+/* EventEngine の閾値の設定です。 */
+struct EventOptions final {
+  double moisture_target = -1.0; /* 水分の目標値（0 未満なら通知しません） */
+};
+
+/* EventEngine の統計です。 */
+struct EventStats final {
+  std::size_t jumps = 0;         /* 閉じた式で跳んだ回数 */
+  std::size_t skipped_steps = 0; /* 跳んで省略した dt ステップの数 */
+  std::size_t kernel_steps = 0;  /* 更新式で 1 ステップずつ進めた数 */
+  std::size_t events = 0;        /* 通知したイベントの数 */
+};
+
+/*
+  Simulator（dt 秒刻みの前進オイラー）の上で、工程の切り替え・水分の目標値・
+  過熱閾値・品質ステータスの変化をイベントとして購読するエンジンです。
+
+  run() はステップごとの出力を行わず、次のイベントの時刻へ直接跳びます。
+  工程内の dt ステップは成分ごとに x' = a x + b の 1 次式（乾燥の劣化側の香気は
+  温度の等比級数の和）なので、n ステップ後の状態は閉じた式で求まり、
+  水分と温度が閾値をまたぐステップ数は対数で解けます。品質スコアは成分の
+  和で単調とは限らないため、各成分が区間の両端で挟まれることを使って
+  区間を二分し、ステータスが変わる最初のステップを探します。
+  イベントのステップだけは更新式で進めるため、判定は Simulator と同じ式で行います。
+  閉じた式で跳んだ状態は逐次計算と丸め誤差の範囲で一致します。
+  dt が大きく 1 次式の係数が (0, 1] に入らない工程（振動する場合）は
+  1 ステップずつ進めます。
+
+  run(recorder) は Simulator を dt 秒ずつ進めて各ステップを recorder へ渡し、
+  同じイベントをステップごとの判定で通知します。
+*/
+class EventEngine final {
+ public:
+  using Callback = std::function<void(const SimulationEvent&)>;
+
+  explicit EventEngine(SimulationConfig config,
+                       const EventOptions& options = {});
+
+  /* 初期状態の茶葉を設定します。 */
+  void set_initial_leaf(const TeaLeaf& leaf);
+
+  /* type のイベントを購読します（同じ種類に複数登録できます）。 */
+  void subscribe(EventType type, Callback callback);
+
+  /* 全工程を、イベントの時刻へ跳びながら実行します（ステップごとの出力なし）。 */
+  void run();
+
+  /*
+    全工程を dt 秒ずつ実行して各ステップを recorder へ渡し、イベントを通知します。
+    recorder は record(ProcessState, double, const TeaLeaf&) を持つ型です（TraceRecorder 参照）。
+  */
+  template <typename Recorder>
+  void run(Recorder& recorder) {
+    begin();
+    Simulator sim(config_);
+    sim.set_initial_leaf(leaf_);
+    ProcessState stage = sim.current_process();
+    while (sim.step(config_.dt_seconds, recorder)) {
+      if (sim.current_process() != stage) {
+        stage = sim.current_process();
+        notify_stage(stage);
+      }
+      if (sim.elapsed_milliseconds() != elapsed_ms_) {
+        ++stats_.kernel_steps;
+      }
+      leaf_ = sim.leaf();
+      elapsed_ms_ = sim.elapsed_milliseconds();
+      observe(stage);
+    }
+    notify_stage(ProcessState::FINISHED);
+  }
+
+  /* 最後に実行した全工程の最終状態を返します。 */
+  const TeaLeaf& leaf() const;
+
+  /* 最後に実行した全工程の経過時間（秒）を返します。 */
+  double elapsed_seconds() const;
+
+  /* 最後の run の統計を返します。 */
+  const EventStats& stats() const;
+
+ private:
+  /* 閾値の判定結果です（前回と比べてイベントを検出します）。 */
+  struct Flags final {
+    bool moisture_above = false;
+    bool overheated = false;
+    int status = 0; /* 0: BAD, 1: OK, 2: GOOD */
+  };
+
+  void begin();
+  Flags flags_of(const TeaLeaf& leaf) const;
+  void observe(ProcessState process);
+  void notify_stage(ProcessState process);
+  void notify(EventType type, ProcessState process, bool rising);
+
+  SimulationConfig config_;
+  EventOptions options_;
+  ModelParams model_;
+  std::vector<std::pair<EventType, Callback>> callbacks_;
+
+  TeaLeaf initial_;
+  TeaLeaf leaf_;
+  std::int64_t elapsed_ms_ = 0;
+  Flags flags_;
+  EventStats stats_;
+};
+
+} /* namespace tea */
@@ -0,0 +1,323 @@
+/*
+ * @file Optimizer.cpp
+ * @brief 工程時間の逆最適化（品質スコア最大化）
+ *
+ * 蒸し/揉捻/乾燥の工程時間を、時間予算の範囲で品質スコアが最大になるように
+ * 探索します。工程境界の状態を軌跡として保持し、後段工程の候補評価では
+ * 前段工程を再シミュレーションしません。
+ */
+
+#include "simulation/Optimizer.h"
+
+#include <algorithm> // For std::max, std::min, std::sort
+#include <atomic>
+#include <cstdint>
+#include <functional> // For std::ref
+#include <memory>
+#include <thread>
+
+#include "domain/ProcessState.h"
+#include "domain/TimeStep.h"
+#include "io/CsvWriter.h"
+#include "simulation/StageRunner.h"
+
+namespace tea {
+
+namespace {
+
+/*
+ * @brief 1 軸あたりのグリッド分割数です。
+ *
+ * 探索範囲がこれ以下なら 1 秒刻みの全探索になります。
+ */
+constexpr int kGridPoints = 24;
+
+/*
+ * @brief 1 工程の軌跡（整数秒ごとの状態列）を保持します。
+ *
+ * 工程時間 d（ミリ秒で d = q * dt + r）の状態は「q ステップ後の状態に
+ * r を 1 回適用」と等しいため、全候補を 1 本の軌跡から復元できます。
+ * 候補の工程時間は整数秒なので、各整数秒 s について floor(s / dt) ステップ後の
+ * 状態だけを残します（dt が 1 秒未満でも軌跡の長さは秒数で決まります）。
+ */
+class StageTrajectory final {
+ public:
+  /* 開始状態から max_seconds 分の軌跡を構築します。 */
+  StageTrajectory(const IProcess& process,
+                  const TeaLeaf& start,
+                  int max_seconds,
+                  std::int64_t dt_ms)
+      : process_(&process), dt_ms_(dt_ms) {
+    const int seconds = std::max(0, max_seconds);
+    states_.reserve(static_cast<std::size_t>(seconds) + 1);
+    states_.push_back(start);
+    TeaLeaf leaf = start;
+    std::int64_t steps = 0;
+    for (int s = 1; s <= seconds; ++s) {
+      const std::int64_t target = s * kMillisecondsPerSecond / dt_ms_;
+      if (target > steps) {
+        process_->apply_steps(leaf, to_seconds(dt_ms_),
+                              static_cast<int>(target - steps));
+        steps = target;
+      }
+      states_.push_back(leaf);
+    }
+  }
+
+  /* 工程時間 duration_seconds 後の状態を返します。 */
+  TeaLeaf at(int duration_seconds) const {
+    const std::int64_t duration_ms = duration_seconds * kMillisecondsPerSecond;
+    const std::int64_t r = duration_ms % dt_ms_;
+    TeaLeaf leaf = states_[static_cast<std::size_t>(duration_seconds)];
+    if (r > 0) {
+      process_->apply_step(leaf, to_seconds(r));
+    }
+    return leaf;
+  }
+
+ private:
+  const IProcess* process_;
+  std::int64_t dt_ms_;
+  std::vector<TeaLeaf> states_;
+};
+
+/*
+ * @brief グリッド探索の 1 軸（範囲と刻み）です。
+ */
+struct Axis final {
+  int lo = 0;
+  int hi = 0;
+  int stride = 1;
+};
+
+/*
+ * @brief 範囲から刻み幅を決めた軸を作ります。
+ */
+Axis make_axis(int lo, int hi) {
+  Axis a;
+  a.lo = lo;
+  a.hi = std::max(lo, hi);
+  a.stride = std::max(1, (a.hi - a.lo + kGridPoints - 1) / kGridPoints);
+  return a;
+}
+
+/*
+ * @brief 軸上の候補値（両端を含む）を列挙します。
+ */
+std::vector<int> axis_values(const Axis& a) {
+  std::vector<int> values;
+  for (int v = a.lo; v < a.hi; v += a.stride) {
+    values.push_back(v);
+  }
+  values.push_back(a.hi);
+  return values;
+}
+
+/*
+ * @brief 合計時間ごとの最良点を保持するテーブルです（スレッドローカル）。
+ */
+struct ThreadResult final {
+  std::vector<OptimizePoint> best_by_total;
+  std::vector<bool> has_total;
+  OptimizePoint best;
+  bool found = false;
+  std::size_t evaluations = 0;
+};
+
+/*
+ * @brief a が b より良い点かを返します。
+ *
+ * スコアが同じ場合は合計時間が短い方、さらに同じなら工程時間の辞書順で
+ * 小さい方を優先し、スレッド数によらず結果が決定的になるようにします。
+ */
+bool better(const OptimizePoint& a, const OptimizePoint& b) {
+  if (a.score != b.score) {
+    return a.score > b.score;
+  }
+  if (a.total_seconds() != b.total_seconds()) {
+    return a.total_seconds() < b.total_seconds();
+  }
+  if (a.steaming_seconds != b.steaming_seconds) {
+    return a.steaming_seconds < b.steaming_seconds;
+  }
+  return a.rolling_seconds < b.rolling_seconds;
+}
+
+/*
+ * @brief 点を記録し、最良点と合計時間別の最良点を更新します。
+ */
+void record(ThreadResult& r, const OptimizePoint& p) {
+  ++r.evaluations;
+  const std::size_t total = static_cast<std::size_t>(p.total_seconds());
+  if (!r.has_total[total] || better(p, r.best_by_total[total])) {
+    r.best_by_total[total] = p;
+    r.has_total[total] = true;
+  }
+  if (!r.found || better(p, r.best)) {
+    r.best = p;
+    r.found = true;
+  }
+}
+
+} /* namespace */
+
+/*
+ * @brief 時間予算内で品質スコアを最大化する工程時間を探索します。
+ *
+ * 蒸し/揉捻はグリッド探索後、最良点の近傍へ範囲を絞って刻みを細かくし、
+ * 1 秒刻みになるまで繰り返します。乾燥は揉捻終了時の状態から 1 本の軌跡を
+ * 作り、予算内の全乾燥時間を評価します。蒸しの候補はスレッドで分担します。
+ *
+ * @param config 最適化の設定
+ * @param initial 初期状態の茶葉
+ * @return 最良点とパレートフロント
+ */
+OptimizeResult optimize_durations(const OptimizeConfig& config,
+                                  const TeaLeaf& initial) {
+  OptimizeResult result;
+
+  const std::int64_t dt = to_milliseconds(config.dt_seconds);
+  const int budget = config.budget_seconds;
+  const int min_stage = std::max(1, config.min_stage_seconds);
+  if (dt <= 0 || budget < 3 * min_stage) {
+    return result;
+  }
+  int max_stage = budget - 2 * min_stage;
+  if (config.max_stage_seconds > 0) {
+    max_stage = std::min(max_stage, config.max_stage_seconds);
+  }
+  if (max_stage < min_stage) {
+    return result;
+  }
+
+  TeaLeaf start = initial;
+  normalize(start);
+
+  const ModelParams model = make_model(config.model);
+  const std::unique_ptr<IProcess> steaming =
+      make_process(ProcessState::STEAMING, model);
+  const std::unique_ptr<IProcess> rolling =
+      make_process(ProcessState::ROLLING, model);
+  const std::unique_ptr<IProcess> drying =
+      make_process(ProcessState::DRYING, model);
+
+  int thread_count = config.threads;
+  if (thread_count <= 0) {
+    thread_count = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  thread_count = std::max(1, thread_count);
+
+  std::vector<ThreadResult> partials(static_cast<std::size_t>(thread_count));
+  for (ThreadResult& r : partials) {
+    r.best_by_total.resize(static_cast<std::size_t>(budget) + 1);
+    r.has_total.assign(static_cast<std::size_t>(budget) + 1, false);
+  }
+
+  Axis steam_axis = make_axis(min_stage, max_stage);
+  Axis roll_axis = make_axis(min_stage, max_stage);
+
+  while (true) {
+    const std::vector<int> steam_values = axis_values(steam_axis);
+    const std::vector<int> roll_values = axis_values(roll_axis);
+    const StageTrajectory steam_traj(*steaming, start, steam_axis.hi, dt);
+
+    std::atomic<std::size_t> next{0};
+    auto worker = [&](ThreadResult& out) {
+      while (true) {
+        const std::size_t i = next.fetch_add(1);
+        if (i >= steam_values.size()) {
+          return;
+        }
+        const int s = steam_values[i];
+        const int roll_max =
+            std::min(roll_axis.hi, budget - s - min_stage);
+        if (roll_max < roll_axis.lo) {
+          continue;
+        }
+        const StageTrajectory roll_traj(*rolling, steam_traj.at(s),
+                                        roll_max, dt);
+        for (const int r : roll_values) {
+          if (r > roll_max) {
+            break;
+          }
+          const int dry_max = std::min(max_stage, budget - s - r);
+          const StageTrajectory dry_traj(*drying, roll_traj.at(r),
+                                         dry_max, dt);
+          for (int d = min_stage; d <= dry_max; ++d) {
+            OptimizePoint p;
+            p.steaming_seconds = s;
+            p.rolling_seconds = r;
+            p.drying_seconds = d;
+            p.leaf = dry_traj.at(d);
+            p.score = ::tea_io::CsvWriter::quality_score(
+                p.leaf.moisture, p.leaf.aroma, p.leaf.color);
+            record(out, p);
+          }
+        }
+      }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(static_cast<std::size_t>(thread_count - 1));
+    for (int t = 1; t < thread_count; ++t) {
+      pool.emplace_back(worker,
+                        std::ref(partials[static_cast<std::size_t>(t)]));
+    }
+    worker(partials.front());
+    for (std::thread& th : pool) {
+      th.join();
+    }
+
+    const ThreadResult* level_best = nullptr;
+    for (const ThreadResult& r : partials) {
+      if (r.found &&
+          (level_best == nullptr || better(r.best, level_best->best))) {
+        level_best = &r;
+      }
+    }
+    if (level_best == nullptr) {
+      return result;
+    }
+    if (steam_axis.stride == 1 && roll_axis.stride == 1) {
+      break;
+    }
+
+    /* 最良点の前後 1 刻み分へ範囲を絞り、細かいグリッドで再探索します。 */
+    const OptimizePoint& b = level_best->best;
+    steam_axis = make_axis(
+        std::max(min_stage, b.steaming_seconds - steam_axis.stride),
+        std::min(max_stage, b.steaming_seconds + steam_axis.stride));
+    roll_axis = make_axis(
+        std::max(min_stage, b.rolling_seconds - roll_axis.stride),
+        std::min(max_stage, b.rolling_seconds + roll_axis.stride));
+  }
+
+  /* スレッドごとの結果を統合し、パレートフロントを作ります。 */
+  std::vector<OptimizePoint> by_total(static_cast<std::size_t>(budget) + 1);
+  std::vector<bool> has_total(static_cast<std::size_t>(budget) + 1, false);
+  for (const ThreadResult& r : partials) {
+    result.evaluations += r.evaluations;
+    if (r.found && (!result.found || better(r.best, result.best))) {
+      result.best = r.best;
+      result.found = true;
+    }
+    for (std::size_t t = 0; t < r.has_total.size(); ++t) {
+      if (r.has_total[t] &&
+          (!has_total[t] || better(r.best_by_total[t], by_total[t]))) {
+        by_total[t] = r.best_by_total[t];
+        has_total[t] = true;
+      }
+    }
+  }
+
+  double front_score = -1.0;
+  for (std::size_t t = 0; t < by_total.size(); ++t) {
+    if (has_total[t] && by_total[t].score > front_score) {
+      front_score = by_total[t].score;
+      result.pareto_front.push_back(by_total[t]);
+    }
+  }
+  return result;
+}
+
+} /* namespace tea */
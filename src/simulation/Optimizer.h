@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "domain/Model.h"
+#include "domain/TeaLeaf.h"
+
+namespace tea {
+
+/* 工程時間の最適化（品質スコア最大化）の設定です。 */
+struct OptimizeConfig final {
+  ModelType model = ModelType::DEFAULT; /* モデル（係数セット） */
+  double dt_seconds = 1.0;              /* 時間刻み [s]（1 ms 単位） */
+  int budget_seconds = 240;             /* 3工程合計の時間予算 [s] */
+  int min_stage_seconds = 1;            /* 各工程の最短時間 [s] */
+  int max_stage_seconds = 0;            /* 各工程の最長時間 [s]（0: 予算まで） */
+  int threads = 0;                      /* 探索スレッド数（0: 自動） */
+};
+
+/* 評価した 1 点（工程時間の組と最終状態）です。 */
+struct OptimizePoint final {
+  int steaming_seconds = 0;
+  int rolling_seconds = 0;
+  int drying_seconds = 0;
+  double score = 0.0;
+  TeaLeaf leaf;
+
+  /* 3工程の合計時間を返します。 */
+  int total_seconds() const {
+    return steaming_seconds + rolling_seconds + drying_seconds;
+  }
+};
+
+/* 最適化の結果です。 */
+struct OptimizeResult final {
+  OptimizePoint best;
+  /* 評価点のうち「合計時間 vs 品質」で支配されない点（合計時間の昇順）。 */
+  std::vector<OptimizePoint> pareto_front;
+  std::size_t evaluations = 0;
+  bool found = false;
+};
+
+/*
+  時間予算内で品質スコアを最大化する工程時間を探索します。
+  蒸し/揉捻はグリッド + 近傍細分化、乾燥は揉捻終了時の状態から
+  1 本の軌跡で全候補を評価します（前段工程を再計算しません）。
+*/
+OptimizeResult optimize_durations(const OptimizeConfig& config,
+                                  const TeaLeaf& initial);
+
+} /* namespace tea */
@@ -0,0 +1,347 @@
+/*
+ * @file OutputPlan.cpp
+ * @brief 設定からの出力行数・バイト数の予測
+ *
+ * 行数は Simulator::step の工程遷移と同じ規則で数えるため正確です。
+ * バイト数は各列の値域から整形後の桁数を抑えた上限で、実際の出力は
+ * これを超えません（量子化・圧縮した出力は通常これよりかなり小さくなります）。
+ */
+
+#include "simulation/OutputPlan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "domain/Model.h"
+#include "domain/ProcessState.h"
+#include "domain/TimeStep.h"
+#include "io/Multiplex.h"
+
+namespace tea {
+
+namespace {
+
+/* CSV ヘッダ行です（CsvWriter::write_header と同じ内容）。 */
+constexpr const char* kTextHeader =
+    "process,elapsedSeconds,moisture,temperatureC,aroma,color,"
+    "qualityScore,qualityStatus\n";
+
+/* 多重化 CSV のヘッダで増える "batch," の長さです。 */
+constexpr std::size_t kBatchColumnBytes = 6;
+
+/* .teaq の先頭（マジック 4 バイト + 版数）の長さです。 */
+constexpr std::uint64_t kQuantizedPreambleBytes = 5;
+
+/* LZ4 コンテナの先頭・ブロックヘッダ・終端の長さです。 */
+constexpr std::uint64_t kLz4PreambleBytes = 5;
+constexpr std::uint64_t kLz4BlockHeaderBytes = 8;
+constexpr std::uint64_t kLz4TerminatorBytes = 4;
+
+/* .team の先頭・チャンクヘッダ・索引エントリ・末尾の長さです。 */
+constexpr std::uint64_t kMultiplexPreambleBytes = 5;
+constexpr std::uint64_t kMultiplexChunkHeaderBytes = 12;
+constexpr std::uint64_t kMultiplexIndexEntryBytes = 16;
+constexpr std::uint64_t kMultiplexTrailerBytes = 20;
+
+/* 品質判定（GOOD/OK/BAD）の最長です。 */
+constexpr std::size_t kStatusBytes = 4;
+
+/* 有限の double を固定小数で整形したときの整数部の最大桁数です。 */
+constexpr std::size_t kMaxIntegerDigits =
+    std::numeric_limits<double>::max_exponent10 + 1;
+
+/* varint の最長（64 ビット）です。 */
+constexpr std::size_t kMaxVarintBytes = 10;
+
+/*
+ * @brief 値域 [lo, hi] の整数を %d で整形したときの最大文字数を返します。
+ */
+std::size_t int_width(std::int64_t lo, std::int64_t hi) {
+  std::uint64_t m = static_cast<std::uint64_t>(std::max(
+      lo < 0 ? -lo : lo, hi < 0 ? -hi : hi));
+  std::size_t digits = 1;
+  while (m >= 10) {
+    m /= 10;
+    ++digits;
+  }
+  return digits + (lo < 0 ? 1 : 0);
+}
+
+/*
+ * @brief 値域 [lo, hi] の実数を %.<decimals>f で整形したときの最大文字数を返します。
+ *
+ * 丸めで桁が繰り上がる分と、負のゼロの符号も含めて上から抑えます。
+ * 値域が有限でなければ、有限の double で取り得る最大の桁数を返します。
+ */
+std::size_t fixed_width(double lo, double hi, int decimals) {
+  const std::size_t fraction =
+      decimals > 0 ? 1 + static_cast<std::size_t>(decimals) : 0;
+  if (!std::isfinite(lo) || !std::isfinite(hi)) {
+    return 1 + kMaxIntegerDigits + fraction;
+  }
+  const double m =
+      std::max(std::fabs(lo), std::fabs(hi)) + 0.5 * std::pow(10.0, -decimals);
+  std::size_t digits = 1;
+  for (double p = 10.0; m >= p && digits < kMaxIntegerDigits; p *= 10.0) {
+    ++digits;
+  }
+  return (lo <= 0.0 ? 1 : 0) + digits + fraction;
+}
+
+/*
+ * @brief 大きさ magnitude 以下の非負整数を varint で書いたときの最大バイト数を返します。
+ */
+std::size_t varint_width(double magnitude) {
+  if (!std::isfinite(magnitude)) {
+    return kMaxVarintBytes;
+  }
+  std::size_t bytes = 1;
+  for (double v = magnitude; v >= 128.0 && bytes < kMaxVarintBytes;
+       v /= 128.0) {
+    ++bytes;
+  }
+  return bytes;
+}
+
+/*
+ * @brief 量子化した値の大きさ q 以下の列について、残差の varint の最大バイト数を返します。
+ *
+ * 残差は q - (2*prev - prev2) なので大きさは 4q 以下、zigzag で 8q 以下です。
+ */
+std::size_t residual_width(double q) {
+  return varint_width(8.0 * (q + 1.0));
+}
+
+/*
+ * @brief LZ4 コンテナ（--compress）へ raw バイトを書いたときの上限を返します。
+ *
+ * 圧縮で縮まないブロックは無圧縮で格納されるため、各ブロックは元の大きさ
+ * + ヘッダ以下です。
+ */
+std::uint64_t lz4_container_bound(std::uint64_t raw) {
+  const std::uint64_t block = tea_io::Lz4FileSink::kDefaultBlockSize;
+  const std::uint64_t blocks = (raw + block - 1) / block;
+  return kLz4PreambleBytes + raw + blocks * kLz4BlockHeaderBytes +
+         kLz4TerminatorBytes;
+}
+
+} /* namespace */
+
+/*
+ * @brief 設定と初期状態から、1 バッチ分の出力を予測します。
+ *
+ * 行数は Simulator::step と同じく、正の工程時間 d の工程は ceil(d/出力間隔) 行
+ * （出力間隔は dt * sample_substeps）、
+ * 0 以下の工程は先頭なら 0 行・2 番目以降なら幅 d の 1 行です。
+ * 温度は各工程で目標値へ 1 - k*幅 の割合で近づくため、k*幅 が 1 以下なら
+ * 目標値との凸包に、2 以下なら目標値を中心とした区間に収まります。
+ * それを超える（発散し得る）場合は値域を無限大として扱います。
+ *
+ * @param config 実行設定
+ * @param initial 初期状態
+ * @return 予測
+ */
+OutputPlan plan_output(const SimulationConfig& config, const TeaLeaf& initial) {
+  OutputPlan plan;
+  const ModelParams model = make_model(config.model);
+  const int durations[kOutputStageCount] = {
+      config.steaming_seconds, config.rolling_seconds, config.drying_seconds};
+  const ProcessState states[kOutputStageCount] = {
+      ProcessState::STEAMING, ProcessState::ROLLING, ProcessState::DRYING};
+  const double targets[kOutputStageCount] = {model.steaming.target_temp_c,
+                                             model.rolling.target_temp_c,
+                                             model.drying.target_temp_c};
+  const double rates[kOutputStageCount] = {
+      model.steaming.heat_k, model.rolling.cool_k, model.drying.temp_k};
+
+  /* 時刻は Simulator と同じくミリ秒で数えます。 */
+  const std::int64_t dt = to_milliseconds(config.dt_seconds);
+  const std::int64_t sample = dt * sample_substeps(config);
+  std::int64_t elapsed = 0;
+  std::int64_t elapsed_lo = 0;
+  std::int64_t elapsed_hi = 0;
+  double temp_lo = initial.temperature_c;
+  double temp_hi = initial.temperature_c;
+  for (std::size_t i = 0; i < kOutputStageCount; ++i) {
+    plan.name_bytes[i] = std::strlen(to_string(states[i]));
+    const std::int64_t d = durations[i] * kMillisecondsPerSecond;
+    std::int64_t rows = 0;
+    std::int64_t width = 0;
+    if (dt > 0 && d > 0) {
+      rows = (d + sample - 1) / sample;
+      width = std::min(dt, d);
+    } else if (dt > 0 && i > 0) {
+      rows = 1;
+      width = d;
+    }
+    if (rows == 0) {
+      continue;
+    }
+    plan.stage_rows[i] = rows;
+    plan.total_rows += rows;
+    elapsed += d;
+    elapsed_lo = std::min(elapsed_lo, elapsed);
+    elapsed_hi = std::max(elapsed_hi, elapsed);
+
+    const double g = targets[i];
+    const double kw = rates[i] * to_seconds(width);
+    if (width < 0 || !(kw <= 2.0)) {
+      temp_lo = -std::numeric_limits<double>::infinity();
+      temp_hi = std::numeric_limits<double>::infinity();
+    } else if (kw <= 1.0) {
+      temp_lo = std::min(temp_lo, g);
+      temp_hi = std::max(temp_hi, g);
+    } else {
+      const double r = std::max(std::fabs(temp_lo - g), std::fabs(temp_hi - g));
+      temp_lo = g - r;
+      temp_hi = g + r;
+    }
+  }
+
+  /* 水分は [0, 1]、香気・色は [0, 100]、品質スコアは [0, 100] に正規化されます。 */
+  /*
+    経過時間の整数部は秒へ切り上げた値域で数え、出力間隔が整数秒でなければ
+    小数部（"." と最大 3 桁）の分を足します。
+  */
+  const std::int64_t ms = kMillisecondsPerSecond;
+  const std::int64_t seconds_lo = -((-elapsed_lo + ms - 1) / ms);
+  const std::int64_t seconds_hi = (elapsed_hi + ms - 1) / ms;
+  const std::size_t elapsed_w =
+      int_width(seconds_lo, seconds_hi) + (sample % ms != 0 ? 4 : 0);
+  const std::size_t numbers =
+      elapsed_w + fixed_width(0.0, 1.0, 6) + fixed_width(temp_lo, temp_hi, 3) +
+      2 * fixed_width(0.0, 100.0, 3) + fixed_width(0.0, 100.0, 2) +
+      kStatusBytes + 7; /* 数値列の区切り 6 個と改行です。 */
+  const std::size_t console_numbers =
+      elapsed_w + fixed_width(0.0, 1.0, 2) + fixed_width(temp_lo, temp_hi, 1) +
+      2 * fixed_width(0.0, 100.0, 1) +
+      std::strlen("[] t=s moisture= temp= aroma= color=\n");
+  for (std::size_t i = 0; i < kOutputStageCount; ++i) {
+    plan.text_row_bytes[i] = plan.name_bytes[i] + 1 + numbers;
+    plan.console_row_bytes =
+        std::max(plan.console_row_bytes, plan.name_bytes[i] + console_numbers);
+  }
+
+  const double elapsed_max = static_cast<double>(
+      std::max(seconds_hi, seconds_lo < 0 ? -seconds_lo : seconds_lo));
+  const double temp_max = std::max(std::fabs(temp_lo), std::fabs(temp_hi));
+  plan.quantized_row_bytes =
+      varint_width(8.0 * (elapsed_max + 1.0) * 32.0 + 31.0) +
+      residual_width(1e6) + residual_width(temp_max * 1e3) +
+      2 * residual_width(1e5) + residual_width(1e4);
+  return plan;
+}
+
+/*
+ * @brief 任意の行 1 行の上限を返します。
+ *
+ * @param plan 予測
+ * @param encoding 符号化方式
+ * @return バイト数（.teaq は工程名の埋め込みを含む）
+ */
+std::size_t max_row_bytes(const OutputPlan& plan, tea_io::CsvEncoding encoding) {
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; i < kOutputStageCount; ++i) {
+    bytes = std::max(bytes, encoding == tea_io::CsvEncoding::TEXT
+                                ? plan.text_row_bytes[i]
+                                : plan.quantized_row_bytes + 1 +
+                                      plan.name_bytes[i]);
+  }
+  return bytes;
+}
+
+/*
+ * @brief 1 バッチを単独ファイルへ書いたときの大きさの上限を返します。
+ *
+ * @param plan 予測
+ * @param encoding 符号化方式
+ * @param compression 圧縮方式
+ * @return バイト数
+ */
+std::uint64_t file_bytes_bound(const OutputPlan& plan,
+                               tea_io::CsvEncoding encoding,
+                               tea_io::Compression compression) {
+  std::uint64_t raw = 0;
+  if (encoding == tea_io::CsvEncoding::TEXT) {
+    raw = std::strlen(kTextHeader);
+    for (std::size_t i = 0; i < kOutputStageCount; ++i) {
+      raw += static_cast<std::uint64_t>(plan.stage_rows[i]) *
+             plan.text_row_bytes[i];
+    }
+  } else {
+    raw = kQuantizedPreambleBytes +
+          static_cast<std::uint64_t>(plan.total_rows) * plan.quantized_row_bytes;
+    for (std::size_t i = 0; i < kOutputStageCount; ++i) {
+      if (plan.stage_rows[i] > 0) {
+        raw += 1 + plan.name_bytes[i];
+      }
+    }
+  }
+  return compression == tea_io::Compression::LZ4 ? lz4_container_bound(raw)
+                                                 : raw;
+}
+
+/*
+ * @brief batches 本を多重化ファイルへ書いたときの大きさの上限を返します。
+ *
+ * TEXT は batch 列付きの 1 本の CSV（圧縮はファイル全体）、QUANTIZED は
+ * K 行ごとのチャンクと索引です（圧縮はチャンク単位で、縮まなければ無圧縮）。
+ *
+ * @param plan 予測
+ * @param batches バッチ数
+ * @param encoding 符号化方式
+ * @param compression 圧縮方式
+ * @param keyframe_rows チャンクあたりの行数 K
+ * @return バイト数
+ */
+std::uint64_t multiplex_bytes_bound(const OutputPlan& plan,
+                                    int batches,
+                                    tea_io::CsvEncoding encoding,
+                                    tea_io::Compression compression,
+                                    int keyframe_rows) {
+  const std::uint64_t n = batches > 0 ? static_cast<std::uint64_t>(batches) : 0;
+  if (encoding == tea_io::CsvEncoding::TEXT) {
+    const std::uint64_t prefix = int_width(0, batches > 0 ? batches - 1 : 0) + 1;
+    std::uint64_t raw = kBatchColumnBytes + std::strlen(kTextHeader);
+    for (std::size_t i = 0; i < kOutputStageCount; ++i) {
+      raw += n * static_cast<std::uint64_t>(plan.stage_rows[i]) *
+             (plan.text_row_bytes[i] + prefix);
+    }
+    return compression == tea_io::Compression::LZ4 ? lz4_container_bound(raw)
+                                                   : raw;
+  }
+
+  const std::uint64_t k =
+      keyframe_rows > 0
+          ? static_cast<std::uint64_t>(keyframe_rows)
+          : static_cast<std::uint64_t>(
+                tea_io::MultiplexWriter::kDefaultKeyframeRows);
+  const std::uint64_t rows = static_cast<std::uint64_t>(plan.total_rows);
+  const std::uint64_t chunks = (rows + k - 1) / k;
+  std::uint64_t names = 0;
+  for (std::size_t i = 0; i < kOutputStageCount; ++i) {
+    if (plan.stage_rows[i] > 0) {
+      names += 1 + plan.name_bytes[i];
+    }
+  }
+  const std::uint64_t per_batch =
+      rows * plan.quantized_row_bytes +
+      chunks * (kMultiplexChunkHeaderBytes + kMultiplexIndexEntryBytes + names);
+  return kMultiplexPreambleBytes + n * per_batch + kMultiplexTrailerBytes;
+}
+
+/*
+ * @brief batches 本を並べたときの CLI のログ 1 行の上限を返します。
+ *
+ * @param plan 予測
+ * @param batches バッチ数
+ * @return バイト数
+ */
+std::size_t console_line_bytes(const OutputPlan& plan, int batches) {
+  return std::strlen("[batch=] ") +
+         int_width(0, batches > 0 ? batches - 1 : 0) + plan.console_row_bytes;
+}
+
+} /* namespace tea */
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "domain/TeaLeaf.h"
+#include "io/CsvWriter.h"
+#include "io/OutputSink.h"
+#include "simulation/Simulator.h"
+
+namespace tea {
+
+/* 工程の数（蒸し・揉捻・乾燥）です。 */
+constexpr std::size_t kOutputStageCount = 3;
+
+/*
+  1 バッチ分の出力の予測です。
+  SimulationConfig から工程ごとの行数（ceil(工程時間/出力間隔)）は正確に決まり、
+  各列の値域も初期状態とモデル係数から抑えられるため、出力の大きさを
+  実行前に上から見積もれます。書き手やログのバッファを一度だけ確保するのに使います。
+*/
+struct OutputPlan final {
+  /* 工程ごと（蒸し・揉捻・乾燥の順）の行数です。 */
+  std::array<std::int64_t, kOutputStageCount> stage_rows{};
+
+  /* 全行数（Simulator::step が true を返す回数）です。 */
+  std::int64_t total_rows = 0;
+
+  /* 工程ごとの CSV 1 行の上限（バイト、ヘッダと batch 列を除く）です。 */
+  std::array<std::size_t, kOutputStageCount> text_row_bytes{};
+
+  /* 工程ごとの名前の長さ（.teaq で初出時に埋め込む分）です。 */
+  std::array<std::size_t, kOutputStageCount> name_bytes{};
+
+  /* .teaq 1 行の上限（バイト、工程名の埋め込みを除く）です。 */
+  std::size_t quantized_row_bytes = 0;
+
+  /* CLI のログ 1 行の上限（バイト、"[batch=<n>] " を除く）です。 */
+  std::size_t console_row_bytes = 0;
+};
+
+/* 設定と初期状態から、1 バッチ分の出力を予測します。 */
+OutputPlan plan_output(const SimulationConfig& config,
+                       const TeaLeaf& initial = TeaLeaf());
+
+/* 任意の行 1 行の上限（バイト、.teaq は工程名の埋め込みを含む）を返します。 */
+std::size_t max_row_bytes(const OutputPlan& plan, tea_io::CsvEncoding encoding);
+
+/*
+  1 バッチを単独ファイルへ書いたときの大きさの上限（バイト）を返します。
+  ヘッダ（.teaq の先頭）と圧縮コンテナの枠を含みます。
+  途中で flush せず、閉じるときにまとめて書き出す前提です。
+*/
+std::uint64_t file_bytes_bound(const OutputPlan& plan,
+                               tea_io::CsvEncoding encoding,
+                               tea_io::Compression compression);
+
+/* batches 本を多重化ファイルへ書いたときの大きさの上限（バイト）を返します。 */
+std::uint64_t multiplex_bytes_bound(const OutputPlan& plan,
+                                    int batches,
+                                    tea_io::CsvEncoding encoding,
+                                    tea_io::Compression compression,
+                                    int keyframe_rows);
+
+/* batches 本を並べたときの CLI のログ 1 行の上限（バイト）を返します。 */
+std::size_t console_line_bytes(const OutputPlan& plan, int batches);
+
+} /* namespace tea */
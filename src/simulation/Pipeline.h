@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include "domain/Model.h"
+#include "domain/TeaLeaf.h"
+#include "domain/TimeStep.h"
+#include "process/StepKernels.h"
+
+namespace tea {
+
+/*
+  1 ステップの更新式を、成分ごとの x' = a x + b に畳んだ係数です。
+  例えば蒸しの温度は T' = T + (target - T) * heat_k * dt なので、
+  a = 1 - heat_k * dt, b = target * heat_k * dt になります。
+  係数と dt がコンパイル時定数なら、a と b もコンパイル時に求まります。
+*/
+struct AffineStep final {
+  double temperature_a = 1.0;
+  double temperature_b = 0.0;
+  double moisture_a = 1.0;
+  double moisture_b = 0.0;
+  double aroma_a = 1.0;
+  double aroma_b = 0.0;
+  double color_a = 1.0;
+  double color_b = 0.0;
+
+  /* 乾燥の過熱時の香気 a' = a - damage_k * dt * (T' - overheat_c) の係数です。 */
+  double damage_per_c = 0.0; /* damage_k * dt */
+  double overheat_c = 0.0;
+};
+
+/* 蒸し工程の 1 ステップ（dt 秒）の係数です。 */
+constexpr AffineStep steaming_affine(const SteamingParams& p, double dt) {
+  AffineStep s;
+  s.temperature_a = 1.0 - p.heat_k * dt;
+  s.temperature_b = p.target_temp_c * p.heat_k * dt;
+  s.moisture_b = p.moisture_gain_per_s * dt;
+  s.aroma_a = 1.0 - p.aroma_gain_per_s * dt / 100.0;
+  s.aroma_b = p.aroma_gain_per_s * dt;
+  s.color_a = 1.0 - p.color_gain_per_s * dt / 100.0;
+  s.color_b = p.color_gain_per_s * dt;
+  return s;
+}
+
+/* 揉捻工程の 1 ステップ（dt 秒）の係数です。 */
+constexpr AffineStep rolling_affine(const RollingParams& p, double dt) {
+  AffineStep s;
+  s.temperature_a = 1.0 - p.cool_k * dt;
+  s.temperature_b = p.target_temp_c * p.cool_k * dt;
+  s.moisture_a = 1.0 - 0.6 * p.moisture_loss_k * dt;
+  s.moisture_b = -0.4 * p.moisture_loss_k * dt;
+  s.aroma_a = 1.0 - p.aroma_gain_per_s * dt / 100.0;
+  s.aroma_b = p.aroma_gain_per_s * dt;
+  s.color_a = 1.0 - p.color_gain_per_s * dt / 100.0;
+  s.color_b = p.color_gain_per_s * dt;
+  return s;
+}
+
+/*
+  乾燥工程の 1 ステップ（dt 秒）の係数です。
+  水分の減衰率 exp(-dry_k * dt) は std::exp が constexpr でないため含めず、
+  香気の a/b は過熱していない（回復側の）式です。
+*/
+constexpr AffineStep drying_affine(const DryingParams& p, double dt) {
+  AffineStep s;
+  s.temperature_a = 1.0 - p.temp_k * dt;
+  s.temperature_b = p.target_temp_c * p.temp_k * dt;
+  s.aroma_a = 1.0 - p.aroma_recover_per_s * dt / 100.0;
+  s.aroma_b = p.aroma_recover_per_s * dt;
+  s.color_a = 1.0 - p.color_gain_per_s * dt / 100.0;
+  s.color_b = p.color_gain_per_s * dt;
+  s.damage_per_c = p.aroma_damage_k * dt;
+  s.overheat_c = p.overheat_c;
+  return s;
+}
+
+/* 蒸し・揉捻の 1 ステップを畳んだ係数で進めます。 */
+inline void affine_step(const AffineStep& s, TeaLeaf& leaf) {
+  leaf.temperature_c = leaf.temperature_c * s.temperature_a + s.temperature_b;
+  leaf.moisture = leaf.moisture * s.moisture_a + s.moisture_b;
+  leaf.aroma = leaf.aroma * s.aroma_a + s.aroma_b;
+  leaf.color = leaf.color * s.color_a + s.color_b;
+  normalize(leaf);
+}
+
+/* 乾燥の 1 ステップを畳んだ係数で進めます（decay は exp(-dry_k * dt)）。 */
+inline void affine_drying_step(const AffineStep& s, double decay, TeaLeaf& leaf) {
+  leaf.temperature_c = leaf.temperature_c * s.temperature_a + s.temperature_b;
+  leaf.moisture *= decay;
+  const double damaged =
+      leaf.aroma - s.damage_per_c * (leaf.temperature_c - s.overheat_c);
+  const double recovered = leaf.aroma * s.aroma_a + s.aroma_b;
+  leaf.aroma = (leaf.temperature_c > s.overheat_c) ? damaged : recovered;
+  leaf.color = leaf.color * s.color_a + s.color_b;
+  normalize(leaf);
+}
+
+/*
+  組み込みモデル M と時間刻み（DtMilliseconds）をテンプレート引数に取り、
+  係数をコンパイル時定数として蒸し → 揉捻 → 乾燥を進める経路です。
+
+  実行時の経路（Simulator/run_stage）はモデルの係数を工程オブジェクトへ
+  コピーして 1 ステップごとに (target - T) * k * dt を計算しますが、ここでは
+  1 - k * dt などを constexpr の AffineStep に畳んでおくため、内側のループは
+  積和だけになります。乾燥の水分減衰率 exp(-dry_k * dt) は std::exp が
+  constexpr でないため、モデルと dt の組ごとにプログラム開始時に 1 回だけ求めます。
+  工程時間が dt で割り切れない場合の末尾の端数ステップは、実行時の更新式で進めます。
+
+  演算の順序が更新式（StepKernels.h）と異なるため、結果は Simulator と
+  丸め誤差の範囲で一致します（ビット単位では一致しません）。
+*/
+template <ModelType M, std::int64_t DtMilliseconds = kMillisecondsPerSecond>
+class Pipeline final {
+  static_assert(DtMilliseconds > 0, "time step must be at least 1 ms");
+
+ public:
+  static constexpr ModelParams kParams = kModelParams<M>;
+  static constexpr double kDtSeconds =
+      static_cast<double>(DtMilliseconds) /
+      static_cast<double>(kMillisecondsPerSecond);
+
+  static constexpr AffineStep kSteaming =
+      steaming_affine(kParams.steaming, kDtSeconds);
+  static constexpr AffineStep kRolling =
+      rolling_affine(kParams.rolling, kDtSeconds);
+  static constexpr AffineStep kDrying =
+      drying_affine(kParams.drying, kDtSeconds);
+
+  /* 乾燥の水分減衰率 exp(-dry_k * dt)（drying_decay と同じ値）です。 */
+  static inline const double kDryingDecay =
+      std::exp(-kParams.drying.dry_k * kDtSeconds);
+
+  /* initial から全工程を進めた最終状態を返します（工程時間は秒）。 */
+  static TeaLeaf run(const TeaLeaf& initial,
+                     int steaming_seconds,
+                     int rolling_seconds,
+                     int drying_seconds) {
+    TeaLeaf leaf = initial;
+    normalize(leaf);
+
+    std::int64_t full = 0;
+    std::int64_t last_ms = 0;
+    split(steaming_seconds, full, last_ms);
+    for (std::int64_t i = 0; i < full; ++i) {
+      affine_step(kSteaming, leaf);
+    }
+    if (last_ms > 0) {
+      steaming_step(kParams.steaming, leaf, to_seconds(last_ms));
+    }
+
+    split(rolling_seconds, full, last_ms);
+    for (std::int64_t i = 0; i < full; ++i) {
+      affine_step(kRolling, leaf);
+    }
+    if (last_ms > 0) {
+      rolling_step(kParams.rolling, leaf, to_seconds(last_ms));
+    }
+
+    split(drying_seconds, full, last_ms);
+    const double decay = kDryingDecay;
+    for (std::int64_t i = 0; i < full; ++i) {
+      affine_drying_step(kDrying, decay, leaf);
+    }
+    if (last_ms > 0) {
+      drying_step(kParams.drying, leaf, to_seconds(last_ms));
+    }
+    return leaf;
+  }
+
+ private:
+  /* 工程時間を dt ちょうどのステップ数と末尾の端数（ms）に分けます。 */
+  static void split(int duration_seconds,
+                    std::int64_t& full,
+                    std::int64_t& last_ms) {
+    const std::int64_t duration_ms =
+        duration_seconds > 0 ? duration_seconds * kMillisecondsPerSecond : 0;
+    full = duration_ms / DtMilliseconds;
+    last_ms = duration_ms - full * DtMilliseconds;
+  }
+};
+
+} /* namespace tea */
@@ -0,0 +1,286 @@
+/*
+ * @file PrefixCache.cpp
+ * @brief 工程境界の茶葉状態を再利用する LRU キャッシュ
+ *
+ * 乾燥パラメータだけを振るスイープなどで、同一の蒸し/揉捻工程を
+ * 毎回再計算しないよう、工程境界ごとの状態を保持します。
+ */
+
+#include "simulation/PrefixCache.h"
+
+#include <algorithm> // For std::max, std::min
+#include <cstring> // For std::memcpy
+#include <memory>
+
+#include "domain/ProcessState.h"
+#include "simulation/Simulator.h"
+#include "simulation/StageRunner.h"
+
+namespace tea {
+
+namespace {
+
+/*
+ * @brief 工程の並び（Simulator の既定構成と同じ順）です。
+ */
+constexpr ProcessState kStageOrder[3] = {
+  ProcessState::STEAMING,
+  ProcessState::ROLLING,
+  ProcessState::DRYING
+};
+
+} /* namespace */
+
+/*
+ * @brief 最大エントリ数を指定して構築します。
+ *
+ * @param capacity 最大エントリ数（0 は 1 とみなします）
+ */
+PrefixStateCache::PrefixStateCache(std::size_t capacity)
+    : capacity_(capacity == 0 ? 1 : capacity) {
+  index_.reserve(capacity_);
+}
+
+/*
+ * @brief キーのハッシュ値を計算します（ビット列の FNV-1a 風合成）。
+ *
+ * Key::operator== は値で比較し -0.0 と 0.0 を等しいとみなすため、
+ * 0 は +0.0 のビット列に揃えてから合成します。
+ *
+ * @param key 対象キー
+ * @return ハッシュ値
+ */
+std::size_t PrefixStateCache::KeyHash::operator()(const Key& key) const {
+  std::uint64_t h = 1469598103934665603ULL;
+  for (const double v : key.values) {
+    const double normalized = (v == 0.0) ? 0.0 : v;
+    std::uint64_t bits = 0;
+    std::memcpy(&bits, &normalized, sizeof(bits));
+    h ^= bits;
+    h *= 1099511628211ULL;
+    h ^= (h >> 29);
+  }
+  return static_cast<std::size_t>(h);
+}
+
+/*
+ * @brief depth 工程ぶんの境界キーを作ります。
+ *
+ * depth 以降の工程のパラメータ/時間は結果に影響しないため 0 のままにし、
+ * 後段だけが異なる実行同士でキーが一致するようにします。
+ *
+ * @param params 工程別パラメータ
+ * @param durations 工程時間
+ * @param dt_seconds 時間刻み
+ * @param initial 初期状態
+ * @param depth 境界の深さ（1: 蒸し後, 2: 揉捻後, 3: 乾燥後）
+ * @return キー
+ */
+PrefixStateCache::Key PrefixStateCache::make_key(const ModelParams& params,
+                                                 const Durations& durations,
+                                                 double dt_seconds,
+                                                 const TeaLeaf& initial,
+                                                 int depth) {
+  Key key;
+  std::size_t i = 0;
+  auto put = [&key, &i](double v) { key.values[i++] = v; };
+
+  put(static_cast<double>(depth));
+  put(dt_seconds);
+  put(initial.moisture);
+  put(initial.temperature_c);
+  put(initial.aroma);
+  put(initial.color);
+  for (int s = 0; s < 3; ++s) {
+    put(s < depth ? static_cast<double>(durations[static_cast<std::size_t>(s)])
+                  : 0.0);
+  }
+
+  if (depth >= 1) {
+    const SteamingParams& p = params.steaming;
+    put(p.target_temp_c);
+    put(p.heat_k);
+    put(p.moisture_gain_per_s);
+    put(p.aroma_gain_per_s);
+    put(p.color_gain_per_s);
+  }
+  if (depth >= 2) {
+    const RollingParams& p = params.rolling;
+    put(p.target_temp_c);
+    put(p.cool_k);
+    put(p.moisture_loss_k);
+    put(p.aroma_gain_per_s);
+    put(p.color_gain_per_s);
+  }
+  if (depth >= 3) {
+    const DryingParams& p = params.drying;
+    put(p.target_temp_c);
+    put(p.temp_k);
+    put(p.dry_k);
+    put(p.aroma_recover_per_s);
+    put(p.overheat_c);
+    put(p.aroma_damage_k);
+    put(p.color_gain_per_s);
+  }
+  return key;
+}
+
+/*
+ * @brief キーを検索し、見つかれば LRU の先頭へ移動します。
+ *
+ * @param key 検索キー
+ * @return 見つかった状態（無ければ null）
+ */
+const TeaLeaf* PrefixStateCache::find(const Key& key) {
+  const auto it = index_.find(key);
+  if (it == index_.end()) {
+    return nullptr;
+  }
+  lru_.splice(lru_.begin(), lru_, it->second);
+  return &it->second->leaf;
+}
+
+/*
+ * @brief キーと状態を登録します。
+ *
+ * 既存キーなら値を更新して先頭へ移動し、容量超過時は最古のエントリを捨てます。
+ *
+ * @param key 登録キー
+ * @param leaf 工程境界の状態
+ */
+void PrefixStateCache::insert(const Key& key, const TeaLeaf& leaf) {
+  const auto it = index_.find(key);
+  if (it != index_.end()) {
+    it->second->leaf = leaf;
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return;
+  }
+  if (index_.size() >= capacity_) {
+    index_.erase(lru_.back().key);
+    lru_.pop_back();
+    ++stats_.evictions;
+  }
+  lru_.push_front(Entry{key, leaf});
+  index_.emplace(key, lru_.begin());
+}
+
+/*
+ * @brief 全工程を実行した最終状態を返します。
+ *
+ * @param params 工程別パラメータ
+ * @param durations 工程時間（蒸し, 揉捻, 乾燥）
+ * @param dt_seconds 時間刻み（秒）
+ * @param initial 初期状態
+ * @return 最終状態
+ */
+TeaLeaf PrefixStateCache::run(const ModelParams& params,
+                              const Durations& durations,
+                              double dt_seconds,
+                              const TeaLeaf& initial) {
+  return run_prefix(params, durations, dt_seconds, initial, 3);
+}
+
+/*
+ * @brief 先頭から target_depth 工程を実行した工程境界の状態を返します。
+ *
+ * target_depth → … → 蒸し後の順に境界を探し、最も深い境界から
+ * 残りの工程だけを計算します。計算した境界はすべて登録します。
+ *
+ * @param params 工程別パラメータ
+ * @param durations 工程時間（蒸し, 揉捻, 乾燥）
+ * @param dt_seconds 時間刻み（秒）
+ * @param initial 初期状態
+ * @param target_depth 工程境界の深さ（1〜3 に丸めます）
+ * @return 工程境界の状態
+ */
+TeaLeaf PrefixStateCache::run_prefix(const ModelParams& params,
+                                     const Durations& durations,
+                                     double dt_seconds,
+                                     const TeaLeaf& initial,
+                                     int target_depth) {
+  target_depth = std::max(1, std::min(target_depth, 3));
+  TeaLeaf start = initial;
+  normalize(start);
+
+  TeaLeaf leaf = start;
+  int resume_depth = 0;
+  for (int depth = target_depth; depth >= 1; --depth) {
+    const TeaLeaf* cached =
+        find(make_key(params, durations, dt_seconds, start, depth));
+    if (cached != nullptr) {
+      leaf = *cached;
+      resume_depth = depth;
+      break;
+    }
+  }
+
+  if (resume_depth > 0) {
+    ++stats_.hits;
+    stats_.stages_reused += static_cast<std::size_t>(resume_depth);
+  } else {
+    ++stats_.misses;
+  }
+
+  for (int depth = resume_depth; depth < target_depth; ++depth) {
+    const std::unique_ptr<IProcess> process =
+        make_process(kStageOrder[depth], params);
+    run_stage(*process, leaf, durations[static_cast<std::size_t>(depth)],
+              dt_seconds);
+    insert(make_key(params, durations, dt_seconds, start, depth + 1), leaf);
+  }
+  return leaf;
+}
+
+/*
+ * @brief SimulationConfig のモデル/工程時間/dt で実行します。
+ *
+ * @param config 実行設定
+ * @param initial 初期状態
+ * @return 最終状態
+ */
+TeaLeaf PrefixStateCache::run(const SimulationConfig& config,
+                              const TeaLeaf& initial) {
+  return run(make_model(config.model),
+             Durations{config.steaming_seconds, config.rolling_seconds,
+                       config.drying_seconds},
+             config.dt_seconds,
+             initial);
+}
+
+/*
+ * @brief 統計を返します。
+ *
+ * @return キャッシュ統計
+ */
+const PrefixCacheStats& PrefixStateCache::stats() const {
+  return stats_;
+}
+
+/*
+ * @brief 現在のエントリ数を返します。
+ *
+ * @return エントリ数
+ */
+std::size_t PrefixStateCache::size() const {
+  return index_.size();
+}
+
+/*
+ * @brief 最大エントリ数を返します。
+ *
+ * @return 最大エントリ数
+ */
+std::size_t PrefixStateCache::capacity() const {
+  return capacity_;
+}
+
+/*
+ * @brief 全エントリと統計を破棄します。
+ */
+void PrefixStateCache::clear() {
+  lru_.clear();
+  index_.clear();
+  stats_ = PrefixCacheStats();
+}
+
+} /* namespace tea */
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+#include "domain/Model.h"
+#include "domain/TeaLeaf.h"
+
+namespace tea {
+
+struct SimulationConfig;
+
+/* 工程境界キャッシュの統計です。 */
+struct PrefixCacheStats final {
+  std::size_t hits = 0;          /* 工程境界の状態を再利用できた実行数 */
+  std::size_t misses = 0;        /* 先頭から計算した実行数 */
+  std::size_t evictions = 0;     /* 容量超過で捨てたエントリ数 */
+  std::size_t stages_reused = 0; /* 再計算を省略した工程数の合計 */
+};
+
+/*
+  工程境界（蒸し後/揉捻後/乾燥後）の茶葉状態を保持する LRU キャッシュです。
+  キーは (初期状態, 先頭から k 工程のパラメータと時間, dt) で、
+  実行時は最も深くキャッシュされた境界から再開します。
+*/
+class PrefixStateCache final {
+ public:
+  /* 工程時間（蒸し, 揉捻, 乾燥）の組です。 */
+  using Durations = std::array<int, 3>;
+
+  /* 最大エントリ数を指定して構築します（0 は 1 とみなします）。 */
+  explicit PrefixStateCache(std::size_t capacity);
+
+  /* 全工程を実行した最終状態を返します（途中の境界はキャッシュされます）。 */
+  TeaLeaf run(const ModelParams& params,
+              const Durations& durations,
+              double dt_seconds,
+              const TeaLeaf& initial);
+
+  /*
+    先頭から depth 工程（1: 蒸し, 2: 揉捻, 3: 乾燥まで）を実行した工程境界の
+    状態を返します（durations のうち depth 以降の時間は使いません）。
+  */
+  TeaLeaf run_prefix(const ModelParams& params,
+                     const Durations& durations,
+                     double dt_seconds,
+                     const TeaLeaf& initial,
+                     int depth);
+
+  /* SimulationConfig のモデル/工程時間/dt で run します。 */
+  TeaLeaf run(const SimulationConfig& config, const TeaLeaf& initial);
+
+  /* 統計を返します。 */
+  const PrefixCacheStats& stats() const;
+
+  /* 現在のエントリ数を返します。 */
+  std::size_t size() const;
+
+  /* 最大エントリ数を返します。 */
+  std::size_t capacity() const;
+
+  /* 全エントリと統計を破棄します。 */
+  void clear();
+
+ private:
+  /* 工程境界を識別するキー（未使用の工程分は 0 埋め）です。 */
+  struct Key final {
+    std::array<double, 26> values{}; /* depth, dt, 初期状態4, 時間3, 係数17 */
+
+    bool operator==(const Key& other) const {
+      return values == other.values;
+    }
+  };
+
+  /* Key のハッシュ関数です。 */
+  struct KeyHash final {
+    std::size_t operator()(const Key& key) const;
+  };
+
+  /* LRU リスト上のエントリです。 */
+  struct Entry final {
+    Key key;
+    TeaLeaf leaf;
+  };
+
+  using EntryList = std::list<Entry>;
+
+  /* depth 工程ぶんの境界キーを作ります。 */
+  static Key make_key(const ModelParams& params,
+                      const Durations& durations,
+                      double dt_seconds,
+                      const TeaLeaf& initial,
+                      int depth);
+
+  /* キーを検索し、見つかれば最新として扱います。 */
+  const TeaLeaf* find(const Key& key);
+
+  /* キーと状態を登録します（容量超過時は最古を捨てます）。 */
+  void insert(const Key& key, const TeaLeaf& leaf);
+
+  std::size_t capacity_;
+  EntryList lru_;
+  std::unordered_map<Key, EntryList::iterator, KeyHash> index_;
+  PrefixCacheStats stats_;
+};
+
+} /* namespace tea */
@@ -0,0 +1,350 @@
+/*
+ * @file QueryBatcher.cpp
+ * @brief 最終品質の問い合わせをまとめて一括評価するスレッド安全な窓口
+ *
+ * 呼び出し元は要求をキューへ積んで結果を待つだけで、計算は評価スレッドが
+ * 窓ごとにまとめて行います。同じレシピの要求は 1 つの BatchEngine に
+ * 並べて SoA のまま全工程を進めるため、要求ごとに Simulator を組み立てて
+ * 回すよりも工程の組み立てとキャッシュミスが大幅に減ります。
+ */
+
+#include "simulation/QueryBatcher.h"
+
+#include <algorithm> // For std::min, std::stable_sort
+#include <cmath>
+#include <cstring> // For std::memcpy
+#include <iterator> // For std::prev
+
+#include "domain/Model.h"
+#include "domain/TimeStep.h"
+#include "simulation/BatchEngine.h"
+
+namespace tea {
+
+namespace {
+
+/* 量子化した格子番号を厳密に表せる上限（2^52）です。 */
+constexpr double kMaxQuantizedIndex = 4503599627370496.0;
+
+/* Key のうちレシピ（モデル, dt, 工程時間 3 つ）を表す先頭の値の数です。 */
+constexpr std::size_t kRecipeValues = 5;
+
+} /* namespace */
+
+/*
+ * @brief 値を刻み step の格子点へ丸め、格子番号を返します。
+ *
+ * step が 0 以下、または値が格子番号で表せない場合は丸めず、
+ * ビット列をそのまま番号として使います。
+ *
+ * @param v 値
+ * @param step 刻み
+ * @param snapped 丸めた値の格納先（nullptr 可）
+ * @return 格子番号
+ */
+std::int64_t quantize_index(double v, double step, double* snapped) {
+  if (step > 0.0 && std::isfinite(v) &&
+      std::fabs(v / step) < kMaxQuantizedIndex) {
+    const std::int64_t index = std::llround(v / step);
+    if (snapped != nullptr) {
+      *snapped = static_cast<double>(index) * step;
+    }
+    return index;
+  }
+  std::int64_t bits = 0;
+  std::memcpy(&bits, &v, sizeof(bits));
+  if (snapped != nullptr) {
+    *snapped = v;
+  }
+  return bits;
+}
+
+/*
+ * @brief キーのハッシュ値を計算します（FNV-1a 風合成）。
+ *
+ * @param key 対象キー
+ * @return ハッシュ値
+ */
+std::size_t QueryBatcher::KeyHash::operator()(const Key& key) const {
+  std::uint64_t h = 1469598103934665603ULL;
+  for (const std::int64_t v : key.values) {
+    h ^= static_cast<std::uint64_t>(v);
+    h *= 1099511628211ULL;
+    h ^= (h >> 29);
+  }
+  return static_cast<std::size_t>(h);
+}
+
+/*
+ * @brief 設定を保持し、評価スレッドを起動します。
+ *
+ * @param options 窓の長さ、一括評価の上限、キャッシュ容量、量子化の刻み
+ */
+QueryBatcher::QueryBatcher(const QueryBatcherOptions& options)
+    : options_(options) {
+  options_.max_batch = std::max<std::size_t>(1, options_.max_batch);
+  options_.cache_size = std::max<std::size_t>(1, options_.cache_size);
+  queue_.reserve(options_.max_batch);
+  index_.reserve(options_.cache_size);
+  dispatcher_ = std::thread(&QueryBatcher::dispatch_main, this);
+}
+
+/*
+ * @brief 評価待ちの要求をすべて評価してから評価スレッドを止めます。
+ */
+QueryBatcher::~QueryBatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_ready_.notify_one();
+  dispatcher_.join();
+}
+
+/*
+ * @brief 要求を受け付け、結果の引換券を返します。
+ *
+ * 結果キャッシュにあれば結果入りの引換券を返し、同じキーの要求が
+ * 評価待ちならその評価を共有します。どちらでもなければキューへ積みます。
+ *
+ * @param config レシピ（モデル, dt, 工程時間）
+ * @param initial 初期状態（量子化してから評価します）
+ * @return 結果の引換券
+ */
+QueryBatcher::Ticket QueryBatcher::submit(const SimulationConfig& config,
+                                          const TeaLeaf& initial) {
+  const QueryQuantization& q = options_.quantization;
+  Key key;
+  key.values[0] = static_cast<std::int64_t>(config.model);
+  key.values[1] = to_milliseconds(config.dt_seconds);
+  key.values[2] = config.steaming_seconds;
+  key.values[3] = config.rolling_seconds;
+  key.values[4] = config.drying_seconds;
+  TeaLeaf snapped;
+  key.values[5] =
+      quantize_index(initial.moisture, q.moisture, &snapped.moisture);
+  key.values[6] = quantize_index(initial.temperature_c, q.temperature_c,
+                                 &snapped.temperature_c);
+  key.values[7] = quantize_index(initial.aroma, q.aroma, &snapped.aroma);
+  key.values[8] = quantize_index(initial.color, q.color, &snapped.color);
+
+  Ticket ticket;
+  ticket.owner_ = this;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  ++stats_.requests;
+
+  const auto cached = index_.find(key);
+  if (cached != index_.end()) {
+    ++stats_.cache_hits;
+    lru_.splice(lru_.begin(), lru_, cached->second);
+    ticket.result_ = cached->second->result;
+    return ticket;
+  }
+
+  const auto waiting = in_flight_.find(key);
+  if (waiting != in_flight_.end()) {
+    ++stats_.coalesced;
+    ticket.pending_ = waiting->second;
+    return ticket;
+  }
+
+  std::shared_ptr<Pending> pending = std::make_shared<Pending>();
+  pending->key = key;
+  pending->config = config;
+  pending->initial = snapped;
+  if (queue_.empty()) {
+    first_arrival_ = std::chrono::steady_clock::now();
+  }
+  queue_.push_back(pending);
+  in_flight_.emplace(key, pending);
+  if (queue_.size() == 1 || queue_.size() == options_.max_batch) {
+    work_ready_.notify_one();
+  }
+  ticket.pending_ = std::move(pending);
+  return ticket;
+}
+
+/*
+ * @brief 最終状態と品質スコアを返します（submit して結果を待ちます）。
+ *
+ * @param config レシピ（モデル, dt, 工程時間）
+ * @param initial 初期状態（量子化してから評価します）
+ * @return 最終状態と品質スコア
+ */
+QueryResult QueryBatcher::evaluate(const SimulationConfig& config,
+                                   const TeaLeaf& initial) {
+  return submit(config, initial).get();
+}
+
+/*
+ * @brief 統計を返します。
+ *
+ * @return 統計の写し
+ */
+QueryBatcherStats QueryBatcher::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+/*
+ * @brief 結果キャッシュのエントリ数を返します。
+ *
+ * @return エントリ数
+ */
+std::size_t QueryBatcher::cache_entries() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return lru_.size();
+}
+
+/*
+ * @brief 評価スレッドの本体です。
+ *
+ * 最初の要求から窓が過ぎるか max_batch 件集まるまで待ち、キューの先頭から
+ * 最大 max_batch 件をロックの外で一括評価し、結果をキャッシュへ登録してから
+ * 待っている呼び出し元をまとめて起こします。
+ * 停止要求後は窓を待たずに残りを評価し、キューが空になったら終わります。
+ */
+void QueryBatcher::dispatch_main() {
+  std::vector<std::shared_ptr<Pending>> batch;
+  batch.reserve(options_.max_batch);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_ready_.wait(lock, [&] { return stopping_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;
+    }
+    if (!stopping_ && options_.window.count() > 0) {
+      work_ready_.wait_until(lock, first_arrival_ + options_.window, [&] {
+        return stopping_ || queue_.size() >= options_.max_batch;
+      });
+    }
+
+    const std::size_t n = std::min(queue_.size(), options_.max_batch);
+    batch.assign(queue_.begin(), queue_.begin() + static_cast<long>(n));
+    queue_.erase(queue_.begin(), queue_.begin() + static_cast<long>(n));
+    if (!queue_.empty()) {
+      first_arrival_ = std::chrono::steady_clock::now();
+    }
+
+    lock.unlock();
+    const std::size_t recipes = evaluate_batch(batch);
+    lock.lock();
+
+    ++stats_.batches;
+    stats_.recipes += recipes;
+    stats_.evaluations += batch.size();
+    for (const std::shared_ptr<Pending>& p : batch) {
+      p->done = true;
+      in_flight_.erase(p->key);
+      insert_cache(p->key, p->result);
+    }
+    batch.clear();
+
+    /* 結果は 1 件ずつではなく、一括評価ごとに 1 回だけ通知します。 */
+    results_ready_.notify_all();
+  }
+}
+
+/*
+ * @brief 要求をレシピごとにまとめ、BatchEngine で一括評価します。
+ *
+ * @param batch 評価する要求（レシピ順に並べ替えます）
+ * @return 評価したレシピの数
+ */
+std::size_t QueryBatcher::evaluate_batch(
+    std::vector<std::shared_ptr<Pending>>& batch) const {
+  const auto same_recipe = [](const Pending& a, const Pending& b) {
+    return std::equal(a.key.values.begin(),
+                      a.key.values.begin() + kRecipeValues,
+                      b.key.values.begin());
+  };
+  std::stable_sort(batch.begin(), batch.end(),
+                   [](const std::shared_ptr<Pending>& a,
+                      const std::shared_ptr<Pending>& b) {
+                     return std::lexicographical_compare(
+                         a->key.values.begin(),
+                         a->key.values.begin() + kRecipeValues,
+                         b->key.values.begin(),
+                         b->key.values.begin() + kRecipeValues);
+                   });
+
+  std::size_t recipes = 0;
+  std::size_t begin = 0;
+  while (begin < batch.size()) {
+    std::size_t end = begin + 1;
+    while (end < batch.size() && same_recipe(*batch[begin], *batch[end])) {
+      ++end;
+    }
+
+    const SimulationConfig& config = batch[begin]->config;
+    BatchEngine engine(make_model(config.model));
+    for (std::size_t i = begin; i < end; ++i) {
+      engine.add(batch[i]->initial);
+    }
+    engine.run(config);
+    for (std::size_t i = begin; i < end; ++i) {
+      batch[i]->result.leaf = engine.leaf(i - begin);
+      batch[i]->result.score = engine.quality_score(i - begin);
+    }
+
+    ++recipes;
+    begin = end;
+  }
+  return recipes;
+}
+
+/*
+ * @brief 結果をキャッシュへ登録します（容量超過時は最古と入れ替えます）。
+ *
+ * @param key 要求のキー
+ * @param result 評価結果
+ */
+void QueryBatcher::insert_cache(const Key& key, const QueryResult& result) {
+  if (index_.find(key) != index_.end()) {
+    return;
+  }
+  if (lru_.size() < options_.cache_size) {
+    lru_.push_front(Entry{key, result});
+    index_.emplace(key, lru_.begin());
+    return;
+  }
+  /* 満杯なら最古のエントリ（リストとハッシュのノード）をそのまま使い回します。 */
+  auto node = index_.extract(lru_.back().key);
+  lru_.splice(lru_.begin(), lru_, std::prev(lru_.end()));
+  lru_.front().key = key;
+  lru_.front().result = result;
+  node.key() = key;
+  node.mapped() = lru_.begin();
+  index_.insert(std::move(node));
+}
+
+/*
+ * @brief 結果が出るまで待って返します。
+ *
+ * @return 最終状態と品質スコア
+ */
+QueryResult QueryBatcher::Ticket::get() const {
+  if (!pending_) {
+    return result_;
+  }
+  std::unique_lock<std::mutex> lock(owner_->mutex_);
+  owner_->results_ready_.wait(lock, [&] { return pending_->done; });
+  return pending_->result;
+}
+
+/*
+ * @brief 結果が出ていれば true を返します。
+ *
+ * @return 結果が出ていれば true
+ */
+bool QueryBatcher::Ticket::ready() const {
+  if (!pending_) {
+    return owner_ != nullptr;
+  }
+  std::lock_guard<std::mutex> lock(owner_->mutex_);
+  return pending_->done;
+}
+
+} /* namespace tea */
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "domain/TeaLeaf.h"
+#include "simulation/Simulator.h"
+
+namespace tea {
+
+/*
+  要求の初期状態を量子化する刻みです（0 以下の項目は量子化しません）。
+  刻みの格子点へ丸めた値で評価するため、同じ格子点に落ちる要求は
+  同じ結果を共有します。
+*/
+struct QueryQuantization final {
+  double moisture = 1e-6;
+  double temperature_c = 1e-4;
+  double aroma = 1e-4;
+  double color = 1e-4;
+};
+
+/*
+  値を刻み step の格子点へ丸め、格子番号を返します（snapped には丸めた値）。
+  step が 0 以下か、値が格子番号で表せない場合は丸めず、ビット列を番号にします。
+*/
+std::int64_t quantize_index(double v, double step, double* snapped = nullptr);
+
+/* QueryBatcher の設定です。 */
+struct QueryBatcherOptions final {
+  /* 最初の要求が届いてから一括評価を始めるまで待つ時間です。 */
+  std::chrono::microseconds window{200};
+
+  /* この数の要求が集まったら窓を待たずに評価します。 */
+  std::size_t max_batch = 1024;
+
+  /* 結果キャッシュの最大エントリ数（0 は 1 とみなします）です。 */
+  std::size_t cache_size = 4096;
+
+  /* 初期状態の量子化の刻みです。 */
+  QueryQuantization quantization;
+};
+
+/* 最終品質の問い合わせ結果です。 */
+struct QueryResult final {
+  TeaLeaf leaf;        /* 全工程後の茶葉状態 */
+  double score = 0.0;  /* 品質スコア（0-100） */
+};
+
+/* QueryBatcher の統計です。 */
+struct QueryBatcherStats final {
+  std::size_t requests = 0;    /* 受け付けた要求数 */
+  std::size_t cache_hits = 0;  /* 結果キャッシュから返した要求数 */
+  std::size_t coalesced = 0;   /* 評価待ちの同一要求に相乗りした要求数 */
+  std::size_t batches = 0;     /* 一括評価の回数 */
+  std::size_t recipes = 0;     /* 一括評価で回したレシピ（BatchEngine）の数 */
+  std::size_t evaluations = 0; /* 実際に計算した茶葉の数 */
+};
+
+/*
+  多数のスレッドから届く「レシピ X・初期状態 Y の最終品質」の問い合わせを
+  まとめて評価するスレッド安全な窓口です。
+  要求（submit / evaluate）は評価スレッドのキューに積まれ、窓（window）が過ぎるか max_batch 件
+  集まった時点でレシピごとにまとめ、BatchEngine（SoA）で一括計算します。
+  初期状態を量子化したキーで、評価済みの結果（LRU キャッシュ）と
+  評価待ちの同一要求を共有するため、重複した要求は 1 回しか計算しません。
+  結果は BatchEngine（＝ Simulator）で量子化後の初期状態を計算したものと一致します。
+*/
+class QueryBatcher final {
+ public:
+  class Ticket;
+
+  explicit QueryBatcher(const QueryBatcherOptions& options = {});
+
+  /* 評価待ちの要求をすべて評価してから評価スレッドを止めます。 */
+  ~QueryBatcher();
+
+  QueryBatcher(const QueryBatcher&) = delete;
+  QueryBatcher& operator=(const QueryBatcher&) = delete;
+
+  /*
+    要求を受け付け、結果の引換券を返します（待たずに戻ります）。
+    1 つのスレッドから多数の要求をまとめて投げたい場合に使います。
+  */
+  Ticket submit(const SimulationConfig& config, const TeaLeaf& initial);
+
+  /* 最終状態と品質スコアを返します（submit して結果を待ちます）。 */
+  QueryResult evaluate(const SimulationConfig& config, const TeaLeaf& initial);
+
+  /* 統計を返します。 */
+  QueryBatcherStats stats() const;
+
+  /* 結果キャッシュのエントリ数を返します。 */
+  std::size_t cache_entries() const;
+
+ private:
+  /* 要求を識別するキー（レシピ 5 値と量子化した初期状態 4 値）です。 */
+  struct Key final {
+    std::array<std::int64_t, 9> values{};
+
+    bool operator==(const Key& other) const {
+      return values == other.values;
+    }
+  };
+
+  /* Key のハッシュ関数です。 */
+  struct KeyHash final {
+    std::size_t operator()(const Key& key) const;
+  };
+
+  /* 評価待ちの要求です（同一キーの呼び出し元で共有します）。 */
+  struct Pending final {
+    Key key;
+    SimulationConfig config;
+    TeaLeaf initial; /* 量子化後の初期状態 */
+    QueryResult result;
+    bool done = false;
+  };
+
+  /* LRU リスト上のキャッシュエントリです。 */
+  struct Entry final {
+    Key key;
+    QueryResult result;
+  };
+
+  using EntryList = std::list<Entry>;
+
+  void dispatch_main();
+  std::size_t evaluate_batch(std::vector<std::shared_ptr<Pending>>& batch) const;
+  void insert_cache(const Key& key, const QueryResult& result);
+
+  QueryBatcherOptions options_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable work_ready_;
+  mutable std::condition_variable results_ready_;
+  std::vector<std::shared_ptr<Pending>> queue_;
+  std::chrono::steady_clock::time_point first_arrival_;
+  std::unordered_map<Key, std::shared_ptr<Pending>, KeyHash> in_flight_;
+  EntryList lru_;
+  std::unordered_map<Key, EntryList::iterator, KeyHash> index_;
+  QueryBatcherStats stats_;
+  bool stopping_ = false;
+
+  std::thread dispatcher_;
+};
+
+/*
+  QueryBatcher::submit の結果の引換券です。
+  一括評価の結果は 1 回の通知でまとめて公開されるため、多数の引換券を
+  順に get しても呼び出し元が結果 1 件ごとに起こされることはありません。
+*/
+class QueryBatcher::Ticket final {
+ public:
+  Ticket() = default;
+
+  /* 結果が出るまで待って返します。 */
+  QueryResult get() const;
+
+  /* 結果が出ていれば true を返します。 */
+  bool ready() const;
+
+ private:
+  friend class QueryBatcher;
+
+  const QueryBatcher* owner_ = nullptr;
+  std::shared_ptr<const Pending> pending_; /* キャッシュから返した場合は空 */
+  QueryResult result_;                     /* キャッシュから返した結果 */
+};
+
+} /* namespace tea */
@@ -0,0 +1,478 @@
+/*
+ * @file ResultCache.cpp
+ * @brief 最終状態と品質スコアを mmap したファイルへ永続化する結果キャッシュ
+ *
+ * 同じ設定・初期状態の実行を繰り返す場合に、シミュレーションを丸ごと
+ * 省略できるよう、結果を固定長スロットのハッシュ表としてファイルに残します。
+ * 表はセット連想（8 本の組）で、組の中だけを探すため探索は定数時間です。
+ */
+
+#include "simulation/ResultCache.h"
+
+#include <algorithm> // For std::min, std::max
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "domain/Model.h"
+#include "domain/TimeStep.h"
+#include "io/CsvWriter.h"
+
+namespace tea {
+
+namespace {
+
+/* ファイル先頭の識別子です。 */
+constexpr char kMagic[8] = {'T', 'E', 'A', 'R', 'C', 'A', 'C', 'H'};
+
+/* ファイル形式の版です（スロットの並びを変えたら上げます）。 */
+constexpr std::uint32_t kVersion = 2;
+
+/* 1 組のスロット数です。 */
+constexpr std::size_t kWays = 8;
+
+/* エントリ数の上限の上限（ファイルが 2 GiB を超えない範囲）です。 */
+constexpr std::size_t kMaxEntries = std::size_t(1) << 24;
+
+/*
+ * @brief バイト列の FNV-1a ハッシュを返します。
+ *
+ * @param data 先頭
+ * @param n バイト数
+ * @param h 初期値
+ * @return ハッシュ値
+ */
+std::uint64_t fnv1a(const void* data, std::size_t n,
+                    std::uint64_t h = 1469598103934665603ULL) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for (std::size_t i = 0; i < n; ++i) {
+    h ^= p[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+} /* namespace */
+
+/* ファイル先頭のヘッダです（64 バイト）。 */
+struct ResultCache::Header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t slot_bytes;
+  std::uint64_t capacity; /* スロット数 */
+  std::uint64_t entries;  /* 有効なスロット数 */
+  std::uint64_t clock;    /* 最終使用時刻に使う単調な通し番号 */
+  std::uint8_t reserved[24];
+};
+
+/* キャッシュのキーです（64 バイト、パディングは 0 で埋めます）。 */
+struct ResultCache::Key {
+  std::uint64_t params_hash; /* モデル係数のハッシュ */
+  std::int32_t model;
+  std::int32_t dt_milliseconds; /* 時間刻み（ミリ秒、版 2 から） */
+  std::int32_t stage_seconds[3];
+  std::int32_t reserved;
+  std::int64_t initial[4]; /* 量子化した初期状態（水分, 温度, 香気, 色） */
+};
+
+/* 1 エントリ分のスロットです（128 バイト）。 */
+struct ResultCache::Slot {
+  std::uint64_t tag;       /* キーのハッシュ（0 は空き） */
+  std::uint64_t last_used; /* 最後に使った時刻（Header::clock） */
+  Key key;
+  double leaf[4]; /* 最終状態（水分, 温度, 香気, 色） */
+  double score;
+  std::uint8_t reserved[8];
+};
+
+/*
+ * @brief ヘッダが妥当で、ファイルの大きさがスロット数と合っているかを返します。
+ *
+ * @param h 読み込んだヘッダ
+ * @param file_bytes ファイルの大きさ
+ * @return 使えるファイルなら true
+ */
+bool ResultCache::header_is_valid(const Header& h, std::uint64_t file_bytes) {
+  return std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 &&
+         h.version == kVersion && h.slot_bytes == sizeof(Slot) &&
+         h.capacity >= kWays && h.capacity <= kMaxEntries &&
+         h.capacity % kWays == 0 && h.entries <= h.capacity &&
+         file_bytes == sizeof(Header) + h.capacity * sizeof(Slot);
+}
+
+/*
+ * @brief 空の表を一時ファイルに作り、path へ rename() で置き換えます。
+ *
+ * 置き換え前のファイルを対応付けている他のプロセスは、そのまま古い内容を
+ * 使い続けられます（その場で切り詰めると SIGBUS や表の取り違えになるため）。
+ * 呼び出し側は path のロックを持っている必要があります。
+ *
+ * @param path キャッシュファイルのパス
+ * @param capacity スロット数
+ * @return 置き換えられたら true
+ */
+bool ResultCache::rebuild(const std::string& path, std::size_t capacity) {
+  const std::string tmp = path + ".tmp." + std::to_string(::getpid());
+  const int fd =
+      ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.slot_bytes = sizeof(Slot);
+  header.capacity = capacity;
+  const bool ok =
+      ::ftruncate(fd, static_cast<off_t>(sizeof(Header) +
+                                         capacity * sizeof(Slot))) == 0 &&
+      ::pwrite(fd, &header, sizeof(header), 0) ==
+          static_cast<ssize_t>(sizeof(header));
+  ::close(fd);
+  if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+    ::unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+/*
+ * @brief ファイルを開き（無ければ作り）、対応付けます。
+ *
+ * ヘッダが妥当な既存ファイルは、そのスロット数（エントリ数の上限）を引き継ぎ、
+ * max_entries は新しく作るときだけ使います。形式の合わないファイルは
+ * 一時ファイルに作り直して置き換え、開き直します。ロックを待つ間に
+ * 他のプロセスが置き換えた場合も、開き直して新しいファイルを使います。
+ *
+ * @param path キャッシュファイルのパス
+ * @param max_entries 新しく作るときのエントリ数の上限（8 の倍数へ切り上げ）
+ * @param quantization 初期状態をキーにするときの量子化の刻み
+ */
+ResultCache::ResultCache(const std::string& path,
+                         std::size_t max_entries,
+                         const QueryQuantization& quantization)
+    : quantization_(quantization) {
+  static_assert(sizeof(Header) == 64, "header layout");
+  static_assert(sizeof(Key) == 64, "key layout");
+  static_assert(sizeof(Slot) == 128, "slot layout");
+  static_assert(std::is_trivially_copyable<Slot>::value,
+                "slots are written directly into the mapped file");
+
+  max_entries = std::min(std::max(max_entries, kWays), kMaxEntries);
+  const std::size_t new_capacity = (max_entries + kWays - 1) / kWays * kWays;
+
+  /* 作り直しと、他プロセスによる置き換えの検出で開き直す回数の上限です。 */
+  constexpr int kMaxAttempts = 8;
+  for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+      return;
+    }
+    lock();
+
+    struct stat st;
+    struct stat current;
+    if (::fstat(fd_, &st) != 0) {
+      break;
+    }
+    if (::stat(path.c_str(), &current) != 0 || current.st_dev != st.st_dev ||
+        current.st_ino != st.st_ino) {
+      /* ロックを待つ間に置き換えられたので、新しいファイルを開き直します。 */
+      unlock();
+      ::close(fd_);
+      fd_ = -1;
+      continue;
+    }
+
+    Header existing;
+    const bool valid =
+        ::pread(fd_, &existing, sizeof(existing), 0) ==
+            static_cast<ssize_t>(sizeof(existing)) &&
+        header_is_valid(existing, static_cast<std::uint64_t>(st.st_size));
+    if (!valid) {
+      const bool rebuilt = rebuild(path, new_capacity);
+      unlock();
+      ::close(fd_);
+      fd_ = -1;
+      if (!rebuilt) {
+        return;
+      }
+      continue;
+    }
+
+    capacity_ = static_cast<std::size_t>(existing.capacity);
+    map_bytes_ = static_cast<std::size_t>(st.st_size);
+    void* map = ::mmap(nullptr, map_bytes_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd_, 0);
+    if (map == MAP_FAILED) {
+      break;
+    }
+    map_ = map;
+    header_ = static_cast<Header*>(map_);
+    slots_ =
+        reinterpret_cast<Slot*>(static_cast<char*>(map_) + sizeof(Header));
+    unlock();
+    return;
+  }
+
+  if (fd_ >= 0) {
+    unlock();
+    ::close(fd_);
+    fd_ = -1;
+  }
+  capacity_ = 0;
+  map_bytes_ = 0;
+}
+
+/*
+ * @brief ファイルの対応付けを解除して閉じます（内容はカーネルが書き戻します）。
+ */
+ResultCache::~ResultCache() {
+  if (map_ != nullptr) {
+    ::munmap(map_, map_bytes_);
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+/*
+ * @brief ファイルを開けていれば true を返します。
+ *
+ * @return 開けていれば true
+ */
+bool ResultCache::is_open() const {
+  return map_ != nullptr;
+}
+
+/*
+ * @brief 設定と初期状態からキーを作ります。
+ *
+ * @param config レシピ
+ * @param initial 初期状態
+ * @return キー
+ */
+ResultCache::Key ResultCache::make_key(const SimulationConfig& config,
+                                       const TeaLeaf& initial) const {
+  const ModelParams params = make_model(config.model);
+  static_assert(sizeof(ModelParams) == 17 * sizeof(double),
+                "ModelParams is hashed as a flat array of coefficients");
+
+  Key key;
+  std::memset(&key, 0, sizeof(key));
+  key.params_hash = fnv1a(&params, sizeof(params));
+  key.model = static_cast<std::int32_t>(config.model);
+  key.dt_milliseconds =
+      static_cast<std::int32_t>(to_milliseconds(config.dt_seconds));
+  key.stage_seconds[0] = config.steaming_seconds;
+  key.stage_seconds[1] = config.rolling_seconds;
+  key.stage_seconds[2] = config.drying_seconds;
+  key.initial[0] = quantize_index(initial.moisture, quantization_.moisture);
+  key.initial[1] =
+      quantize_index(initial.temperature_c, quantization_.temperature_c);
+  key.initial[2] = quantize_index(initial.aroma, quantization_.aroma);
+  key.initial[3] = quantize_index(initial.color, quantization_.color);
+  return key;
+}
+
+/*
+ * @brief ハッシュに対応する組の先頭スロットを返します。
+ *
+ * 最下位ビットは空き判定のため常に 1 にしているので、組の選択には使いません。
+ *
+ * @param tag キーのハッシュ
+ * @return 組の先頭
+ */
+ResultCache::Slot* ResultCache::bucket(std::uint64_t tag) const {
+  const std::size_t sets = capacity_ / kWays;
+  return slots_ + (static_cast<std::size_t>((tag >> 1) % sets) * kWays);
+}
+
+/*
+ * @brief 他のプロセスと排他するためにファイルをロックします。
+ */
+void ResultCache::lock() const {
+  while (::flock(fd_, LOCK_EX) != 0 && errno == EINTR) {
+  }
+}
+
+/*
+ * @brief ファイルのロックを解除します。
+ */
+void ResultCache::unlock() const {
+  ::flock(fd_, LOCK_UN);
+}
+
+/*
+ * @brief 結果を探します。
+ *
+ * @param config レシピ
+ * @param initial 初期状態
+ * @return 見つかれば結果、無ければ std::nullopt
+ */
+std::optional<QueryResult> ResultCache::find(const SimulationConfig& config,
+                                             const TeaLeaf& initial) {
+  if (!is_open()) {
+    ++stats_.misses;
+    return std::nullopt;
+  }
+  const Key key = make_key(config, initial);
+  const std::uint64_t tag = fnv1a(&key, sizeof(key)) | 1;
+
+  lock();
+  Slot* set = bucket(tag);
+  for (std::size_t i = 0; i < kWays; ++i) {
+    Slot& slot = set[i];
+    if (slot.tag == tag && std::memcmp(&slot.key, &key, sizeof(key)) == 0) {
+      slot.last_used = ++header_->clock;
+      QueryResult result;
+      result.leaf.moisture = slot.leaf[0];
+      result.leaf.temperature_c = slot.leaf[1];
+      result.leaf.aroma = slot.leaf[2];
+      result.leaf.color = slot.leaf[3];
+      result.score = slot.score;
+      unlock();
+      ++stats_.hits;
+      return result;
+    }
+  }
+  unlock();
+  ++stats_.misses;
+  return std::nullopt;
+}
+
+/*
+ * @brief 結果を登録します。
+ *
+ * 組の中に同じキーか空きがあればそこへ、無ければ最も長く使われていない
+ * スロットへ書きます。書き込み中は tag を 0 にしておき、途中で止まっても
+ * 壊れたエントリが見つからないようにします。
+ *
+ * @param config レシピ
+ * @param initial 初期状態
+ * @param result 最終状態と品質スコア
+ */
+void ResultCache::store(const SimulationConfig& config,
+                        const TeaLeaf& initial,
+                        const QueryResult& result) {
+  if (!is_open()) {
+    return;
+  }
+  const Key key = make_key(config, initial);
+  const std::uint64_t tag = fnv1a(&key, sizeof(key)) | 1;
+
+  lock();
+  Slot* set = bucket(tag);
+  Slot* target = nullptr;
+  Slot* empty = nullptr;
+  Slot* oldest = &set[0];
+  for (std::size_t i = 0; i < kWays; ++i) {
+    Slot& slot = set[i];
+    if (slot.tag == tag && std::memcmp(&slot.key, &key, sizeof(key)) == 0) {
+      target = &slot;
+      break;
+    }
+    if (slot.tag == 0) {
+      if (empty == nullptr) {
+        empty = &slot;
+      }
+    } else if (slot.last_used < oldest->last_used) {
+      oldest = &slot;
+    }
+  }
+  if (target == nullptr && empty != nullptr) {
+    target = empty;
+    ++header_->entries;
+  } else if (target == nullptr) {
+    target = oldest;
+    ++stats_.evictions;
+  }
+
+  target->tag = 0;
+  target->key = key;
+  target->leaf[0] = result.leaf.moisture;
+  target->leaf[1] = result.leaf.temperature_c;
+  target->leaf[2] = result.leaf.aroma;
+  target->leaf[3] = result.leaf.color;
+  target->score = result.score;
+  target->last_used = ++header_->clock;
+  target->tag = tag;
+  unlock();
+}
+
+/*
+ * @brief 結果を探し、無ければ Simulator で計算して登録してから返します。
+ *
+ * 計算は量子化した初期状態で行うため、QueryBatcher の結果と一致します。
+ *
+ * @param config レシピ
+ * @param initial 初期状態
+ * @return 最終状態と品質スコア
+ */
+QueryResult ResultCache::evaluate(const SimulationConfig& config,
+                                  const TeaLeaf& initial) {
+  if (const std::optional<QueryResult> cached = find(config, initial)) {
+    return *cached;
+  }
+  /* 同じ格子点のどの要求から計算しても同じ結果になるよう、丸めた初期状態で計算します。 */
+  TeaLeaf snapped;
+  quantize_index(initial.moisture, quantization_.moisture, &snapped.moisture);
+  quantize_index(initial.temperature_c, quantization_.temperature_c,
+                 &snapped.temperature_c);
+  quantize_index(initial.aroma, quantization_.aroma, &snapped.aroma);
+  quantize_index(initial.color, quantization_.color, &snapped.color);
+
+  Simulator sim(config);
+  sim.set_initial_leaf(snapped);
+  while (sim.step(config.dt_seconds, nullptr)) {
+  }
+  QueryResult result;
+  result.leaf = sim.leaf();
+  result.score = ::tea_io::CsvWriter::quality_score(
+      result.leaf.moisture, result.leaf.aroma, result.leaf.color);
+  store(config, initial, result);
+  return result;
+}
+
+/*
+ * @brief 統計を返します。
+ *
+ * @return 統計
+ */
+const ResultCacheStats& ResultCache::stats() const {
+  return stats_;
+}
+
+/*
+ * @brief ファイル内の有効なエントリ数を返します。
+ *
+ * @return エントリ数
+ */
+std::size_t ResultCache::size() const {
+  if (!is_open()) {
+    return 0;
+  }
+  lock();
+  const std::size_t n = static_cast<std::size_t>(header_->entries);
+  unlock();
+  return n;
+}
+
+/*
+ * @brief エントリ数の上限を返します。
+ *
+ * @return スロット数
+ */
+std::size_t ResultCache::capacity() const {
+  return capacity_;
+}
+
+} /* namespace tea */
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "domain/TeaLeaf.h"
+#include "simulation/QueryBatcher.h"
+#include "simulation/Simulator.h"
+
+namespace tea {
+
+/* ResultCache の統計（このインスタンスで数えた分）です。 */
+struct ResultCacheStats final {
+  std::size_t hits = 0;      /* ファイルの結果を返した数 */
+  std::size_t misses = 0;    /* 見つからず計算した数 */
+  std::size_t evictions = 0; /* 容量超過で上書きしたエントリ数 */
+};
+
+/*
+  最終状態と品質スコアをファイルへ永続化する結果キャッシュです。
+  ファイルはヘッダと固定長スロットの配列で、mmap して直接読み書きします。
+  キーは (モデル係数のハッシュ, モデル, dt, 工程時間, 量子化した初期状態) で、
+  同じ格子点に落ちる初期状態は最初に計算した結果を共有します。
+
+  スロットは 8 本ずつの組（セット連想）に分かれ、キーのハッシュで組を選びます。
+  組が埋まっていれば、その中で最も長く使われていないものを上書きするため、
+  ファイルの大きさはエントリ数の上限で決まります。
+  複数のプロセスから同じファイルを使えるよう、操作ごとに flock で排他します。
+  既存のファイルはそのエントリ数の上限を引き継ぐため、上限の指定が違う
+  プロセス同士でも同じ表を共有します。形式の合わないファイルだけを、
+  一時ファイルに作って rename() で置き換えます（使用中のファイルは切り詰めません）。
+*/
+class ResultCache final {
+ public:
+  /* 既定のエントリ数の上限です。 */
+  static constexpr std::size_t kDefaultEntries = 65536;
+
+  /*
+    ファイルを開きます（無ければ作ります）。max_entries は新しく作るときの
+    上限で、8 の倍数へ切り上げます（既存のファイルは元の上限のまま使います）。
+  */
+  explicit ResultCache(const std::string& path,
+                       std::size_t max_entries = kDefaultEntries,
+                       const QueryQuantization& quantization = {});
+
+  /* ファイルの対応付けを解除して閉じます。 */
+  ~ResultCache();
+
+  ResultCache(const ResultCache&) = delete;
+  ResultCache& operator=(const ResultCache&) = delete;
+
+  /* ファイルを開けていれば true を返します。 */
+  bool is_open() const;
+
+  /* 結果を探します（見つからなければ std::nullopt）。 */
+  std::optional<QueryResult> find(const SimulationConfig& config,
+                                  const TeaLeaf& initial);
+
+  /* 結果を登録します（同じキーがあれば上書きします）。 */
+  void store(const SimulationConfig& config,
+             const TeaLeaf& initial,
+             const QueryResult& result);
+
+  /* 結果を探し、無ければ量子化した初期状態を Simulator で計算して登録してから返します。 */
+  QueryResult evaluate(const SimulationConfig& config, const TeaLeaf& initial);
+
+  /* 統計を返します。 */
+  const ResultCacheStats& stats() const;
+
+  /* ファイル内の有効なエントリ数を返します。 */
+  std::size_t size() const;
+
+  /* エントリ数の上限を返します。 */
+  std::size_t capacity() const;
+
+ private:
+  struct Header;
+  struct Slot;
+  struct Key;
+
+  static bool header_is_valid(const Header& h, std::uint64_t file_bytes);
+  static bool rebuild(const std::string& path, std::size_t capacity);
+
+  Key make_key(const SimulationConfig& config, const TeaLeaf& initial) const;
+  Slot* bucket(std::uint64_t tag) const;
+  void lock() const;
+  void unlock() const;
+
+  QueryQuantization quantization_;
+  int fd_ = -1;
+  void* map_ = nullptr;
+  std::size_t map_bytes_ = 0;
+  Header* header_ = nullptr;
+  Slot* slots_ = nullptr;
+  std::size_t capacity_ = 0;
+  ResultCacheStats stats_;
+};
+
+} /* namespace tea */
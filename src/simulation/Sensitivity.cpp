@@ -0,0 +1,181 @@
+/*
+ * @file Sensitivity.cpp
+ * @brief 前進モードの自動微分による、パラメータ感度の算出
+ *
+ * 工程の更新式（process/StepKernels.h）を双対数 Dual<N> で評価し、
+ * 1 回の実行で最終状態と品質スコアの全パラメータに対する偏微分を求めます。
+ */
+
+#include "simulation/Sensitivity.h"
+
+#include <cstddef>
+
+#include "simulation/StageRunner.h"
+
+namespace tea {
+
+namespace {
+
+/* パラメータの表示名です（順序は params_of と同じです）。 */
+constexpr const char* kParamNames[kModelParamCount] = {
+    "steaming.target_temp_c",
+    "steaming.heat_k",
+    "steaming.moisture_gain_per_s",
+    "steaming.aroma_gain_per_s",
+    "steaming.color_gain_per_s",
+    "rolling.target_temp_c",
+    "rolling.cool_k",
+    "rolling.moisture_loss_k",
+    "rolling.aroma_gain_per_s",
+    "rolling.color_gain_per_s",
+    "drying.target_temp_c",
+    "drying.temp_k",
+    "drying.dry_k",
+    "drying.aroma_recover_per_s",
+    "drying.overheat_c",
+    "drying.aroma_damage_k",
+    "drying.color_gain_per_s",
+};
+
+/*
+ * @brief パラメータへのポインタを、表示名と同じ順序で並べて返します。
+ *
+ * @param p 工程別パラメータ
+ * @return 各パラメータへのポインタ
+ */
+template <typename T, typename Params>
+std::array<T*, kModelParamCount> params_of(Params& p) {
+  return {&p.steaming.target_temp_c,    &p.steaming.heat_k,
+          &p.steaming.moisture_gain_per_s, &p.steaming.aroma_gain_per_s,
+          &p.steaming.color_gain_per_s, &p.rolling.target_temp_c,
+          &p.rolling.cool_k,            &p.rolling.moisture_loss_k,
+          &p.rolling.aroma_gain_per_s,  &p.rolling.color_gain_per_s,
+          &p.drying.target_temp_c,      &p.drying.temp_k,
+          &p.drying.dry_k,              &p.drying.aroma_recover_per_s,
+          &p.drying.overheat_c,         &p.drying.aroma_damage_k,
+          &p.drying.color_gain_per_s};
+}
+
+/*
+ * @brief 品質スコアを数値型 T で求めます（CsvWriter::quality_score と同じ式と演算順序）。
+ */
+template <typename T>
+T quality_score_of(const TeaLeafT<T>& leaf) {
+  const T score = leaf.aroma * T(0.4) + leaf.color * T(0.4) +
+                  (T(1.0) - leaf.moisture) * T(100.0) * T(0.2);
+  return clamp(score, T(0.0), T(100.0));
+}
+
+} /* namespace */
+
+/*
+ * @brief i 番目のパラメータの表示名を返します。
+ *
+ * @param i パラメータの番号（0..kModelParamCount-1）
+ * @return 表示名（範囲外なら "unknown"）
+ */
+const char* model_param_name(int i) {
+  if (i < 0 || i >= kModelParamCount) {
+    return "unknown";
+  }
+  return kParamNames[i];
+}
+
+/*
+ * @brief i 番目のパラメータの値を返します。
+ *
+ * @param params 工程別パラメータ
+ * @param i パラメータの番号（0..kModelParamCount-1）
+ * @return 値（範囲外なら 0）
+ */
+double model_param_value(const ModelParams& params, int i) {
+  if (i < 0 || i >= kModelParamCount) {
+    return 0.0;
+  }
+  return *params_of<const double>(params)[static_cast<std::size_t>(i)];
+}
+
+/*
+ * @brief i 番目のパラメータへ値を設定します。
+ *
+ * @param params 工程別パラメータ
+ * @param i パラメータの番号（0..kModelParamCount-1、範囲外は無視）
+ * @param value 設定する値
+ */
+void set_model_param_value(ModelParams& params, int i, double value) {
+  if (i < 0 || i >= kModelParamCount) {
+    return;
+  }
+  *params_of<double>(params)[static_cast<std::size_t>(i)] = value;
+}
+
+/*
+ * @brief 各係数を自動微分の入力とした双対数のパラメータを返します。
+ *
+ * @param params 微分の基点とする工程別パラメータ
+ * @return i 番目の係数の微分が単位ベクトル e_i のパラメータ
+ */
+ModelParamsT<ParamDual> make_dual_params(const ModelParams& params) {
+  ModelParamsT<ParamDual> p;
+  const std::array<ParamDual*, kModelParamCount> vars = params_of<ParamDual>(p);
+  for (int i = 0; i < kModelParamCount; ++i) {
+    *vars[static_cast<std::size_t>(i)] =
+        ParamDual::variable(model_param_value(params, i), i);
+  }
+  return p;
+}
+
+/*
+ * @brief レシピを双対数で 1 回実行し、最終状態の全パラメータに対する偏微分を求めます。
+ *
+ * @param config 実行設定（工程時間と dt を使用。model は無視）
+ * @param params 微分の基点とする工程別パラメータ
+ * @param initial 初期状態（定義域へ正規化します）
+ * @return 最終状態、品質スコアと各量の偏微分
+ */
+SensitivityResult compute_sensitivity(const SimulationConfig& config,
+                                      const ModelParams& params,
+                                      const TeaLeaf& initial) {
+  const ModelParamsT<ParamDual> p = make_dual_params(params);
+
+  TeaLeafT<ParamDual> leaf;
+  leaf.moisture = initial.moisture;
+  leaf.temperature_c = initial.temperature_c;
+  leaf.aroma = initial.aroma;
+  leaf.color = initial.color;
+  normalize(leaf);
+
+  run_stage(ProcessState::STEAMING, p, leaf, config.steaming_seconds,
+            config.dt_seconds);
+  run_stage(ProcessState::ROLLING, p, leaf, config.rolling_seconds,
+            config.dt_seconds);
+  run_stage(ProcessState::DRYING, p, leaf, config.drying_seconds,
+            config.dt_seconds);
+  const ParamDual score = quality_score_of(leaf);
+
+  SensitivityResult out;
+  out.leaf.moisture = leaf.moisture.v;
+  out.leaf.temperature_c = leaf.temperature_c.v;
+  out.leaf.aroma = leaf.aroma.v;
+  out.leaf.color = leaf.color.v;
+  out.score = score.v;
+  out.moisture = leaf.moisture.d;
+  out.aroma = leaf.aroma.d;
+  out.color = leaf.color.d;
+  out.score_gradient = score.d;
+  return out;
+}
+
+/*
+ * @brief config.model のパラメータを基点に感度を求めます。
+ *
+ * @param config 実行設定
+ * @param initial 初期状態
+ * @return 最終状態、品質スコアと各量の偏微分
+ */
+SensitivityResult compute_sensitivity(const SimulationConfig& config,
+                                      const TeaLeaf& initial) {
+  return compute_sensitivity(config, make_model(config.model), initial);
+}
+
+} /* namespace tea */
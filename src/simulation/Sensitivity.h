@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+
+#include "domain/Dual.h"
+#include "domain/Model.h"
+#include "domain/TeaLeaf.h"
+#include "simulation/Simulator.h"
+
+namespace tea {
+
+/* 微分の対象とするパラメータの数（蒸し 5 + 揉捻 5 + 乾燥 7）です。 */
+constexpr int kModelParamCount = 17;
+
+/* i 番目のパラメータの表示名（"steaming.heat_k" など）を返します。 */
+const char* model_param_name(int i);
+
+/* i 番目のパラメータの値を返します。 */
+double model_param_value(const ModelParams& params, int i);
+
+/* i 番目のパラメータへ value を設定します（範囲外の i は無視します）。 */
+void set_model_param_value(ModelParams& params, int i, double value);
+
+/* 全パラメータに対する微分を持つ双対数です。 */
+using ParamDual = Dual<kModelParamCount>;
+
+/* params の各係数を、i 番目の微分が単位ベクトルの入力とした双対数のパラメータを返します。 */
+ModelParamsT<ParamDual> make_dual_params(const ModelParams& params);
+
+/* 最終状態の各量の、全パラメータに対する偏微分です。 */
+using ParamGradient = std::array<double, kModelParamCount>;
+
+/* 感度解析の結果です。 */
+struct SensitivityResult final {
+  TeaLeaf leaf;       /* 最終状態（Simulator の結果と一致します） */
+  double score = 0.0; /* 最終の品質スコア */
+  ParamGradient moisture{};
+  ParamGradient aroma{};
+  ParamGradient color{};
+  ParamGradient score_gradient{};
+};
+
+/*
+  config のレシピを 1 回だけ実行し、最終の水分・香気・色・品質スコアの
+  全パラメータ（params）に対する偏微分を前進モードの自動微分で求めます。
+  更新式は StepKernels.h を双対数 Dual<kModelParamCount> で評価するため、
+  有限差分のようにパラメータごとに再実行する必要がなく、刻み幅の選び方による
+  誤差もありません。clamp で定義域の端に張り付いた量と、乾燥の香気の式の
+  切り替え（overheat_c をまたぐ時刻の移動）の寄与は微分に含みません。
+*/
+SensitivityResult compute_sensitivity(const SimulationConfig& config,
+                                      const ModelParams& params,
+                                      const TeaLeaf& initial = TeaLeaf());
+
+/* config.model のパラメータで compute_sensitivity を行います。 */
+SensitivityResult compute_sensitivity(const SimulationConfig& config,
+                                      const TeaLeaf& initial = TeaLeaf());
+
+} /* namespace tea */
@@ -6,13 +6,24 @@
 #include <string>
 
 #include "domain/ProcessState.h"
+#include "domain/TimeStep.h"
 #include "io/CsvWriter.h"
-#include "process/DryingProcess.h"
-#include "process/RollingProcess.h"
-#include "process/SteamingProcess.h"
+#include "perf/Stats.h"
+#include "perf/Trace.h"
+#include "simulation/StageRunner.h"
 
 namespace tea {
 
+/* 記録間隔が dt の何ステップ分かを返します。 */
+int sample_substeps(const SimulationConfig& config) {
+  const std::int64_t dt_ms = to_milliseconds(config.dt_seconds);
+  const std::int64_t sample_ms = to_milliseconds(config.sample_seconds);
+  if (dt_ms <= 0 || sample_ms <= dt_ms) {
+    return 1;
+  }
+  return static_cast<int>(std::min<std::int64_t>(sample_ms / dt_ms, 1 << 30));
+}
+
 /* 既定設定で構築します。 */
 Simulator::Simulator() : Simulator(SimulationConfig()) {
 }
@@ -20,9 +31,7 @@ Simulator::Simulator() : Simulator(SimulationConfig()) {
 /* 設定を指定して構築します。 */
 Simulator::Simulator(SimulationConfig config) : config_(config) {
   build_default_stages();
-  stage_index_ = 0;
-  stage_remaining_seconds_ =
-      stages_.empty() ? 0 : stages_.front().duration_seconds;
+  restart();
 }
 
 /* 初期状態を設定します。 */
@@ -38,15 +47,15 @@ void Simulator::build_default_stages() {
   const ModelParams model = make_model(config_.model);
 
   stages_.push_back(Stage{
-    std::make_unique<SteamingProcess>(model.steaming),
+    make_process(ProcessState::STEAMING, model),
     config_.steaming_seconds
   });
   stages_.push_back(Stage{
-    std::make_unique<RollingProcess>(model.rolling),
+    make_process(ProcessState::ROLLING, model),
     config_.rolling_seconds
   });
   stages_.push_back(Stage{
-    std::make_unique<DryingProcess>(model.drying),
+    make_process(ProcessState::DRYING, model),
     config_.drying_seconds
   });
 }
@@ -58,56 +67,115 @@ void Simulator::run(std::ostream& os) {
 
 /* CSV出力を伴って全工程を実行します。 */
 void Simulator::run(std::ostream& os, ::tea_io::CsvWriter* csv) {
-  elapsed_seconds_ = 0;
-  stage_index_ = 0;
-  stage_remaining_seconds_ =
-      stages_.empty() ? 0 : stages_.front().duration_seconds;
+  if (csv != nullptr) {
+    CsvTraceRecorder recorder(*csv);
+    run(os, recorder);
+  } else {
+    NullTraceRecorder recorder;
+    run(os, recorder);
+  }
+}
+
+/* 1 ステップ進め、csv があれば 1 行書き出します。完了済みなら false を返します。 */
+bool Simulator::step(double dt_seconds, ::tea_io::CsvWriter* csv) {
+  return step(dt_seconds, 1, csv);
+}
 
-  while (step(config_.dt_seconds, csv)) {
-    log_step(os, current_process(), elapsed_seconds_);
+/* 最大 substeps ステップ進め、csv があれば 1 行書き出します。 */
+bool Simulator::step(double dt_seconds,
+                     int substeps,
+                     ::tea_io::CsvWriter* csv) {
+  if (csv != nullptr) {
+    CsvTraceRecorder recorder(*csv);
+    return step(dt_seconds, substeps, recorder);
   }
+  NullTraceRecorder recorder;
+  return step(dt_seconds, substeps, recorder);
+}
+
+/* 経過時間と工程を先頭へ戻します。 */
+void Simulator::restart() {
+  elapsed_ms_ = 0;
+  stage_index_ = 0;
+  stage_remaining_ms_ =
+      stages_.empty()
+          ? 0
+          : stages_.front().duration_seconds * kMillisecondsPerSecond;
 }
 
-/* 1 ステップ進めます。完了済みなら false を返します。 */
-bool Simulator::step(int dt_seconds, ::tea_io::CsvWriter* csv) {
+/* 出力を伴わずに最大 substeps ステップ進めます。完了済みなら false を返します。 */
+bool Simulator::advance(double dt_seconds, int substeps) {
   /*
-    dt_seconds は正の整数を想定します。
-    不正値（0以下）は進捗が生まれず呼び出し側で無限ループの原因になるため、
+    dt は 1 ms 単位の正の値を想定します（時刻はミリ秒の整数で数えます）。
+    不正値（1 ms 未満）は進捗が生まれず呼び出し側で無限ループの原因になるため、
     ここで弾きます。
   */
-  if (dt_seconds <= 0) {
+  const std::int64_t dt_ms = to_milliseconds(dt_seconds);
+  if (dt_ms <= 0 || substeps <= 0) {
     return false;
   }
 
   if (stages_.empty() || stage_index_ >= stages_.size()) {
     return false;
   }
-  if (stage_remaining_seconds_ <= 0) {
+  if (stage_remaining_ms_ <= 0) {
     ++stage_index_;
     if (stage_index_ >= stages_.size()) {
+      ::tea_perf::trace_instant(to_string(ProcessState::FINISHED), "stage",
+                                "elapsed_ms", elapsed_ms_);
       return false;
     }
-    stage_remaining_seconds_ = stages_[stage_index_].duration_seconds;
+    stage_remaining_ms_ =
+        stages_[stage_index_].duration_seconds * kMillisecondsPerSecond;
+    ::tea_perf::trace_instant(to_string(stages_[stage_index_].process->state()),
+                              "stage", "elapsed_ms", elapsed_ms_);
   }
 
   /*
     dt が工程時間で割り切れない場合でも、工程時間ぴったりで進むように
     残り時間に応じて最後のステップ幅を調整します。
+    残りに収まる分の dt ステップはまとめて適用し、工程の終わりに
+    端数が残る場合だけ残り時間ちょうどの 1 ステップを足します
+    （工程時間が負の場合もそのまま 1 ステップとして適用します）。
   */
   const Stage& stage = stages_[stage_index_];
-  const int step = std::min(dt_seconds, stage_remaining_seconds_);
-  stage.process->apply_step(leaf_, step);
-  elapsed_seconds_ += step;
-  stage_remaining_seconds_ -= step;
-
-  if (csv != nullptr) {
-    csv->write_row(to_string(stage.process->state()),
-                   elapsed_seconds_,
-                   leaf_.moisture,
-                   leaf_.temperature_c,
-                   leaf_.aroma,
-                   leaf_.color);
+  const std::int64_t full =
+      stage_remaining_ms_ > 0
+          ? std::min<std::int64_t>(substeps, stage_remaining_ms_ / dt_ms)
+          : 0;
+  std::int64_t advanced_ms = full * dt_ms;
+  int steps = static_cast<int>(full);
+  {
+    TEA_STATS_TIMER(PHYSICS);
+    if (full > 0) {
+      stage.process->apply_steps(leaf_, to_seconds(dt_ms), steps);
+    }
+    if (full < substeps && advanced_ms != stage_remaining_ms_) {
+      const std::int64_t last_ms = stage_remaining_ms_ - advanced_ms;
+      stage.process->apply_step(leaf_, to_seconds(last_ms));
+      advanced_ms += last_ms;
+      ++steps;
+    }
+  }
+#if TEA_ENABLE_STATS
+  switch (stage.process->state()) {
+    case ProcessState::STEAMING:
+      TEA_STATS_ADD(STEAMING_STEPS, steps);
+      break;
+    case ProcessState::ROLLING:
+      TEA_STATS_ADD(ROLLING_STEPS, steps);
+      break;
+    case ProcessState::DRYING:
+      TEA_STATS_ADD(DRYING_STEPS, steps);
+      break;
+    case ProcessState::FINISHED:
+      break;
   }
+#else
+  (void)steps;
+#endif
+  elapsed_ms_ += advanced_ms;
+  stage_remaining_ms_ -= advanced_ms;
   return true;
 }
 
@@ -125,19 +193,26 @@ const TeaLeaf& Simulator::leaf() const {
 }
 
 /* 経過時間（秒）を返します。 */
-int Simulator::elapsed_seconds() const {
-  return elapsed_seconds_;
+double Simulator::elapsed_seconds() const {
+  return to_seconds(elapsed_ms_);
+}
+
+/* 経過時間（ミリ秒）を返します。 */
+std::int64_t Simulator::elapsed_milliseconds() const {
+  return elapsed_ms_;
 }
 
 /* 1 ステップのログ行を出力します。 */
 void Simulator::log_step(std::ostream& os,
                          ProcessState state,
-                         int elapsed_seconds) {
+                         double elapsed_seconds) {
   /*
     ログは「工程名 + 経過時間 + 状態量」を固定フォーマットで出します。
     例:
       [STEAMING] t=30s moisture=0.78 temp=95.0 aroma=40.0 color=10.0
   */
+  TEA_STATS_TIMER(LOG_FORMAT);
+  TEA_STATS_ADD(LOG_LINES, 1);
   const char* label = to_string(state);
   os << '[' << label << ']';
   {
@@ -149,7 +224,11 @@ void Simulator::log_step(std::ostream& os,
     const int pad = std::max(0, 11 - used);
     os << std::string(static_cast<std::size_t>(pad), ' ');
   }
-  os << "t=" << elapsed_seconds << "s ";
+  {
+    char t[32];
+    ::tea_io::CsvWriter::format_elapsed(t, sizeof(t), elapsed_seconds);
+    os << "t=" << t << "s ";
+  }
 
   os << std::fixed << std::setprecision(2);
   os << "moisture=" << leaf_.moisture << ' ';
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <iosfwd>
 #include <memory>
 #include <vector>
@@ -7,6 +8,7 @@
 #include "domain/Model.h"
 #include "domain/TeaLeaf.h"
 #include "process/IProcess.h"
+#include "simulation/TraceRecorder.h"
 
 namespace tea_io {
 class CsvWriter;
@@ -16,13 +18,25 @@ namespace tea {
 
 /* シミュレーションの実行設定です。 */
 struct SimulationConfig final {
-  int dt_seconds = 1;         /* 時間刻み [s] */
+  double dt_seconds = 1.0;    /* 時間刻み [s]（1 ms 単位、1 秒未満も可） */
   int steaming_seconds = 30;  /* 蒸し工程の時間 [s] */
   int rolling_seconds = 30;   /* 揉捻工程の時間 [s] */
   int drying_seconds = 60;    /* 乾燥工程の時間 [s] */
   ModelType model = ModelType::DEFAULT; /* モデル（係数セット） */
+
+  /*
+    記録（ログ・CSV の行）の間隔 [s] です（dt の整数倍、0 以下なら毎ステップ）。
+    細かい dt で長い工程を進めるときに、行数を dt と切り離すために使います。
+  */
+  double sample_seconds = 0.0;
 };
 
+/*
+  config の記録間隔が dt の何ステップ分かを返します（1 以上）。
+  記録間隔が dt の整数倍でない場合は切り捨てます。
+*/
+int sample_substeps(const SimulationConfig& config);
+
 /* 製造工程シミュレーションを統括し、工程遷移とログ出力を行います。 */
 class Simulator final {
  public:
@@ -41,8 +55,45 @@ class Simulator final {
   /* CSV出力を伴って全工程を実行します（csv が null の場合は無効）。 */
   void run(std::ostream& os, ::tea_io::CsvWriter* csv);
 
+  /* 記録間隔（sample_seconds）ごとに recorder へ記録しながら全工程を実行します。 */
+  template <typename Recorder>
+  void run(std::ostream& os, Recorder& recorder) {
+    restart();
+    const int substeps = sample_substeps(config_);
+    while (step(config_.dt_seconds, substeps, recorder)) {
+      log_step(os, current_process(), elapsed_seconds());
+    }
+  }
+
   /* 1 ステップ進めます。完了済みなら false を返します。 */
-  bool step(int dt_seconds, ::tea_io::CsvWriter* csv);
+  bool step(double dt_seconds, ::tea_io::CsvWriter* csv);
+
+  /*
+    1 ステップ進め、進んだ後の状態を recorder へ渡します。完了済みなら false を返します。
+    recorder は record(ProcessState, double, const TeaLeaf&) を持つ型です（TraceRecorder 参照）。
+  */
+  template <typename Recorder>
+  bool step(double dt_seconds, Recorder& recorder) {
+    return step(dt_seconds, 1, recorder);
+  }
+
+  /* dt 秒のステップを最大 substeps 回進めてから 1 行記録します（下記参照）。 */
+  bool step(double dt_seconds, int substeps, ::tea_io::CsvWriter* csv);
+
+  /*
+    dt 秒のステップを最大 substeps 回進め、進んだ後の状態を recorder へ 1 回だけ
+    渡します。工程の終わりではそこで止まるため、step(dt) を substeps 回呼んで
+    最後の状態だけ記録するのと同じ結果になります（途中のステップは
+    IProcess::apply_steps でまとめて適用します）。完了済みなら false を返します。
+  */
+  template <typename Recorder>
+  bool step(double dt_seconds, int substeps, Recorder& recorder) {
+    if (!advance(dt_seconds, substeps)) {
+      return false;
+    }
+    recorder.record(current_process(), elapsed_seconds(), leaf_);
+    return true;
+  }
 
   /* 現在工程を返します（完了時は FINISHED を返します）。 */
   ProcessState current_process() const;
@@ -51,7 +102,10 @@ class Simulator final {
   const TeaLeaf& leaf() const;
 
   /* 経過時間（秒）を返します。 */
-  int elapsed_seconds() const;
+  double elapsed_seconds() const;
+
+  /* 経過時間（ミリ秒）を返します。 */
+  std::int64_t elapsed_milliseconds() const;
 
  private:
   /* 工程と継続時間を束ねたステージです。 */
@@ -63,16 +117,22 @@ class Simulator final {
   /* 既定のステージ構成を構築します。 */
   void build_default_stages();
 
+  /* 経過時間と工程を先頭へ戻します（茶葉状態はそのままです）。 */
+  void restart();
+
+  /* 出力を伴わずに最大 substeps ステップ進めます。完了済みなら false を返します。 */
+  bool advance(double dt_seconds, int substeps);
+
   /* 1 行分のログを出力します。 */
-  void log_step(std::ostream& os, ProcessState state, int elapsed_seconds);
+  void log_step(std::ostream& os, ProcessState state, double elapsed_seconds);
 
   SimulationConfig config_;
   TeaLeaf leaf_;
-  int elapsed_seconds_ = 0;
+  std::int64_t elapsed_ms_ = 0;
   std::vector<Stage> stages_;
 
   std::size_t stage_index_ = 0;
-  int stage_remaining_seconds_ = 0;
+  std::int64_t stage_remaining_ms_ = 0;
 };
 
 } /* namespace tea */
@@ -0,0 +1,77 @@
+/*
+ * @file StageRunner.cpp
+ * @brief 工程単位の実行ユーティリティ
+ *
+ * Simulator の工程構築と、1 工程分だけをまとめて進める処理を提供します。
+ * 最適化やスイープで「工程境界の状態」を再利用するための土台です。
+ */
+
+#include "simulation/StageRunner.h"
+
+#include <algorithm> // For std::min
+#include <cstdint>
+#include <limits>
+
+#include "domain/TimeStep.h"
+#include "process/DryingProcess.h"
+#include "process/RollingProcess.h"
+#include "process/SteamingProcess.h"
+
+namespace tea {
+
+/*
+ * @brief 工程種別とモデルから工程オブジェクトを生成します。
+ *
+ * @param state 工程種別
+ * @param model 工程別パラメータ
+ * @return 工程オブジェクト（FINISHED の場合は null）
+ */
+std::unique_ptr<IProcess> make_process(ProcessState state,
+                                       const ModelParams& model) {
+  switch (state) {
+    case ProcessState::STEAMING:
+      return std::make_unique<SteamingProcess>(model.steaming);
+    case ProcessState::ROLLING:
+      return std::make_unique<RollingProcess>(model.rolling);
+    case ProcessState::DRYING:
+      return std::make_unique<DryingProcess>(model.drying);
+    case ProcessState::FINISHED:
+      break;
+  }
+  return nullptr;
+}
+
+/*
+ * @brief 1 工程を duration_seconds だけ進めます。
+ *
+ * 残りに収まる dt ステップはまとめて適用し、dt が工程時間で割り切れない
+ * 場合は、最後のステップ幅を残り時間に合わせます。
+ *
+ * @param process 適用する工程
+ * @param leaf 更新する茶葉
+ * @param duration_seconds 工程時間（秒）
+ * @param dt_seconds 時間刻み（秒、1 ms 未満なら何もしません）
+ */
+void run_stage(const IProcess& process,
+               TeaLeaf& leaf,
+               int duration_seconds,
+               double dt_seconds) {
+  const std::int64_t dt_ms = to_milliseconds(dt_seconds);
+  if (dt_ms <= 0 || duration_seconds <= 0) {
+    return;
+  }
+  const std::int64_t duration_ms = duration_seconds * kMillisecondsPerSecond;
+  const std::int64_t full = duration_ms / dt_ms;
+  for (std::int64_t done = 0; done < full;) {
+    const int n = static_cast<int>(std::min<std::int64_t>(
+        full - done, std::numeric_limits<int>::max()));
+    process.apply_steps(leaf, to_seconds(dt_ms), n);
+    done += n;
+  }
+  const std::int64_t last_ms = duration_ms - full * dt_ms;
+  if (last_ms > 0) {
+    process.apply_step(leaf, to_seconds(last_ms));
+  }
+}
+
+} /* namespace tea */
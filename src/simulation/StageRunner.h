@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "domain/Model.h"
+#include "domain/ProcessState.h"
+#include "domain/TeaLeaf.h"
+#include "domain/TimeStep.h"
+#include "process/IProcess.h"
+#include "process/StepKernels.h"
+
+namespace tea {
+
+/* 工程種別とモデルから工程オブジェクトを生成します（FINISHED は null）。 */
+std::unique_ptr<IProcess> make_process(ProcessState state,
+                                       const ModelParams& model);
+
+/*
+  1 工程を duration_seconds だけ進めます。
+  Simulator::step と同じく min(dt, 残り時間) で（ミリ秒単位で）刻むため、
+  工程ごとに分割して呼んでも全体実行と同じ結果になります。
+*/
+void run_stage(const IProcess& process,
+               TeaLeaf& leaf,
+               int duration_seconds,
+               double dt_seconds);
+
+/*
+  1 工程を数値型 T の更新式（StepKernels.h）で duration_seconds だけ進めます。
+  刻み方は上の run_stage と同じで、T=double なら結果も一致します。
+  T に双対数（Dual.h）を使うと、パラメータに対する微分も同時に進みます。
+*/
+template <typename T>
+void run_stage(ProcessState stage,
+               const ModelParamsT<T>& params,
+               TeaLeafT<T>& leaf,
+               int duration_seconds,
+               double dt_seconds) {
+  const std::int64_t dt_ms = to_milliseconds(dt_seconds);
+  if (dt_ms <= 0 || duration_seconds <= 0) {
+    return;
+  }
+  const std::int64_t duration_ms = duration_seconds * kMillisecondsPerSecond;
+  const std::int64_t full = duration_ms / dt_ms;
+  const std::int64_t last_ms = duration_ms - full * dt_ms;
+  const T dt(to_seconds(dt_ms));
+  const T last(to_seconds(last_ms));
+  switch (stage) {
+    case ProcessState::STEAMING:
+      for (std::int64_t i = 0; i < full; ++i) {
+        steaming_step(params.steaming, leaf, dt);
+      }
+      if (last_ms > 0) {
+        steaming_step(params.steaming, leaf, last);
+      }
+      break;
+    case ProcessState::ROLLING:
+      for (std::int64_t i = 0; i < full; ++i) {
+        rolling_step(params.rolling, leaf, dt);
+      }
+      if (last_ms > 0) {
+        rolling_step(params.rolling, leaf, last);
+      }
+      break;
+    case ProcessState::DRYING: {
+      const T decay = drying_decay(params.drying, dt);
+      for (std::int64_t i = 0; i < full; ++i) {
+        drying_step(params.drying, leaf, dt, decay);
+      }
+      if (last_ms > 0) {
+        drying_step(params.drying, leaf, last);
+      }
+      break;
+    }
+    case ProcessState::FINISHED:
+      break;
+  }
+}
+
+} /* namespace tea */
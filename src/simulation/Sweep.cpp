@@ -0,0 +1,296 @@
+/*
+ * @file Sweep.cpp
+ * @brief 工程時間・乾燥パラメータのスイープのプロセス内実行
+ *
+ * CLI を繰り返し起動する代わりに、工程時間と乾燥パラメータの直積を
+ * 1 プロセス内で評価します。
+ * 工程境界の状態は PrefixStateCache で再利用します。
+ */
+
+#include "simulation/Sweep.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "domain/TimeStep.h"
+#include "io/CsvWriter.h"
+#include "process/StepKernels.h"
+
+namespace tea {
+
+namespace {
+
+/* 上限と比べるときに、閉じた式と逐次計算の丸め誤差の分だけ残す余裕です。 */
+constexpr double kPruneMargin = 1e-9;
+
+/* 工程時間を dt の刻み数と、工程の終わりの端数の刻み [s] に分けたものです。 */
+struct StageSteps final {
+  double steps = 0.0; /* dt 秒の刻みの数 */
+  double dt = 0.0;    /* 刻み [s] */
+  double last = 0.0;  /* 端数の刻み [s]（無ければ 0） */
+};
+
+/*
+ * @brief 工程時間を run_stage と同じ刻み（dt と端数 1 回）に分けます。
+ */
+StageSteps split_stage(int duration_seconds, std::int64_t dt_ms) {
+  StageSteps s;
+  const std::int64_t total_ms =
+      std::max(0, duration_seconds) * kMillisecondsPerSecond;
+  s.steps = static_cast<double>(total_ms / dt_ms);
+  s.dt = to_seconds(dt_ms);
+  s.last = to_seconds(total_ms % dt_ms);
+  return s;
+}
+
+/*
+ * @brief 100 へ飽和する更新 x + g dt (1 - x / 100) を工程の終わりまで進めた値の上限です。
+ *
+ * 1 刻みの係数 1 - g dt / 100 が [0, 1] なら更新は x について単調増加で、
+ * 時間が長いほど 100 へ近づくため、最長の工程時間での値が上限になります。
+ */
+double saturating_upper(double x, double gain_per_s, const StageSteps& s) {
+  if (!(gain_per_s > 0.0)) {
+    return x;
+  }
+  const double f = 1.0 - gain_per_s * s.dt / 100.0;
+  const double f_last = 1.0 - gain_per_s * s.last / 100.0;
+  if (!(f >= 0.0 && f <= 1.0 && f_last >= 0.0 && f_last <= 1.0)) {
+    return 100.0;
+  }
+  return std::min(100.0, 100.0 - (100.0 - x) * std::pow(f, s.steps) * f_last);
+}
+
+/*
+ * @brief 揉捻の水分の更新 m - L dt (0.4 + 0.6 m) を工程の終わりまで進めた値の下限です。
+ */
+double rolling_moisture_lower(double m, double loss_k, const StageSteps& s) {
+  if (!(loss_k > 0.0)) {
+    return m;
+  }
+  const double a = 1.0 - 0.6 * loss_k * s.dt;
+  const double a_last = 1.0 - 0.6 * loss_k * s.last;
+  if (!(a >= 0.0 && a_last >= 0.0)) {
+    return 0.0;
+  }
+  /* m_{n+1} = a m_n + b は不動点 -2/3 へ単調に近づきます。 */
+  const double fixed = -2.0 / 3.0;
+  const double m_n = fixed + (m - fixed) * std::pow(a, s.steps);
+  return std::max(0.0, a_last * m_n - 0.4 * loss_k * s.last);
+}
+
+} /* namespace */
+
+/*
+ * @brief 残りの工程で到達し得る品質スコアの上限を返します。
+ *
+ * @param params 工程別パラメータ
+ * @param dt_seconds 時間刻み（秒）
+ * @param leaf first_stage 番目の工程の直前の状態
+ * @param first_stage 残りの最初の工程（0: 蒸し, 1: 揉捻, 2: 乾燥, 3 以上なら残り無し）
+ * @param max_durations 各工程の最長の工程時間（first_stage より前は使いません）
+ * @return 品質スコアの上限（0-100）
+ */
+double quality_upper_bound(const ModelParams& params,
+                           double dt_seconds,
+                           const TeaLeaf& leaf,
+                           int first_stage,
+                           const std::array<int, 3>& max_durations) {
+  const std::int64_t dt_ms = to_milliseconds(dt_seconds);
+  TeaLeaf bound = leaf;
+  normalize(bound);
+  if (dt_ms <= 0) {
+    return 100.0;
+  }
+
+  double moisture = bound.moisture; /* 水分は下限、香気と色は上限を追います。 */
+  double aroma = bound.aroma;
+  double color = bound.color;
+  for (int stage = std::max(0, first_stage); stage < 3; ++stage) {
+    const StageSteps s =
+        split_stage(max_durations[static_cast<std::size_t>(stage)], dt_ms);
+    if (stage == 0) {
+      const SteamingParams& p = params.steaming;
+      /* 蒸しは水分を足すだけなので、加える量が負の場合だけ下限が下がります。 */
+      if (p.moisture_gain_per_s < 0.0) {
+        moisture = std::max(0.0, moisture + p.moisture_gain_per_s *
+                                                (s.steps * s.dt + s.last));
+      }
+      aroma = saturating_upper(aroma, p.aroma_gain_per_s, s);
+      color = saturating_upper(color, p.color_gain_per_s, s);
+    } else if (stage == 1) {
+      const RollingParams& p = params.rolling;
+      moisture = rolling_moisture_lower(moisture, p.moisture_loss_k, s);
+      aroma = saturating_upper(aroma, p.aroma_gain_per_s, s);
+      color = saturating_upper(color, p.color_gain_per_s, s);
+    } else {
+      const DryingParams& p = params.drying;
+      if (p.dry_k > 0.0) {
+        moisture *= std::pow(drying_decay(p, s.dt), s.steps) *
+                    drying_decay(p, s.last);
+      }
+      /* 過熱中の劣化は香気を下げるだけなので、回復の式だけで上限を取ります。 */
+      aroma = saturating_upper(aroma, p.aroma_recover_per_s, s);
+      color = saturating_upper(color, p.color_gain_per_s, s);
+    }
+  }
+  return ::tea_io::CsvWriter::quality_score(moisture, aroma, color);
+}
+
+namespace {
+
+/*
+ * @brief 乾燥パラメータの候補ごとに、spec.params の乾燥だけを差し替えたモデルを返します。
+ */
+std::vector<ModelParams> drying_variants(const SweepSpec& spec) {
+  if (spec.drying_params.empty()) {
+    return {spec.params};
+  }
+  std::vector<ModelParams> variants;
+  variants.reserve(spec.drying_params.size());
+  for (const DryingParams& drying : spec.drying_params) {
+    ModelParams params = spec.params;
+    params.drying = drying;
+    variants.push_back(params);
+  }
+  return variants;
+}
+
+/*
+ * @brief 1 候補の最終状態とスコアを求めて通知し、集計へ加えます。
+ */
+void evaluate(const SweepSpec& spec,
+              const ModelParams& params,
+              PrefixStateCache& cache,
+              const PrefixStateCache::Durations& durations,
+              const std::function<void(const SweepEntry&)>& on_result,
+              SweepSummary& summary) {
+  SweepEntry e;
+  e.steaming_seconds = durations[0];
+  e.rolling_seconds = durations[1];
+  e.drying_seconds = durations[2];
+  e.drying = params.drying;
+  e.leaf = cache.run(params, durations, spec.dt_seconds, spec.initial);
+  e.score = ::tea_io::CsvWriter::quality_score(e.leaf.moisture, e.leaf.aroma,
+                                               e.leaf.color);
+  summary.best_score =
+      summary.evaluations == 0 ? e.score : std::max(summary.best_score, e.score);
+  ++summary.evaluations;
+  if (on_result) {
+    on_result(e);
+  }
+}
+
+/*
+ * @brief 値の列の最大値を返します（空なら 0）。
+ */
+int longest(const std::vector<int>& values) {
+  return values.empty() ? 0 : *std::max_element(values.begin(), values.end());
+}
+
+/*
+ * @brief 工程ごとに上限を確かめながらスイープします（spec.prune の場合）。
+ *
+ * 蒸しの前は初期状態から、揉捻・乾燥の前はキャッシュした工程境界の状態から、
+ * その候補と後段の最長の工程時間で上限を求めます（乾燥パラメータが決まる前は
+ * 候補ごとの上限の最大値）。上限が閾値（prune_min_score とそれまでの最良スコアの
+ * 大きい方）を下回れば、その工程以降の候補をまとめて打ち切ります。
+ */
+void run_pruned_sweep(const SweepSpec& spec,
+                      const std::vector<ModelParams>& variants,
+                      PrefixStateCache& cache,
+                      const std::function<void(const SweepEntry&)>& on_result,
+                      SweepSummary& summary) {
+  const int max_rolling = longest(spec.rolling_seconds);
+  const int max_drying = longest(spec.drying_seconds);
+  const std::size_t per_rolling = variants.size() * spec.drying_seconds.size();
+  const std::size_t per_steaming = spec.rolling_seconds.size() * per_rolling;
+  const auto bound = [&spec, &variants](const TeaLeaf& leaf, int first_stage,
+                                        const std::array<int, 3>& durations) {
+    double best = 0.0;
+    for (const ModelParams& params : variants) {
+      best = std::max(best, quality_upper_bound(params, spec.dt_seconds, leaf,
+                                                first_stage, durations));
+    }
+    return best;
+  };
+  const auto hopeless = [&spec, &summary](double upper) {
+    const double threshold =
+        std::max(spec.prune_min_score,
+                 summary.evaluations == 0 ? 0.0 : summary.best_score);
+    return upper + kPruneMargin < threshold;
+  };
+  const auto prune = [&summary](int stage, std::size_t count) {
+    summary.pruned += count;
+    summary.pruned_before[static_cast<std::size_t>(stage)] += count;
+  };
+
+  for (const int s : spec.steaming_seconds) {
+    if (hopeless(bound(spec.initial, 0, {s, max_rolling, max_drying}))) {
+      prune(0, per_steaming);
+      continue;
+    }
+    const TeaLeaf steamed = cache.run_prefix(
+        spec.params, {s, 0, 0}, spec.dt_seconds, spec.initial, 1);
+    for (const int r : spec.rolling_seconds) {
+      if (hopeless(bound(steamed, 1, {s, r, max_drying}))) {
+        prune(1, per_rolling);
+        continue;
+      }
+      const TeaLeaf rolled = cache.run_prefix(
+          spec.params, {s, r, 0}, spec.dt_seconds, spec.initial, 2);
+      for (const ModelParams& params : variants) {
+        for (const int d : spec.drying_seconds) {
+          if (hopeless(quality_upper_bound(params, spec.dt_seconds, rolled, 2,
+                                           {s, r, d}))) {
+            prune(2, 1);
+            continue;
+          }
+          evaluate(spec, params, cache, {s, r, d}, on_result, summary);
+        }
+      }
+    }
+  }
+}
+
+} /* namespace */
+
+/*
+ * @brief スイープを実行し、結果を 1 件ずつ通知します。
+ *
+ * @param spec スイープ定義
+ * @param cache 工程境界キャッシュ（呼び出し間で共有可能）
+ * @param on_result 評価結果の通知先（空なら通知しません）
+ * @return 評価数・枝刈り数とキャッシュ統計（呼び出し前からの差分）
+ */
+SweepSummary run_sweep(const SweepSpec& spec,
+                       PrefixStateCache& cache,
+                       const std::function<void(const SweepEntry&)>& on_result) {
+  const PrefixCacheStats before = cache.stats();
+
+  const std::vector<ModelParams> variants = drying_variants(spec);
+  SweepSummary summary;
+  if (spec.prune) {
+    run_pruned_sweep(spec, variants, cache, on_result, summary);
+  } else {
+    for (const int s : spec.steaming_seconds) {
+      for (const int r : spec.rolling_seconds) {
+        for (const ModelParams& params : variants) {
+          for (const int d : spec.drying_seconds) {
+            evaluate(spec, params, cache, {s, r, d}, on_result, summary);
+          }
+        }
+      }
+    }
+  }
+
+  const PrefixCacheStats& after = cache.stats();
+  summary.cache.hits = after.hits - before.hits;
+  summary.cache.misses = after.misses - before.misses;
+  summary.cache.evictions = after.evictions - before.evictions;
+  summary.cache.stages_reused = after.stages_reused - before.stages_reused;
+  return summary;
+}
+
+} /* namespace tea */
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "domain/Model.h"
+#include "domain/TeaLeaf.h"
+#include "simulation/PrefixCache.h"
+
+namespace tea {
+
+/* 工程時間と乾燥パラメータのスイープの定義です（各軸の直積を評価します）。 */
+struct SweepSpec final {
+  ModelParams params;
+  double dt_seconds = 1.0; /* 時間刻み [s]（1 ms 単位） */
+  TeaLeaf initial;
+  std::vector<int> steaming_seconds;
+  std::vector<int> rolling_seconds;
+  std::vector<int> drying_seconds;
+
+  /*
+    乾燥パラメータの候補（空なら params.drying の 1 点）です。乾燥だけの軸なので、
+    候補が変わっても揉捻後までの工程境界はキャッシュから再利用されます。
+  */
+  std::vector<DryingParams> drying_params;
+
+  /*
+    枝刈りを行うか（既定は全候補を評価します）。有効な場合、工程境界の状態から
+    到達し得るスコアの上限（quality_upper_bound）が prune_min_score と
+    それまでの最良スコアのどちらかを下回った候補は、残りの工程を計算せずに
+    打ち切り、on_result へも渡しません。
+  */
+  bool prune = false;
+  double prune_min_score = 80.0; /* 既定は GOOD の閾値 */
+};
+
+/* スイープの 1 評価結果です。 */
+struct SweepEntry final {
+  int steaming_seconds = 0;
+  int rolling_seconds = 0;
+  int drying_seconds = 0;
+  DryingParams drying; /* 評価に使った乾燥パラメータ */
+  TeaLeaf leaf;
+  double score = 0.0;
+};
+
+/* スイープ全体の集計です。 */
+struct SweepSummary final {
+  std::size_t evaluations = 0;
+  PrefixCacheStats cache;
+
+  /* 枝刈りで打ち切った候補の数です（全工程を評価した数は evaluations）。 */
+  std::size_t pruned = 0;
+
+  /* 打ち切った候補を、計算せずに済んだ最初の工程（蒸し/揉捻/乾燥）ごとに数えたものです。 */
+  std::array<std::size_t, 3> pruned_before{};
+
+  /* 評価した候補の最良スコアです（評価が無ければ 0）。 */
+  double best_score = 0.0;
+};
+
+/*
+  leaf（first_stage 番目の工程の直前の状態、0: 蒸し, 1: 揉捻, 2: 乾燥）から
+  残りの工程を各 max_durations 秒以内だけ dt 刻みで進めたときに、到達し得る
+  品質スコアの上限を返します。香気と色は 100 へ飽和する式の上側（乾燥の
+  香気の劣化は無視）、水分は工程ごとに単調に減る式の下側で見積もるため、
+  工程時間が max_durations 以下のどの組み合わせでもスコアはこの値を超えません。
+*/
+double quality_upper_bound(const ModelParams& params,
+                           double dt_seconds,
+                           const TeaLeaf& leaf,
+                           int first_stage,
+                           const std::array<int, 3>& max_durations);
+
+/*
+  スイープをプロセス内で実行し、結果を 1 件ずつ on_result へ渡します。
+  蒸し → 揉捻 → 乾燥パラメータ → 乾燥時間の順に入れ子で回すため、後段だけが
+  変わる評価はキャッシュ済みの工程境界から再開します。spec.prune が有効なら、
+  各工程の前に上限を確かめて見込みの無い候補を打ち切ります。
+*/
+SweepSummary run_sweep(const SweepSpec& spec,
+                       PrefixStateCache& cache,
+                       const std::function<void(const SweepEntry&)>& on_result);
+
+} /* namespace tea */
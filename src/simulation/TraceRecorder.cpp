@@ -0,0 +1,90 @@
+/*
+ * @file TraceRecorder.cpp
+ * @brief ステップごとの状態の記録先（列指向のメモリ内記録、CSV 書き出し）
+ */
+
+#include "simulation/TraceRecorder.h"
+
+#include "io/CsvWriter.h"
+#include "simulation/OutputPlan.h"
+
+namespace tea {
+
+/*
+ * @brief rows 行分を先に確保して構築します。
+ *
+ * @param rows 行数
+ */
+ColumnarTraceRecorder::ColumnarTraceRecorder(std::size_t rows) {
+  reserve(rows);
+}
+
+/*
+ * @brief 全列に rows 行分を先に確保します。
+ *
+ * @param rows 行数
+ */
+void ColumnarTraceRecorder::reserve(std::size_t rows) {
+  process.reserve(rows);
+  elapsed_seconds.reserve(rows);
+  moisture.reserve(rows);
+  temperature_c.reserve(rows);
+  aroma.reserve(rows);
+  color.reserve(rows);
+}
+
+/*
+ * @brief 予測した 1 バッチ分の行数を先に確保します。
+ *
+ * @param plan tea::plan_output の予測
+ */
+void ColumnarTraceRecorder::reserve(const OutputPlan& plan) {
+  reserve(static_cast<std::size_t>(plan.total_rows));
+}
+
+/*
+ * @brief 記録をすべて消します（確保済みの容量は残します）。
+ */
+void ColumnarTraceRecorder::clear() {
+  process.clear();
+  elapsed_seconds.clear();
+  moisture.clear();
+  temperature_c.clear();
+  aroma.clear();
+  color.clear();
+}
+
+/*
+ * @brief 行 i の茶葉状態を返します。
+ *
+ * @param i 行番号（size() 未満）
+ * @return 茶葉状態
+ */
+TeaLeaf ColumnarTraceRecorder::leaf(std::size_t i) const {
+  TeaLeaf out;
+  out.moisture = moisture[i];
+  out.temperature_c = temperature_c[i];
+  out.aroma = aroma[i];
+  out.color = color[i];
+  return out;
+}
+
+/*
+ * @brief 1 ステップ分を CSV の 1 行として書き出します。
+ *
+ * @param state 工程
+ * @param elapsed_seconds 経過時間（秒）
+ * @param leaf 茶葉状態
+ */
+void CsvTraceRecorder::record(ProcessState state,
+                              double elapsed_seconds,
+                              const TeaLeaf& leaf) {
+  csv_->write_row(to_string(state),
+                  elapsed_seconds,
+                  leaf.moisture,
+                  leaf.temperature_c,
+                  leaf.aroma,
+                  leaf.color);
+}
+
+} /* namespace tea */
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "domain/ProcessState.h"
+#include "domain/TeaLeaf.h"
+
+namespace tea_io {
+class CsvWriter;
+} /* namespace tea_io */
+
+namespace tea {
+
+struct OutputPlan;
+
+/*
+  Simulator::step / run が 1 ステップごとの状態を渡す記録先の抽象です。
+  step / run は記録先の型をテンプレート引数で受け取るため、final な実装を
+  直接渡せば呼び出しは静的に解決・インライン化されます（NullTraceRecorder は
+  何も残しません）。実行時に切り替えたい場合は TraceRecorder& を渡します。
+*/
+class TraceRecorder {
+ public:
+  virtual ~TraceRecorder() = default;
+
+  /* 1 ステップ進んだ後の工程・経過時間（秒、ミリ秒単位）・茶葉状態を受け取ります。 */
+  virtual void record(ProcessState state,
+                      double elapsed_seconds,
+                      const TeaLeaf& leaf) = 0;
+};
+
+/* 何も記録しない記録先です。 */
+class NullTraceRecorder final : public TraceRecorder {
+ public:
+  void record(ProcessState, double, const TeaLeaf&) override {
+  }
+};
+
+/*
+  列ごとの配列へ記録するメモリ内の記録先です。ファイルを介さずに全ステップの
+  推移を受け取りたい組み込み利用向けで、列ごとに連続しているため集計や
+  ベクトル化した後処理にそのまま渡せます。
+  reserve（tea::plan_output の行数）で先に確保すれば、記録中に再確保しません。
+*/
+class ColumnarTraceRecorder final : public TraceRecorder {
+ public:
+  ColumnarTraceRecorder() = default;
+
+  /* rows 行分を先に確保して構築します。 */
+  explicit ColumnarTraceRecorder(std::size_t rows);
+
+  /* rows 行分を先に確保します。 */
+  void reserve(std::size_t rows);
+
+  /* 予測した 1 バッチ分の行数を先に確保します。 */
+  void reserve(const OutputPlan& plan);
+
+  /* 記録をすべて消します（確保済みの容量は残します）。 */
+  void clear();
+
+  /* 記録した行数を返します。 */
+  std::size_t size() const {
+    return elapsed_seconds.size();
+  }
+
+  void record(ProcessState state,
+              double elapsed_seconds_now,
+              const TeaLeaf& leaf) override {
+    process.push_back(state);
+    elapsed_seconds.push_back(elapsed_seconds_now);
+    moisture.push_back(leaf.moisture);
+    temperature_c.push_back(leaf.temperature_c);
+    aroma.push_back(leaf.aroma);
+    color.push_back(leaf.color);
+  }
+
+  /* 行 i の茶葉状態を返します。 */
+  TeaLeaf leaf(std::size_t i) const;
+
+  std::vector<ProcessState> process;
+  std::vector<double> elapsed_seconds;
+  std::vector<double> moisture;
+  std::vector<double> temperature_c;
+  std::vector<double> aroma;
+  std::vector<double> color;
+};
+
+/* CsvWriter へ 1 行ずつ書き出す記録先です（従来の CsvWriter* 出力と同じ内容）。 */
+class CsvTraceRecorder final : public TraceRecorder {
+ public:
+  explicit CsvTraceRecorder(::tea_io::CsvWriter& csv) : csv_(&csv) {
+  }
+
+  void record(ProcessState state,
+              double elapsed_seconds,
+              const TeaLeaf& leaf) override;
+
+ private:
+  ::tea_io::CsvWriter* csv_;
+};
+
+} /* namespace tea */
@@ -0,0 +1,468 @@
+/*
+ * @file perf_regression.cpp
+ * @brief 固定ワークロードのスループットを基準値と比較する性能回帰テスト
+ *
+ * 外部テストフレームワークに依存せず、CTest（ラベル perf）から実行します。
+ * 各ワークロードを数回実行した最良値を、基準ファイルの値から許容率以上
+ * 下回った場合に失敗します。--update-baseline で基準値を書き換えます。
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Simulator.h"
+#include "io/CsvWriter.h"
+#include "simulation/Pipeline.h"
+#include "simulation/QueryBatcher.h"
+#include "simulation/Simulator.h"
+#include "simulation/StageRunner.h"
+
+#include "test_utils.h"
+
+namespace {
+
+/*
+ * @brief 1 ワークロードの定義です（run は処理件数を返します）。
+ */
+struct Workload final {
+  const char* name;
+  const char* unit;
+  std::function<double()> run;
+};
+
+/*
+ * @brief tmpfs（/dev/shm）上の一時ファイルパスを返します（無ければ一時ディレクトリ）。
+ */
+std::string tmpfs_path(const char* file) {
+  std::error_code ec;
+  const std::filesystem::path shm("/dev/shm");
+  if (std::filesystem::is_directory(shm, ec)) {
+    return (shm / file).string();
+  }
+  return (std::filesystem::temp_directory_path(ec) / file).string();
+}
+
+/*
+ * @brief 10k バッチ × 120 ステップ（I/O なし）を実行します。
+ *
+ * @return 実行したバッチステップ数
+ */
+double run_sim_10k_x120() {
+  constexpr int kBatches = 10000;
+  tea::SimulationConfig config;
+  double steps = 0.0;
+  double sink = 0.0;
+  for (int i = 0; i < kBatches; ++i) {
+    tea::Simulator sim(config);
+    tea::TeaLeaf leaf;
+    leaf.moisture = 0.6 + 0.00001 * i;
+    sim.set_initial_leaf(leaf);
+    while (sim.step(config.dt_seconds, nullptr)) {
+      steps += 1.0;
+    }
+    sink += sim.leaf().aroma;
+  }
+  return sink > 0.0 ? steps : 0.0;
+}
+
+/*
+ * @brief 作業ディレクトリ（通常はディスク上のビルドディレクトリ）の一時ファイルパスを返します。
+ */
+std::string disk_path(const char* file) {
+  std::error_code ec;
+  return (std::filesystem::current_path(ec) / file).string();
+}
+
+/*
+ * @brief CSV を 100 万行、指定の書き出し方式で path へ書き出します。
+ *
+ * @param path 出力パス
+ * @param backend 書き出し方式
+ * @return 書き出した行数
+ */
+double write_csv_1m_rows(const std::string& path,
+                         tea_io::WriteBackend backend) {
+  constexpr int kRows = 1000000;
+  tea_io::OutputFileOptions file;
+  file.backend = backend;
+  {
+    tea_io::CsvWriter w(path, tea_io::CsvEncoding::TEXT,
+                        tea_io::Compression::NONE, file);
+    w.write_header();
+    for (int i = 0; i < kRows; ++i) {
+      const double x = static_cast<double>(i % 1000) * 0.001;
+      w.write_row("DRYING", i, x, 60.0 + x, 40.0 + x, 30.0 + x);
+    }
+  }
+  std::remove(path.c_str());
+  return static_cast<double>(kRows);
+}
+
+/*
+ * @brief CSV を 100 万行書き出します（tmpfs があればそこへ）。
+ *
+ * @return 書き出した行数
+ */
+double run_csv_1m_rows() {
+  return write_csv_1m_rows(tmpfs_path("tea_perf_csv_1m.csv"),
+                           tea_io::WriteBackend::STREAM);
+}
+
+/*
+ * @brief CSV を 100 万行、io_uring で書き出します（tmpfs があればそこへ）。
+ *
+ * @return 書き出した行数
+ */
+double run_csv_1m_rows_uring() {
+  return write_csv_1m_rows(tmpfs_path("tea_perf_csv_1m_uring.csv"),
+                           tea_io::WriteBackend::URING);
+}
+
+/*
+ * @brief CSV を 100 万行、作業ディレクトリへ書き出します。
+ *
+ * @return 書き出した行数
+ */
+double run_csv_1m_rows_disk() {
+  return write_csv_1m_rows(disk_path("tea_perf_csv_1m_disk.csv"),
+                           tea_io::WriteBackend::STREAM);
+}
+
+/*
+ * @brief CSV を 100 万行、io_uring で作業ディレクトリへ書き出します。
+ *
+ * @return 書き出した行数
+ */
+double run_csv_1m_rows_uring_disk() {
+  return write_csv_1m_rows(disk_path("tea_perf_csv_1m_uring_disk.csv"),
+                           tea_io::WriteBackend::URING);
+}
+
+/*
+ * @brief GUI 版 tea_gui::Simulator を 1k バッチで全工程（16.6ms フレーム）更新します。
+ *
+ * @return 実行したバッチ更新数
+ */
+double run_gui_teabatch_1k() {
+  constexpr int kBatches = 1000;
+  tea_gui::Simulator sim;
+  sim.set_batch_count(kBatches);
+  sim.start();
+  double updates = 0.0;
+  while (sim.is_running()) {
+    sim.update(0.0166);
+    updates += kBatches;
+  }
+  return updates;
+}
+
+/* 品質問い合わせワークロードのスレッド数と 1 スレッドあたりの要求数です。 */
+constexpr int kQueryThreads = 8;
+constexpr int kQueriesPerThread = 4096;
+
+/*
+ * @brief 問い合わせ i のレシピ（4 種類）と初期状態（すべて異なる）を返します。
+ */
+tea::SimulationConfig query_recipe(int i, tea::TeaLeaf& initial) {
+  tea::SimulationConfig config;
+  config.model = (i % 2 == 0) ? tea::ModelType::DEFAULT
+                              : tea::ModelType::GENTLE;
+  config.drying_seconds = (i % 4 < 2) ? 60 : 90;
+  initial.moisture = 0.5 + 0.00001 * i;
+  return config;
+}
+
+/*
+ * @brief 8 スレッドが要求ごとに Simulator を組み立てて最終品質を求めます。
+ *
+ * @return 処理した問い合わせ数
+ */
+double run_query_independent_8t() {
+  std::vector<double> sinks(kQueryThreads, 0.0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kQueryThreads; ++t) {
+    threads.emplace_back([&sinks, t] {
+      for (int k = 0; k < kQueriesPerThread; ++k) {
+        tea::TeaLeaf initial;
+        const tea::SimulationConfig config =
+            query_recipe(t * kQueriesPerThread + k, initial);
+        tea::Simulator sim(config);
+        sim.set_initial_leaf(initial);
+        while (sim.step(config.dt_seconds, nullptr)) {
+        }
+        sinks[static_cast<std::size_t>(t)] += tea_io::CsvWriter::quality_score(
+            sim.leaf().moisture, sim.leaf().aroma, sim.leaf().color);
+      }
+    });
+  }
+  for (std::thread& th : threads) {
+    th.join();
+  }
+  double sink = 0.0;
+  for (const double v : sinks) {
+    sink += v;
+  }
+  return sink > 0.0 ? static_cast<double>(kQueryThreads) * kQueriesPerThread
+                    : 0.0;
+}
+
+/*
+ * @brief 8 スレッドが QueryBatcher へ 256 件ずつ submit して最終品質を求めます。
+ *
+ * @return 処理した問い合わせ数
+ */
+double run_query_batched_8t() {
+  constexpr int kInFlight = 256;
+  tea::QueryBatcher batcher;
+  std::vector<double> sinks(kQueryThreads, 0.0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kQueryThreads; ++t) {
+    threads.emplace_back([&batcher, &sinks, t] {
+      std::vector<tea::QueryBatcher::Ticket> tickets;
+      tickets.reserve(kInFlight);
+      for (int k = 0; k < kQueriesPerThread; k += kInFlight) {
+        tickets.clear();
+        for (int j = k; j < k + kInFlight; ++j) {
+          tea::TeaLeaf initial;
+          const tea::SimulationConfig config =
+              query_recipe(t * kQueriesPerThread + j, initial);
+          tickets.push_back(batcher.submit(config, initial));
+        }
+        for (const tea::QueryBatcher::Ticket& f : tickets) {
+          sinks[static_cast<std::size_t>(t)] += f.get().score;
+        }
+      }
+    });
+  }
+  for (std::thread& th : threads) {
+    th.join();
+  }
+  double sink = 0.0;
+  for (const double v : sinks) {
+    sink += v;
+  }
+  return sink > 0.0 ? static_cast<double>(kQueryThreads) * kQueriesPerThread
+                    : 0.0;
+}
+
+/* pipeline_* の工程時間 [s] です（蒸し・揉捻・乾燥、dt = 1 秒）。 */
+constexpr int kPipelineSteaming = 30;
+constexpr int kPipelineRolling = 30;
+constexpr int kPipelineDrying = 600;
+constexpr int kPipelineBatches = 10000;
+
+/*
+ * @brief 10k バッチ × 660 ステップを実行時の係数（run_stage）で進めます。
+ *
+ * @return 実行したバッチステップ数
+ */
+double run_pipeline_runtime_10k() {
+  const tea::ModelParams params = tea::make_model(tea::ModelType::GENTLE);
+  double sink = 0.0;
+  for (int i = 0; i < kPipelineBatches; ++i) {
+    tea::TeaLeaf leaf;
+    leaf.moisture = 0.6 + 0.00001 * i;
+    tea::run_stage(tea::ProcessState::STEAMING, params, leaf,
+                   kPipelineSteaming, 1.0);
+    tea::run_stage(tea::ProcessState::ROLLING, params, leaf,
+                   kPipelineRolling, 1.0);
+    tea::run_stage(tea::ProcessState::DRYING, params, leaf,
+                   kPipelineDrying, 1.0);
+    sink += leaf.aroma;
+  }
+  const double steps = static_cast<double>(kPipelineBatches) *
+                       (kPipelineSteaming + kPipelineRolling + kPipelineDrying);
+  return sink > 0.0 ? steps : 0.0;
+}
+
+/*
+ * @brief 同じ条件を係数がコンパイル時定数の Pipeline<GENTLE> で進めます。
+ *
+ * @return 実行したバッチステップ数
+ */
+double run_pipeline_constexpr_10k() {
+  using Pipeline = tea::Pipeline<tea::ModelType::GENTLE>;
+  double sink = 0.0;
+  for (int i = 0; i < kPipelineBatches; ++i) {
+    tea::TeaLeaf leaf;
+    leaf.moisture = 0.6 + 0.00001 * i;
+    sink += Pipeline::run(leaf, kPipelineSteaming, kPipelineRolling,
+                          kPipelineDrying).aroma;
+  }
+  const double steps = static_cast<double>(kPipelineBatches) *
+                       (kPipelineSteaming + kPipelineRolling + kPipelineDrying);
+  return sink > 0.0 ? steps : 0.0;
+}
+
+/*
+ * @brief 基準ファイル（"<name> <ops/s>" 行）を読み込みます。
+ */
+std::map<std::string, double> load_baseline(const std::string& path) {
+  std::map<std::string, double> m;
+  std::ifstream ifs(path);
+  std::string line;
+  while (std::getline(ifs, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream iss(line);
+    std::string name;
+    double v = 0.0;
+    if (iss >> name >> v) {
+      m[name] = v;
+    }
+  }
+  return m;
+}
+
+/*
+ * @brief 基準ファイルの該当行だけを書き換えます（コメント行は保持します）。
+ */
+bool store_baseline(const std::string& path,
+                    const std::string& name,
+                    double value) {
+  std::vector<std::string> lines;
+  bool replaced = false;
+  {
+    std::ifstream ifs(path);
+    std::string line;
+    while (std::getline(ifs, line)) {
+      std::istringstream iss(line);
+      std::string first;
+      iss >> first;
+      if (first == name) {
+        std::ostringstream oss;
+        oss.setf(std::ios::fixed);
+        oss.precision(0);
+        oss << name << ' ' << value;
+        line = oss.str();
+        replaced = true;
+      }
+      lines.push_back(line);
+    }
+  }
+  if (!replaced) {
+    std::ostringstream oss;
+    oss.setf(std::ios::fixed);
+    oss.precision(0);
+    oss << name << ' ' << value;
+    lines.push_back(oss.str());
+  }
+  std::ofstream ofs(path, std::ios::out | std::ios::trunc);
+  for (const std::string& l : lines) {
+    ofs << l << '\n';
+  }
+  return static_cast<bool>(ofs);
+}
+
+} /* namespace */
+
+/*
+ * @brief 性能回帰テストのエントリポイントです。
+ *
+ * 使い方:
+ *   perf_regression <workload> [--baseline <path>] [--tolerance <pct>]
+ *                   [--repeat <n>] [--update-baseline]
+ *
+ * @return 0: 成功, 1: 劣化検出, 2: 引数エラー
+ */
+int main(int argc, char** argv) {
+  const std::vector<Workload> workloads = {
+    {"sim_10k_x120", "steps/s", run_sim_10k_x120},
+    {"csv_1m_rows", "rows/s", run_csv_1m_rows},
+    {"csv_1m_rows_uring", "rows/s", run_csv_1m_rows_uring},
+    {"csv_1m_rows_disk", "rows/s", run_csv_1m_rows_disk},
+    {"csv_1m_rows_uring_disk", "rows/s", run_csv_1m_rows_uring_disk},
+    {"gui_teabatch_1k", "updates/s", run_gui_teabatch_1k},
+    {"query_independent_8t", "queries/s", run_query_independent_8t},
+    {"query_batched_8t", "queries/s", run_query_batched_8t},
+    {"pipeline_runtime_10k", "steps/s", run_pipeline_runtime_10k},
+    {"pipeline_constexpr_10k", "steps/s", run_pipeline_constexpr_10k},
+  };
+
+  if (argc < 2) {
+    std::cerr << "usage: perf_regression <workload> [--baseline <path>] "
+                 "[--tolerance <pct>] [--repeat <n>] [--update-baseline]\n";
+    return 2;
+  }
+  const std::string name = argv[1];
+  std::string baseline_path;
+  double tolerance_pct = 20.0;
+  int repeat = 3;
+  bool update = false;
+  for (int i = 2; i < argc; ++i) {
+    const std::string a = argv[i];
+    if (a == "--update-baseline") {
+      update = true;
+    } else if (a == "--baseline" && i + 1 < argc) {
+      baseline_path = argv[++i];
+    } else if (a == "--tolerance" && i + 1 < argc) {
+      tolerance_pct = std::atof(argv[++i]);
+    } else if (a == "--repeat" && i + 1 < argc) {
+      repeat = std::max(1, std::atoi(argv[++i]));
+    } else {
+      std::cerr << "Unknown argument: " << a << '\n';
+      return 2;
+    }
+  }
+
+  const Workload* w = nullptr;
+  for (const Workload& c : workloads) {
+    if (name == c.name) {
+      w = &c;
+    }
+  }
+  if (w == nullptr) {
+    std::cerr << "Unknown workload: " << name << '\n';
+    return 2;
+  }
+
+  /* 最良値を採用し、スケジューラ等の一時的な揺らぎを除きます。 */
+  double best = 0.0;
+  for (int r = 0; r < repeat; ++r) {
+    const auto t0 = std::chrono::steady_clock::now();
+    const double ops = w->run();
+    const std::chrono::duration<double> sec =
+        std::chrono::steady_clock::now() - t0;
+    if (sec.count() > 0.0) {
+      best = std::max(best, ops / sec.count());
+    }
+  }
+
+  std::cout.setf(std::ios::fixed);
+  std::cout.precision(0);
+  std::cout << "[perf] " << w->name << ' ' << best << ' ' << w->unit << '\n';
+
+  if (baseline_path.empty()) {
+    return 0;
+  }
+  if (update) {
+    return tea_test::expect(store_baseline(baseline_path, w->name, best),
+                            "baseline should be writable") ? 0 : 1;
+  }
+
+  const std::map<std::string, double> baseline = load_baseline(baseline_path);
+  const auto it = baseline.find(w->name);
+  if (it == baseline.end()) {
+    std::cout << "[perf] no baseline for " << w->name << " (skipped)\n";
+    return 0;
+  }
+  const double floor = it->second * (1.0 - tolerance_pct / 100.0);
+  std::cout << "[perf] baseline " << it->second << ' ' << w->unit
+            << " (floor " << floor << " at -" << tolerance_pct << "%)\n";
+  if (!tea_test::expect(best >= floor, "throughput dropped below baseline")) {
+    return 1;
+  }
+  std::cout << "perf_regression " << w->name << ": OK\n";
+  return 0;
+}
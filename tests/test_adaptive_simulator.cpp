@@ -0,0 +1,312 @@
+/*
+ * @file test_adaptive_simulator.cpp
+ * @brief 適応刻みで工程の式を積分する AdaptiveSimulator の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ * 各工程の式は線形か飽和型で、乾燥の香気も温度の閾値通過で区切れば
+ * 解析解を持つため、積分結果を解析解と比べます。
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "simulation/AdaptiveSimulator.h"
+#include "simulation/Simulator.h"
+#include "test_utils.h"
+
+namespace {
+
+/*
+ * @brief 上限 100 へ近づく飽和モデルの解析解です。
+ */
+double saturate(double v0, double gain_per_s, double t) {
+  return 100.0 - (100.0 - v0) * std::exp(-gain_per_s * t / 100.0);
+}
+
+/*
+ * @brief 目標温度へ近づく緩和モデルの解析解です。
+ */
+double relax(double v0, double target, double k, double t) {
+  return target + (v0 - target) * std::exp(-k * t);
+}
+
+/*
+ * @brief 全工程の時刻 elapsed（秒）における解析解を返します。
+ */
+tea::TeaLeaf exact_leaf(const tea::SimulationConfig& config,
+                        tea::TeaLeaf leaf,
+                        double elapsed) {
+  const tea::ModelParams p = tea::make_model(config.model);
+
+  double t = std::min(elapsed, static_cast<double>(config.steaming_seconds));
+  {
+    const tea::SteamingParams& s = p.steaming;
+    leaf.temperature_c = relax(leaf.temperature_c, s.target_temp_c, s.heat_k, t);
+    leaf.moisture += s.moisture_gain_per_s * t;
+    leaf.aroma = saturate(leaf.aroma, s.aroma_gain_per_s, t);
+    leaf.color = saturate(leaf.color, s.color_gain_per_s, t);
+  }
+  elapsed -= t;
+
+  t = std::min(elapsed, static_cast<double>(config.rolling_seconds));
+  {
+    const tea::RollingParams& r = p.rolling;
+    leaf.temperature_c = relax(leaf.temperature_c, r.target_temp_c, r.cool_k, t);
+    leaf.moisture = -2.0 / 3.0 + (leaf.moisture + 2.0 / 3.0) *
+                                     std::exp(-0.6 * r.moisture_loss_k * t);
+    leaf.aroma = saturate(leaf.aroma, r.aroma_gain_per_s, t);
+    leaf.color = saturate(leaf.color, r.color_gain_per_s, t);
+  }
+  elapsed -= t;
+
+  t = std::min(elapsed, static_cast<double>(config.drying_seconds));
+  {
+    const tea::DryingParams& d = p.drying;
+    const double t0 = leaf.temperature_c;
+    /* 過熱している間は香気が劣化し、閾値を下回ってからは回復します。 */
+    double hot = 0.0;
+    if (t0 > d.overheat_c) {
+      hot = std::log((t0 - d.target_temp_c) / (d.overheat_c - d.target_temp_c)) /
+            d.temp_k;
+      hot = std::min(hot, t);
+      leaf.aroma -= d.aroma_damage_k *
+                    ((d.target_temp_c - d.overheat_c) * hot +
+                     (t0 - d.target_temp_c) * (1.0 - std::exp(-d.temp_k * hot)) /
+                         d.temp_k);
+    }
+    leaf.aroma = saturate(leaf.aroma, d.aroma_recover_per_s, t - hot);
+    leaf.temperature_c = relax(t0, d.target_temp_c, d.temp_k, t);
+    leaf.moisture *= std::exp(-d.dry_k * t);
+    leaf.color = saturate(leaf.color, d.color_gain_per_s, t);
+  }
+  return leaf;
+}
+
+/*
+ * @brief 2 つの茶葉状態の成分ごとの差の最大値を返します。
+ */
+double max_diff(const tea::TeaLeaf& a, const tea::TeaLeaf& b) {
+  return std::max({std::fabs(a.moisture - b.moisture),
+                   std::fabs(a.temperature_c - b.temperature_c),
+                   std::fabs(a.aroma - b.aroma), std::fabs(a.color - b.color)});
+}
+
+/* 各出力時刻の状態を残す記録先です。 */
+struct Rows final {
+  std::vector<tea::ProcessState> states;
+  std::vector<double> elapsed;
+  std::vector<tea::TeaLeaf> leaves;
+
+  void record(tea::ProcessState state, double elapsed_seconds,
+              const tea::TeaLeaf& leaf) {
+    states.push_back(state);
+    elapsed.push_back(elapsed_seconds);
+    leaves.push_back(leaf);
+  }
+};
+
+/*
+ * @brief 全モデルで各出力時刻の状態が解析解と一致し、刻みが出力間隔より粗いことを検証します。
+ */
+bool test_matches_exact_solution() {
+  bool ok = true;
+  const tea::ModelType models[] = {tea::ModelType::DEFAULT,
+                                   tea::ModelType::GENTLE,
+                                   tea::ModelType::AGGRESSIVE};
+  for (const tea::ModelType model : models) {
+    tea::SimulationConfig config;
+    config.model = model;
+    config.drying_seconds = 600;
+    tea::AdaptiveOptions options;
+    options.rtol = 1e-9;
+    options.atol = 1e-11;
+    tea::AdaptiveSimulator sim(config, options);
+
+    Rows rows;
+    sim.run(rows);
+    const int total = config.steaming_seconds + config.rolling_seconds +
+                      config.drying_seconds;
+    ok = tea_test::expect(static_cast<int>(rows.leaves.size()) == total &&
+                              rows.elapsed.back() == total,
+                          "every sample time should be produced") && ok;
+
+    double worst = 0.0;
+    for (std::size_t i = 0; i < rows.leaves.size(); ++i) {
+      const tea::TeaLeaf e =
+          exact_leaf(config, tea::TeaLeaf(), static_cast<double>(rows.elapsed[i]));
+      worst = std::max(worst, max_diff(rows.leaves[i], e));
+    }
+    ok = tea_test::expect(worst < 1e-6,
+                          "dense output should match the exact solution") && ok;
+
+    const tea::AdaptiveStats& s = sim.stats();
+    ok = tea_test::expect(s.accepted_steps < static_cast<std::size_t>(total) / 2,
+                          "smooth stages should use steps much longer than 1s")
+         && ok;
+    ok = tea_test::expect(s.events == 1,
+                          "overheat crossing should limit a step") && ok;
+  }
+  return ok;
+}
+
+/*
+ * @brief 1 秒刻みの前進オイラーより少ない評価で、より正確な結果になることを検証します。
+ */
+bool test_fewer_evaluations_than_euler() {
+  tea::SimulationConfig config;
+  config.drying_seconds = 3600;
+  tea::AdaptiveSimulator sim(config);
+  Rows rows;
+  while (sim.step(config.steaming_seconds + config.rolling_seconds +
+                      config.drying_seconds,
+                  rows)) {
+  }
+
+  const int total = config.steaming_seconds + config.rolling_seconds +
+                    config.drying_seconds;
+  const tea::TeaLeaf exact =
+      exact_leaf(config, tea::TeaLeaf(), static_cast<double>(total));
+  /* 1 秒刻みの前進オイラー（Simulator）の誤差です。 */
+  tea::Simulator euler(config);
+  while (euler.step(1, nullptr)) {
+  }
+  const double euler_error = max_diff(euler.leaf(), exact);
+  const double adaptive_error = max_diff(sim.leaf(), exact);
+
+  bool ok = true;
+  ok = tea_test::expect(adaptive_error < euler_error,
+                        "adaptive result should be more accurate") && ok;
+  ok = tea_test::expect(sim.stats().rhs_evaluations * 4 <
+                            static_cast<std::size_t>(total),
+                        "adaptive run should need far fewer evaluations") && ok;
+  ok = tea_test::expect(rows.elapsed.size() == 3,
+                        "one sample per stage end should be produced") && ok;
+  return ok;
+}
+
+/*
+ * @brief 出力時刻・工程が Simulator と同じ並びになることを検証します。
+ */
+bool test_sample_times_match_simulator() {
+  tea::SimulationConfig config;
+  config.dt_seconds = 7;
+  config.steaming_seconds = 10;
+  config.rolling_seconds = 0;
+  config.drying_seconds = 17;
+
+  tea::Simulator euler(config);
+  tea::AdaptiveSimulator sim(config);
+  bool ok = true;
+  while (true) {
+    const bool a = euler.step(config.dt_seconds, nullptr);
+    const bool b = sim.step(config.dt_seconds, nullptr);
+    ok = tea_test::expect(a == b, "both should finish together") && ok;
+    if (!a || !b) {
+      break;
+    }
+    ok = tea_test::expect(euler.elapsed_seconds() == sim.elapsed_seconds() &&
+                              euler.current_process() == sim.current_process(),
+                          "sample time and stage should match") && ok;
+    ok = tea_test::in_bounds(sim.leaf()) && ok;
+  }
+  ok = tea_test::expect(sim.current_process() == tea::ProcessState::FINISHED,
+                        "adaptive run should finish") && ok;
+  return ok;
+}
+
+/*
+ * @brief 初期状態の指定と刻みの上限が反映されることを検証します。
+ */
+bool test_initial_leaf_and_max_step() {
+  tea::SimulationConfig config;
+  tea::TeaLeaf initial;
+  initial.moisture = 0.6;
+  initial.aroma = 30.0;
+
+  tea::AdaptiveOptions options;
+  options.max_step_seconds = 2.0;
+  tea::AdaptiveSimulator sim(config, options);
+  sim.set_initial_leaf(initial);
+  while (sim.step(config.dt_seconds, nullptr)) {
+  }
+
+  const int total = config.steaming_seconds + config.rolling_seconds +
+                    config.drying_seconds;
+  bool ok = true;
+  ok = tea_test::expect(max_diff(sim.leaf(), exact_leaf(config, initial,
+                                                        total)) < 1e-4,
+                        "initial leaf should be used") && ok;
+  ok = tea_test::expect(sim.stats().accepted_steps >=
+                            static_cast<std::size_t>(total) / 2,
+                        "max_step_seconds should bound the step") && ok;
+  return ok;
+}
+
+/*
+ * @brief 閾値まで縮めた刻みが誤差でやり直しになっても、香気の式を切り替えないことを検証します。
+ *
+ * 許容誤差を丸め誤差より小さくすると誤差の推定が丸め誤差で決まり、縮めた刻みの
+ * ほうがやり直しになることがあります。そのとき閾値の手前で式を切り替えると、
+ * 過熱中の区間を回復側の式で進めてしまい、解析解から離れます。
+ */
+bool test_rejected_event_step_keeps_branch() {
+  tea::SimulationConfig config;
+  config.model = tea::ModelType::GENTLE;
+  config.drying_seconds = 600;
+  tea::TeaLeaf initial;
+  initial.moisture = 0.7;
+  initial.temperature_c = 110.0;
+
+  const double initial_steps[] = {1.0, 10.0, 100.0};
+  const double max_steps[] = {0.0, 5.0, 50.0};
+  const int total = config.steaming_seconds + config.rolling_seconds +
+                    config.drying_seconds;
+  const tea::TeaLeaf exact = exact_leaf(config, initial, total);
+
+  bool ok = true;
+  bool rejected_after_event = false;
+  for (const double initial_step : initial_steps) {
+    for (const double max_step : max_steps) {
+      tea::AdaptiveOptions options;
+      options.rtol = 1e-20;
+      options.atol = 0.0;
+      options.initial_step_seconds = initial_step;
+      options.max_step_seconds = max_step;
+      tea::AdaptiveSimulator sim(config, options);
+      sim.set_initial_leaf(initial);
+      while (sim.step(config.dt_seconds, nullptr)) {
+      }
+      /* やり直した刻みでは通過をもう一度調べるため、区切りが 2 回以上になります。 */
+      rejected_after_event = rejected_after_event || sim.stats().events > 1;
+      ok = tea_test::expect(max_diff(sim.leaf(), exact) < 1e-6,
+                            "aroma branch should switch only at the crossing")
+           && ok;
+    }
+  }
+  ok = tea_test::expect(rejected_after_event,
+                        "a shortened step should have been rejected") && ok;
+  return ok;
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_matches_exact_solution() && ok;
+  ok = test_fewer_evaluations_than_euler() && ok;
+  ok = test_sample_times_match_simulator() && ok;
+  ok = test_initial_leaf_and_max_step() && ok;
+  ok = test_rejected_event_step_keeps_branch() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "adaptive_simulator_tests: OK\n";
+  return 0;
+}
@@ -104,7 +104,7 @@ bool test_model_validation() {
 }
 
 /*
- * @brief batches の境界（最大128）を検証します。
+ * @brief batches の境界（最大128、多重化出力では拡張）を検証します。
  *
  * @return 成功なら true
  */
@@ -123,6 +123,16 @@ bool test_batches_bounds() {
     ok = tea_test::expect(args.error.has_value(),
                           "batches=129 should be rejected") && ok;
   }
+  {
+    const tea_cli::Args args = parse_from(
+        {"tea_factory_simulator_cli", "--batches", "50000", "--multiplex",
+         "all.team"});
+    ok = tea_test::expect(!args.error.has_value(),
+                          "batches=50000 should be accepted with multiplex")
+         && ok;
+    ok = tea_test::expect(args.multiplex_path == "all.team",
+                          "multiplex path should be set") && ok;
+  }
   return ok;
 }
 
@@ -138,6 +148,220 @@ bool test_csv_path_must_not_be_empty() {
                           "empty csv path should be rejected");
 }
 
+/*
+ * @brief スイープ範囲（from:to:step）と dry_k の候補列の妥当/不正値を検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_sweep_range_parsing() {
+  bool ok = true;
+  {
+    const tea_cli::Args args = parse_from(
+        {"tea_factory_simulator_cli", "--sweep-drying", "30:90:15"});
+    ok = tea_test::expect(!args.error.has_value(),
+                          "valid sweep range should be accepted") && ok;
+    ok = tea_test::expect(args.sweep_drying.has_value() &&
+                              args.sweep_drying->from == 30 &&
+                              args.sweep_drying->to == 90 &&
+                              args.sweep_drying->step == 15,
+                          "sweep range should be parsed") && ok;
+  }
+  for (const char* bad : {"90:30:5", "30:90", "30:90:0", "a:b:c"}) {
+    const tea_cli::Args args = parse_from(
+        {"tea_factory_simulator_cli", "--sweep-drying", bad});
+    ok = tea_test::expect(args.error.has_value(),
+                          "invalid sweep range should be rejected") && ok;
+  }
+  {
+    const tea_cli::Args args = parse_from(
+        {"tea_factory_simulator_cli", "--sweep-dry-k", "0.03,0.05"});
+    ok = tea_test::expect(!args.error.has_value() &&
+                              args.sweep_dry_k.size() == 2 &&
+                              args.sweep_dry_k[0] == 0.03 &&
+                              args.sweep_dry_k[1] == 0.05,
+                          "dry_k list should be parsed") && ok;
+  }
+  for (const char* bad : {"", "0.03,", ",0.03", "0.03,0", "-0.1", "x"}) {
+    const tea_cli::Args args = parse_from(
+        {"tea_factory_simulator_cli", "--sweep-dry-k", bad});
+    ok = tea_test::expect(args.error.has_value(),
+                          "invalid dry_k list should be rejected") && ok;
+  }
+  return ok;
+}
+
+/*
+ * @brief --serve と --workers の解析を検証します。
+ */
+bool test_serve_options() {
+  bool ok = true;
+  {
+    const tea_cli::Args args = parse_from({"tea_factory_simulator_cli",
+                                           "--serve", "/tmp/tea.sock",
+                                           "--workers", "4"});
+    ok = tea_test::expect(!args.error.has_value() &&
+                              args.serve_path == "/tmp/tea.sock" &&
+                              args.serve_workers == 4,
+                          "serve options should be parsed") && ok;
+  }
+  {
+    const tea_cli::Args args =
+        parse_from({"tea_factory_simulator_cli", "--serve", ""});
+    ok = tea_test::expect(args.error.has_value(),
+                          "empty socket path should be rejected") && ok;
+  }
+  {
+    const tea_cli::Args args =
+        parse_from({"tea_factory_simulator_cli", "--workers", "0"});
+    ok = tea_test::expect(args.error.has_value(),
+                          "zero workers should be rejected") && ok;
+  }
+  return ok;
+}
+
+/*
+ * @brief --result-cache と --result-cache-size の解析を検証します。
+ */
+bool test_result_cache_options() {
+  bool ok = true;
+  {
+    const tea_cli::Args args = parse_from(
+        {"tea_factory_simulator_cli", "--result-cache", "rc.bin",
+         "--result-cache-size", "1024", "--batches", "500"});
+    ok = tea_test::expect(!args.error.has_value() &&
+                              args.result_cache_path == "rc.bin" &&
+                              args.result_cache_entries == 1024 &&
+                              args.batches == 500,
+                          "result cache options should be parsed") && ok;
+  }
+  {
+    const tea_cli::Args args =
+        parse_from({"tea_factory_simulator_cli", "--result-cache", ""});
+    ok = tea_test::expect(args.error.has_value(),
+                          "empty result cache path should be rejected") && ok;
+  }
+  {
+    const tea_cli::Args args = parse_from(
+        {"tea_factory_simulator_cli", "--result-cache-size", "0"});
+    ok = tea_test::expect(args.error.has_value(),
+                          "zero result cache size should be rejected") && ok;
+  }
+  return ok;
+}
+
+/*
+ * @brief --integrator の解析を検証します。
+ */
+bool test_integrator_option() {
+  bool ok = true;
+  {
+    const tea_cli::Args args = parse_from({"tea_factory_simulator_cli"});
+    ok = tea_test::expect(args.integrator == "euler",
+                          "default integrator should be euler") && ok;
+  }
+  {
+    const tea_cli::Args args = parse_from(
+        {"tea_factory_simulator_cli", "--integrator", "rk45"});
+    ok = tea_test::expect(!args.error.has_value() && args.integrator == "rk45",
+                          "rk45 integrator should be parsed") && ok;
+  }
+  {
+    const tea_cli::Args args = parse_from(
+        {"tea_factory_simulator_cli", "--integrator", "rk4"});
+    ok = tea_test::expect(args.error.has_value(),
+                          "unknown integrator should be rejected") && ok;
+  }
+  {
+    const tea_cli::Args args =
+        parse_from({"tea_factory_simulator_cli", "--sensitivity"});
+    ok = tea_test::expect(!args.error.has_value() && args.sensitivity,
+                          "--sensitivity should be parsed") && ok;
+  }
+  {
+    const tea_cli::Args args = parse_from({"tea_factory_simulator_cli",
+                                           "--sensitivity", "--integrator",
+                                           "rk45"});
+    ok = tea_test::expect(args.error.has_value(),
+                          "--sensitivity should require euler") && ok;
+  }
+  /* run_batches より前に分岐するモードは、rk45 を黙って無視せず拒否すること。 */
+  const std::vector<std::vector<std::string>> euler_only = {
+      {"--serve", "/tmp/tea.sock"}, {"--decode", "a.teaq"},
+      {"--optimize"},               {"--result-cache", "cache.bin"},
+      {"--precision-check"},        {"--events"},
+      {"--sweep-drying", "30:90:15"}};
+  for (const std::vector<std::string>& mode : euler_only) {
+    std::vector<std::string> argv = {"tea_factory_simulator_cli",
+                                     "--integrator", "rk45"};
+    argv.insert(argv.end(), mode.begin(), mode.end());
+    const tea_cli::Args args = parse_from(argv);
+    const std::string name =
+        mode[0].rfind("--sweep-", 0) == 0 ? "--sweep-*" : mode[0];
+    ok = tea_test::expect(args.error.has_value() &&
+                              args.error->rfind(name, 0) == 0,
+                          "mode before run_batches should require euler") && ok;
+  }
+  {
+    const tea_cli::Args args =
+        parse_from({"tea_factory_simulator_cli", "--calibrate", "a.csv",
+                    "--calibrate", "b.csv"});
+    ok = tea_test::expect(!args.error.has_value() &&
+                              args.calibrate_paths.size() == 2 &&
+                              args.calibrate_paths[1] == "b.csv",
+                          "--calibrate should be repeatable") && ok;
+  }
+  {
+    const tea_cli::Args args =
+        parse_from({"tea_factory_simulator_cli", "--calibrate", ""});
+    ok = tea_test::expect(args.error.has_value(),
+                          "empty --calibrate path should be rejected") && ok;
+  }
+  return ok;
+}
+
+/*
+ * @brief 1 秒未満の --dt と --sample-interval の解析を検証します。
+ */
+bool test_fractional_dt_and_sample_interval() {
+  bool ok = true;
+  {
+    const tea_cli::Args args = parse_from(
+        {"tea_factory_simulator_cli", "--dt", "0.1", "--sample-interval", "1.5"});
+    ok = tea_test::expect(!args.error.has_value() && args.dt_seconds == 0.1 &&
+                              args.sample_seconds == 1.5,
+                          "dt=0.1 with sample interval 1.5 should be parsed")
+         && ok;
+  }
+  const char* rejected[] = {"1.2345", "0.0005", ".5", "1e-1"};
+  for (const char* v : rejected) {
+    const tea_cli::Args args = parse_from({"tea_factory_simulator_cli", "--dt", v});
+    ok = tea_test::expect(args.error.has_value(),
+                          "dt finer than 1ms or malformed should be rejected")
+         && ok;
+  }
+  {
+    const tea_cli::Args args = parse_from(
+        {"tea_factory_simulator_cli", "--dt", "0.3", "--sample-interval", "1"});
+    ok = tea_test::expect(args.error.has_value(),
+                          "sample interval must be a multiple of dt") && ok;
+  }
+  {
+    const tea_cli::Args args = parse_from(
+        {"tea_factory_simulator_cli", "--dt", "0.5", "--csv-format", "quantized"});
+    ok = tea_test::expect(args.error.has_value(),
+                          "quantized output should need whole-second rows") && ok;
+  }
+  {
+    const tea_cli::Args args = parse_from(
+        {"tea_factory_simulator_cli", "--dt", "0.5", "--sample-interval", "2",
+         "--csv-format", "quantized"});
+    ok = tea_test::expect(!args.error.has_value(),
+                          "quantized output with whole-second samples is fine")
+         && ok;
+  }
+  return ok;
+}
+
 } /* namespace */
 
 /*
@@ -154,6 +378,11 @@ int main() {
   ok = test_model_validation() && ok;
   ok = test_batches_bounds() && ok;
   ok = test_csv_path_must_not_be_empty() && ok;
+  ok = test_sweep_range_parsing() && ok;
+  ok = test_serve_options() && ok;
+  ok = test_result_cache_options() && ok;
+  ok = test_integrator_option() && ok;
+  ok = test_fractional_dt_and_sample_interval() && ok;
 
   if (!ok) {
     return 1;
@@ -0,0 +1,147 @@
+/*
+ * @file test_batch_engine.cpp
+ * @brief 一括計算エンジン（BatchEngineT）と精度比較の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ */
+
+#include <vector>
+
+#include "simulation/BatchEngine.h"
+#include "simulation/Simulator.h"
+
+#include "test_utils.h"
+
+namespace {
+
+/*
+ * @brief Simulator で全工程を実行した最終状態を返します。
+ */
+tea::TeaLeaf simulate(const tea::SimulationConfig& config,
+                      const tea::TeaLeaf& initial) {
+  tea::Simulator sim(config);
+  sim.set_initial_leaf(initial);
+  while (sim.step(config.dt_seconds, nullptr)) {
+  }
+  return sim.leaf();
+}
+
+/*
+ * @brief 検証用の初期状態を n 枚作ります。
+ */
+std::vector<tea::TeaLeaf> make_leaves(int n) {
+  std::vector<tea::TeaLeaf> leaves;
+  for (int i = 0; i < n; ++i) {
+    tea::TeaLeaf leaf;
+    leaf.moisture = 0.5 + 0.4 * (i % 7) / 6.0;
+    leaf.temperature_c = 20.0 + (i % 11);
+    leaf.aroma = 5.0 * (i % 3);
+    leaves.push_back(leaf);
+  }
+  return leaves;
+}
+
+/*
+ * @brief double の一括計算が Simulator とビット単位で一致することを検証します。
+ *
+ * ブロック境界をまたぐ枚数と、割り切れない dt（最後の刻みが短い）を使います。
+ *
+ * @return 成功なら true
+ */
+bool test_double_matches_simulator() {
+  tea::SimulationConfig config;
+  config.dt_seconds = 7;
+  config.model = tea::ModelType::AGGRESSIVE;
+  config.drying_seconds = 200;
+  const std::vector<tea::TeaLeaf> leaves = make_leaves(600);
+
+  tea::BatchEngine engine(tea::make_model(config.model));
+  for (const tea::TeaLeaf& leaf : leaves) {
+    engine.add(leaf);
+  }
+  engine.run(config);
+
+  bool ok = tea_test::expect(engine.size() == leaves.size(),
+                             "engine should hold all leaves");
+  for (std::size_t i = 0; i < leaves.size() && ok; ++i) {
+    const tea::TeaLeaf expected = simulate(config, leaves[i]);
+    const tea::TeaLeaf actual = engine.leaf(i);
+    ok = tea_test::expect(actual.moisture == expected.moisture &&
+                              actual.temperature_c == expected.temperature_c &&
+                              actual.aroma == expected.aroma &&
+                              actual.color == expected.color,
+                          "double batch should match Simulator exactly") && ok;
+  }
+  return ok;
+}
+
+/*
+ * @brief float の結果が全モデルで double から許容範囲内に収まることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_float_divergence_is_small() {
+  const std::vector<tea::TeaLeaf> leaves = make_leaves(64);
+  const tea::ModelType models[] = {tea::ModelType::DEFAULT,
+                                   tea::ModelType::GENTLE,
+                                   tea::ModelType::AGGRESSIVE};
+  bool ok = true;
+  for (tea::ModelType model : models) {
+    tea::SimulationConfig config;
+    config.model = model;
+    const tea::PrecisionDivergence d =
+        tea::measure_precision_divergence(config, leaves);
+    ok = tea_test::expect(d.max_score_diff < 1e-3,
+                          "float score should stay within 1e-3") && ok;
+    ok = tea_test::expect(d.max_moisture_diff < 1e-5,
+                          "float moisture should stay within 1e-5") && ok;
+  }
+  return ok;
+}
+
+/*
+ * @brief 工程を個別に進めても一括実行と同じ結果になることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_run_stage_composes() {
+  const tea::SimulationConfig config;
+  const tea::ModelParamsT<float> params =
+      tea::params_cast<float>(tea::make_model(config.model));
+  tea::BatchEngineT<float> a(params);
+  tea::BatchEngineT<float> b(params);
+  a.add(tea::TeaLeafT<float>());
+  b.add(tea::TeaLeafT<float>());
+
+  a.run(config);
+  b.run_stage(tea::ProcessState::STEAMING, config.steaming_seconds,
+              config.dt_seconds);
+  b.run_stage(tea::ProcessState::ROLLING, config.rolling_seconds,
+              config.dt_seconds);
+  b.run_stage(tea::ProcessState::DRYING, config.drying_seconds,
+              config.dt_seconds);
+  b.run_stage(tea::ProcessState::FINISHED, 100, config.dt_seconds);
+
+  return tea_test::expect(a.quality_score(0) == b.quality_score(0),
+                          "stage-wise run should match full run");
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_double_matches_simulator() && ok;
+  ok = test_float_divergence_is_small() && ok;
+  ok = test_run_stage_composes() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "batch_engine_tests: OK\n";
+  return 0;
+}
@@ -0,0 +1,250 @@
+/*
+ * @file test_calibration.cpp
+ * @brief 計測トレースの読み込み（TraceReader）と係数の較正（calibrate）の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ * 既知の係数で書いた CSV を計測トレースとして、別の係数から較正し直します。
+ */
+
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "io/CsvWriter.h"
+#include "io/Multiplex.h"
+#include "io/TraceReader.h"
+#include "simulation/Calibration.h"
+#include "simulation/Simulator.h"
+#include "test_utils.h"
+
+namespace {
+
+using tea_test::ScopedFile;
+
+/* 一時ファイル名の接頭辞です。 */
+constexpr char kTempPrefix[] = "calibration_test";
+
+/*
+ * @brief バッチ i のシミュレータを作ります（バッチごとに初期状態を変えます）。
+ */
+tea::Simulator make_sim(tea::ModelType model, double dt, int i) {
+  tea::SimulationConfig config;
+  config.model = model;
+  config.dt_seconds = dt;
+  config.drying_seconds = 120;
+  tea::Simulator sim(config);
+  tea::TeaLeaf leaf;
+  leaf.moisture = 0.6 + 0.05 * i;
+  leaf.temperature_c = 20.0 + 3.0 * i;
+  sim.set_initial_leaf(leaf);
+  return sim;
+}
+
+/*
+ * @brief バッチ i を単独の CSV へ書きます（ステップ数を返します）。
+ */
+std::size_t write_trace(const std::string& path,
+                        tea::ModelType model,
+                        double dt,
+                        int i) {
+  tea_io::CsvWriter csv(path);
+  csv.write_header();
+  tea::Simulator sim = make_sim(model, dt, i);
+  std::size_t steps = 0;
+  while (sim.step(dt, &csv)) {
+    ++steps;
+  }
+  return steps;
+}
+
+/*
+ * @brief 2 つの係数の相対誤差が rel 以下かを返します。
+ */
+bool close_rel(double a, double b, double rel) {
+  return std::fabs(a - b) <= rel * std::fabs(b);
+}
+
+/*
+ * @brief バッチ別 CSV と batch 列付き CSV をトレース単位で読めることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_reader_splits_traces() {
+  ScopedFile single(tea_test::make_temp_path(kTempPrefix, ".csv"));
+  const std::size_t steps =
+      write_trace(single.path(), tea::ModelType::DEFAULT, 0.7, 0);
+
+  ScopedFile mux_file(tea_test::make_temp_path(kTempPrefix, ".csv"));
+  {
+    tea_io::MultiplexWriter mux(mux_file.path(), tea_io::CsvEncoding::TEXT,
+                                tea_io::Compression::NONE);
+    std::vector<tea_io::CsvWriter> writers;
+    std::vector<tea::Simulator> sims;
+    for (int i = 0; i < 3; ++i) {
+      writers.push_back(mux.make_writer(i));
+      sims.push_back(make_sim(tea::ModelType::DEFAULT, 1.0, i));
+    }
+    bool running = true;
+    while (running) {
+      running = false;
+      for (int i = 0; i < 3; ++i) {
+        running = sims[static_cast<std::size_t>(i)].step(
+                      1.0, &writers[static_cast<std::size_t>(i)]) ||
+                  running;
+      }
+    }
+    for (tea_io::CsvWriter& w : writers) {
+      w.flush();
+    }
+    mux.finish();
+  }
+
+  tea_io::TraceReader reader({single.path(), mux_file.path()});
+  std::vector<tea_io::MeasuredTrace> traces;
+  tea_io::MeasuredTrace trace;
+  while (reader.next(trace)) {
+    traces.push_back(trace);
+  }
+
+  bool ok = true;
+  ok = tea_test::expect(reader.error().empty() && traces.size() == 4,
+                        "reader should return one trace per batch") && ok;
+  if (traces.size() == 4) {
+    ok = tea_test::expect(traces[0].batch == -1 &&
+                              traces[0].rows.size() == steps &&
+                              traces[0].rows.front().elapsed_ms == 700 &&
+                              traces[0].rows.back().elapsed_ms == 120000 +
+                                                                   60000,
+                          "single CSV should keep every step") && ok;
+    for (int i = 1; i < 4; ++i) {
+      const tea_io::MeasuredTrace& t = traces[static_cast<std::size_t>(i)];
+      ok = tea_test::expect(t.batch == i - 1 && t.rows.size() == 180 &&
+                                t.rows[29].process ==
+                                    tea::ProcessState::STEAMING &&
+                                t.rows[30].process ==
+                                    tea::ProcessState::ROLLING,
+                            "multiplexed batches should be split") && ok;
+    }
+  }
+
+  tea_io::MeasuredRow row;
+  int batch = -1;
+  ok = tea_test::expect(
+           tea_io::parse_trace_line("DRYING,1.5,0.5,60,40,30,50.00,BAD",
+                                    false, batch, row) &&
+               row.process == tea::ProcessState::DRYING &&
+               row.elapsed_ms == 1500 && row.temperature_c == 60.0,
+           "row should be parsed") && ok;
+  ok = tea_test::expect(
+           !tea_io::parse_trace_line("FINISHED,1,0.5,60,40,30,50,BAD", false,
+                                     batch, row) &&
+               !tea_io::parse_trace_line("DRYING,x,0.5,60,40,30,50,BAD", false,
+                                         batch, row),
+           "malformed rows should be rejected") && ok;
+  return ok;
+}
+
+/*
+ * @brief 読めないファイルや壊れた行を較正のエラーとして返すことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_reader_errors() {
+  ScopedFile broken(tea_test::make_temp_path(kTempPrefix, ".csv"));
+  {
+    std::ofstream out(broken.path());
+    out << "process,elapsedSeconds,moisture,temperatureC,aroma,color,"
+           "qualityScore,qualityStatus\n"
+        << "STEAMING,1,0.75,30,11,10,14,BAD\n"
+        << "STEAMING,oops\n";
+  }
+  bool ok = true;
+  const tea::ModelParams start = tea::make_model(tea::ModelType::DEFAULT);
+  const tea::CalibrationResult missing =
+      tea::calibrate({tea_test::make_temp_path(kTempPrefix, ".missing")},
+                     start);
+  ok = tea_test::expect(!missing.error.empty(),
+                        "missing file should be reported") && ok;
+  const tea::CalibrationResult bad = tea::calibrate({broken.path()}, start);
+  ok = tea_test::expect(bad.error.find(":3:") != std::string::npos,
+                        "malformed row should be reported with its line") && ok;
+  return ok;
+}
+
+/*
+ * @brief 別モデルの係数で書いたトレースから、その係数を較正し直せることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_calibration_recovers_model() {
+  const double dts[] = {1.0, 0.7};
+  bool ok = true;
+  for (const double dt : dts) {
+    std::vector<std::unique_ptr<ScopedFile>> files;
+    std::vector<std::string> paths;
+    for (int i = 0; i < 3; ++i) {
+      files.push_back(std::make_unique<ScopedFile>(
+          tea_test::make_temp_path(kTempPrefix, ".csv")));
+      write_trace(files.back()->path(), tea::ModelType::GENTLE, dt, i);
+      paths.push_back(files.back()->path());
+    }
+
+    const tea::ModelParams truth = tea::make_model(tea::ModelType::GENTLE);
+    const tea::ModelParams start = tea::make_model(tea::ModelType::DEFAULT);
+    tea::CalibrationOptions options;
+    options.dt_seconds = dt;
+    options.chunk_traces = 2;
+    options.threads = 2;
+    int reported = 0;
+    const tea::CalibrationResult r = tea::calibrate(
+        paths, start, options,
+        [&reported](const tea::CalibrationProgress&) { ++reported; });
+
+    ok = tea_test::expect(r.error.empty() && r.traces == 3 && r.converged,
+                          "calibration should converge") && ok;
+    ok = tea_test::expect(r.loss < r.initial_loss * 1e-6 &&
+                              reported == r.iterations && r.iterations > 0,
+                          "loss should drop by orders of magnitude") && ok;
+    for (int i = 0; i < tea::kModelParamCount; ++i) {
+      const std::size_t k = static_cast<std::size_t>(i);
+      const double fitted = tea::model_param_value(r.params, i);
+      if (r.fitted[k]) {
+        /* CSV の丸め（温度は 0.001 °C）の範囲で元の係数に戻ります。 */
+        ok = tea_test::expect(
+                 close_rel(fitted, tea::model_param_value(truth, i), 1e-3),
+                 tea::model_param_name(i)) && ok;
+      } else {
+        ok = tea_test::expect(fitted == tea::model_param_value(start, i),
+                              "unfitted parameter should stay at start") && ok;
+      }
+    }
+    /* 香気と色を使わない既定の尺度では、それらの係数は識別できません。 */
+    ok = tea_test::expect(r.fitted[1] && r.fitted[12] && !r.fitted[3] &&
+                              !r.fitted[14],
+                          "only moisture/temperature coefficients are fitted")
+         && ok;
+  }
+  return ok;
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_reader_splits_traces() && ok;
+  ok = test_reader_errors() && ok;
+  ok = test_calibration_recovers_model() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "calibration_tests: OK\n";
+  return 0;
+}
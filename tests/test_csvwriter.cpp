@@ -1,6 +1,6 @@
 /*
  * @file test_csvwriter.cpp
- * @brief CsvWriter の品質スコア/ステータス算出の検証
+ * @brief CsvWriter の品質スコア/ステータス算出と経過時間の書式の検証
  *
  * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
  */
@@ -64,6 +64,28 @@ bool test_quality_status_thresholds() {
   return ok;
 }
 
+/*
+ * @brief format_elapsed が整数秒は従来どおり、端数はミリ秒までの最短表記で書くことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_format_elapsed() {
+  const struct {
+    double seconds;
+    const char* text;
+  } cases[] = {{30.0, "30"},   {0.0, "0"},       {0.1, "0.1"},
+               {12.25, "12.25"}, {1.5, "1.5"},   {0.001, "0.001"},
+               {4200.7, "4200.7"}};
+  bool ok = true;
+  for (const auto& c : cases) {
+    char buf[32];
+    const int n = tea_io::CsvWriter::format_elapsed(buf, sizeof(buf), c.seconds);
+    ok = tea_test::expect(n > 0 && std::string(buf) == c.text,
+                          "elapsed should be written in shortest ms form") && ok;
+  }
+  return ok;
+}
+
 } /* namespace */
 
 /*
@@ -75,6 +97,7 @@ int main() {
   bool ok = true;
   ok = test_quality_score_formula_and_clamp() && ok;
   ok = test_quality_status_thresholds() && ok;
+  ok = test_format_elapsed() && ok;
 
   if (!ok) {
     return 1;
@@ -146,6 +146,36 @@ bool test_write_row_writes_header_automatically() {
   return ok;
 }
 
+/*
+ * @brief ムーブ代入で上書きされる側の未書き出しの行が失われないことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_move_assignment_flushes_target() {
+  ScopedFile first(make_temp_csv_path());
+  ScopedFile second(first.path() + ".moved.csv");
+
+  {
+    tea_io::CsvWriter w(first.path());
+    w.write_row("STEAMING", 1, 0.75, 25.0, 10.0, 10.0);
+    w.write_row("STEAMING", 2, 0.70, 30.0, 12.0, 11.0);
+    w = tea_io::CsvWriter(second.path());
+    w.write_row("ROLLING", 3, 0.65, 35.0, 14.0, 12.0);
+  }
+
+  const auto first_lines = read_lines(first.path());
+  const auto second_lines = read_lines(second.path());
+
+  bool ok = true;
+  ok = tea_test::expect(first_lines.size() == 3,
+                        "rows buffered before move-assignment should be kept")
+       && ok;
+  ok = tea_test::expect(second_lines.size() == 2 &&
+                            second_lines[1].find("ROLLING,3,") == 0,
+                        "assigned writer should write to its own file") && ok;
+  return ok;
+}
+
 } /* namespace */
 
 /*
@@ -157,6 +187,7 @@ int main() {
   bool ok = true;
   ok = test_header_written_once_and_rows_appended() && ok;
   ok = test_write_row_writes_header_automatically() && ok;
+  ok = test_move_assignment_flushes_target() && ok;
 
   if (!ok) {
     return 1;
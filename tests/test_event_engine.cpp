@@ -0,0 +1,242 @@
+/*
+ * @file test_event_engine.cpp
+ * @brief イベントの時刻へ跳ぶ EventEngine の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ * 跳びながら進めた結果（run()）を、Simulator を 1 ステップずつ進めて
+ * 判定した結果（run(recorder)）と比べます。
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "simulation/EventEngine.h"
+#include "simulation/Simulator.h"
+#include "test_utils.h"
+
+namespace {
+
+/* ステップごとの記録を数える記録先です。 */
+struct CountingRecorder final {
+  std::size_t rows = 0;
+
+  void record(tea::ProcessState, double, const tea::TeaLeaf&) { ++rows; }
+};
+
+/*
+ * @brief 2 つの茶葉状態の成分ごとの差の最大値を返します。
+ */
+double max_diff(const tea::TeaLeaf& a, const tea::TeaLeaf& b) {
+  return std::max({std::fabs(a.moisture - b.moisture),
+                   std::fabs(a.temperature_c - b.temperature_c),
+                   std::fabs(a.aroma - b.aroma), std::fabs(a.color - b.color)});
+}
+
+/*
+ * @brief 全種類のイベントを購読し、発生順に集めます。
+ */
+void collect_all(tea::EventEngine& engine,
+                 std::vector<tea::SimulationEvent>& events) {
+  const tea::EventType types[] = {
+      tea::EventType::STAGE_CHANGED, tea::EventType::MOISTURE_CROSSED,
+      tea::EventType::OVERHEAT, tea::EventType::QUALITY_CHANGED};
+  for (const tea::EventType type : types) {
+    engine.subscribe(type, [&events](const tea::SimulationEvent& e) {
+      events.push_back(e);
+    });
+  }
+}
+
+/*
+ * @brief 跳びながら進めたイベント列が、1 ステップずつの判定と一致することを検証します。
+ */
+bool test_jumps_match_stepwise_events() {
+  struct Case {
+    double dt;
+    int drying;
+    tea::ModelType model;
+    double moisture_target;
+  };
+  const Case cases[] = {
+      {1.0, 3600, tea::ModelType::DEFAULT, 0.3},
+      {0.1, 600, tea::ModelType::AGGRESSIVE, 0.5},
+      {7.0, 601, tea::ModelType::GENTLE, 0.05},
+      {2.0, 60, tea::ModelType::DEFAULT, -1.0},
+      /* heat_k * dt > 1 で係数が負になり、1 ステップずつ進める場合です。 */
+      {20.0, 300, tea::ModelType::AGGRESSIVE, 0.3},
+  };
+
+  bool ok = true;
+  for (const Case& c : cases) {
+    tea::SimulationConfig config;
+    config.dt_seconds = c.dt;
+    config.drying_seconds = c.drying;
+    config.model = c.model;
+    tea::EventOptions options;
+    options.moisture_target = c.moisture_target;
+
+    tea::EventEngine jumping(config, options);
+    std::vector<tea::SimulationEvent> jumped;
+    collect_all(jumping, jumped);
+    jumping.run();
+
+    tea::EventEngine stepping(config, options);
+    std::vector<tea::SimulationEvent> stepped;
+    collect_all(stepping, stepped);
+    CountingRecorder recorder;
+    stepping.run(recorder);
+
+    ok = tea_test::expect(jumped.size() == stepped.size() && jumped.size() >= 4,
+                          "both modes should report the same events") && ok;
+    for (std::size_t i = 0; i < std::min(jumped.size(), stepped.size()); ++i) {
+      const tea::SimulationEvent& a = jumped[i];
+      const tea::SimulationEvent& b = stepped[i];
+      ok = tea_test::expect(a.type == b.type && a.process == b.process &&
+                                a.elapsed_seconds == b.elapsed_seconds &&
+                                a.rising == b.rising,
+                            "event type, stage and time should match") && ok;
+      ok = tea_test::expect(max_diff(a.leaf, b.leaf) < 1e-9,
+                            "event state should match within rounding") && ok;
+    }
+    ok = tea_test::expect(jumped.back().type == tea::EventType::STAGE_CHANGED &&
+                              jumped.back().process ==
+                                  tea::ProcessState::FINISHED,
+                          "last event should be FINISHED") && ok;
+    ok = tea_test::expect(jumping.elapsed_seconds() == stepping.elapsed_seconds(),
+                          "both modes should end at the same time") && ok;
+    ok = tea_test::expect(max_diff(jumping.leaf(), stepping.leaf()) < 1e-9,
+                          "final state should match within rounding") && ok;
+  }
+  return ok;
+}
+
+/*
+ * @brief ステップごとの出力がない場合に中間のステップを省略することを検証します。
+ */
+bool test_skips_intermediate_steps() {
+  tea::SimulationConfig config;
+  config.drying_seconds = 3600;
+  tea::EventOptions options;
+  options.moisture_target = 0.3;
+  tea::EventEngine engine(config, options);
+  engine.run();
+
+  const tea::EventStats& s = engine.stats();
+  const std::size_t total = 30 + 30 + 3600;
+  bool ok = true;
+  ok = tea_test::expect(s.kernel_steps + s.skipped_steps == total,
+                        "every dt step should be either skipped or taken") && ok;
+  ok = tea_test::expect(s.kernel_steps <= 2 * s.events,
+                        "only event steps should use the update kernel") && ok;
+  ok = tea_test::expect(s.skipped_steps > total * 9 / 10,
+                        "most steps should be skipped") && ok;
+
+  /* 逐次実行（Simulator）の最終状態と丸め誤差の範囲で一致します。 */
+  tea::Simulator sim(config);
+  while (sim.step(config.dt_seconds, nullptr)) {
+  }
+  ok = tea_test::expect(max_diff(engine.leaf(), sim.leaf()) < 1e-9,
+                        "jumped state should match the simulator") && ok;
+  return ok;
+}
+
+/*
+ * @brief run(recorder) が Simulator と同じステップを記録し、同じ最終状態になることを検証します。
+ */
+bool test_stepwise_run_matches_simulator() {
+  tea::SimulationConfig config;
+  config.dt_seconds = 0.7;
+  config.steaming_seconds = 10;
+  config.rolling_seconds = 5;
+  config.drying_seconds = 20;
+  tea::TeaLeaf initial;
+  initial.moisture = 0.6;
+  initial.temperature_c = 80.0;
+
+  tea::EventEngine engine(config);
+  engine.set_initial_leaf(initial);
+  CountingRecorder recorder;
+  engine.run(recorder);
+
+  tea::Simulator sim(config);
+  sim.set_initial_leaf(initial);
+  std::size_t steps = 0;
+  while (sim.step(config.dt_seconds, nullptr)) {
+    ++steps;
+  }
+
+  bool ok = true;
+  ok = tea_test::expect(recorder.rows == steps,
+                        "every step should be recorded") && ok;
+  ok = tea_test::expect(engine.leaf().moisture == sim.leaf().moisture &&
+                            engine.leaf().temperature_c ==
+                                sim.leaf().temperature_c &&
+                            engine.leaf().aroma == sim.leaf().aroma &&
+                            engine.leaf().color == sim.leaf().color,
+                        "stepwise run should match the simulator exactly") && ok;
+  return ok;
+}
+
+/*
+ * @brief 購読した種類のイベントだけが届き、向きと品質ステータスが正しいことを検証します。
+ */
+bool test_subscription_and_direction() {
+  tea::SimulationConfig config;
+  config.drying_seconds = 600;
+  tea::EventEngine engine(config);
+
+  std::vector<tea::SimulationEvent> overheat;
+  std::vector<tea::SimulationEvent> quality;
+  engine.subscribe(tea::EventType::OVERHEAT,
+                   [&overheat](const tea::SimulationEvent& e) {
+                     overheat.push_back(e);
+                   });
+  engine.subscribe(tea::EventType::QUALITY_CHANGED,
+                   [&quality](const tea::SimulationEvent& e) {
+                     quality.push_back(e);
+                   });
+  engine.run();
+
+  const double overheat_c =
+      tea::make_model(tea::ModelType::DEFAULT).drying.overheat_c;
+  bool ok = true;
+  /* 蒸しで過熱閾値を上回り、乾燥で下回ります（揉捻の目標温度は閾値ちょうど）。 */
+  ok = tea_test::expect(overheat.size() == 2 && overheat[0].rising &&
+                            overheat[0].process == tea::ProcessState::STEAMING &&
+                            overheat[0].leaf.temperature_c > overheat_c &&
+                            !overheat[1].rising &&
+                            overheat[1].process == tea::ProcessState::DRYING &&
+                            overheat[1].leaf.temperature_c <= overheat_c,
+                        "overheat should be entered and left once") && ok;
+  ok = tea_test::expect(quality.size() == 2 &&
+                            std::string(quality[0].status) == "OK" &&
+                            std::string(quality[1].status) == "GOOD" &&
+                            quality[0].rising && quality[1].rising,
+                        "quality should go BAD -> OK -> GOOD") && ok;
+  ok = tea_test::expect(engine.stats().events == 2 + 2 + 3,
+                        "unsubscribed events should still be counted") && ok;
+  return ok;
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_jumps_match_stepwise_events() && ok;
+  ok = test_skips_intermediate_steps() && ok;
+  ok = test_stepwise_run_matches_simulator() && ok;
+  ok = test_subscription_and_direction() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "event_engine_tests: OK\n";
+  return 0;
+}
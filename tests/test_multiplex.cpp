@@ -0,0 +1,230 @@
+/*
+ * @file test_multiplex.cpp
+ * @brief 多重化出力（MultiplexWriter）と索引によるバッチ読み出しの検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "io/CsvWriter.h"
+#include "io/Multiplex.h"
+#include "io/OutputSink.h"
+#include "simulation/Simulator.h"
+#include "test_utils.h"
+
+namespace {
+
+using tea_test::ScopedFile;
+
+/* 一時ファイル名の接頭辞です。 */
+constexpr char kTempPrefix[] = "multiplex_test";
+
+/* テストで使うバッチ数です。 */
+constexpr int kBatches = 5;
+
+/*
+ * @brief バッチ i のシミュレータを作ります（バッチごとに初期状態を変えます）。
+ */
+tea::Simulator make_sim(int i) {
+  tea::SimulationConfig config;
+  config.drying_seconds = 400;
+  tea::Simulator sim(config);
+  tea::TeaLeaf leaf;
+  leaf.moisture = 0.6 + 0.05 * i;
+  sim.set_initial_leaf(leaf);
+  return sim;
+}
+
+/*
+ * @brief バッチ i を単独の CSV として書いた場合の内容を返します。
+ */
+std::string expected_csv(int i) {
+  ScopedFile file(tea_test::make_temp_path(kTempPrefix, ".csv"));
+  {
+    tea_io::CsvWriter csv(file.path());
+    csv.write_header();
+    tea::Simulator sim = make_sim(i);
+    while (sim.step(1, &csv)) {
+    }
+  }
+  std::string out;
+  tea_io::read_output_file(file.path(), out);
+  return out;
+}
+
+/*
+ * @brief 全バッチを交互に進めながら 1 ファイルへ多重化して書きます。
+ */
+void write_multiplexed(const std::string& path,
+                       tea_io::CsvEncoding encoding,
+                       tea_io::Compression compression,
+                       int keyframe_rows =
+                           tea_io::MultiplexWriter::kDefaultKeyframeRows) {
+  tea_io::MultiplexWriter mux(path, encoding, compression, keyframe_rows);
+  std::vector<tea_io::CsvWriter> writers;
+  std::vector<tea::Simulator> sims;
+  for (int i = 0; i < kBatches; ++i) {
+    writers.push_back(mux.make_writer(i));
+    sims.push_back(make_sim(i));
+  }
+  bool running = true;
+  while (running) {
+    running = false;
+    for (int i = 0; i < kBatches; ++i) {
+      running = sims[static_cast<std::size_t>(i)].step(
+                    1, &writers[static_cast<std::size_t>(i)]) ||
+                running;
+    }
+  }
+  for (tea_io::CsvWriter& w : writers) {
+    w.flush();
+  }
+  mux.finish();
+}
+
+/*
+ * @brief .team から各バッチを取り出すと単独 CSV と一致することを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_quantized_batches_round_trip(tea_io::Compression compression) {
+  ScopedFile file(tea_test::make_temp_path(kTempPrefix, ".team"));
+  write_multiplexed(file.path(), tea_io::CsvEncoding::QUANTIZED, compression);
+
+  tea_io::MultiplexReader reader(file.path());
+  bool ok = tea_test::expect(reader.is_open(), "index should be readable");
+  ok = tea_test::expect(reader.batches().size() == kBatches,
+                        "all batches should be indexed") && ok;
+  for (int i = kBatches - 1; i >= 0; --i) {
+    std::string csv;
+    ok = tea_test::expect(reader.read_batch_csv(i, csv),
+                          "batch should be readable") && ok;
+    ok = tea_test::expect(csv == expected_csv(i),
+                          "batch should match its standalone CSV") && ok;
+  }
+  std::string missing;
+  ok = tea_test::expect(!reader.read_batch_csv(kBatches, missing),
+                        "unknown batch should be rejected") && ok;
+  return ok;
+}
+
+/*
+ * @brief 時刻範囲の問い合わせが範囲内の行だけを、少ないチャンク読み出しで返すことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_time_range_query() {
+  ScopedFile file(tea_test::make_temp_path(kTempPrefix, ".team"));
+  write_multiplexed(file.path(), tea_io::CsvEncoding::QUANTIZED,
+                    tea_io::Compression::LZ4, 16);
+
+  tea_io::MultiplexReader reader(file.path());
+  std::vector<tea_io::QuantizedRow> rows;
+  bool ok = tea_test::expect(reader.query(3, 200, 240, rows),
+                             "range query should succeed");
+  ok = tea_test::expect(rows.size() == 41, "should return 41 rows") && ok;
+  ok = tea_test::expect(!rows.empty() && rows.front().elapsed_seconds == 200 &&
+                            rows.back().elapsed_seconds == 240,
+                        "rows should cover exactly [200, 240]") && ok;
+  ok = tea_test::expect(reader.last_chunks_read() <= 4,
+                        "only chunks overlapping the range should be read")
+       && ok;
+
+  /* 範囲の問い合わせ結果は単独 CSV の該当行と一致します。 */
+  std::string csv;
+  ok = tea_test::expect(reader.query_csv(3, 200, 240, csv),
+                        "CSV query should succeed") && ok;
+  std::istringstream expected(expected_csv(3));
+  std::string line;
+  std::string filtered;
+  std::getline(expected, line);
+  filtered += line + "\n";
+  while (std::getline(expected, line)) {
+    const std::size_t c1 = line.find(',');
+    const int t = std::stoi(line.substr(c1 + 1));
+    if (t >= 200 && t <= 240) {
+      filtered += line + "\n";
+    }
+  }
+  ok = tea_test::expect(csv == filtered, "CSV query should match filter") && ok;
+
+  ok = tea_test::expect(reader.query(3, 5000, 6000, rows) && rows.empty(),
+                        "range past the end should be empty") && ok;
+  return ok;
+}
+
+/*
+ * @brief TEXT の多重化 CSV はヘッダ 1 行と batch 列付きの全行を持つことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_text_has_batch_column() {
+  ScopedFile file(tea_test::make_temp_path(kTempPrefix, ".csv"));
+  write_multiplexed(file.path(), tea_io::CsvEncoding::TEXT,
+                    tea_io::Compression::NONE);
+
+  std::string all;
+  tea_io::read_output_file(file.path(), all);
+  std::istringstream iss(all);
+  std::string line;
+  std::getline(iss, line);
+  bool ok = tea_test::expect(line.rfind("batch,process,", 0) == 0,
+                             "header should start with batch column");
+
+  std::vector<std::size_t> rows(kBatches, 0);
+  while (std::getline(iss, line)) {
+    const int batch = std::stoi(line.substr(0, line.find(',')));
+    ok = tea_test::expect(batch >= 0 && batch < kBatches,
+                          "batch column should be valid") && ok;
+    rows[static_cast<std::size_t>(batch)]++;
+  }
+  for (int i = 0; i < kBatches; ++i) {
+    const std::string csv = expected_csv(i);
+    const std::size_t lines =
+        static_cast<std::size_t>(std::count(csv.begin(), csv.end(), '\n'));
+    ok = tea_test::expect(rows[static_cast<std::size_t>(i)] + 1 == lines,
+                          "each batch should keep all rows") && ok;
+  }
+  return ok;
+}
+
+/*
+ * @brief .team 以外のファイルは索引として開けないことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_rejects_other_files() {
+  ScopedFile file(tea_test::make_temp_path(kTempPrefix, ".csv"));
+  {
+    tea_io::CsvWriter w(file.path());
+    w.write_row("STEAMING", 1, 0.5, 25.0, 10.0, 10.0);
+  }
+  tea_io::MultiplexReader reader(file.path());
+  return tea_test::expect(!reader.is_open(), "CSV should not be accepted");
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_quantized_batches_round_trip(tea_io::Compression::NONE) && ok;
+  ok = test_quantized_batches_round_trip(tea_io::Compression::LZ4) && ok;
+  ok = test_time_range_query() && ok;
+  ok = test_text_has_batch_column() && ok;
+  ok = test_rejects_other_files() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "multiplex_tests: OK\n";
+  return 0;
+}
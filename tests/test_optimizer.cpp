@@ -0,0 +1,160 @@
+/*
+ * @file test_optimizer.cpp
+ * @brief 工程時間の最適化（optimize_durations）の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ */
+
+#include "io/CsvWriter.h"
+#include "simulation/Optimizer.h"
+#include "simulation/Simulator.h"
+
+#include "test_utils.h"
+
+namespace {
+
+/*
+ * @brief Simulator で全工程を実行した最終スコアを返します。
+ */
+double simulate_score(const tea::SimulationConfig& config) {
+  tea::Simulator sim(config);
+  while (sim.step(config.dt_seconds, nullptr)) {
+  }
+  const tea::TeaLeaf& leaf = sim.leaf();
+  return tea_io::CsvWriter::quality_score(leaf.moisture, leaf.aroma,
+                                          leaf.color);
+}
+
+/*
+ * @brief 小さい予算では全探索（Simulator::run 相当）と同じ最良値になることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_matches_brute_force_for_small_budget() {
+  bool ok = true;
+  for (const int dt : {1, 4}) {
+    tea::OptimizeConfig opt;
+    opt.model = tea::ModelType::AGGRESSIVE;
+    opt.dt_seconds = dt;
+    opt.budget_seconds = 20;
+    opt.threads = 2;
+    const tea::OptimizeResult result =
+        tea::optimize_durations(opt, tea::TeaLeaf());
+    ok = tea_test::expect(result.found, "optimizer should find a point") && ok;
+
+    double brute_best = -1.0;
+    for (int s = 1; s <= 18; ++s) {
+      for (int r = 1; s + r <= 19; ++r) {
+        for (int d = 1; s + r + d <= 20; ++d) {
+          tea::SimulationConfig c;
+          c.model = opt.model;
+          c.dt_seconds = dt;
+          c.steaming_seconds = s;
+          c.rolling_seconds = r;
+          c.drying_seconds = d;
+          const double score = simulate_score(c);
+          brute_best = score > brute_best ? score : brute_best;
+        }
+      }
+    }
+    ok = tea_test::expect(tea_test::nearly(result.best.score, brute_best, 1e-9),
+                          "best score should match brute force") && ok;
+  }
+  return ok;
+}
+
+/*
+ * @brief 最良点が予算内で、Simulator の再実行結果と一致することを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_best_is_reproducible_and_within_budget() {
+  tea::OptimizeConfig opt;
+  opt.dt_seconds = 3;
+  opt.budget_seconds = 240;
+  const tea::OptimizeResult result =
+      tea::optimize_durations(opt, tea::TeaLeaf());
+
+  bool ok = true;
+  ok = tea_test::expect(result.found, "optimizer should find a point") && ok;
+  ok = tea_test::expect(result.best.total_seconds() <= opt.budget_seconds,
+                        "best should respect budget") && ok;
+
+  tea::SimulationConfig c;
+  c.dt_seconds = opt.dt_seconds;
+  c.steaming_seconds = result.best.steaming_seconds;
+  c.rolling_seconds = result.best.rolling_seconds;
+  c.drying_seconds = result.best.drying_seconds;
+  ok = tea_test::expect(
+      tea_test::nearly(simulate_score(c), result.best.score, 1e-9),
+      "best score should be reproducible by Simulator") && ok;
+
+  ok = tea_test::expect(
+      result.best.score >= simulate_score(tea::SimulationConfig()),
+      "best should not be worse than default durations") && ok;
+  return ok;
+}
+
+/*
+ * @brief パレートフロントが合計時間・スコアともに単調増加であることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_pareto_front_is_monotonic() {
+  tea::OptimizeConfig opt;
+  opt.budget_seconds = 90;
+  const tea::OptimizeResult result =
+      tea::optimize_durations(opt, tea::TeaLeaf());
+
+  bool ok = true;
+  ok = tea_test::expect(!result.pareto_front.empty(),
+                        "pareto front should not be empty") && ok;
+  for (std::size_t i = 1; i < result.pareto_front.size(); ++i) {
+    const tea::OptimizePoint& a = result.pareto_front[i - 1];
+    const tea::OptimizePoint& b = result.pareto_front[i];
+    ok = tea_test::expect(a.total_seconds() < b.total_seconds(),
+                          "pareto totals should increase") && ok;
+    ok = tea_test::expect(a.score < b.score,
+                          "pareto scores should increase") && ok;
+  }
+  if (!result.pareto_front.empty()) {
+    ok = tea_test::expect(
+        result.pareto_front.back().score == result.best.score,
+        "last pareto point should be the best") && ok;
+  }
+  return ok;
+}
+
+/*
+ * @brief 予算が工程数に満たない場合は解なしになることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_infeasible_budget() {
+  tea::OptimizeConfig opt;
+  opt.budget_seconds = 2;
+  const tea::OptimizeResult result =
+      tea::optimize_durations(opt, tea::TeaLeaf());
+  return tea_test::expect(!result.found, "budget=2 should be infeasible");
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_matches_brute_force_for_small_budget() && ok;
+  ok = test_best_is_reproducible_and_within_budget() && ok;
+  ok = test_pareto_front_is_monotonic() && ok;
+  ok = test_infeasible_budget() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "optimizer_tests: OK\n";
+  return 0;
+}
@@ -0,0 +1,343 @@
+/*
+ * @file test_output_plan.cpp
+ * @brief 設定からの出力行数・バイト数の予測の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ * 行数は実際に Simulator を進めた回数と一致し、バイト数は実際の出力以上であることを確認します。
+ */
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "io/CsvWriter.h"
+#include "io/Multiplex.h"
+#include "simulation/OutputPlan.h"
+#include "simulation/Simulator.h"
+#include "test_utils.h"
+
+namespace {
+
+using tea_test::ScopedFile;
+
+/* 一時ファイル名の接頭辞です。 */
+constexpr char kTempPrefix[] = "output_plan_test";
+
+/*
+ * @brief 設定を作ります。
+ */
+tea::SimulationConfig make_config(double dt, int steaming, int rolling,
+                                  int drying, tea::ModelType model,
+                                  double sample = 0.0) {
+  tea::SimulationConfig config;
+  config.dt_seconds = dt;
+  config.sample_seconds = sample;
+  config.steaming_seconds = steaming;
+  config.rolling_seconds = rolling;
+  config.drying_seconds = drying;
+  config.model = model;
+  return config;
+}
+
+/*
+ * @brief 検証に使う設定の一覧です（割り切れない dt、0 秒の工程、発散し得る大きな dt、
+ * 1 秒未満の dt と出力間隔を含む）。
+ */
+std::vector<tea::SimulationConfig> configs() {
+  return {
+      make_config(1, 30, 30, 60, tea::ModelType::DEFAULT),
+      make_config(7, 30, 31, 59, tea::ModelType::GENTLE),
+      make_config(3, 0, 10, 10, tea::ModelType::DEFAULT),
+      make_config(4, 10, 0, 9, tea::ModelType::AGGRESSIVE),
+      make_config(5, 10, 10, 0, tea::ModelType::DEFAULT),
+      make_config(20, 40, 40, 40, tea::ModelType::DEFAULT),
+      make_config(100, 300, 200, 500, tea::ModelType::AGGRESSIVE),
+      make_config(2, 600, 600, 3600, tea::ModelType::GENTLE),
+      make_config(0.1, 30, 31, 60, tea::ModelType::DEFAULT),
+      make_config(0.3, 10, 7, 20, tea::ModelType::GENTLE, 1.5),
+      make_config(0.25, 30, 30, 60, tea::ModelType::AGGRESSIVE, 0.75),
+      make_config(0.001, 2, 0, 1, tea::ModelType::DEFAULT, 0.4),
+  };
+}
+
+/*
+ * @brief 予測した工程ごとの行数が、実際に Simulator を進めた回数と一致することを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_rows_are_exact() {
+  bool ok = true;
+  for (const tea::SimulationConfig& config : configs()) {
+    const tea::OutputPlan plan = tea::plan_output(config);
+    tea::Simulator sim(config);
+    std::int64_t rows[tea::kOutputStageCount] = {};
+    std::int64_t total = 0;
+    while (sim.step(config.dt_seconds, tea::sample_substeps(config), nullptr)) {
+      ++rows[static_cast<int>(sim.current_process())];
+      ++total;
+    }
+    ok = tea_test::expect(plan.total_rows == total, "total rows") && ok;
+    for (std::size_t i = 0; i < tea::kOutputStageCount; ++i) {
+      ok = tea_test::expect(plan.stage_rows[i] == rows[i], "stage rows") && ok;
+    }
+  }
+  const tea::OutputPlan none =
+      tea::plan_output(make_config(0, 30, 30, 60, tea::ModelType::DEFAULT));
+  ok = tea_test::expect(none.total_rows == 0, "dt <= 0 produces no rows") && ok;
+  return ok;
+}
+
+/*
+ * @brief 単独ファイルの大きさと CSV の各行が上限を超えないことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_file_bounds() {
+  bool ok = true;
+  for (const tea::SimulationConfig& config : configs()) {
+    const tea::OutputPlan plan = tea::plan_output(config);
+    for (const tea_io::CsvEncoding encoding :
+         {tea_io::CsvEncoding::TEXT, tea_io::CsvEncoding::QUANTIZED}) {
+      for (const tea_io::Compression compression :
+           {tea_io::Compression::NONE, tea_io::Compression::LZ4}) {
+        ScopedFile file(tea_test::make_temp_path(kTempPrefix, ".out"));
+        {
+          tea_io::CsvWriter csv(file.path(), encoding, compression);
+          csv.reserve_rows(plan.total_rows,
+                           tea::max_row_bytes(plan, encoding));
+          csv.write_header();
+          tea::Simulator sim(config);
+          while (sim.step(config.dt_seconds, tea::sample_substeps(config),
+                          &csv)) {
+          }
+        }
+        std::error_code ec;
+        const std::uint64_t size = std::filesystem::file_size(file.path(), ec);
+        ok = tea_test::expect(
+                 size <= tea::file_bytes_bound(plan, encoding, compression),
+                 "file size should not exceed the bound") && ok;
+
+        if (encoding == tea_io::CsvEncoding::TEXT &&
+            compression == tea_io::Compression::NONE) {
+          std::ifstream ifs(file.path());
+          std::string line;
+          std::getline(ifs, line);
+          std::size_t longest = 0;
+          while (std::getline(ifs, line)) {
+            longest = std::max(longest, line.size() + 1);
+          }
+          ok = tea_test::expect(longest <= tea::max_row_bytes(plan, encoding),
+                                "CSV row should not exceed the bound") && ok;
+        }
+      }
+    }
+  }
+  return ok;
+}
+
+/*
+ * @brief 多重化ファイルの大きさが上限を超えないことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_multiplex_bounds() {
+  constexpr int kBatches = 11;
+  constexpr int kKeyframeRows = 16;
+  const tea::SimulationConfig config =
+      make_config(3, 30, 31, 60, tea::ModelType::AGGRESSIVE);
+  const tea::OutputPlan plan = tea::plan_output(config);
+
+  bool ok = true;
+  for (const tea_io::CsvEncoding encoding :
+       {tea_io::CsvEncoding::TEXT, tea_io::CsvEncoding::QUANTIZED}) {
+    for (const tea_io::Compression compression :
+         {tea_io::Compression::NONE, tea_io::Compression::LZ4}) {
+      ScopedFile file(tea_test::make_temp_path(kTempPrefix, ".team"));
+      {
+        tea_io::MultiplexWriter mux(file.path(), encoding, compression,
+                                    kKeyframeRows);
+        std::vector<std::optional<tea_io::CsvWriter>> csvs(kBatches);
+        std::vector<tea::Simulator> sims;
+        sims.reserve(kBatches);
+        for (int i = 0; i < kBatches; ++i) {
+          sims.emplace_back(config);
+          csvs[static_cast<std::size_t>(i)].emplace(mux.make_writer(i));
+        }
+        bool running = true;
+        while (running) {
+          running = false;
+          for (int i = 0; i < kBatches; ++i) {
+            running = sims[static_cast<std::size_t>(i)].step(
+                          config.dt_seconds,
+                          &*csvs[static_cast<std::size_t>(i)]) ||
+                      running;
+          }
+        }
+        for (std::optional<tea_io::CsvWriter>& csv : csvs) {
+          csv->flush();
+        }
+        mux.finish();
+      }
+      std::error_code ec;
+      const std::uint64_t size = std::filesystem::file_size(file.path(), ec);
+      ok = tea_test::expect(
+               size > 0 && size <= tea::multiplex_bytes_bound(
+                                        plan, kBatches, encoding, compression,
+                                        kKeyframeRows),
+               "multiplexed size should not exceed the bound") && ok;
+    }
+  }
+  return ok;
+}
+
+/*
+ * @brief 予約した CSV バッファとログ 1 周期分の文字列が、実行中に再確保されないことを検証します。
+ *
+ * CLI と同じく、バッチごとの CsvWriter に reserve_rows(plan.total_rows, …) を、
+ * ログに「バッチ数 × console_line_bytes」を一度だけ予約し、全バッチを最後まで
+ * 進める間の容量が変わらないことを確かめます。
+ *
+ * @return 成功なら true
+ */
+bool test_reserved_buffers_never_grow() {
+  constexpr int kBatches = 3;
+  /* CLI のログ 1 行と同じ書式です（src/cli/main.cpp の kLogLineFormat）。 */
+  constexpr const char* kLogLineFormat =
+      "[batch=%d] [%s] t=%ss moisture=%.2f temp=%.1f aroma=%.1f color=%.1f\n";
+
+  bool ok = true;
+  for (const tea::SimulationConfig& config : configs()) {
+    const tea::OutputPlan plan = tea::plan_output(config);
+    const int substeps = tea::sample_substeps(config);
+    for (const tea_io::CsvEncoding encoding :
+         {tea_io::CsvEncoding::TEXT, tea_io::CsvEncoding::QUANTIZED}) {
+      for (const tea_io::Compression compression :
+           {tea_io::Compression::NONE, tea_io::Compression::LZ4}) {
+        std::vector<std::unique_ptr<ScopedFile>> files;
+        std::vector<std::optional<tea_io::CsvWriter>> csvs(kBatches);
+        std::vector<std::size_t> reserved(kBatches);
+        std::vector<tea::Simulator> sims;
+        sims.reserve(kBatches);
+        for (int i = 0; i < kBatches; ++i) {
+          const std::size_t k = static_cast<std::size_t>(i);
+          files.push_back(std::make_unique<ScopedFile>(
+              tea_test::make_temp_path(kTempPrefix, ".out")));
+          csvs[k].emplace(files.back()->path(), encoding, compression);
+          csvs[k]->write_header();
+          csvs[k]->reserve_rows(plan.total_rows,
+                                tea::max_row_bytes(plan, encoding));
+          reserved[k] = csvs[k]->buffer_capacity();
+          sims.emplace_back(config);
+        }
+        std::string log;
+        log.reserve(static_cast<std::size_t>(kBatches) *
+                    tea::console_line_bytes(plan, kBatches));
+        const std::size_t log_reserved = log.capacity();
+
+        bool grew = false;
+        bool running = true;
+        while (running) {
+          running = false;
+          log.clear();
+          for (int i = 0; i < kBatches; ++i) {
+            const std::size_t k = static_cast<std::size_t>(i);
+            tea::Simulator& sim = sims[k];
+            if (!sim.step(config.dt_seconds, substeps, &*csvs[k])) {
+              continue;
+            }
+            running = true;
+            char elapsed[32];
+            tea_io::CsvWriter::format_elapsed(elapsed, sizeof(elapsed),
+                                              sim.elapsed_seconds());
+            char line[192];
+            const int n = std::snprintf(
+                line, sizeof(line), kLogLineFormat, i,
+                tea::to_string(sim.current_process()), elapsed,
+                sim.leaf().moisture, sim.leaf().temperature_c,
+                sim.leaf().aroma, sim.leaf().color);
+            log.append(line, static_cast<std::size_t>(n));
+            grew = grew || csvs[k]->buffer_capacity() != reserved[k];
+          }
+          grew = grew || log.capacity() != log_reserved;
+        }
+        ok = tea_test::expect(!grew, "reserved buffers should not grow") && ok;
+      }
+    }
+  }
+  return ok;
+}
+
+/*
+ * @brief キーフレーム K 行を保持する多重化の書き出しで、予約した容量が変わらないことを検証します。
+ *
+ * K 行が既定の確保量（書き出し閾値）を超える場合、reserve_rows の予約だけが頼りです。
+ *
+ * @return 成功なら true
+ */
+bool test_keyframe_buffer_never_grows() {
+  constexpr int kBatches = 2;
+  constexpr int kKeyframeRows = 8192;
+  const tea::SimulationConfig config =
+      make_config(0.01, 30, 30, 200, tea::ModelType::AGGRESSIVE);
+  const tea::OutputPlan plan = tea::plan_output(config);
+  const tea_io::CsvEncoding encoding = tea_io::CsvEncoding::QUANTIZED;
+
+  ScopedFile file(tea_test::make_temp_path(kTempPrefix, ".team"));
+  tea_io::MultiplexWriter mux(file.path(), encoding,
+                              tea_io::Compression::NONE, kKeyframeRows);
+  std::vector<std::optional<tea_io::CsvWriter>> csvs(kBatches);
+  std::vector<std::size_t> reserved(kBatches);
+  std::vector<tea::Simulator> sims;
+  sims.reserve(kBatches);
+  for (int i = 0; i < kBatches; ++i) {
+    const std::size_t k = static_cast<std::size_t>(i);
+    csvs[k].emplace(mux.make_writer(i));
+    csvs[k]->reserve_rows(plan.total_rows, tea::max_row_bytes(plan, encoding));
+    reserved[k] = csvs[k]->buffer_capacity();
+    sims.emplace_back(config);
+  }
+
+  bool grew = false;
+  bool running = true;
+  while (running) {
+    running = false;
+    for (int i = 0; i < kBatches; ++i) {
+      const std::size_t k = static_cast<std::size_t>(i);
+      if (sims[k].step(config.dt_seconds, &*csvs[k])) {
+        running = true;
+        grew = grew || csvs[k]->buffer_capacity() != reserved[k];
+      }
+    }
+  }
+  for (std::optional<tea_io::CsvWriter>& csv : csvs) {
+    csv->flush();
+  }
+  mux.finish();
+  return tea_test::expect(!grew, "keyframe buffer should not grow");
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_rows_are_exact() && ok;
+  ok = test_file_bounds() && ok;
+  ok = test_multiplex_bounds() && ok;
+  ok = test_reserved_buffers_never_grow() && ok;
+  ok = test_keyframe_buffer_never_grows() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "output_plan_tests: OK\n";
+  return 0;
+}
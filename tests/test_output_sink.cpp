@@ -0,0 +1,189 @@
+/*
+ * @file test_output_sink.cpp
+ * @brief LZ4 ブロック圧縮と出力シンク/読み戻しの検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "io/CsvWriter.h"
+#include "io/Lz4.h"
+#include "io/OutputSink.h"
+#include "io/QuantizedTrace.h"
+#include "test_utils.h"
+
+namespace {
+
+using tea_test::ScopedFile;
+
+/* 一時ファイル名の接頭辞です。 */
+constexpr char kTempPrefix[] = "output_sink_test";
+
+/*
+ * @brief 圧縮→展開で元に戻ることを確認します。
+ */
+bool round_trips(const std::string& input) {
+  std::vector<char> packed(tea_io::lz4::compress_bound(input.size()));
+  const std::size_t n = tea_io::lz4::compress(input.data(), input.size(),
+                                              packed.data(), packed.size());
+  std::string output(input.size(), '\0');
+  return n > 0 &&
+         tea_io::lz4::decompress(packed.data(), n, &output[0],
+                                 output.size()) &&
+         output == input;
+}
+
+/*
+ * @brief 空、短い、繰り返し、擬似乱数の入力が往復できることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_lz4_round_trip() {
+  std::string repetitive;
+  for (int i = 0; i < 5000; ++i) {
+    repetitive += "DRYING," + std::to_string(i) + ",0.123456,80.000\n";
+  }
+  std::string noise;
+  unsigned int x = 12345;
+  for (int i = 0; i < 70000; ++i) {
+    x = x * 1103515245u + 12345u;
+    noise += static_cast<char>(x >> 24);
+  }
+
+  bool ok = true;
+  ok = tea_test::expect(round_trips(""), "empty input") && ok;
+  ok = tea_test::expect(round_trips("abc"), "short input") && ok;
+  ok = tea_test::expect(round_trips(std::string(100000, 'a')),
+                        "long run (overlapping copies)") && ok;
+  ok = tea_test::expect(round_trips(repetitive), "CSV-like input") && ok;
+  ok = tea_test::expect(round_trips(noise), "incompressible input") && ok;
+
+  std::vector<char> packed(tea_io::lz4::compress_bound(repetitive.size()));
+  const std::size_t n = tea_io::lz4::compress(
+      repetitive.data(), repetitive.size(), packed.data(), packed.size());
+  ok = tea_test::expect(n * 3 < repetitive.size(),
+                        "CSV-like input should compress") && ok;
+  return ok;
+}
+
+/*
+ * @brief 壊れた圧縮データを範囲外へ書かずに拒否することを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_lz4_rejects_corrupted_input() {
+  const std::string input(1000, 'z');
+  std::vector<char> packed(tea_io::lz4::compress_bound(input.size()));
+  const std::size_t n = tea_io::lz4::compress(input.data(), input.size(),
+                                              packed.data(), packed.size());
+  std::string output(input.size(), '\0');
+
+  bool ok = true;
+  ok = tea_test::expect(!tea_io::lz4::decompress(packed.data(), n - 1,
+                                                 &output[0], output.size()),
+                        "truncated input should fail") && ok;
+  ok = tea_test::expect(!tea_io::lz4::decompress(packed.data(), n, &output[0],
+                                                 output.size() - 1),
+                        "too small output should fail") && ok;
+  return ok;
+}
+
+/*
+ * @brief 小さいブロックで書いたファイルを読み戻せることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_lz4_file_sink_round_trip() {
+  ScopedFile file(tea_test::make_temp_path(kTempPrefix, ".lz4"));
+  std::string expected;
+  {
+    tea_io::Lz4FileSink sink(file.path(), 1024);
+    for (int i = 0; i < 2000; ++i) {
+      const std::string line = "row," + std::to_string(i * 7) + "\n";
+      sink.write(line.data(), line.size());
+      expected += line;
+    }
+  }
+
+  tea_io::OutputFileReader reader(file.path());
+  std::string actual;
+  std::string chunk;
+  int chunks = 0;
+  while (reader.read_chunk(chunk)) {
+    actual += chunk;
+    ++chunks;
+  }
+
+  bool ok = true;
+  ok = tea_test::expect(reader.compressed(), "should detect LZ4 file") && ok;
+  ok = tea_test::expect(!reader.corrupted(), "should end cleanly") && ok;
+  ok = tea_test::expect(chunks > 1, "should be split into blocks") && ok;
+  ok = tea_test::expect(actual == expected, "content should round-trip") && ok;
+  return ok;
+}
+
+/*
+ * @brief 圧縮した CSV/.teaq が無圧縮 CSV と同じ内容に戻ることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_csv_writer_compression() {
+  ScopedFile plain(tea_test::make_temp_path(kTempPrefix, ".csv"));
+  ScopedFile packed(tea_test::make_temp_path(kTempPrefix, ".csv.lz4"));
+  ScopedFile teaq(tea_test::make_temp_path(kTempPrefix, ".teaq.lz4"));
+  {
+    tea_io::CsvWriter a(plain.path());
+    tea_io::CsvWriter b(packed.path(), tea_io::CsvEncoding::TEXT,
+                        tea_io::Compression::LZ4);
+    tea_io::CsvWriter c(teaq.path(), tea_io::CsvEncoding::QUANTIZED,
+                        tea_io::Compression::LZ4);
+    for (int i = 0; i < 3000; ++i) {
+      const double m = 0.9 - 0.0002 * i;
+      const double t = 25.0 + 0.01 * i;
+      a.write_row("DRYING", i, m, t, 40.0, 30.0);
+      b.write_row("DRYING", i, m, t, 40.0, 30.0);
+      c.write_row("DRYING", i, m, t, 40.0, 30.0);
+    }
+  }
+
+  std::string expected;
+  std::string unpacked;
+  bool ok = true;
+  ok = tea_test::expect(tea_io::read_output_file(plain.path(), expected),
+                        "plain file should be readable") && ok;
+  ok = tea_test::expect(tea_io::read_output_file(packed.path(), unpacked),
+                        "compressed file should be readable") && ok;
+  ok = tea_test::expect(unpacked == expected,
+                        "compressed CSV should match plain CSV") && ok;
+
+  tea_io::QuantizedTraceReader reader(teaq.path());
+  std::ostringstream decoded;
+  reader.write_csv(decoded);
+  ok = tea_test::expect(decoded.str() == expected,
+                        "compressed .teaq should decode to plain CSV") && ok;
+  return ok;
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_lz4_round_trip() && ok;
+  ok = test_lz4_rejects_corrupted_input() && ok;
+  ok = test_lz4_file_sink_round_trip() && ok;
+  ok = test_csv_writer_compression() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "output_sink_tests: OK\n";
+  return 0;
+}
@@ -0,0 +1,146 @@
+/*
+ * @file test_pipeline.cpp
+ * @brief constexpr の組み込みモデル（kModelParams）と Pipeline<ModelType> の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ * 係数を畳んだ経路の結果が、実行時の係数で進めた Simulator と丸め誤差の
+ * 範囲で一致することを確かめます。
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "process/StepKernels.h"
+#include "simulation/Pipeline.h"
+#include "simulation/Simulator.h"
+#include "test_utils.h"
+
+namespace {
+
+/* 組み込みモデルの係数と畳んだ係数はコンパイル時に求まります。 */
+static_assert(tea::kModelParams<tea::ModelType::GENTLE>.steaming.heat_k ==
+                  0.08 * 0.75,
+              "gentle heat_k should be a compile-time constant");
+static_assert(tea::Pipeline<tea::ModelType::DEFAULT>::kSteaming.temperature_a ==
+                  1.0 - 0.08,
+              "1 - heat_k * dt should be folded at compile time");
+static_assert(tea::Pipeline<tea::ModelType::AGGRESSIVE, 500>::kDtSeconds == 0.5,
+              "dt should follow the template argument");
+
+/*
+ * @brief 2 つの状態の成分ごとの差の最大値を返します。
+ */
+double max_diff(const tea::TeaLeaf& a, const tea::TeaLeaf& b) {
+  return std::max({std::fabs(a.moisture - b.moisture),
+                   std::fabs(a.temperature_c - b.temperature_c),
+                   std::fabs(a.aroma - b.aroma),
+                   std::fabs(a.color - b.color)});
+}
+
+/*
+ * @brief Simulator で全工程を進めた最終状態を返します。
+ */
+tea::TeaLeaf simulate(tea::ModelType model,
+                      double dt,
+                      const tea::TeaLeaf& initial,
+                      int steaming,
+                      int rolling,
+                      int drying) {
+  tea::SimulationConfig config;
+  config.model = model;
+  config.dt_seconds = dt;
+  config.steaming_seconds = steaming;
+  config.rolling_seconds = rolling;
+  config.drying_seconds = drying;
+  tea::Simulator sim(config);
+  sim.set_initial_leaf(initial);
+  while (sim.step(dt, nullptr)) {
+  }
+  return sim.leaf();
+}
+
+/*
+ * @brief Pipeline<M, Dt> を工程時間の組ごとに Simulator と比べます。
+ */
+template <tea::ModelType M, std::int64_t DtMilliseconds>
+bool check_matches_simulator() {
+  using P = tea::Pipeline<M, DtMilliseconds>;
+  const int durations[][3] = {{30, 30, 120}, {45, 20, 600}, {0, 7, 3600}};
+  const double dt = P::kDtSeconds;
+
+  bool ok = true;
+  for (const auto& d : durations) {
+    for (int i = 0; i < 3; ++i) {
+      tea::TeaLeaf leaf;
+      leaf.moisture = 0.6 + 0.1 * i;
+      leaf.temperature_c = 20.0 + 10.0 * i;
+      const tea::TeaLeaf expected = simulate(M, dt, leaf, d[0], d[1], d[2]);
+      const tea::TeaLeaf actual = P::run(leaf, d[0], d[1], d[2]);
+      ok = tea_test::expect(max_diff(actual, expected) < 1e-9,
+                            "pipeline should match the simulator") && ok;
+    }
+  }
+  return ok;
+}
+
+/*
+ * @brief constexpr の係数が実行時の make_model と一致することを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_constexpr_models_match_runtime() {
+  bool ok = true;
+  const tea::ModelParams def = tea::make_model(tea::ModelType::DEFAULT);
+  const tea::ModelParams aggr = tea::make_model(tea::ModelType::AGGRESSIVE);
+  const auto& c_def = tea::kModelParams<tea::ModelType::DEFAULT>;
+  const auto& c_aggr = tea::kModelParams<tea::ModelType::AGGRESSIVE>;
+  ok = tea_test::expect(c_def.steaming.heat_k == def.steaming.heat_k &&
+                            c_def.drying.dry_k == def.drying.dry_k,
+                        "default constants should match make_model") && ok;
+  ok = tea_test::expect(c_aggr.rolling.moisture_loss_k ==
+                                aggr.rolling.moisture_loss_k &&
+                            c_aggr.drying.aroma_damage_k ==
+                                aggr.drying.aroma_damage_k,
+                        "aggressive constants should match make_model") && ok;
+  ok = tea_test::expect(
+           tea::Pipeline<tea::ModelType::GENTLE, 700>::kDryingDecay ==
+               tea::drying_decay(tea::make_model(tea::ModelType::GENTLE).drying,
+                                 0.7),
+           "drying decay should equal drying_decay") && ok;
+  return ok;
+}
+
+/*
+ * @brief 全モデル・端数ステップのある刻みで Simulator と一致することを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_pipeline_matches_simulator() {
+  bool ok = true;
+  ok = check_matches_simulator<tea::ModelType::DEFAULT, 1000>() && ok;
+  ok = check_matches_simulator<tea::ModelType::GENTLE, 1000>() && ok;
+  ok = check_matches_simulator<tea::ModelType::AGGRESSIVE, 1000>() && ok;
+  ok = check_matches_simulator<tea::ModelType::DEFAULT, 700>() && ok;
+  ok = check_matches_simulator<tea::ModelType::AGGRESSIVE, 2000>() && ok;
+  return ok;
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_constexpr_models_match_runtime() && ok;
+  ok = test_pipeline_matches_simulator() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "pipeline_tests: OK\n";
+  return 0;
+}
@@ -0,0 +1,367 @@
+/*
+ * @file test_prefix_cache.cpp
+ * @brief 工程境界キャッシュ（PrefixStateCache）とスイープ（枝刈りを含む）の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "io/CsvWriter.h"
+#include "simulation/PrefixCache.h"
+#include "simulation/Simulator.h"
+#include "simulation/Sweep.h"
+
+#include "test_utils.h"
+
+namespace {
+
+/*
+ * @brief Simulator で全工程を実行した最終状態を返します。
+ */
+tea::TeaLeaf simulate(const tea::SimulationConfig& config,
+                      const tea::TeaLeaf& initial) {
+  tea::Simulator sim(config);
+  sim.set_initial_leaf(initial);
+  while (sim.step(config.dt_seconds, nullptr)) {
+  }
+  return sim.leaf();
+}
+
+/*
+ * @brief 2つの茶葉状態が一致することを検証します。
+ */
+bool same_leaf(const tea::TeaLeaf& a, const tea::TeaLeaf& b) {
+  const double eps = 1e-12;
+  return tea_test::nearly(a.moisture, b.moisture, eps) &&
+         tea_test::nearly(a.temperature_c, b.temperature_c, eps) &&
+         tea_test::nearly(a.aroma, b.aroma, eps) &&
+         tea_test::nearly(a.color, b.color, eps);
+}
+
+/*
+ * @brief キャッシュ経由の結果が Simulator と一致し、乾燥だけ変えると再利用されることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_drying_sweep_reuses_prefix() {
+  tea::PrefixStateCache cache(64);
+  tea::TeaLeaf initial;
+  initial.moisture = 0.7;
+
+  bool ok = true;
+  for (int drying = 10; drying <= 50; drying += 10) {
+    tea::SimulationConfig config;
+    config.dt_seconds = 3;
+    config.model = tea::ModelType::GENTLE;
+    config.drying_seconds = drying;
+    ok = tea_test::expect(same_leaf(cache.run(config, initial),
+                                    simulate(config, initial)),
+                          "cached run should match Simulator") && ok;
+  }
+
+  const tea::PrefixCacheStats& st = cache.stats();
+  ok = tea_test::expect(st.misses == 1, "only first run should miss") && ok;
+  ok = tea_test::expect(st.hits == 4, "later runs should hit") && ok;
+  ok = tea_test::expect(st.stages_reused == 8,
+                        "each hit should reuse steaming+rolling") && ok;
+  return ok;
+}
+
+/*
+ * @brief 同一設定の再実行は乾燥後の境界から即座に返ることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_identical_run_hits_final_boundary() {
+  tea::PrefixStateCache cache(8);
+  const tea::SimulationConfig config;
+  const tea::TeaLeaf a = cache.run(config, tea::TeaLeaf());
+  const tea::TeaLeaf b = cache.run(config, tea::TeaLeaf());
+
+  bool ok = true;
+  ok = tea_test::expect(same_leaf(a, b), "results should match") && ok;
+  ok = tea_test::expect(cache.stats().stages_reused == 3,
+                        "identical run should reuse all stages") && ok;
+  return ok;
+}
+
+/*
+ * @brief 初期状態の -0.0 と 0.0 が同じエントリに当たることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_negative_zero_shares_entry() {
+  /*
+    温度は normalize で丸められないため -0.0 のままキーに入ります。
+    1件だけではバケットが偶然一致しうるため、複数の初期状態で確かめます。
+  */
+  const int runs = 32;
+  tea::PrefixStateCache cache(256);
+  const tea::SimulationConfig config;
+  for (int k = 0; k < runs; ++k) {
+    tea::TeaLeaf leaf;
+    leaf.moisture = 0.5 + 0.01 * k;
+    leaf.temperature_c = 0.0;
+    cache.run(config, leaf);
+    leaf.temperature_c = -0.0;
+    cache.run(config, leaf);
+  }
+
+  bool ok = true;
+  ok = tea_test::expect(cache.stats().misses == static_cast<std::size_t>(runs),
+                        "-0.0 should not miss after 0.0") && ok;
+  ok = tea_test::expect(cache.size() == static_cast<std::size_t>(3 * runs),
+                        "-0.0 should not add entries") && ok;
+  return ok;
+}
+
+/*
+ * @brief 容量を超えると最古のエントリが捨てられることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_lru_is_bounded() {
+  tea::PrefixStateCache cache(4);
+  for (int s = 1; s <= 5; ++s) {
+    tea::SimulationConfig config;
+    config.steaming_seconds = s;
+    cache.run(config, tea::TeaLeaf());
+  }
+
+  bool ok = true;
+  ok = tea_test::expect(cache.size() <= cache.capacity(),
+                        "size should not exceed capacity") && ok;
+  ok = tea_test::expect(cache.stats().evictions > 0,
+                        "evictions should be counted") && ok;
+
+  cache.clear();
+  ok = tea_test::expect(cache.size() == 0, "clear should drop entries") && ok;
+  ok = tea_test::expect(cache.stats().hits == 0, "clear should reset stats")
+       && ok;
+  return ok;
+}
+
+/*
+ * @brief run_sweep が直積を評価し、集計を返すことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_run_sweep_counts() {
+  tea::SweepSpec spec;
+  spec.params = tea::make_model(tea::ModelType::DEFAULT);
+  spec.steaming_seconds = {20, 30};
+  spec.rolling_seconds = {30};
+  spec.drying_seconds = {40, 50, 60};
+
+  tea::PrefixStateCache cache(128);
+  int seen = 0;
+  const tea::SweepSummary summary =
+      tea::run_sweep(spec, cache, [&seen](const tea::SweepEntry&) { ++seen; });
+
+  bool ok = true;
+  ok = tea_test::expect(summary.evaluations == 6, "should evaluate 2x1x3")
+       && ok;
+  ok = tea_test::expect(seen == 6, "callback should be called per entry")
+       && ok;
+  ok = tea_test::expect(summary.cache.misses == 2,
+                        "each steaming value should miss once") && ok;
+  ok = tea_test::expect(summary.cache.hits == 4,
+                        "remaining drying values should hit") && ok;
+  return ok;
+}
+
+/*
+ * @brief 到達し得るスコアの上限が、どの工程境界から見ても実際のスコア以上であることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_quality_upper_bound_is_sound() {
+  const tea::ModelType models[] = {tea::ModelType::DEFAULT,
+                                   tea::ModelType::GENTLE,
+                                   tea::ModelType::AGGRESSIVE};
+  const double dts[] = {1.0, 0.3, 7.0};
+  tea::TeaLeaf hot;
+  hot.temperature_c = 90.0;
+  hot.aroma = 70.0;
+  const tea::TeaLeaf initials[] = {tea::TeaLeaf(), hot};
+
+  tea::PrefixStateCache cache(256);
+  bool ok = true;
+  bool all_sound = true;
+  bool some_tight = false;
+  for (const tea::ModelType model : models) {
+    const tea::ModelParams params = tea::make_model(model);
+    for (const double dt : dts) {
+      for (const tea::TeaLeaf& initial : initials) {
+        for (int s = 10; s <= 70; s += 30) {
+          for (int r = 5; r <= 65; r += 30) {
+            for (int d = 20; d <= 1220; d += 400) {
+              const tea::PrefixStateCache::Durations durations{s, r, d};
+              const tea::TeaLeaf final_leaf =
+                  cache.run(params, durations, dt, initial);
+              const double score = tea_io::CsvWriter::quality_score(
+                  final_leaf.moisture, final_leaf.aroma, final_leaf.color);
+              for (int depth = 0; depth < 3; ++depth) {
+                const tea::TeaLeaf boundary =
+                    depth == 0 ? initial
+                               : cache.run_prefix(params, durations, dt,
+                                                  initial, depth);
+                const double bound = tea::quality_upper_bound(
+                    params, dt, boundary, depth, durations);
+                all_sound = all_sound && score <= bound + 1e-9;
+                some_tight = some_tight || (depth == 2 && bound - score < 5.0);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  ok = tea_test::expect(all_sound, "bound should never be below the score")
+       && ok;
+  ok = tea_test::expect(some_tight, "bound before drying should be useful")
+       && ok;
+  return ok;
+}
+
+/*
+ * @brief 工程時間を固定して乾燥パラメータだけを変えると、揉捻後の境界が再利用されることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_drying_params_sweep_reuses_prefix() {
+  tea::SweepSpec spec;
+  spec.params = tea::make_model(tea::ModelType::DEFAULT);
+  spec.dt_seconds = 2;
+  spec.steaming_seconds = {30};
+  spec.rolling_seconds = {30};
+  spec.drying_seconds = {60};
+  for (const double k : {0.03, 0.04, 0.05, 0.06}) {
+    tea::DryingParams drying = spec.params.drying;
+    drying.dry_k = k;
+    spec.drying_params.push_back(drying);
+  }
+
+  tea::PrefixStateCache cache(64);
+  std::vector<tea::SweepEntry> entries;
+  const tea::SweepSummary summary = tea::run_sweep(
+      spec, cache, [&entries](const tea::SweepEntry& e) { entries.push_back(e); });
+
+  bool ok = true;
+  ok = tea_test::expect(summary.evaluations == 4 && entries.size() == 4,
+                        "should evaluate each drying variant") && ok;
+  ok = tea_test::expect(summary.cache.misses == 1,
+                        "only the first variant should miss") && ok;
+  ok = tea_test::expect(summary.cache.hits == 3 &&
+                            summary.cache.stages_reused == 6,
+                        "later variants should resume after rolling") && ok;
+
+  for (const tea::SweepEntry& e : entries) {
+    /* 再利用した結果が、空のキャッシュで先頭から計算した結果と一致すること。 */
+    tea::ModelParams params = spec.params;
+    params.drying = e.drying;
+    tea::PrefixStateCache fresh(1);
+    const tea::TeaLeaf expected =
+        fresh.run(params, {30, 30, 60}, spec.dt_seconds, spec.initial);
+    ok = tea_test::expect(same_leaf(e.leaf, expected),
+                          "reused prefix should match a cold run") && ok;
+  }
+  ok = tea_test::expect(entries.front().leaf.moisture >
+                            entries.back().leaf.moisture,
+                        "larger dry_k should dry further") && ok;
+  return ok;
+}
+
+/*
+ * @brief 枝刈りしたスイープが全評価と同じ最良点を見つけ、打ち切り数を集計することを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_pruned_sweep_keeps_best() {
+  tea::SweepSpec spec;
+  spec.params = tea::make_model(tea::ModelType::DEFAULT);
+  for (int v = 5; v <= 60; v += 5) {
+    spec.steaming_seconds.push_back(v);
+    spec.rolling_seconds.push_back(v);
+  }
+  for (int v = 100; v <= 1500; v += 50) {
+    spec.drying_seconds.push_back(v);
+  }
+  const std::size_t total = spec.steaming_seconds.size() *
+                            spec.rolling_seconds.size() *
+                            spec.drying_seconds.size();
+
+  tea::PrefixStateCache full_cache(1024);
+  std::vector<tea::SweepEntry> full;
+  const tea::SweepSummary full_summary = tea::run_sweep(
+      spec, full_cache, [&full](const tea::SweepEntry& e) { full.push_back(e); });
+
+  spec.prune = true;
+  tea::PrefixStateCache pruned_cache(1024);
+  std::vector<tea::SweepEntry> kept;
+  const tea::SweepSummary summary = tea::run_sweep(
+      spec, pruned_cache,
+      [&kept](const tea::SweepEntry& e) { kept.push_back(e); });
+
+  const auto by_score = [](const tea::SweepEntry& a, const tea::SweepEntry& b) {
+    return a.score < b.score;
+  };
+  const tea::SweepEntry& best_full =
+      *std::max_element(full.begin(), full.end(), by_score);
+  const tea::SweepEntry& best_kept =
+      *std::max_element(kept.begin(), kept.end(), by_score);
+
+  bool ok = true;
+  ok = tea_test::expect(full_summary.pruned == 0 &&
+                            full_summary.evaluations == total,
+                        "sweep without pruning should evaluate everything")
+       && ok;
+  ok = tea_test::expect(best_kept.score == best_full.score &&
+                            best_kept.steaming_seconds ==
+                                best_full.steaming_seconds &&
+                            best_kept.rolling_seconds ==
+                                best_full.rolling_seconds &&
+                            best_kept.drying_seconds == best_full.drying_seconds,
+                        "pruning should keep the best candidate") && ok;
+  ok = tea_test::expect(summary.best_score == best_full.score,
+                        "summary should report the best score") && ok;
+  ok = tea_test::expect(summary.evaluations + summary.pruned == total &&
+                            summary.evaluations == kept.size(),
+                        "every candidate should be evaluated or pruned") && ok;
+  ok = tea_test::expect(summary.pruned_before[0] + summary.pruned_before[1] +
+                                summary.pruned_before[2] ==
+                            summary.pruned,
+                        "pruned counts per stage should add up") && ok;
+  ok = tea_test::expect(summary.pruned > total / 2 &&
+                            summary.pruned_before[1] > 0 &&
+                            summary.pruned_before[2] > 0,
+                        "most candidates should be pruned before a stage") && ok;
+  return ok;
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_drying_sweep_reuses_prefix() && ok;
+  ok = test_identical_run_hits_final_boundary() && ok;
+  ok = test_negative_zero_shares_entry() && ok;
+  ok = test_lru_is_bounded() && ok;
+  ok = test_run_sweep_counts() && ok;
+  ok = test_drying_params_sweep_reuses_prefix() && ok;
+  ok = test_quality_upper_bound_is_sound() && ok;
+  ok = test_pruned_sweep_keeps_best() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "prefix_cache_tests: OK\n";
+  return 0;
+}
@@ -97,6 +97,42 @@ bool test_drying_decreases_moisture_and_can_damage_aroma() {
   return ok;
 }
 
+/*
+ * @brief apply_steps(n) が apply_step の n 回とビット単位で一致することを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_apply_steps_matches_repeated_steps() {
+  const tea::ModelParams m = tea::make_model(tea::ModelType::AGGRESSIVE);
+  const tea::SteamingProcess steaming(m.steaming);
+  const tea::RollingProcess rolling(m.rolling);
+  const tea::DryingProcess drying(m.drying);
+  const tea::IProcess* processes[] = {&steaming, &rolling, &drying};
+  const double dts[] = {1.0, 0.1, 0.7};
+
+  bool ok = true;
+  for (const tea::IProcess* proc : processes) {
+    for (const double dt : dts) {
+      tea::TeaLeaf start;
+      start.temperature_c = m.drying.overheat_c + 5.0;
+      start.aroma = 60.0;
+      tea::TeaLeaf single = start;
+      tea::TeaLeaf batched = start;
+      for (int i = 0; i < 250; ++i) {
+        proc->apply_step(single, dt);
+      }
+      proc->apply_steps(batched, dt, 250);
+      ok = tea_test::expect(single.moisture == batched.moisture &&
+                                single.temperature_c == batched.temperature_c &&
+                                single.aroma == batched.aroma &&
+                                single.color == batched.color,
+                            "apply_steps should match repeated apply_step")
+           && ok;
+    }
+  }
+  return ok;
+}
+
 } /* namespace */
 
 /*
@@ -109,6 +145,7 @@ int main() {
   ok = test_steaming_increases_temp_and_aroma() && ok;
   ok = test_rolling_decreases_moisture() && ok;
   ok = test_drying_decreases_moisture_and_can_damage_aroma() && ok;
+  ok = test_apply_steps_matches_repeated_steps() && ok;
 
   if (!ok) {
     return 1;
@@ -0,0 +1,170 @@
+/*
+ * @file test_quantized_trace.cpp
+ * @brief 固定小数点・差分符号化トレース（.teaq）の往復検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ */
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "io/CsvWriter.h"
+#include "io/QuantizedTrace.h"
+#include "simulation/Simulator.h"
+#include "test_utils.h"
+
+namespace {
+
+using tea_test::ScopedFile;
+
+/* 一時ファイル名の接頭辞です。 */
+constexpr char kTempPrefix[] = "quantized_trace_test";
+
+/*
+ * @brief ファイル全体を文字列として読み込みます。
+ */
+std::string read_all(const std::string& path) {
+  std::ifstream ifs(path, std::ios::binary);
+  std::ostringstream oss;
+  oss << ifs.rdbuf();
+  return oss.str();
+}
+
+/*
+ * @brief .teaq を CSV テキストへ復号します。
+ */
+std::string decode(const std::string& path) {
+  tea_io::QuantizedTraceReader reader(path);
+  std::ostringstream oss;
+  reader.write_csv(oss);
+  return oss.str();
+}
+
+/*
+ * @brief 全工程の出力が CSV と文字単位で一致し、十分小さくなることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_simulation_round_trip() {
+  ScopedFile csv(tea_test::make_temp_path(kTempPrefix, ".csv"));
+  ScopedFile teaq(tea_test::make_temp_path(kTempPrefix, ".teaq"));
+
+  tea::SimulationConfig config;
+  config.model = tea::ModelType::AGGRESSIVE;
+  config.drying_seconds = 600;
+  {
+    tea_io::CsvWriter text(csv.path());
+    tea_io::CsvWriter quantized(teaq.path(), tea_io::CsvEncoding::QUANTIZED);
+    tea::Simulator a(config);
+    tea::Simulator b(config);
+    while (a.step(config.dt_seconds, &text)) {
+      b.step(config.dt_seconds, &quantized);
+    }
+  }
+
+  const std::string expected = read_all(csv.path());
+  bool ok = true;
+  ok = tea_test::expect(decode(teaq.path()) == expected,
+                        "decoded trace should match CSV text") && ok;
+  ok = tea_test::expect(read_all(teaq.path()).size() * 6 < expected.size(),
+                        "quantized trace should be much smaller") && ok;
+  return ok;
+}
+
+/*
+ * @brief 半端値の丸め、負値、辞書外の工程名も往復できることを検証します。
+ *
+ * 表示桁で 0 に丸まる小さな負の値（-0.0001 など）と負のゼロは、
+ * どちらの経路でも "-0.000" ではなく "0.000" になります。
+ *
+ * @return 成功なら true
+ */
+bool test_edge_values_round_trip() {
+  ScopedFile csv(tea_test::make_temp_path(kTempPrefix, ".csv"));
+  ScopedFile teaq(tea_test::make_temp_path(kTempPrefix, ".teaq"));
+  {
+    tea_io::CsvWriter text(csv.path());
+    tea_io::CsvWriter quantized(teaq.path(), tea_io::CsvEncoding::QUANTIZED);
+    for (int i = 0; i < 12; ++i) {
+      const std::string process = "P" + std::to_string(i);
+      const double m = 0.0000005 * i;
+      const double t = -12.0625 + 0.0005 * i;
+      const double a = 0.125 * i;
+      const double c = 99.9995 - i;
+      text.write_row(process, i * 1000, m, t, a, c);
+      quantized.write_row(process, i * 1000, m, t, a, c);
+    }
+    const double tiny[] = {-0.0001, -0.0, -0.0004999, -0.0000004};
+    for (const double v : tiny) {
+      text.write_row("DRYING", 12000, v, v, v, v);
+      quantized.write_row("DRYING", 12000, v, v, v, v);
+    }
+  }
+  return tea_test::expect(decode(teaq.path()) == read_all(csv.path()),
+                          "edge values should round-trip");
+}
+
+/*
+ * @brief 途中で切れたファイルを破損として検出することを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_truncated_file_is_detected() {
+  ScopedFile teaq(tea_test::make_temp_path(kTempPrefix, ".teaq"));
+  {
+    tea_io::CsvWriter w(teaq.path(), tea_io::CsvEncoding::QUANTIZED);
+    w.write_row("STEAMING", 1, 0.5, 25.0, 10.0, 10.0);
+    w.write_row("STEAMING", 2, 0.6, 30.0, 11.0, 11.0);
+  }
+  const std::string full = read_all(teaq.path());
+  {
+    std::ofstream ofs(teaq.path(), std::ios::binary | std::ios::trunc);
+    ofs.write(full.data(), static_cast<std::streamsize>(full.size() - 1));
+  }
+
+  tea_io::QuantizedTraceReader reader(teaq.path());
+  tea_io::QuantizedRow row;
+  bool ok = tea_test::expect(reader.is_open(), "header should be valid");
+  ok = tea_test::expect(reader.next(row), "first row should decode") && ok;
+  ok = tea_test::expect(!reader.next(row), "second row is truncated") && ok;
+  ok = tea_test::expect(reader.corrupted(), "truncation should be reported")
+       && ok;
+  return ok;
+}
+
+/*
+ * @brief 形式の違うファイルは開けないことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_rejects_non_teaq_file() {
+  ScopedFile csv(tea_test::make_temp_path(kTempPrefix, ".csv"));
+  {
+    tea_io::CsvWriter w(csv.path());
+    w.write_row("STEAMING", 1, 0.5, 25.0, 10.0, 10.0);
+  }
+  tea_io::QuantizedTraceReader reader(csv.path());
+  return tea_test::expect(!reader.is_open(), "CSV should not be accepted");
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_simulation_round_trip() && ok;
+  ok = test_edge_values_round_trip() && ok;
+  ok = test_truncated_file_is_detected() && ok;
+  ok = test_rejects_non_teaq_file() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "quantized_trace_tests: OK\n";
+  return 0;
+}
@@ -0,0 +1,271 @@
+/*
+ * @file test_query_batcher.cpp
+ * @brief 最終品質の問い合わせをまとめて評価する QueryBatcher の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "io/CsvWriter.h"
+#include "simulation/QueryBatcher.h"
+#include "simulation/Simulator.h"
+#include "test_utils.h"
+
+namespace {
+
+/*
+ * @brief 既定の刻みで量子化した初期状態を返します。
+ */
+tea::TeaLeaf snap(const tea::TeaLeaf& leaf) {
+  const tea::QueryQuantization q;
+  tea::TeaLeaf out;
+  out.moisture = static_cast<double>(std::llround(leaf.moisture / q.moisture)) *
+                 q.moisture;
+  out.temperature_c =
+      static_cast<double>(std::llround(leaf.temperature_c / q.temperature_c)) *
+      q.temperature_c;
+  out.aroma = static_cast<double>(std::llround(leaf.aroma / q.aroma)) * q.aroma;
+  out.color = static_cast<double>(std::llround(leaf.color / q.color)) * q.color;
+  return out;
+}
+
+/*
+ * @brief Simulator で全工程を実行した最終状態を返します。
+ */
+tea::TeaLeaf simulate(const tea::SimulationConfig& config,
+                      const tea::TeaLeaf& initial) {
+  tea::Simulator sim(config);
+  sim.set_initial_leaf(initial);
+  while (sim.step(config.dt_seconds, nullptr)) {
+  }
+  return sim.leaf();
+}
+
+/*
+ * @brief 結果が Simulator（量子化後の初期状態）と完全に一致するかを返します。
+ */
+bool matches_simulator(const tea::QueryResult& r,
+                       const tea::SimulationConfig& config,
+                       const tea::TeaLeaf& initial) {
+  const tea::TeaLeaf e = simulate(config, snap(initial));
+  return r.leaf.moisture == e.moisture &&
+         r.leaf.temperature_c == e.temperature_c &&
+         r.leaf.aroma == e.aroma && r.leaf.color == e.color &&
+         r.score == tea_io::CsvWriter::quality_score(e.moisture, e.aroma,
+                                                     e.color);
+}
+
+/*
+ * @brief i 番目の要求のレシピを返します（4 種類）。
+ */
+tea::SimulationConfig recipe(int i) {
+  tea::SimulationConfig config;
+  config.model = (i % 2 == 0) ? tea::ModelType::DEFAULT
+                              : tea::ModelType::GENTLE;
+  config.drying_seconds = (i % 4 < 2) ? 60 : 90;
+  return config;
+}
+
+/*
+ * @brief 1 件の要求が Simulator と一致し、再要求がキャッシュから返ることを検証します。
+ */
+bool test_single_query_matches_simulator() {
+  tea::QueryBatcherOptions options;
+  options.window = std::chrono::microseconds(0);
+  tea::QueryBatcher batcher(options);
+
+  tea::SimulationConfig config;
+  config.dt_seconds = 2;
+  config.model = tea::ModelType::AGGRESSIVE;
+  tea::TeaLeaf initial;
+  initial.moisture = 0.8123456789;
+  initial.temperature_c = 21.5;
+
+  bool ok = true;
+  const tea::QueryResult a = batcher.evaluate(config, initial);
+  ok = tea_test::expect(matches_simulator(a, config, initial),
+                        "result should match Simulator") && ok;
+
+  /* 刻みの半分未満しか違わない要求は同じ格子点に落ち、キャッシュから返ります。 */
+  tea::TeaLeaf near = initial;
+  near.moisture += 1e-8;
+  const tea::QueryResult b = batcher.evaluate(config, near);
+  ok = tea_test::expect(b.leaf.moisture == a.leaf.moisture &&
+                            b.score == a.score,
+                        "nearby request should share the result") && ok;
+
+  const tea::QueryBatcherStats s = batcher.stats();
+  ok = tea_test::expect(s.requests == 2 && s.cache_hits == 1 &&
+                            s.evaluations == 1 && s.batches == 1,
+                        "second request should be a cache hit") && ok;
+  return ok;
+}
+
+/*
+ * @brief 多数のスレッドからの要求がすべて正しく、重複は 1 回だけ計算されることを検証します。
+ */
+bool test_concurrent_queries_are_deduplicated() {
+  tea::QueryBatcherOptions options;
+  options.window = std::chrono::microseconds(500);
+  options.max_batch = 64;
+  tea::QueryBatcher batcher(options);
+
+  constexpr int kThreads = 8;
+  constexpr int kPerThread = 50;
+  std::atomic<int> mismatches{0};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int k = 0; k < kPerThread; ++k) {
+        const int i = t * kPerThread + k;
+        const tea::SimulationConfig config = recipe(i);
+        tea::TeaLeaf initial;
+        initial.moisture = 0.70 + 0.01 * static_cast<double>(i % 25);
+        const tea::QueryResult r = batcher.evaluate(config, initial);
+        if (!matches_simulator(r, config, initial)) {
+          mismatches.fetch_add(1);
+        }
+      }
+    });
+  }
+  for (std::thread& th : threads) {
+    th.join();
+  }
+
+  const tea::QueryBatcherStats s = batcher.stats();
+  bool ok = true;
+  ok = tea_test::expect(mismatches.load() == 0,
+                        "every caller should get its own correct result") && ok;
+  ok = tea_test::expect(s.requests == kThreads * kPerThread,
+                        "all requests should be counted") && ok;
+  ok = tea_test::expect(s.evaluations == 100,
+                        "each distinct request should be computed once") && ok;
+  ok = tea_test::expect(s.cache_hits + s.coalesced + s.evaluations ==
+                            s.requests,
+                        "requests should be hits, coalesced or evaluated") &&
+       ok;
+  ok = tea_test::expect(s.recipes >= 4 && s.recipes <= s.evaluations,
+                        "batches should be grouped by recipe") && ok;
+  return ok;
+}
+
+/*
+ * @brief max_batch 件集まれば窓を待たずに 1 回で評価することを検証します。
+ */
+bool test_full_batch_skips_window() {
+  tea::QueryBatcherOptions options;
+  options.window = std::chrono::microseconds(10 * 1000 * 1000);
+  options.max_batch = 8;
+  tea::QueryBatcher batcher(options);
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t] {
+      tea::TeaLeaf initial;
+      initial.aroma = 5.0 + static_cast<double>(t);
+      batcher.evaluate(tea::SimulationConfig(), initial);
+    });
+  }
+  for (std::thread& th : threads) {
+    th.join();
+  }
+  const double elapsed = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+  const tea::QueryBatcherStats s = batcher.stats();
+  bool ok = true;
+  ok = tea_test::expect(elapsed < 5.0,
+                        "a full batch should not wait for the window") && ok;
+  ok = tea_test::expect(s.batches == 1 && s.recipes == 1 &&
+                            s.evaluations == 8,
+                        "one recipe should be evaluated in one batch") && ok;
+  return ok;
+}
+
+/*
+ * @brief 1 スレッドから submit した多数の要求が 1 回の一括評価にまとまることを検証します。
+ */
+bool test_submit_from_one_thread() {
+  tea::QueryBatcherOptions options;
+  options.window = std::chrono::microseconds(10 * 1000 * 1000);
+  options.max_batch = 64;
+  tea::QueryBatcher batcher(options);
+
+  std::vector<tea::QueryBatcher::Ticket> tickets;
+  std::vector<tea::TeaLeaf> initials;
+  for (int i = 0; i < 64; ++i) {
+    tea::TeaLeaf initial;
+    initial.moisture = 0.6 + 0.005 * static_cast<double>(i);
+    initials.push_back(initial);
+    tickets.push_back(batcher.submit(recipe(i), initial));
+  }
+
+  bool ok = true;
+  for (std::size_t i = 0; i < tickets.size(); ++i) {
+    ok = tea_test::expect(matches_simulator(tickets[i].get(),
+                                            recipe(static_cast<int>(i)),
+                                            initials[i]),
+                          "submitted request should match Simulator") && ok;
+  }
+  const tea::QueryBatcherStats s = batcher.stats();
+  ok = tea_test::expect(s.batches == 1 && s.recipes == 4 &&
+                            s.evaluations == 64 && s.coalesced == 0,
+                        "submitted requests should form one batch") && ok;
+  return ok;
+}
+
+/*
+ * @brief 結果キャッシュが容量で抑えられることを検証します。
+ */
+bool test_cache_is_bounded() {
+  tea::QueryBatcherOptions options;
+  options.window = std::chrono::microseconds(0);
+  options.cache_size = 2;
+  tea::QueryBatcher batcher(options);
+
+  for (int i = 0; i < 5; ++i) {
+    tea::TeaLeaf initial;
+    initial.color = 10.0 + static_cast<double>(i);
+    batcher.evaluate(tea::SimulationConfig(), initial);
+  }
+  tea::TeaLeaf first;
+  first.color = 10.0;
+  batcher.evaluate(tea::SimulationConfig(), first);
+
+  const tea::QueryBatcherStats s = batcher.stats();
+  bool ok = true;
+  ok = tea_test::expect(batcher.cache_entries() == 2,
+                        "cache should keep at most cache_size entries") && ok;
+  ok = tea_test::expect(s.cache_hits == 0 && s.evaluations == 6,
+                        "evicted entries should be recomputed") && ok;
+  return ok;
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_single_query_matches_simulator() && ok;
+  ok = test_concurrent_queries_are_deduplicated() && ok;
+  ok = test_full_batch_skips_window() && ok;
+  ok = test_submit_from_one_thread() && ok;
+  ok = test_cache_is_bounded() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "query_batcher_tests: OK\n";
+  return 0;
+}
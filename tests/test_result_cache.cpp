@@ -0,0 +1,293 @@
+/*
+ * @file test_result_cache.cpp
+ * @brief 最終結果をファイルへ永続化する ResultCache の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ */
+
+#include <cstdio>
+#include <string>
+
+#include <unistd.h>
+
+#include "io/CsvWriter.h"
+#include "simulation/ResultCache.h"
+#include "simulation/Simulator.h"
+#include "test_utils.h"
+
+namespace {
+
+/*
+ * @brief テスト用のキャッシュファイルのパスを返します（既存のファイルは消します）。
+ */
+std::string fresh_path(const char* name) {
+  const std::string path = "result_cache_test_" + std::to_string(::getpid()) +
+                           "_" + name + ".bin";
+  std::remove(path.c_str());
+  return path;
+}
+
+/*
+ * @brief i 番目の初期状態を返します（すべて量子化の格子点上にあります）。
+ */
+tea::TeaLeaf initial_leaf(int i) {
+  tea::TeaLeaf leaf;
+  leaf.moisture = 0.70 + 0.001 * static_cast<double>(i);
+  leaf.aroma = 10.0 + static_cast<double>(i % 7);
+  return leaf;
+}
+
+/*
+ * @brief 結果が量子化後の初期状態で Simulator を実行したものと一致するかを返します。
+ */
+bool matches_simulator(const tea::QueryResult& r,
+                       const tea::SimulationConfig& config,
+                       const tea::TeaLeaf& initial) {
+  const tea::QueryQuantization q;
+  tea::TeaLeaf snapped;
+  tea::quantize_index(initial.moisture, q.moisture, &snapped.moisture);
+  tea::quantize_index(initial.temperature_c, q.temperature_c,
+                      &snapped.temperature_c);
+  tea::quantize_index(initial.aroma, q.aroma, &snapped.aroma);
+  tea::quantize_index(initial.color, q.color, &snapped.color);
+
+  tea::Simulator sim(config);
+  sim.set_initial_leaf(snapped);
+  while (sim.step(config.dt_seconds, nullptr)) {
+  }
+  const tea::TeaLeaf e = sim.leaf();
+  return r.leaf.moisture == e.moisture &&
+         r.leaf.temperature_c == e.temperature_c &&
+         r.leaf.aroma == e.aroma && r.leaf.color == e.color &&
+         r.score == tea_io::CsvWriter::quality_score(e.moisture, e.aroma,
+                                                     e.color);
+}
+
+/*
+ * @brief 計算した結果が Simulator と一致し、ファイルを開き直しても残ることを検証します。
+ */
+bool test_results_persist_across_reopen() {
+  const std::string path = fresh_path("persist");
+  tea::SimulationConfig config;
+  config.model = tea::ModelType::GENTLE;
+  config.drying_seconds = 90;
+
+  bool ok = true;
+  {
+    tea::ResultCache cache(path, 64);
+    ok = tea_test::expect(cache.is_open(), "cache file should open") && ok;
+    for (int i = 0; i < 10; ++i) {
+      const tea::QueryResult r = cache.evaluate(config, initial_leaf(i));
+      ok = tea_test::expect(matches_simulator(r, config, initial_leaf(i)),
+                            "computed result should match Simulator") && ok;
+    }
+    ok = tea_test::expect(cache.stats().misses == 10 &&
+                              cache.stats().hits == 0 && cache.size() == 10,
+                          "first pass should compute every result") && ok;
+  }
+  {
+    tea::ResultCache cache(path, 64);
+    for (int i = 0; i < 10; ++i) {
+      const tea::QueryResult r = cache.evaluate(config, initial_leaf(i));
+      ok = tea_test::expect(matches_simulator(r, config, initial_leaf(i)),
+                            "cached result should match Simulator") && ok;
+    }
+    ok = tea_test::expect(cache.stats().hits == 10 &&
+                              cache.stats().misses == 0,
+                          "reopened cache should return stored results") && ok;
+
+    /* レシピが違えば別のキーです。 */
+    tea::SimulationConfig other = config;
+    other.dt_seconds = 2;
+    ok = tea_test::expect(!cache.find(other, initial_leaf(0)).has_value(),
+                          "different recipe should miss") && ok;
+  }
+  std::remove(path.c_str());
+  return ok;
+}
+
+/*
+ * @brief 同じ格子点に落ちる初期状態が結果を共有することを検証します。
+ */
+bool test_quantized_initial_shares_entry() {
+  const std::string path = fresh_path("quantized");
+  tea::ResultCache cache(path, 64);
+  const tea::SimulationConfig config;
+
+  tea::TeaLeaf a;
+  a.moisture = 0.8123456789;
+  tea::TeaLeaf b = a;
+  b.moisture += 1e-8;
+
+  const tea::QueryResult ra = cache.evaluate(config, a);
+  const tea::QueryResult rb = cache.evaluate(config, b);
+  bool ok = true;
+  ok = tea_test::expect(ra.leaf.moisture == rb.leaf.moisture &&
+                            ra.score == rb.score,
+                        "nearby initial states should share the result") && ok;
+  ok = tea_test::expect(matches_simulator(rb, config, b),
+                        "shared result should match the snapped input") && ok;
+  ok = tea_test::expect(cache.stats().hits == 1 && cache.size() == 1,
+                        "second request should be a hit") && ok;
+  std::remove(path.c_str());
+  return ok;
+}
+
+/*
+ * @brief エントリ数が上限で抑えられ、溢れた分は追い出されることを検証します。
+ */
+bool test_entries_are_bounded() {
+  const std::string path = fresh_path("bounded");
+  tea::ResultCache cache(path, 16);
+  const tea::SimulationConfig config;
+
+  for (int i = 0; i < 40; ++i) {
+    cache.evaluate(config, initial_leaf(i));
+  }
+  bool ok = true;
+  ok = tea_test::expect(cache.capacity() == 16 && cache.size() == 16,
+                        "every slot should be used up to the capacity") && ok;
+  ok = tea_test::expect(cache.stats().evictions == 24,
+                        "overflowing entries should be evicted") && ok;
+
+  /* 追い出されずに残っている結果も Simulator と一致します。 */
+  std::size_t hits = 0;
+  for (int i = 0; i < 40; ++i) {
+    if (const auto r = cache.find(config, initial_leaf(i))) {
+      ++hits;
+      ok = tea_test::expect(matches_simulator(*r, config, initial_leaf(i)),
+                            "remaining entry should be intact") && ok;
+    }
+  }
+  ok = tea_test::expect(hits > 0 && hits <= 16,
+                        "only the remaining entries should hit") && ok;
+  std::remove(path.c_str());
+  return ok;
+}
+
+/*
+ * @brief 上限の指定が違っても既存のファイルの上限を引き継ぐことを検証します。
+ */
+bool test_existing_capacity_is_adopted() {
+  const std::string path = fresh_path("adopt");
+  const tea::SimulationConfig config;
+  {
+    tea::ResultCache cache(path, 16);
+    cache.evaluate(config, initial_leaf(0));
+  }
+  bool ok = true;
+  {
+    tea::ResultCache cache(path, 30);
+    ok = tea_test::expect(cache.capacity() == 16,
+                          "existing capacity should be adopted") && ok;
+    ok = tea_test::expect(cache.size() == 1 &&
+                              cache.find(config, initial_leaf(0)).has_value(),
+                          "existing entries should be kept") && ok;
+  }
+  std::remove(path.c_str());
+  {
+    tea::ResultCache cache(path, 30);
+    ok = tea_test::expect(cache.capacity() == 32,
+                          "capacity should be rounded up to the set size") && ok;
+  }
+  std::remove(path.c_str());
+  return ok;
+}
+
+/*
+ * @brief 同じファイルを上限の違う 2 つのインスタンスで同時に使えることを検証します。
+ *
+ * 後から開いた側が表を作り直すと、先に開いた側は対応付けが壊れる
+ * （縮めば SIGBUS、伸ばせば空の表を読む）ため、両者が同じ表を共有することを確かめます。
+ */
+bool test_two_instances_share_file() {
+  const std::string path = fresh_path("shared");
+  const tea::SimulationConfig config;
+  bool ok = true;
+  {
+    tea::ResultCache small(path, 16);
+    small.evaluate(config, initial_leaf(0));
+    tea::ResultCache large(path, 256);
+    ok = tea_test::expect(small.is_open() && large.is_open() &&
+                              large.capacity() == small.capacity(),
+                          "second instance should adopt the capacity") && ok;
+    ok = tea_test::expect(large.find(config, initial_leaf(0)).has_value(),
+                          "second instance should see the first's entry") && ok;
+
+    large.evaluate(config, initial_leaf(1));
+    ok = tea_test::expect(small.find(config, initial_leaf(1)).has_value(),
+                          "first instance should see the second's entry") && ok;
+    const tea::QueryResult r = small.evaluate(config, initial_leaf(2));
+    ok = tea_test::expect(matches_simulator(r, config, initial_leaf(2)) &&
+                              large.size() == 3,
+                          "both instances should keep working") && ok;
+  }
+  std::remove(path.c_str());
+  return ok;
+}
+
+/*
+ * @brief 形式の合わないファイルは置き換えて作り直し、使用中の対応付けは壊さないことを検証します。
+ */
+bool test_invalid_file_is_replaced() {
+  const std::string path = fresh_path("replace");
+  const tea::SimulationConfig config;
+  bool ok = true;
+  {
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    std::fputs("not a cache", f);
+    std::fclose(f);
+    tea::ResultCache cache(path, 32);
+    ok = tea_test::expect(cache.is_open() && cache.size() == 0 &&
+                              cache.capacity() == 32,
+                          "corrupt file should be recreated") && ok;
+    cache.evaluate(config, initial_leaf(1));
+    ok = tea_test::expect(cache.find(config, initial_leaf(1)).has_value(),
+                          "recreated file should be usable") && ok;
+
+    /* 使用中のファイルが置き換えられても、元の対応付けはそのまま読めます。 */
+    std::remove(path.c_str());
+    f = std::fopen(path.c_str(), "wb");
+    std::fputs("broken again", f);
+    std::fclose(f);
+    tea::ResultCache replacement(path, 16);
+    ok = tea_test::expect(replacement.is_open() &&
+                              replacement.capacity() == 16 &&
+                              replacement.size() == 0,
+                          "second corrupt file should be recreated") && ok;
+    ok = tea_test::expect(cache.find(config, initial_leaf(1)).has_value(),
+                          "earlier mapping should stay readable") && ok;
+  }
+  const std::string tmp = path + ".tmp." + std::to_string(::getpid());
+  std::FILE* leftover = std::fopen(tmp.c_str(), "rb");
+  ok = tea_test::expect(leftover == nullptr,
+                        "temporary file should be renamed into place") && ok;
+  if (leftover != nullptr) {
+    std::fclose(leftover);
+  }
+  std::remove(path.c_str());
+  return ok;
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_results_persist_across_reopen() && ok;
+  ok = test_quantized_initial_shares_entry() && ok;
+  ok = test_entries_are_bounded() && ok;
+  ok = test_existing_capacity_is_adopted() && ok;
+  ok = test_two_instances_share_file() && ok;
+  ok = test_invalid_file_is_replaced() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "result_cache_tests: OK\n";
+  return 0;
+}
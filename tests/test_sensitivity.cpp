@@ -0,0 +1,222 @@
+/*
+ * @file test_sensitivity.cpp
+ * @brief 双対数（Dual）と自動微分による感度解析（compute_sensitivity）の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ * 自動微分の結果を、パラメータごとに再実行する中心差分と比べます。
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+
+#include "domain/Dual.h"
+#include "io/CsvWriter.h"
+#include "process/DryingProcess.h"
+#include "simulation/Sensitivity.h"
+#include "simulation/Simulator.h"
+#include "simulation/StageRunner.h"
+#include "test_utils.h"
+
+namespace {
+
+/*
+ * @brief 指定パラメータで全工程を double で実行した最終状態を返します。
+ */
+tea::TeaLeaf run_double(const tea::SimulationConfig& config,
+                        const tea::ModelParams& params) {
+  tea::TeaLeaf leaf;
+  tea::run_stage(tea::ProcessState::STEAMING, params, leaf,
+                 config.steaming_seconds, config.dt_seconds);
+  tea::run_stage(tea::ProcessState::ROLLING, params, leaf,
+                 config.rolling_seconds, config.dt_seconds);
+  tea::run_stage(tea::ProcessState::DRYING, params, leaf,
+                 config.drying_seconds, config.dt_seconds);
+  return leaf;
+}
+
+/*
+ * @brief 双対数の四則演算と exp が解析的な微分と一致することを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_dual_arithmetic() {
+  using D = tea::Dual<2>;
+  const double x0 = 1.5;
+  const double y0 = 0.25;
+  const D x = D::variable(x0, 0);
+  const D y = D::variable(y0, 1);
+
+  /* f = x * y / (x + y) - exp(-x * y) + 3 */
+  const D f = x * y / (x + y) - exp(-x * y) + D(3.0);
+  const double s = x0 + y0;
+  const double e = std::exp(-x0 * y0);
+  const double dfdx = y0 * y0 / (s * s) + y0 * e;
+  const double dfdy = x0 * x0 / (s * s) + x0 * e;
+
+  bool ok = true;
+  ok = tea_test::expect(f.v == x0 * y0 / (x0 + y0) - std::exp(-x0 * y0) + 3.0,
+                        "value should follow double arithmetic") && ok;
+  ok = tea_test::expect(tea_test::nearly(f.d[0], dfdx, 1e-12) &&
+                            tea_test::nearly(f.d[1], dfdy, 1e-12),
+                        "derivatives should match the analytic ones") && ok;
+
+  const D c = tea::clamp(x, D(0.0), D(1.0));
+  ok = tea_test::expect(c.v == 1.0 && c.d[0] == 0.0,
+                        "clamped value should have no derivative") && ok;
+  return ok;
+}
+
+/*
+ * @brief 型で共通化した run_stage と双対数の値が、Simulator の結果と一致することを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_values_match_simulator() {
+  const double dts[] = {1.0, 0.3, 7.0};
+  bool ok = true;
+  for (const double dt : dts) {
+    tea::SimulationConfig config;
+    config.dt_seconds = dt;
+    config.drying_seconds = 200;
+    config.model = tea::ModelType::AGGRESSIVE;
+    tea::Simulator sim(config);
+    while (sim.step(config.dt_seconds, nullptr)) {
+    }
+    const tea::TeaLeaf expected = sim.leaf();
+
+    const tea::TeaLeaf plain =
+        run_double(config, tea::make_model(config.model));
+    const tea::SensitivityResult r = tea::compute_sensitivity(config);
+
+    ok = tea_test::expect(plain.moisture == expected.moisture &&
+                              plain.temperature_c == expected.temperature_c &&
+                              plain.aroma == expected.aroma &&
+                              plain.color == expected.color,
+                          "typed run_stage should match the simulator") && ok;
+    ok = tea_test::expect(r.leaf.moisture == expected.moisture &&
+                              r.leaf.temperature_c == expected.temperature_c &&
+                              r.leaf.aroma == expected.aroma &&
+                              r.leaf.color == expected.color,
+                          "dual values should match the simulator") && ok;
+    ok = tea_test::expect(
+             r.score == tea_io::CsvWriter::quality_score(
+                            expected.moisture, expected.aroma, expected.color),
+             "dual score should match quality_score") && ok;
+  }
+
+  /* 乾燥工程の端数ステップも IProcess 経由の run_stage と一致します。 */
+  const tea::ModelParams params = tea::make_model(tea::ModelType::DEFAULT);
+  tea::TeaLeaf a;
+  a.temperature_c = 90.0;
+  tea::TeaLeaf b = a;
+  tea::run_stage(tea::DryingProcess(params.drying), a, 25, 0.7);
+  tea::run_stage(tea::ProcessState::DRYING, params, b, 25, 0.7);
+  ok = tea_test::expect(a.moisture == b.moisture && a.aroma == b.aroma &&
+                            a.temperature_c == b.temperature_c,
+                        "typed drying stage should match the process") && ok;
+  return ok;
+}
+
+/*
+ * @brief 全パラメータの自動微分が中心差分と一致することを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_gradients_match_finite_differences() {
+  struct Case {
+    tea::ModelType model;
+    double dt;
+    int drying;
+  };
+  const Case cases[] = {
+      {tea::ModelType::DEFAULT, 1.0, 60},
+      {tea::ModelType::GENTLE, 0.3, 45},
+      {tea::ModelType::AGGRESSIVE, 2.0, 30},
+  };
+
+  bool ok = true;
+  for (const Case& c : cases) {
+    tea::SimulationConfig config;
+    config.model = c.model;
+    config.dt_seconds = c.dt;
+    config.drying_seconds = c.drying;
+    const tea::ModelParams base = tea::make_model(c.model);
+    const tea::SensitivityResult r = tea::compute_sensitivity(config, base);
+
+    for (int i = 0; i < tea::kModelParamCount; ++i) {
+      const std::size_t k = static_cast<std::size_t>(i);
+      const double value = tea::model_param_value(base, i);
+      const double h = 1e-6 * std::max(std::fabs(value), 1e-3);
+      tea::ModelParams up = base;
+      tea::ModelParams down = base;
+      tea::set_model_param_value(up, i, value + h);
+      tea::set_model_param_value(down, i, value - h);
+      const tea::TeaLeaf lu = run_double(config, up);
+      const tea::TeaLeaf ld = run_double(config, down);
+      const double su =
+          tea_io::CsvWriter::quality_score(lu.moisture, lu.aroma, lu.color);
+      const double sd =
+          tea_io::CsvWriter::quality_score(ld.moisture, ld.aroma, ld.color);
+
+      const auto close = [](double ad, double fd) {
+        return std::fabs(ad - fd) <= 1e-5 * (1.0 + std::fabs(ad));
+      };
+      ok = tea_test::expect(
+               close(r.moisture[k], (lu.moisture - ld.moisture) / (2 * h)) &&
+                   close(r.aroma[k], (lu.aroma - ld.aroma) / (2 * h)) &&
+                   close(r.color[k], (lu.color - ld.color) / (2 * h)) &&
+                   close(r.score_gradient[k], (su - sd) / (2 * h)),
+               tea::model_param_name(i)) && ok;
+    }
+  }
+  return ok;
+}
+
+/*
+ * @brief パラメータの名前・取得・設定が対応していることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_param_accessors() {
+  tea::ModelParams params = tea::make_model(tea::ModelType::DEFAULT);
+  bool ok = true;
+  ok = tea_test::expect(tea::model_param_value(params, 1) ==
+                                params.steaming.heat_k &&
+                            std::string(tea::model_param_name(1)) ==
+                                "steaming.heat_k",
+                        "index 1 should be steaming.heat_k") && ok;
+  tea::set_model_param_value(params, tea::kModelParamCount - 1, 0.5);
+  ok = tea_test::expect(params.drying.color_gain_per_s == 0.5 &&
+                            std::string(tea::model_param_name(
+                                tea::kModelParamCount - 1)) ==
+                                "drying.color_gain_per_s",
+                        "last index should be drying.color_gain_per_s") && ok;
+  ok = tea_test::expect(std::string(tea::model_param_name(-1)) == "unknown" &&
+                            tea::model_param_value(params,
+                                                   tea::kModelParamCount) == 0.0,
+                        "out-of-range index should be rejected") && ok;
+  return ok;
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_dual_arithmetic() && ok;
+  ok = test_values_match_simulator() && ok;
+  ok = test_gradients_match_finite_differences() && ok;
+  ok = test_param_accessors() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "sensitivity_tests: OK\n";
+  return 0;
+}
@@ -0,0 +1,276 @@
+/*
+ * @file test_server.cpp
+ * @brief 常駐サーバ（要求処理と Unix ドメインソケット経由の往復）の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "io/CsvWriter.h"
+#include "server/SimulationServer.h"
+#include "simulation/Simulator.h"
+#include "test_utils.h"
+
+namespace {
+
+/*
+ * @brief ほぼ一意なテスト用ソケットパスを生成します。
+ */
+std::string make_temp_path(const char* ext) {
+  using clock = std::chrono::steady_clock;
+  const auto now = clock::now().time_since_epoch().count();
+  std::ostringstream oss;
+  oss << "server_test_" << now << "_" << &oss << ext;
+  return oss.str();
+}
+
+/*
+ * @brief 要求 1 行を処理した応答を返します（途中経過の送り出しは out へ残します）。
+ */
+std::string handle(tea_server::RequestHandler& handler,
+                   const std::string& line,
+                   tea_server::Action* action = nullptr) {
+  std::string out;
+  std::string flushed;
+  const tea_server::Action a = handler.handle(
+      line, out, [&](std::string& data) {
+        flushed += data;
+        data.clear();
+      });
+  if (action != nullptr) {
+    *action = a;
+  }
+  return flushed + out;
+}
+
+/*
+ * @brief Simulator で全工程を実行した結果を simulate の応答形式で返します。
+ */
+std::string expected_simulate(const tea::SimulationConfig& config,
+                              const tea::TeaLeaf& initial) {
+  tea::Simulator sim(config);
+  sim.set_initial_leaf(initial);
+  while (sim.step(config.dt_seconds, nullptr)) {
+  }
+  const tea::TeaLeaf& leaf = sim.leaf();
+  const double score =
+      tea_io::CsvWriter::quality_score(leaf.moisture, leaf.aroma, leaf.color);
+  char line[256];
+  std::snprintf(line, sizeof(line),
+                "ok moisture=%.6f temperatureC=%.3f aroma=%.3f color=%.3f "
+                "score=%.2f status=%s\n",
+                leaf.moisture, leaf.temperature_c, leaf.aroma, leaf.color,
+                score, tea_io::CsvWriter::quality_status(score));
+  return line;
+}
+
+/*
+ * @brief simulate が Simulator の最終状態と一致し、再要求がキャッシュから返ることを検証します。
+ */
+bool test_simulate_matches_simulator() {
+  bool ok = true;
+  tea_server::RequestHandler handler(64);
+
+  ok = tea_test::expect(handle(handler, "simulate") ==
+                            expected_simulate(tea::SimulationConfig(),
+                                              tea::TeaLeaf()),
+                        "default simulate should match Simulator") && ok;
+
+  tea::SimulationConfig config;
+  config.model = tea::ModelType::GENTLE;
+  config.dt_seconds = 2;
+  config.drying_seconds = 90;
+  tea::TeaLeaf initial;
+  initial.moisture = 0.8;
+  initial.aroma = 12.5;
+  const std::string line =
+      "simulate model=gentle dt=2 drying=90 moisture=0.8 aroma=12.5";
+  const std::string first = handle(handler, line);
+  ok = tea_test::expect(first == expected_simulate(config, initial),
+                        "simulate with keys should match Simulator") && ok;
+
+  const std::size_t hits = handler.cache().stats().hits;
+  ok = tea_test::expect(handle(handler, line) == first,
+                        "repeated simulate should return the same line") && ok;
+  ok = tea_test::expect(handler.cache().stats().hits == hits + 1,
+                        "repeated simulate should hit the cache") && ok;
+  return ok;
+}
+
+/*
+ * @brief sweep が全組み合わせの行と集計行を返すことを検証します。
+ */
+bool test_sweep_streams_rows() {
+  tea_server::RequestHandler handler(64);
+  const std::string out =
+      handle(handler, "sweep steaming=20:40:10 drying=50:70:10");
+
+  std::size_t rows = 0;
+  std::size_t ends = 0;
+  std::istringstream iss(out);
+  std::string line;
+  std::string last;
+  while (std::getline(iss, line)) {
+    if (line.rfind("row ", 0) == 0) {
+      ++rows;
+    } else if (line.rfind("end ", 0) == 0) {
+      ++ends;
+    }
+    last = line;
+  }
+  bool ok = true;
+  ok = tea_test::expect(rows == 9, "sweep should return 3x3 rows") && ok;
+  ok = tea_test::expect(ends == 1 && last.rfind("end evaluations=9 ", 0) == 0,
+                        "sweep should end with a summary line") && ok;
+  ok = tea_test::expect(out.find("row 30,30,60,") != std::string::npos,
+                        "sweep rows should start with the durations") && ok;
+  return ok;
+}
+
+/*
+ * @brief 不正な要求がエラー行になり、接続の扱いが正しく返ることを検証します。
+ */
+bool test_errors_and_control() {
+  bool ok = true;
+  tea_server::RequestHandler handler(8);
+  for (const char* bad :
+       {"bogus", "simulate model=fast", "simulate dt=0", "simulate drying",
+        "simulate steaming=10:20:5", "simulate moisture=1.5",
+        "sweep drying=90:30:5", "simulate color=nan", "simulate x=1"}) {
+    const std::string out = handle(handler, bad);
+    ok = tea_test::expect(out.rfind("error ", 0) == 0,
+                          "invalid request should return an error line") && ok;
+  }
+  ok = tea_test::expect(handle(handler, "sweep steaming=1:86400:1 "
+                                        "rolling=1:86400:1")
+                                .rfind("error too many", 0) == 0,
+                        "oversized sweep should be rejected") && ok;
+
+  tea_server::Action action = tea_server::Action::CLOSE;
+  ok = tea_test::expect(handle(handler, "   ", &action).empty() &&
+                            action == tea_server::Action::CONTINUE,
+                        "blank line should be ignored") && ok;
+  ok = tea_test::expect(handle(handler, "ping") == "pong\n",
+                        "ping should return pong") && ok;
+  ok = tea_test::expect(handle(handler, "stats").rfind("ok requests=12 "
+                                                       "errors=10 ",
+                                                       0) == 0,
+                        "stats should count requests and errors") && ok;
+  handle(handler, "quit", &action);
+  ok = tea_test::expect(action == tea_server::Action::CLOSE,
+                        "quit should close the connection") && ok;
+  handle(handler, "shutdown", &action);
+  ok = tea_test::expect(action == tea_server::Action::SHUTDOWN,
+                        "shutdown should stop the server") && ok;
+  return ok;
+}
+
+/*
+ * @brief n 行を受け取るまで読みます。
+ */
+std::string read_lines(int fd, int n) {
+  std::string out;
+  char buffer[4096];
+  int lines = 0;
+  while (lines < n) {
+    const ssize_t got = ::recv(fd, buffer, sizeof(buffer), 0);
+    if (got <= 0) {
+      break;
+    }
+    for (ssize_t i = 0; i < got; ++i) {
+      lines += buffer[i] == '\n' ? 1 : 0;
+    }
+    out.append(buffer, static_cast<std::size_t>(got));
+  }
+  return out;
+}
+
+/*
+ * @brief ソケット経由で複数要求を送り、shutdown で run が戻ることを検証します。
+ */
+bool test_socket_round_trip() {
+  tea_server::ServerOptions options;
+  options.socket_path = make_temp_path(".sock");
+  options.workers = 2;
+  options.cache_size = 64;
+
+  bool ok = true;
+  {
+    tea_server::SimulationServer server(options);
+    std::string error;
+    if (!tea_test::expect(server.start(&error), "server should start")) {
+      std::cerr << error << '\n';
+      return false;
+    }
+    ok = tea_test::expect(server.worker_count() == 2,
+                          "server should start the requested workers") && ok;
+    std::thread runner([&] { server.run(); });
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, options.socket_path.data(),
+                options.socket_path.size());
+    ok = tea_test::expect(
+             ::connect(fd, reinterpret_cast<const sockaddr*>(&addr),
+                       sizeof(addr)) == 0,
+             "client should connect") && ok;
+
+    /* 2 要求をまとめて送り、応答もまとめて受け取れることを確認します。 */
+    const std::string batch = "ping\r\nsimulate drying=90\n";
+    ok = tea_test::expect(::send(fd, batch.data(), batch.size(), 0) ==
+                              static_cast<ssize_t>(batch.size()),
+                          "client should send requests") && ok;
+    tea::SimulationConfig config;
+    config.drying_seconds = 90;
+    ok = tea_test::expect(read_lines(fd, 2) ==
+                              "pong\n" +
+                                  expected_simulate(config, tea::TeaLeaf()),
+                          "pipelined requests should be answered in order") &&
+         ok;
+
+    const std::string stop = "shutdown\n";
+    ::send(fd, stop.data(), stop.size(), 0);
+    ok = tea_test::expect(read_lines(fd, 1) == "ok\n",
+                          "shutdown should be acknowledged") && ok;
+    runner.join();
+    ::close(fd);
+    ok = tea_test::expect(server.requests() == 3,
+                          "server should count handled requests") && ok;
+  }
+  ok = tea_test::expect(::access(options.socket_path.c_str(), F_OK) != 0,
+                        "socket file should be removed") && ok;
+  return ok;
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_simulate_matches_simulator() && ok;
+  ok = test_sweep_streams_rows() && ok;
+  ok = test_errors_and_control() && ok;
+  ok = test_socket_round_trip() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "server_tests: OK\n";
+  return 0;
+}
@@ -7,6 +7,9 @@
 
 #include "simulation/Simulator.h"
 
+#include <cstdint>
+#include <vector>
+
 #include "test_utils.h"
 
 namespace {
@@ -109,6 +112,81 @@ bool test_dt_non_positive_is_rejected() {
   return ok0 && ok1 && ok2;
 }
 
+/*
+ * @brief 1 秒未満の dt でも工程の境界と合計時間をミリ秒単位で正確に踏むことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_fractional_dt_hits_stage_boundaries() {
+  bool ok = true;
+  const double dts[] = {0.1, 0.7, 0.001};
+  for (const double dt : dts) {
+    tea::SimulationConfig config;
+    config.dt_seconds = dt;
+    config.steaming_seconds = 3;
+    config.rolling_seconds = 2;
+    config.drying_seconds = 4;
+    tea::Simulator sim(config);
+
+    std::vector<std::int64_t> stage_ends;
+    tea::ProcessState last = sim.current_process();
+    std::int64_t last_ms = 0;
+    while (sim.step(dt, nullptr)) {
+      if (sim.current_process() != last) {
+        stage_ends.push_back(last_ms);
+        last = sim.current_process();
+      }
+      last_ms = sim.elapsed_milliseconds();
+    }
+    stage_ends.push_back(last_ms);
+
+    ok = tea_test::expect(stage_ends.size() == 3 && stage_ends[0] == 3000 &&
+                              stage_ends[1] == 5000 && stage_ends[2] == 9000,
+                          "stages should end exactly at 3s, 5s and 9s") && ok;
+    ok = tea_test::expect(sim.elapsed_seconds() == 9.0,
+                          "elapsed_seconds should be exactly the total") && ok;
+  }
+  return ok;
+}
+
+/*
+ * @brief 出力間隔ごとにまとめて進めても、1 刻みずつ進めた結果とビット単位で一致することを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_substeps_match_single_steps() {
+  tea::SimulationConfig config;
+  config.dt_seconds = 0.1;
+  config.steaming_seconds = 3;
+  config.rolling_seconds = 2;
+  config.drying_seconds = 5;
+  const int substeps = 7;
+
+  tea::Simulator fine(config);
+  tea::Simulator coarse(config);
+  bool ok = true;
+  int rows = 0;
+  while (coarse.step(config.dt_seconds, substeps, nullptr)) {
+    ++rows;
+    /* 出力時刻（substeps 刻みごとか工程の終わり）まで 1 刻みずつ進めます。 */
+    while (fine.elapsed_milliseconds() < coarse.elapsed_milliseconds()) {
+      ok = tea_test::expect(fine.step(config.dt_seconds, nullptr),
+                            "single steps should not finish early") && ok;
+    }
+    ok = tea_test::expect(
+             fine.elapsed_milliseconds() == coarse.elapsed_milliseconds() &&
+                 fine.leaf().moisture == coarse.leaf().moisture &&
+                 fine.leaf().temperature_c == coarse.leaf().temperature_c &&
+                 fine.leaf().aroma == coarse.leaf().aroma &&
+                 fine.leaf().color == coarse.leaf().color,
+             "batched steps should match single steps bit for bit") && ok;
+  }
+  /* 工程ごとに ceil(30/7), ceil(20/7), ceil(50/7) 行です。 */
+  ok = tea_test::expect(rows == 5 + 3 + 8, "one row per sample or stage end")
+       && ok;
+  return ok;
+}
+
 } /* namespace */
 
 /*
@@ -121,6 +199,8 @@ int main() {
   ok = test_dt_is_split_to_fit_stage_duration() && ok;
   ok = test_process_order_progresses() && ok;
   ok = test_dt_non_positive_is_rejected() && ok;
+  ok = test_fractional_dt_hits_stage_boundaries() && ok;
+  ok = test_substeps_match_single_steps() && ok;
 
   if (!ok) {
     return 1;
@@ -0,0 +1,111 @@
+/*
+ * @file test_stats.cpp
+ * @brief ホットパス計測（tea_perf）の集計と JSON 出力の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ * TEAFACTORY_ENABLE_STATS=OFF のビルドでは、計測が 0 のままであることを検証します。
+ */
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "perf/Stats.h"
+#include "simulation/Simulator.h"
+
+#include "test_utils.h"
+
+namespace {
+
+/*
+ * @brief 工程ごとのステップ数が集計されることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_step_counters() {
+  tea_perf::reset();
+  tea::SimulationConfig config;
+  config.dt_seconds = 7;
+  tea::Simulator sim(config);
+  while (sim.step(config.dt_seconds, nullptr)) {
+  }
+  const tea_perf::StatsSnapshot s = tea_perf::collect();
+
+  if (!tea_perf::compiled_in()) {
+    return tea_test::expect(
+        s.counter(tea_perf::Counter::STEAMING_STEPS) == 0,
+        "counters should stay zero when compiled out");
+  }
+
+  bool ok = true;
+  ok = tea_test::expect(s.counter(tea_perf::Counter::STEAMING_STEPS) == 5,
+                        "steaming 30s / dt 7 should be 5 steps") && ok;
+  ok = tea_test::expect(s.counter(tea_perf::Counter::ROLLING_STEPS) == 5,
+                        "rolling 30s / dt 7 should be 5 steps") && ok;
+  ok = tea_test::expect(s.counter(tea_perf::Counter::DRYING_STEPS) == 9,
+                        "drying 60s / dt 7 should be 9 steps") && ok;
+  return ok;
+}
+
+/*
+ * @brief 終了したスレッドのカウンタも集計に含まれることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_thread_counters_are_merged() {
+  tea_perf::reset();
+  std::thread th([] {
+    for (int i = 0; i < 10; ++i) {
+      TEA_STATS_ADD(CSV_ROWS, 1);
+    }
+  });
+  th.join();
+  TEA_STATS_ADD(CSV_ROWS, 5);
+
+  const std::uint64_t expected = tea_perf::compiled_in() ? 15 : 0;
+  return tea_test::expect(
+      tea_perf::collect().counter(tea_perf::Counter::CSV_ROWS) == expected,
+      "thread-local counters should be merged");
+}
+
+/*
+ * @brief JSON 出力に全カウンタ名が含まれることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_json_contains_keys() {
+  tea_perf::StatsSnapshot s;
+  s.counters[static_cast<std::size_t>(tea_perf::Counter::CSV_ROWS)] = 42;
+  std::ostringstream oss;
+  tea_perf::write_json(oss, s);
+  const std::string json = oss.str();
+
+  bool ok = true;
+  ok = tea_test::expect(json.find("\"csv_rows\":42") != std::string::npos,
+                        "json should contain csv_rows") && ok;
+  ok = tea_test::expect(json.find("\"physics\":") != std::string::npos,
+                        "json should contain physics timer") && ok;
+  ok = tea_test::expect(json.front() == '{', "json should be an object")
+       && ok;
+  return ok;
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_step_counters() && ok;
+  ok = test_thread_counters_are_merged() && ok;
+  ok = test_json_contains_keys() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "stats_tests: OK\n";
+  return 0;
+}
@@ -260,6 +260,47 @@ bool test_dt_non_positive_does_not_advance() {
   return ok;
 }
 
+/*
+ * @brief 1 秒未満の物理刻みでも、フレームの区切り方によらず同じ結果になり、
+ * 工程の境界をミリ秒単位で踏むことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_sub_second_time_step() {
+  tea_gui::TeaBatch a;
+  tea_gui::TeaBatch b;
+  a.reset();
+  b.reset();
+  a.set_time_step(0.1);
+  b.set_time_step(0.1);
+
+  a.update(31.0);
+  for (int i = 0; i < 310; ++i) {
+    b.update(0.1);
+  }
+
+  bool ok = true;
+  ok = tea_test::expect(a.time_step_seconds() == 0.1,
+                        "time step should be 0.1s") && ok;
+  ok = tea_test::expect(a.elapsed_seconds() == 31.0 &&
+                            b.elapsed_seconds() == 31.0,
+                        "elapsed_seconds should be exactly 31s") && ok;
+  ok = tea_test::expect(a.process() == b.process() &&
+                            a.moisture() == b.moisture() &&
+                            a.temperature_c() == b.temperature_c() &&
+                            a.aroma() == b.aroma() && a.color() == b.color(),
+                        "frame size should not change the result") && ok;
+
+  tea_gui::TeaBatch c;
+  c.reset();
+  c.set_time_step(0.7);
+  c.update(30.0);
+  ok = tea_test::expect(c.elapsed_seconds() == 30.0 &&
+                            c.process() == tea::ProcessState::ROLLING,
+                        "0.7s steps should stop exactly at the stage end") && ok;
+  return ok;
+}
+
 } /* namespace */
 
 /*
@@ -270,6 +311,7 @@ bool test_dt_non_positive_does_not_advance() {
 int main() {
   bool ok = true;
   ok = test_stage_boundary_carryover() && ok;
+  ok = test_sub_second_time_step() && ok;
   ok = test_reaches_finished() && ok;
   ok = test_model_scaling_effect() && ok;
   ok = test_fractional_dt_accumulation() && ok;
@@ -0,0 +1,91 @@
+/*
+ * @file test_trace.cpp
+ * @brief Chrome trace_event 記録（tea_perf::Trace）の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ */
+
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "perf/Trace.h"
+#include "simulation/Simulator.h"
+
+#include "test_utils.h"
+
+namespace {
+
+/*
+ * @brief 無効時はスパンが記録されないことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_disabled_records_nothing() {
+  tea_perf::trace_stop();
+  tea_perf::trace_clear();
+  {
+    TEA_TRACE_SCOPE("disabled.span", "test");
+  }
+  tea_perf::trace_instant("disabled.instant", "test");
+  return tea_test::expect(tea_perf::trace_event_count() == 0,
+                          "no events should be recorded when disabled");
+}
+
+/*
+ * @brief 複数スレッドのスパンと工程遷移イベントが JSON へ出力されることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_spans_and_stage_events_are_written() {
+  tea_perf::trace_clear();
+  tea_perf::trace_start();
+  {
+    TEA_TRACE_SCOPE("main.span", "test", "value", 7);
+  }
+  std::thread th([] { TEA_TRACE_SCOPE("worker.span", "test"); });
+  th.join();
+
+  tea::Simulator sim;
+  while (sim.step(10, nullptr)) {
+  }
+  tea_perf::trace_stop();
+
+  std::ostringstream oss;
+  tea_perf::trace_write_json(oss);
+  const std::string json = oss.str();
+
+  bool ok = true;
+  ok = tea_test::expect(json.find("\"traceEvents\":[") != std::string::npos,
+                        "json should have traceEvents") && ok;
+  ok = tea_test::expect(json.find("\"main.span\"") != std::string::npos,
+                        "main thread span should be written") && ok;
+  ok = tea_test::expect(json.find("\"worker.span\"") != std::string::npos,
+                        "worker thread span should survive thread exit") && ok;
+  ok = tea_test::expect(json.find("\"args\":{\"value\":7}") != std::string::npos,
+                        "span arg should be written") && ok;
+  ok = tea_test::expect(json.find("\"ROLLING\"") != std::string::npos,
+                        "stage transition should be written") && ok;
+  ok = tea_test::expect(json.find("\"FINISHED\"") != std::string::npos,
+                        "finish should be written") && ok;
+  return ok;
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_disabled_records_nothing() && ok;
+  ok = test_spans_and_stage_events_are_written() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "trace_tests: OK\n";
+  return 0;
+}
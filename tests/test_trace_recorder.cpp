@@ -0,0 +1,186 @@
+/*
+ * @file test_trace_recorder.cpp
+ * @brief ステップごとの記録先（列指向・何もしない・CSV）の検証
+ *
+ * 外部テストフレームワークに依存せず、CTest から実行できる最小の検証を行います。
+ */
+
+#include <sstream>
+#include <string>
+
+#include "io/CsvWriter.h"
+#include "io/OutputSink.h"
+#include "simulation/OutputPlan.h"
+#include "simulation/Simulator.h"
+#include "simulation/TraceRecorder.h"
+#include "test_utils.h"
+
+namespace {
+
+using tea_test::ScopedFile;
+
+/* 一時ファイル名の接頭辞です。 */
+constexpr char kTempPrefix[] = "trace_recorder_test";
+
+/*
+ * @brief TraceRecorder を継承しない記録先です（テンプレートで受け取れることの確認用）。
+ */
+struct CountingRecorder final {
+  int rows = 0;
+  int last_elapsed = 0;
+
+  void record(tea::ProcessState, int elapsed_seconds, const tea::TeaLeaf&) {
+    ++rows;
+    last_elapsed = elapsed_seconds;
+  }
+};
+
+/*
+ * @brief 2 つの茶葉状態が一致するかを返します。
+ */
+bool same_leaf(const tea::TeaLeaf& a, const tea::TeaLeaf& b) {
+  return a.moisture == b.moisture && a.temperature_c == b.temperature_c &&
+         a.aroma == b.aroma && a.color == b.color;
+}
+
+/*
+ * @brief 列指向の記録が各ステップの状態と一致し、予測行数の確保で再確保しないことを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_columnar_matches_steps() {
+  tea::SimulationConfig config;
+  config.dt_seconds = 7;
+  const tea::OutputPlan plan = tea::plan_output(config);
+
+  tea::ColumnarTraceRecorder trace;
+  trace.reserve(plan);
+  const std::size_t capacity = trace.moisture.capacity();
+
+  tea::Simulator a(config);
+  tea::Simulator b(config);
+  bool ok = true;
+  std::size_t i = 0;
+  while (a.step(config.dt_seconds, trace)) {
+    b.step(config.dt_seconds, nullptr);
+    ok = tea_test::expect(same_leaf(trace.leaf(i), b.leaf()),
+                          "recorded leaf should match") && ok;
+    ok = tea_test::expect(trace.elapsed_seconds[i] == b.elapsed_seconds(),
+                          "recorded elapsed should match") && ok;
+    ok = tea_test::expect(trace.process[i] == b.current_process(),
+                          "recorded process should match") && ok;
+    ++i;
+  }
+  ok = tea_test::expect(trace.size() ==
+                            static_cast<std::size_t>(plan.total_rows),
+                        "row count should match the plan") && ok;
+  ok = tea_test::expect(trace.moisture.capacity() == capacity,
+                        "reserved columns should not reallocate") && ok;
+
+  trace.clear();
+  ok = tea_test::expect(trace.size() == 0 &&
+                            trace.moisture.capacity() == capacity,
+                        "clear should keep capacity") && ok;
+  return ok;
+}
+
+/*
+ * @brief 独自の記録先・TraceRecorder 参照・run でも同じ行数が記録されることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_recorder_kinds() {
+  const tea::SimulationConfig config;
+  const tea::OutputPlan plan = tea::plan_output(config);
+
+  tea::Simulator a(config);
+  CountingRecorder counting;
+  while (a.step(config.dt_seconds, counting)) {
+  }
+
+  tea::Simulator b(config);
+  tea::ColumnarTraceRecorder columnar;
+  tea::TraceRecorder& base = columnar;
+  while (b.step(config.dt_seconds, base)) {
+  }
+
+  tea::Simulator c(config);
+  tea::ColumnarTraceRecorder via_run;
+  std::ostringstream log;
+  c.run(log, via_run);
+
+  tea::Simulator d(config);
+  tea::NullTraceRecorder null;
+  while (d.step(config.dt_seconds, null)) {
+  }
+
+  bool ok = true;
+  ok = tea_test::expect(counting.rows == plan.total_rows,
+                        "custom recorder row count") && ok;
+  ok = tea_test::expect(counting.last_elapsed == a.elapsed_seconds(),
+                        "custom recorder last elapsed") && ok;
+  ok = tea_test::expect(columnar.size() ==
+                            static_cast<std::size_t>(plan.total_rows),
+                        "virtual dispatch row count") && ok;
+  ok = tea_test::expect(via_run.size() == columnar.size() &&
+                            via_run.moisture == columnar.moisture,
+                        "run should record the same rows") && ok;
+  ok = tea_test::expect(same_leaf(d.leaf(), a.leaf()),
+                        "null recorder should not change the result") && ok;
+  return ok;
+}
+
+/*
+ * @brief CsvTraceRecorder の出力が CsvWriter* を渡した場合と同じになることを検証します。
+ *
+ * @return 成功なら true
+ */
+bool test_csv_recorder_matches_pointer_overload() {
+  tea::SimulationConfig config;
+  config.dt_seconds = 3;
+  ScopedFile by_pointer(tea_test::make_temp_path(kTempPrefix, ".csv"));
+  ScopedFile by_recorder(tea_test::make_temp_path(kTempPrefix, ".csv"));
+  {
+    tea_io::CsvWriter x(by_pointer.path());
+    tea_io::CsvWriter y(by_recorder.path());
+    x.write_header();
+    y.write_header();
+    tea::CsvTraceRecorder recorder(y);
+    tea::Simulator a(config);
+    tea::Simulator b(config);
+    while (a.step(config.dt_seconds, &x)) {
+      b.step(config.dt_seconds, recorder);
+    }
+  }
+
+  std::string expected;
+  std::string actual;
+  bool ok = true;
+  ok = tea_test::expect(tea_io::read_output_file(by_pointer.path(), expected),
+                        "pointer CSV should be readable") && ok;
+  ok = tea_test::expect(tea_io::read_output_file(by_recorder.path(), actual),
+                        "recorder CSV should be readable") && ok;
+  ok = tea_test::expect(!expected.empty() && actual == expected,
+                        "recorder CSV should match") && ok;
+  return ok;
+}
+
+} /* namespace */
+
+/*
+ * @brief テストのエントリポイントです。
+ *
+ * @return 0: 成功, 1: 失敗
+ */
+int main() {
+  bool ok = true;
+  ok = test_columnar_matches_steps() && ok;
+  ok = test_recorder_kinds() && ok;
+  ok = test_csv_recorder_matches_pointer_overload() && ok;
+
+  if (!ok) {
+    return 1;
+  }
+  std::cout << "trace_recorder_tests: OK\n";
+  return 0;
+}
@@ -7,8 +7,13 @@
 
 #pragma once
 
+#include <chrono>
 #include <cmath>
+#include <cstdio>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
 
 #include "domain/TeaLeaf.h"
 
@@ -74,5 +79,49 @@ inline bool in_bounds(const tea::TeaLeaf& leaf) {
   return ok;
 }
 
+/*
+ * @brief スコープ終了時にファイルを削除するガードです。
+ */
+class ScopedFile final {
+ public:
+  /* 生成したファイルパスを保持します。 */
+  explicit ScopedFile(std::string path) : path_(std::move(path)) {
+  }
+
+  /* コピーは禁止します（2重削除防止）。 */
+  ScopedFile(const ScopedFile&) = delete;
+  ScopedFile& operator=(const ScopedFile&) = delete;
+
+  /* デストラクタで後始末します（失敗しても無視）。 */
+  ~ScopedFile() {
+    if (!path_.empty()) {
+      std::remove(path_.c_str());
+    }
+  }
+
+  /* パスを返します。 */
+  const std::string& path() const {
+    return path_;
+  }
+
+ private:
+  std::string path_;
+};
+
+/*
+ * @brief ほぼ一意なテスト用ファイル名を生成します。
+ *
+ * @param prefix ファイル名の接頭辞（テスト名など）
+ * @param ext 拡張子（"." を含む）
+ * @return カレントディレクトリ上のファイル名
+ */
+inline std::string make_temp_path(const char* prefix, const char* ext) {
+  using clock = std::chrono::steady_clock;
+  const auto now = clock::now().time_since_epoch().count();
+  std::ostringstream oss;
+  oss << prefix << "_" << now << "_" << &oss << ext;
+  return oss.str();
+}
+
 } /* namespace tea_test */
 